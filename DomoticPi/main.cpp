@@ -8,8 +8,8 @@
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <systemd/sd-daemon.h>
 
-#include <mutex>
-#include <condition_variable>
+#include <csignal>
+#include <cstring>
 #include <unistd.h>
 
 using namespace domotic_pi;
@@ -22,6 +22,18 @@ int main(int argc, char** argv)
 
 	console->info("Hello from domotic pi service.");
 
+	// Block SIGUSR1 before any thread is started so that only main thread receives it
+	sigset_t reportSignals;
+	sigemptyset(&reportSignals);
+	sigaddset(&reportSignals, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &reportSignals, nullptr);
+
+	// Inputs and outputs on a GPIO character device chip instead of wiringPi (ie. a gpio-sim chip)
+	if (argc > 2 && strcmp(argv[1], "--gpio-chip") == 0) {
+		console->info("Using GPIO chip '{}'.", argv[2]);
+		IGpioBackend::set(std::make_shared<ChardevGpio>(argv[2]));
+	}
+
 	int retval = domoticPiInit();
 	if (retval) {
 		console->critical("DomoticPi setup went wrong.");
@@ -75,12 +87,15 @@ int main(int argc, char** argv)
 	// Notify systemd for initialization completed
 	sd_notify(0, "READY=1");
 
-	std::mutex mWake;
-	bool wake = false;
-	std::condition_variable wakeCond;
+	// Dump runtime statistics each time SIGUSR1 is received
+	int signal;
+	while (sigwait(&reportSignals, &signal) == 0) {
+		rapidjson::StringBuffer statsBuffer;
+		rapidjson::PrettyWriter<rapidjson::StringBuffer> statsWriter(statsBuffer);
+		localNode->stats_to_json().Accept(statsWriter);
 
-	std::unique_lock<std::mutex> lock(mWake);
-	wakeCond.wait(lock, [&wake] { return wake; });
+		console->info("Statistics report :\n{}", statsBuffer.GetString());
+	}
 
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,314 @@
+#include <PtyPeer.h>
+
+#include <exceptions.h>
+#include <SerialLink.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+using namespace domotic_pi;
+
+namespace {
+
+	constexpr size_t setFrameSize = 11;
+	constexpr size_t ackFrameSize = 6;
+
+	// Poll timeout of the peer thread without pending answer, bounds its stop time
+	constexpr int idlePollMs = 20;
+
+	std::string linkAnswer(uint8_t type, uint8_t seq, uint8_t index)
+	{
+		uint8_t frame[ackFrameSize] = { (uint8_t)(ackFrameSize - 1), type, seq, index };
+
+		uint16_t crc = SerialLink::crc16(frame, ackFrameSize - 2);
+		frame[ackFrameSize - 2] = (uint8_t)(crc >> 8);
+		frame[ackFrameSize - 1] = (uint8_t)crc;
+
+		return std::string((const char*)frame, ackFrameSize);
+	}
+
+}
+
+sim::PtyPeer::PtyPeer(PeerFraming framing) :
+	_framing(framing), _master(-1), _slave(-1),
+	_default(PeerStep{ peer_echo, std::chrono::milliseconds::zero() }), _scriptStep(0), _loop(false),
+	_rxBytes(0), _rxFrames(0), _crcErrors(0), _running(true)
+{
+	char device[256];
+	if (openpty(&_master, &_slave, device, nullptr, nullptr) < 0) {
+		throw domotic_pi_exception(std::string("Could not open a pseudo terminal: ") + strerror(errno));
+	}
+	_device = device;
+
+	// Raw line discipline: bytes go through untouched, both ways
+	struct termios raw;
+	tcgetattr(_slave, &raw);
+	cfmakeraw(&raw);
+	tcsetattr(_slave, TCSANOW, &raw);
+
+	_peerThread = std::thread(&PtyPeer::_peer_loop, this);
+}
+
+sim::PtyPeer::~PtyPeer()
+{
+	_running = false;
+	_peerThread.join();
+
+	close(_slave);
+	close(_master);
+}
+
+bool sim::PtyPeer::parseScript(const std::string& text, std::vector<PeerStep>& script)
+{
+	static const std::map<std::string, PeerAction> actions = {
+		{ "ignore", peer_ignore }, { "echo", peer_echo }, { "ack", peer_ack },
+		{ "nack", peer_nack }, { "corrupt", peer_corrupt }
+	};
+
+	script.clear();
+
+	size_t start = 0;
+	while (start <= text.size()) {
+		size_t end = text.find(',', start);
+		std::string item = text.substr(start, end == std::string::npos ? std::string::npos : end - start);
+
+		PeerStep step{ peer_echo, std::chrono::milliseconds::zero() };
+
+		size_t at = item.find('@');
+		if (at != std::string::npos) {
+			char* last;
+			long delay = strtol(item.c_str() + at + 1, &last, 10);
+			if (*last != '\0' || delay < 0 || at + 1 == item.size()) {
+				return false;
+			}
+			step.delay = std::chrono::milliseconds(delay);
+			item.resize(at);
+		}
+
+		auto action = actions.find(item);
+		if (action == actions.end()) {
+			return false;
+		}
+		step.action = action->second;
+		script.push_back(step);
+
+		if (end == std::string::npos) {
+			break;
+		}
+		start = end + 1;
+	}
+
+	return !script.empty();
+}
+
+const std::string& sim::PtyPeer::getDevice() const
+{
+	return _device;
+}
+
+void sim::PtyPeer::setDefault(PeerStep step)
+{
+	std::unique_lock<std::mutex> lock(_peerLock);
+	_default = step;
+}
+
+void sim::PtyPeer::setScript(const std::vector<PeerStep>& script, bool loop)
+{
+	std::unique_lock<std::mutex> lock(_peerLock);
+	_script = script;
+	_scriptStep = 0;
+	_loop = loop;
+}
+
+void sim::PtyPeer::setFrameCallback(std::function<void(const std::string& frame)> callback)
+{
+	std::unique_lock<std::mutex> lock(_peerLock);
+	_frameCallback = callback;
+}
+
+void sim::PtyPeer::send(const std::string& bytes)
+{
+	std::unique_lock<std::mutex> lock(_peerLock);
+	_write_all(bytes);
+}
+
+bool sim::PtyPeer::waitFrames(uint64_t count, std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(_peerLock);
+	return _frameChange.wait_for(lock, timeout, [this, count] { return _rxFrames >= count; });
+}
+
+uint64_t sim::PtyPeer::getReceivedBytes() const
+{
+	std::unique_lock<std::mutex> lock(_peerLock);
+	return _rxBytes;
+}
+
+uint64_t sim::PtyPeer::getReceivedFrames() const
+{
+	std::unique_lock<std::mutex> lock(_peerLock);
+	return _rxFrames;
+}
+
+uint64_t sim::PtyPeer::getCrcErrors() const
+{
+	std::unique_lock<std::mutex> lock(_peerLock);
+	return _crcErrors;
+}
+
+bool sim::PtyPeer::getLinkValue(uint8_t index, int32_t& value) const
+{
+	std::unique_lock<std::mutex> lock(_peerLock);
+
+	auto linkValue = _linkValues.find(index);
+	if (linkValue == _linkValues.end()) {
+		return false;
+	}
+
+	value = linkValue->second;
+	return true;
+}
+
+void sim::PtyPeer::_peer_loop()
+{
+	char buffer[4096];
+
+	while (_running) {
+		int timeout = idlePollMs;
+		{
+			std::unique_lock<std::mutex> lock(_peerLock);
+
+			// Delayed answers due
+			auto now = std::chrono::steady_clock::now();
+			while (!_answers.empty() && _answers.begin()->first <= now) {
+				_write_all(_answers.begin()->second);
+				_answers.erase(_answers.begin());
+			}
+
+			if (!_answers.empty()) {
+				auto wait = std::chrono::ceil<std::chrono::milliseconds>(_answers.begin()->first - now);
+				timeout = std::min(timeout, (int)wait.count());
+			}
+		}
+
+		struct pollfd master = { _master, POLLIN, 0 };
+		if (poll(&master, 1, timeout) <= 0 || !(master.revents & POLLIN)) {
+			continue;
+		}
+
+		ssize_t size = read(_master, buffer, sizeof(buffer));
+		if (size <= 0) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_peerLock);
+
+		_rxBytes += size;
+
+		if (_framing == peer_raw) {
+			_handle_frame(std::string(buffer, size));
+			continue;
+		}
+
+		_rxBuffer.append(buffer, size);
+
+		while (!_rxBuffer.empty()) {
+			size_t length;
+			if (_framing == peer_lines) {
+				size_t end = _rxBuffer.find('\n');
+				if (end == std::string::npos) {
+					break;
+				}
+				length = end + 1;
+			}
+			else {
+				length = 1 + (uint8_t)_rxBuffer[0];
+				if (_rxBuffer.size() < length) {
+					break;
+				}
+			}
+
+			_handle_frame(_rxBuffer.substr(0, length));
+			_rxBuffer.erase(0, length);
+		}
+	}
+}
+
+void sim::PtyPeer::_handle_frame(const std::string& frame)
+{
+	PeerStep step = _default;
+	if (_scriptStep < _script.size()) {
+		step = _script[_scriptStep++];
+		if (_loop && _scriptStep == _script.size()) {
+			_scriptStep = 0;
+		}
+	}
+
+	std::string answer;
+
+	if (_framing == peer_link && step.action != peer_ignore && step.action != peer_echo) {
+		const uint8_t* bytes = (const uint8_t*)frame.data();
+		bool valid = frame.size() == setFrameSize && bytes[1] == link_set &&
+			SerialLink::crc16(bytes, setFrameSize - 2) == (uint16_t)(bytes[setFrameSize - 2] << 8 | bytes[setFrameSize - 1]);
+
+		if (!valid) {
+			_crcErrors++;
+		}
+		else if (step.action != peer_nack) {
+			_linkValues[bytes[3]] = (int32_t)((uint32_t)bytes[4] << 24 | (uint32_t)bytes[5] << 16 | (uint32_t)bytes[6] << 8 | bytes[7]);
+		}
+
+		uint8_t type = valid && step.action != peer_nack ? link_ack : link_nack;
+		answer = linkAnswer(type, frame.size() > 2 ? bytes[2] : 0, frame.size() > 3 ? bytes[3] : 0);
+	}
+	else if (step.action == peer_echo || (step.action == peer_corrupt && _framing != peer_link)) {
+		answer = frame;
+	}
+	else if (step.action == peer_ack) {
+		answer = "ok\n";
+	}
+	else if (step.action == peer_nack) {
+		answer = "nok\n";
+	}
+
+	if (step.action == peer_corrupt && !answer.empty()) {
+		answer.back() ^= 0x5a;
+	}
+
+	_rxFrames++;
+	if (_frameCallback) {
+		_frameCallback(frame);
+	}
+	_frameChange.notify_all();
+
+	if (answer.empty()) {
+		return;
+	}
+
+	if (step.delay.count() > 0) {
+		_answers.emplace(std::chrono::steady_clock::now() + step.delay, answer);
+	}
+	else {
+		_write_all(answer);
+	}
+}
+
+void sim::PtyPeer::_write_all(const std::string& bytes)
+{
+	for (size_t offset = 0; offset < bytes.size(); ) {
+		ssize_t written = write(_master, bytes.data() + offset, bytes.size() - offset);
+		if (written < 0) {
+			if (errno == EINTR || errno == EAGAIN) {
+				continue;
+			}
+			return;
+		}
+		offset += written;
+	}
+}
@@ -0,0 +1,158 @@
+#ifndef DOMOTIC_PI_SIM_PTY_PEER
+#define DOMOTIC_PI_SIM_PTY_PEER
+
+#include <domoticPiDefine.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace domotic_pi {
+
+	namespace sim {
+
+		// How the peer splits the bytes written by the library
+		enum PeerFraming {
+			peer_raw = 0,		// no framing: each read chunk is handled as one frame
+			peer_lines = 1,		// frames ended by a new line
+			peer_link = 2		// serial link frames, prefixed by their length on one byte
+		};
+
+		// Answer of the peer to a received frame
+		enum PeerAction {
+			peer_ignore = 0,	// nothing sent back, as if the frame was lost
+			peer_echo = 1,		// frame sent back as received
+			peer_ack = 2,		// link ack of a valid set frame (nack if its CRC is wrong), "ok" line otherwise
+			peer_nack = 3,		// link nack, "nok" line otherwise
+			peer_corrupt = 4	// ack or echo sent back with its last byte flipped
+		};
+
+		struct PeerStep {
+			PeerAction action;
+			std::chrono::milliseconds delay;
+		};
+
+		/**
+		 *	Fake serial device on a pseudo terminal: the library opens getDevice() as a serial port
+		 *	(the mocked serialOpen opens existing devices for real) while a peer thread reads what is
+		 *	written and answers each frame following a script, on a real clock.
+		 */
+		class PtyPeer {
+		public:
+			/**
+			 *	@brief Open a raw pseudo terminal and start the peer thread
+			 *
+			 *	@throws domotic_pi_exception if no pseudo terminal can be opened
+			 */
+			PtyPeer(PeerFraming framing = peer_raw);
+
+			PtyPeer(const PtyPeer&) = delete;
+			PtyPeer& operator= (const PtyPeer&) = delete;
+			~PtyPeer();
+
+			/**
+			 *	@brief Parse a comma separated script of actions, each one optionally delayed
+			 *		   by a number of milliseconds (ie. "ack,ack,ignore,corrupt@5,nack@20")
+			 *
+			 *	@return false if the script is not valid
+			 */
+			static bool parseScript(const std::string& text, std::vector<PeerStep>& script);
+
+			/**
+			 *	@brief Get the device name to open as serial port
+			 */
+			const std::string& getDevice() const;
+
+			/**
+			 *	@brief Set the answer to frames received past the script, peer_echo by default
+			 */
+			void setDefault(PeerStep step);
+
+			/**
+			 *	@brief Set the answers to the next received frames, in order
+			 *
+			 *	@param loop run the script again once ended instead of the default step
+			 */
+			void setScript(const std::vector<PeerStep>& script, bool loop = false);
+
+			/**
+			 *	@brief Get notified of each received frame, on the peer thread
+			 */
+			void setFrameCallback(std::function<void(const std::string& frame)> callback);
+
+			/**
+			 *	@brief Write given bytes to the library, as the device would
+			 */
+			void send(const std::string& bytes);
+
+			/**
+			 *	@brief Wait until given number of frames have been received
+			 *
+			 *	@return false on timeout
+			 */
+			bool waitFrames(uint64_t count, std::chrono::milliseconds timeout);
+
+			uint64_t getReceivedBytes() const;
+
+			uint64_t getReceivedFrames() const;
+
+			/**
+			 *	@brief Get the number of link set frames received with a wrong CRC
+			 */
+			uint64_t getCrcErrors() const;
+
+			/**
+			 *	@brief Get the last value acked for given module of the serial link
+			 *
+			 *	@return false if no value has been acked for the module
+			 */
+			bool getLinkValue(uint8_t index, int32_t& value) const;
+
+		private:
+			const PeerFraming _framing;
+			int _master;
+			int _slave;
+			std::string _device;
+
+			mutable std::mutex _peerLock;
+			std::condition_variable _frameChange;
+			PeerStep _default;
+			std::vector<PeerStep> _script;
+			size_t _scriptStep;
+			bool _loop;
+			std::function<void(const std::string&)> _frameCallback;
+			std::map<uint8_t, int32_t> _linkValues;
+
+			// Delayed answers, by due time
+			std::multimap<std::chrono::steady_clock::time_point, std::string> _answers;
+
+			std::string _rxBuffer;
+			uint64_t _rxBytes;
+			uint64_t _rxFrames;
+			uint64_t _crcErrors;
+
+			std::atomic<bool> _running;
+			std::thread _peerThread;
+
+			void _peer_loop();
+
+			/**
+			 *	@brief Answer given frame following the script, called with peer lock held
+			 */
+			void _handle_frame(const std::string& frame);
+
+			void _write_all(const std::string& bytes);
+		};
+
+	}
+
+}
+
+#endif // !DOMOTIC_PI_SIM_PTY_PEER
@@ -0,0 +1,106 @@
+#include <libDomoticPi.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace domotic_pi;
+
+static void printUsage()
+{
+	fprintf(stderr,
+		"Usage: gpioBatchBench [outputCount] [triggerCount]\n"
+		"\n"
+		"Measure the programmed event trigger path: two events switch all the DigitalSwitch\n"
+		"outputs of a simulated GPIO on and off in turn. Statistics are printed on stdout, the\n"
+		"exit code is not zero if the outputs switched by any trigger have not been written\n"
+		"together in one backend operation.\n"
+		"\n"
+		"  outputCount   number of outputs switched by each event, spread over the pins (default 8)\n"
+		"  triggerCount  number of event triggers (default 10000)\n");
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 3) {
+		printUsage();
+		return -1;
+	}
+
+	size_t outputCount = argc > 1 ? strtoul(argv[1], nullptr, 10) : 8;
+	size_t triggerCount = argc > 2 ? strtoul(argv[2], nullptr, 10) : 10000;
+
+	if (outputCount < 2 || outputCount > DOMOTIC_PI_MAX_PIN + 1 || triggerCount == 0) {
+		printUsage();
+		return -1;
+	}
+
+	auto console = spdlog::stderr_color_mt("gpioBatchBench");
+	console->set_level(spdlog::level::level_enum::critical);
+	setConsole(console);
+
+	auto gpio = std::make_shared<SimulatedGpio>();
+	IGpioBackend::set(gpio);
+
+	// Outputs spread over the pins, so banks are not written by contiguous masks only
+	std::vector<int> pins;
+	std::vector<std::shared_ptr<DigitalSwitch>> outputs;
+	for (size_t i = 0; i < outputCount; ++i) {
+		int pin = (int)(i * (DOMOTIC_PI_MAX_PIN + 1) / outputCount);
+		pins.push_back(pin);
+		outputs.push_back(std::make_shared<DigitalSwitch>("out" + std::to_string(i), pin));
+	}
+
+	auto on = std::make_shared<ProgrammedEvent>("on");
+	auto off = std::make_shared<ProgrammedEvent>("off");
+	for (auto& output : outputs) {
+		on->addOutputAction(output, 1);
+		off->addOutputAction(output, 0);
+	}
+
+	LatencyHistogram triggerLatency;
+	size_t together = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t trigger = 0; trigger < triggerCount; ++trigger) {
+		gpio->clearWrites();
+
+		Timestamp called = Clock::now();
+		(trigger % 2 ? off : on)->triggerEvent();
+		triggerLatency.recordSince(called);
+
+		if (gpio->writtenTogether(pins)) {
+			++together;
+		}
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	rapidjson::Document result(rapidjson::kObjectType);
+	auto& allocator = result.GetAllocator();
+
+	result.AddMember("outputs", (uint64_t)outputCount, allocator);
+	result.AddMember("triggers", (uint64_t)triggerCount, allocator);
+	result.AddMember("seconds", seconds, allocator);
+	result.AddMember("triggers_per_s", triggerCount / seconds, allocator);
+
+	rapidjson::Value latency(triggerLatency.to_json(), allocator);
+	result.AddMember("trigger_latency", latency, allocator);
+
+	result.AddMember("written_together", (uint64_t)together, allocator);
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+	result.Accept(writer);
+	printf("%s\n", buffer.GetString());
+
+	return together == triggerCount ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+#include <libDomoticPi.h>
+#include <PtyPeer.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace domotic_pi;
+
+static void printUsage()
+{
+	fprintf(stderr,
+		"Usage: serialBench [frameSize] [frameCount] [delimiter|length]\n"
+		"\n"
+		"Measure the SerialInterface receive path: frames are written as fast as possible to a\n"
+		"pseudo terminal whose other end is read by a SerialInterface, received frames are\n"
+		"checked and throughput statistics are printed on stdout.\n"
+		"\n"
+		"  frameSize   payload bytes per frame (default 64)\n"
+		"  frameCount  number of frames sent (default 200000)\n"
+		"  framing     frames ended by a new line or prefixed by a 2 bytes length (default delimiter)\n");
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 4 || (argc > 1 && !strcmp(argv[1], "--help"))) {
+		printUsage();
+		return -1;
+	}
+
+	size_t frameSize = argc > 1 ? strtoul(argv[1], nullptr, 10) : 64;
+	size_t frameCount = argc > 2 ? strtoul(argv[2], nullptr, 10) : 200000;
+	bool lengthFraming = argc > 3 && !strcmp(argv[3], "length");
+
+	if (frameSize == 0 || frameSize + 2 > DOMOTIC_PI_SERIAL_RX_BUFFER || frameCount == 0) {
+		fprintf(stderr, "Frame size must be between 1 and %d bytes.\n", DOMOTIC_PI_SERIAL_RX_BUFFER - 2);
+		return -1;
+	}
+
+	auto console = spdlog::stderr_color_mt("serialBench");
+	console->set_level(spdlog::level::level_enum::warn);
+	setConsole(console);
+
+	// Fake device only sending
+	sim::PtyPeer peer;
+	peer.setDefault(sim::PeerStep{ sim::peer_ignore, std::chrono::milliseconds::zero() });
+
+	// One frame pattern, frames carry their sequence number in their first byte
+	std::string frame;
+	if (lengthFraming) {
+		frame.push_back((char)(frameSize >> 8));
+		frame.push_back((char)(frameSize & 0xff));
+	}
+	size_t payloadStart = frame.size();
+	for (size_t i = 0; i < frameSize; ++i) {
+		frame.push_back((char)('a' + i % 26));
+	}
+	if (!lengthFraming) {
+		frame.push_back('\n');
+	}
+
+	std::mutex doneLock;
+	std::condition_variable doneChange;
+	std::atomic<size_t> received(0);
+	std::atomic<size_t> corrupted(0);
+
+	auto serial = std::make_shared<SerialInterface>("bench", peer.getDevice(), 115200, -1, -1);
+	if (lengthFraming) {
+		serial->setLengthPrefix(2);
+	}
+
+	auto token = serial->addFrameCallback([&](std::string_view payload, Timestamp timestamp) {
+		size_t sequence = received.load(std::memory_order_relaxed);
+		if (payload.size() != frameSize || payload[0] != (char)('A' + sequence % 26)) {
+			corrupted++;
+		}
+
+		if (received.fetch_add(1, std::memory_order_relaxed) + 1 == frameCount) {
+			std::unique_lock<std::mutex> lock(doneLock);
+			doneChange.notify_all();
+		}
+	});
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::thread writer([&] {
+		// Frames are written in chunks, as a fast peripheral would send them
+		std::string chunk;
+		size_t sent = 0;
+
+		while (sent < frameCount) {
+			chunk.clear();
+			while (sent < frameCount && chunk.size() + frame.size() <= 16384) {
+				frame[payloadStart] = (char)('A' + sent % 26);
+				chunk.append(frame);
+				++sent;
+			}
+
+			peer.send(chunk);
+		}
+	});
+
+	{
+		std::unique_lock<std::mutex> lock(doneLock);
+		doneChange.wait_for(lock, std::chrono::seconds(60), [&] {
+			return received.load() >= frameCount;
+		});
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	writer.join();
+	token.reset();
+
+	rapidjson::Document result(rapidjson::kObjectType);
+	auto& allocator = result.GetAllocator();
+
+	result.AddMember("framing", rapidjson::StringRef(lengthFraming ? "length" : "delimiter"), allocator);
+	result.AddMember("frame_size", (uint64_t)frameSize, allocator);
+	result.AddMember("frames_sent", (uint64_t)frameCount, allocator);
+	result.AddMember("frames_received", (uint64_t)received.load(), allocator);
+	result.AddMember("frames_corrupted", (uint64_t)corrupted.load(), allocator);
+	result.AddMember("seconds", seconds, allocator);
+	result.AddMember("frames_per_s", received.load() / seconds, allocator);
+	result.AddMember("mbytes_per_s", serial->getReceivedBytes() / seconds / 1e6, allocator);
+
+	rapidjson::Value stats(serial->stats_to_json(), allocator);
+	result.AddMember("serial", stats, allocator);
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> writerJson(buffer);
+	result.Accept(writerJson);
+	printf("%s\n", buffer.GetString());
+
+	serial.reset();
+
+	return received.load() == frameCount && corrupted.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+#include <libDomoticPi.h>
+#include <PtyPeer.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace domotic_pi;
+
+static void printUsage()
+{
+	fprintf(stderr,
+		"Usage: serialLinkBench [text|binary] [commandCount] [outputCount] [script]\n"
+		"\n"
+		"Measure the SerialOutput transmit path: commands are set as fast as possible on serial\n"
+		"outputs sharing a pseudo terminal, whose other end is a fake device answering following\n"
+		"the script. Statistics are printed on stdout, the exit code is not zero if the device\n"
+		"does not end with the last value of every output.\n"
+		"\n"
+		"  protocol      text commands, or binary commands acked by the device (default binary)\n"
+		"  commandCount  number of values set (default 100000)\n"
+		"  outputCount   number of outputs the values are spread over, up to 26 (default 4)\n"
+		"  script        device answers to the received frames, repeated: comma separated\n"
+		"                ignore, echo, ack, nack or corrupt, each one optionally delayed by\n"
+		"                @milliseconds (default ack for binary, ignore for text)\n");
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 5 || (argc > 1 && strcmp(argv[1], "text") && strcmp(argv[1], "binary"))) {
+		printUsage();
+		return -1;
+	}
+
+	bool binary = argc < 2 || !strcmp(argv[1], "binary");
+	size_t commandCount = argc > 2 ? strtoul(argv[2], nullptr, 10) : 100000;
+	size_t outputCount = argc > 3 ? strtoul(argv[3], nullptr, 10) : 4;
+
+	std::vector<sim::PeerStep> script;
+	if (argc > 4 && !sim::PtyPeer::parseScript(argv[4], script)) {
+		fprintf(stderr, "Invalid script '%s'.\n", argv[4]);
+		return -1;
+	}
+
+	if (commandCount == 0 || outputCount == 0 || outputCount > 26) {
+		printUsage();
+		return -1;
+	}
+
+	auto console = spdlog::stderr_color_mt("serialLinkBench");
+	console->set_level(spdlog::level::level_enum::critical);
+	setConsole(console);
+
+	sim::PtyPeer peer(binary ? sim::peer_link : sim::peer_raw);
+	peer.setDefault(sim::PeerStep{ binary ? sim::peer_ack : sim::peer_ignore, std::chrono::milliseconds::zero() });
+	peer.setScript(script, true);
+
+	// Text commands are not framed: the stream is kept to find the last value of each output
+	std::string textStream;
+	if (!binary) {
+		peer.setFrameCallback([&textStream](const std::string& frame) {
+			textStream.append(frame);
+		});
+	}
+
+	auto serial = std::make_shared<SerialInterface>("bench", peer.getDevice(), 115200, -1, -1);
+
+	// Single letter ids, so the text stream of id and value pairs can be split back
+	std::vector<std::shared_ptr<SerialOutput>> outputs;
+	for (size_t i = 0; i < outputCount; ++i) {
+		outputs.push_back(std::make_shared<SerialOutput>(
+			std::string(1, (char)('a' + i)), serial, 0, (int)commandCount, binary ? (int)i : -1));
+	}
+
+	LatencyHistogram setLatency;
+	std::vector<int> lastValues(outputCount, 0);
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t command = 1; command <= commandCount; ++command) {
+		size_t output = command % outputCount;
+
+		Timestamp called = Clock::now();
+		outputs[output]->setValue((int)command);
+		setLatency.recordSince(called);
+
+		lastValues[output] = (int)command;
+	}
+
+	double setSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// Written, acked or given up, then received by the device up to the last transmitted frame
+	serial->flush();
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+	if (binary) {
+		auto link = serial->getLink();
+		while (link->getPendingCount() > 0 && std::chrono::steady_clock::now() < deadline) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		// Frames of superseded commands may still be in flight
+		while (peer.getReceivedFrames() < link->stats_to_json()["tx_frames"].GetUint64() &&
+			std::chrono::steady_clock::now() < deadline) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	else {
+		while (peer.getReceivedBytes() < serial->stats_to_json()["tx_bytes"].GetUint64() &&
+			std::chrono::steady_clock::now() < deadline) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// Device state against the last value set on each output
+	size_t consistent = 0;
+	std::map<char, int> textValues;
+	for (size_t i = 0; i < textStream.size(); ) {
+		char id = textStream[i++];
+		size_t digits = i;
+		while (i < textStream.size() && isdigit((unsigned char)textStream[i])) {
+			++i;
+		}
+		textValues[id] = atoi(textStream.substr(digits, i - digits).c_str());
+	}
+
+	for (size_t i = 0; i < outputCount; ++i) {
+		int32_t value = -1;
+		if (binary) {
+			peer.getLinkValue((uint8_t)i, value);
+		}
+		else if (textValues.count((char)('a' + i))) {
+			value = textValues[(char)('a' + i)];
+		}
+
+		if (value == lastValues[i]) {
+			++consistent;
+		}
+	}
+
+	rapidjson::Document result(rapidjson::kObjectType);
+	auto& allocator = result.GetAllocator();
+
+	result.AddMember("protocol", rapidjson::StringRef(binary ? "binary" : "text"), allocator);
+	result.AddMember("commands", (uint64_t)commandCount, allocator);
+	result.AddMember("outputs", (uint64_t)outputCount, allocator);
+	result.AddMember("set_seconds", setSeconds, allocator);
+	result.AddMember("seconds", seconds, allocator);
+	result.AddMember("commands_per_s", commandCount / seconds, allocator);
+
+	rapidjson::Value latency(setLatency.to_json(), allocator);
+	result.AddMember("set_latency", latency, allocator);
+
+	result.AddMember("device_bytes", peer.getReceivedBytes(), allocator);
+	result.AddMember("device_frames", peer.getReceivedFrames(), allocator);
+	result.AddMember("device_crc_errors", peer.getCrcErrors(), allocator);
+	result.AddMember("consistent_outputs", (uint64_t)consistent, allocator);
+
+	rapidjson::Value stats(serial->stats_to_json(), allocator);
+	result.AddMember("serial", stats, allocator);
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+	result.Accept(writer);
+	printf("%s\n", buffer.GetString());
+
+	outputs.clear();
+	serial.reset();
+
+	return consistent == outputCount ? 0 : 1;
+}
@@ -0,0 +1,302 @@
+#include <libDomoticPi.h>
+#include <Simulation.h>
+#include <rapidjson/error/en.h>
+#include <rapidjson/filereadstream.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace domotic_pi;
+
+/**
+ *	Input change to be replayed at given virtual time
+ */
+struct TraceEntry {
+	Timestamp at;
+	int pin;
+	std::string topic;
+	std::string payload;
+	int value;
+};
+
+static bool loadJson(const char * path, rapidjson::Document& json)
+{
+	FILE* jsonFile = fopen(path, "r");
+	if (jsonFile == nullptr) {
+		fprintf(stderr, "Could not open file '%s'.\n", path);
+		return false;
+	}
+
+	char buffer[65535];
+	rapidjson::FileReadStream is(jsonFile, buffer, sizeof(buffer));
+
+	json.ParseStream(is);
+	fclose(jsonFile);
+	if (json.HasParseError()) {
+		fprintf(stderr, "Syntax error detected in '%s' : %s\n", path, rapidjson::GetParseError_En(json.GetParseError()));
+		return false;
+	}
+
+	return true;
+}
+
+static void printUsage()
+{
+	fprintf(stderr,
+		"Usage: domoticPiSim <nodeConfig.json> <trace.json> [options]\n"
+		"\n"
+		"Replay a trace of input changes on a virtual clock against the given node configuration,\n"
+		"printing the resulting command stream on stdout and timing statistics on stderr.\n"
+		"\n"
+		"Trace format: { \"trace\": [ entry, ... ] }, each entry has an \"at\" time in seconds and one of\n"
+		"  \"input\": id, \"value\": n             drive a DigitalButton pin or publish on a MqttButton topic\n"
+		"  \"pin\": n, \"value\": n                drive a raw pin level\n"
+		"  \"topic\": t, \"payload\": p            publish a raw mqtt message\n"
+		"\n"
+		"Options:\n"
+		"  --echo           emulated devices answer cmnd/<topic> with the same payload on stat/<topic>\n"
+		"  --tail <s>       virtual seconds to keep running after the last trace entry (default 10)\n"
+		"  --verbose        print library log messages on stderr\n");
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3) {
+		printUsage();
+		return -1;
+	}
+
+	bool verbose = false;
+	double tailSeconds = 10;
+	for (int i = 3; i < argc; ++i) {
+		if (strcmp(argv[i], "--echo") == 0) {
+			sim::setDeviceEcho(true);
+		}
+		else if (strcmp(argv[i], "--tail") == 0 && i + 1 < argc) {
+			tailSeconds = std::stod(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--verbose") == 0) {
+			verbose = true;
+		}
+		else {
+			printUsage();
+			return -1;
+		}
+	}
+
+	// Virtual time must be set before any library module starts using the timer wheel
+	Clock::setVirtual();
+	const Timestamp start = Clock::now();
+	const std::shared_ptr<TimerWheel> timerWheel = TimerWheel::load();
+	const std::shared_ptr<EventDispatcher> eventDispatcher = EventDispatcher::load();
+
+	// Pins are kept in memory, writes are part of the command stream
+	const std::shared_ptr<SimulatedGpio> gpio = std::make_shared<SimulatedGpio>();
+	gpio->setRecordWrites(false);
+	gpio->setWriteCallback([](const SimulatedGpio::Write& write) {
+		sim::recordCommand("gpio", std::to_string(write.pin), std::to_string(write.value));
+	});
+	IGpioBackend::set(gpio);
+
+	// PWM edges are produced by the replay loop on the simulated pins
+	const std::shared_ptr<PwmScheduler> pwmScheduler = PwmScheduler::load();
+
+	// Keep stdout for the command stream only
+	auto console = spdlog::stderr_color_mt("simulator");
+	console->set_level(verbose ? spdlog::level::level_enum::debug : spdlog::level::level_enum::warn);
+	setConsole(console);
+
+	if (domoticPiInit()) {
+		fprintf(stderr, "DomoticPi setup went wrong.\n");
+		return -1;
+	}
+
+	rapidjson::Document configJson;
+	rapidjson::Document traceJson;
+	if (!loadJson(argv[1], configJson) || !loadJson(argv[2], traceJson)) {
+		return -2;
+	}
+
+	if (!traceJson.IsObject() || !traceJson.HasMember("trace") || !traceJson["trace"].IsArray()) {
+		fprintf(stderr, "Trace file must contain a 'trace' array.\n");
+		return -2;
+	}
+
+	DomoticNode_ptr node;
+	try {
+		node = DomoticNode::from_json(configJson, true);
+	}
+	catch (domotic_pi_exception& dpe) {
+		fprintf(stderr, "Exception while loading given node configuration: %s\n", dpe.what());
+		return -3;
+	}
+
+	// Print each command as soon as it is sent, relative to simulation start
+	size_t commandCount = 0;
+	sim::setCommandSink([&](const sim::Command& command) {
+		++commandCount;
+		printf("%12.3f  %-8s %-32s %s\n",
+			std::chrono::duration<double, std::milli>(command.time - start).count(),
+			command.backend.c_str(), command.target.c_str(), command.value.c_str());
+	});
+
+	// Gestures recognized on buttons are part of the command stream too
+	std::vector<CallbackToken_ptr> gestureTokens;
+	for (auto& input : node->getInputs()) {
+		auto button = std::dynamic_pointer_cast<IButtonStateGenerator>(input);
+		if (button == nullptr) {
+			continue;
+		}
+
+		std::string inputId = input->getID();
+		gestureTokens.push_back(button->addSinglePressCallback([inputId] {
+			sim::recordCommand("gesture", inputId, "single_press");
+		}));
+		gestureTokens.push_back(button->addDoublePressCallback([inputId] {
+			sim::recordCommand("gesture", inputId, "double_press");
+		}));
+		gestureTokens.push_back(button->addMultiPressCallback([inputId](unsigned int clicks) {
+			sim::recordCommand("gesture", inputId, "multi_press " + std::to_string(clicks));
+		}));
+		gestureTokens.push_back(button->addLongPressCallback([inputId] {
+			sim::recordCommand("gesture", inputId, "long_press");
+		}));
+		gestureTokens.push_back(button->addHoldRepeatCallback([inputId] {
+			sim::recordCommand("gesture", inputId, "hold_repeat");
+		}));
+	}
+
+	// Resolve trace entries to pin levels and broker messages
+	std::vector<TraceEntry> trace;
+	for (auto& it : traceJson["trace"].GetArray()) {
+		TraceEntry entry{ start + std::chrono::duration_cast<Timestamp::duration>(
+			std::chrono::duration<double>(it.HasMember("at") ? it["at"].GetDouble() : 0)), -1, "", "", 0 };
+
+		if (it.HasMember("value")) {
+			entry.value = it["value"].GetInt();
+		}
+
+		if (it.HasMember("input")) {
+			Input_ptr input = node->getInput(it["input"].GetString());
+			auto digitalButton = std::dynamic_pointer_cast<DigitalButton>(input);
+
+			if (digitalButton != nullptr) {
+				entry.pin = digitalButton->getPin();
+			}
+			else if (input != nullptr && !input->getListenedTopics().empty()) {
+				entry.topic = input->getListenedTopics().front().second;
+				entry.payload = it.HasMember("payload") ? it["payload"].GetString() : entry.value ? "ON" : "OFF";
+			}
+			else {
+				fprintf(stderr, "Trace input '%s' not found or not supported.\n", it["input"].GetString());
+				return -4;
+			}
+		}
+		else if (it.HasMember("pin")) {
+			entry.pin = it["pin"].GetInt();
+		}
+		else if (it.HasMember("topic")) {
+			entry.topic = it["topic"].GetString();
+			entry.payload = it.HasMember("payload") ? it["payload"].GetString() : "";
+		}
+		else {
+			fprintf(stderr, "Trace entry without input, pin or topic.\n");
+			return -4;
+		}
+
+		trace.push_back(entry);
+	}
+
+	std::stable_sort(trace.begin(), trace.end(), [](const TraceEntry& a, const TraceEntry& b) {
+		return a.at < b.at;
+	});
+
+	// Run queued events and deliver broker messages until nothing is left to do at current time
+	auto settle = [&] {
+		do {
+			sim::deliverMessages();
+		} while (eventDispatcher->drain() > 0);
+	};
+
+	// Serve every timer, PWM edge and broker message due up to given virtual time
+	auto runUntil = [&](Timestamp until) {
+		for (;;) {
+			settle();
+
+			Timestamp next = std::min(timerWheel->getNextExpiry(), pwmScheduler->getNextEdge());
+			if (next > until) {
+				break;
+			}
+
+			Clock::advanceTo(next);
+			timerWheel->advance();
+			pwmScheduler->advance();
+		}
+
+		Clock::advanceTo(until);
+	};
+
+	// Real time spent by the library on each trace entry
+	LatencyHistogram processing;
+	auto wallStart = std::chrono::steady_clock::now();
+
+	for (auto& entry : trace) {
+		runUntil(entry.at);
+
+		auto entryStart = std::chrono::steady_clock::now();
+
+		if (entry.pin >= 0) {
+			gpio->setLevel(entry.pin, entry.value);
+		}
+		else {
+			sim::injectMessage(entry.topic, entry.payload);
+		}
+		settle();
+		timerWheel->advance();
+		settle();
+
+		processing.record(std::chrono::steady_clock::now() - entryStart);
+	}
+
+	Timestamp end = (trace.empty() ? start : trace.back().at)
+		+ std::chrono::duration_cast<Timestamp::duration>(std::chrono::duration<double>(tailSeconds));
+	runUntil(end);
+
+	auto wallTime = std::chrono::steady_clock::now() - wallStart;
+	fflush(stdout);
+
+	// Timing statistics
+	rapidjson::Document stats(rapidjson::kObjectType);
+
+	rapidjson::Value replay(rapidjson::kObjectType);
+	replay.AddMember("entries", (uint64_t)trace.size(), stats.GetAllocator());
+	replay.AddMember("commands", (uint64_t)commandCount, stats.GetAllocator());
+	replay.AddMember("virtual_ms", std::chrono::duration<double, std::milli>(end - start).count(), stats.GetAllocator());
+	replay.AddMember("wall_ms", std::chrono::duration<double, std::milli>(wallTime).count(), stats.GetAllocator());
+	replay.AddMember("entries_per_s", trace.size() / std::max(std::chrono::duration<double>(wallTime).count(), 1e-9),
+		stats.GetAllocator());
+	stats.AddMember("replay", replay, stats.GetAllocator());
+
+	rapidjson::Value processingStats(processing.to_json(), stats.GetAllocator());
+	stats.AddMember("processing", processingStats, stats.GetAllocator());
+
+	rapidjson::Value nodeStats(node->stats_to_json(), stats.GetAllocator());
+	stats.AddMember("node", nodeStats, stats.GetAllocator());
+
+	rapidjson::StringBuffer statsBuffer;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> statsWriter(statsBuffer);
+	stats.Accept(statsWriter);
+	fprintf(stderr, "%s\n", statsBuffer.GetString());
+
+	gestureTokens.clear();
+	node.reset();
+
+	return 0;
+}
@@ -0,0 +1,19 @@
+#include <Simulation.h>
+
+#include <Clock.h>
+
+using namespace domotic_pi;
+
+static sim::CommandSink commandSink;
+
+void sim::setCommandSink(CommandSink sink)
+{
+	commandSink = sink;
+}
+
+void sim::recordCommand(const std::string& backend, const std::string& target, const std::string& value)
+{
+	if (commandSink) {
+		commandSink(Command{ Clock::now(), backend, target, value });
+	}
+}
@@ -0,0 +1,63 @@
+#ifndef DOMOTIC_PI_SIM_SIMULATION
+#define DOMOTIC_PI_SIM_SIMULATION
+
+#include <domoticPiDefine.h>
+
+#include <functional>
+#include <string>
+
+namespace domotic_pi {
+
+	namespace sim {
+
+		/**
+		 *	Command sent by the library to a simulated backend
+		 */
+		struct Command {
+			Timestamp time;
+			std::string backend;
+			std::string target;
+			std::string value;
+		};
+
+		typedef std::function<void(const Command&)> CommandSink;
+
+		/**
+		 *	@brief Set the function receiving every command sent to simulated backends
+		 */
+		void setCommandSink(CommandSink sink);
+
+		/**
+		 *	@brief Report a command to the command sink, stamped with current Clock time
+		 *
+		 *	@param backend backend the command has been sent to (gpio, mqtt, serial...)
+		 *	@param target pin, topic or port addressed by the command
+		 *	@param value value written
+		 */
+		void recordCommand(const std::string& backend, const std::string& target, const std::string& value);
+
+		/**
+		 *	@brief Publish a message on the simulated broker from outside the node
+		 *
+		 *	@note The message is queued, it is delivered by deliverMessages
+		 */
+		void injectMessage(const std::string& topic, const std::string& payload);
+
+		/**
+		 *	@brief Emulate devices answering each cmnd/<topic> message with the same payload on stat/<topic>
+		 */
+		void setDeviceEcho(bool echo);
+
+		/**
+		 *	@brief Deliver queued broker messages to matching subscriptions, including 
+		 *		   the ones published meanwhile by delivery callbacks
+		 *
+		 *	@return number of messages delivered
+		 */
+		size_t deliverMessages();
+
+	}
+
+}
+
+#endif // !DOMOTIC_PI_SIM_SIMULATION
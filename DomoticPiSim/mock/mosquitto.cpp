@@ -0,0 +1,177 @@
+#include <mosquitto.h>
+
+#include <EventGraph.h>
+#include <Simulation.h>
+
+#include <algorithm>
+#include <deque>
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace domotic_pi;
+
+struct mosquitto {
+	void *userdata;
+	bool connected;
+	std::vector<std::string> subscriptions;
+	void (*on_message)(struct mosquitto *, void *, const struct mosquitto_message *);
+};
+
+namespace {
+
+	std::list<struct mosquitto *> clients;
+	std::deque<std::pair<std::string, std::string>> pendingMessages;
+	bool deviceEcho = false;
+
+}
+
+int mosquitto_lib_init(void)
+{
+	return MOSQ_ERR_SUCCESS;
+}
+
+int mosquitto_lib_cleanup(void)
+{
+	return MOSQ_ERR_SUCCESS;
+}
+
+struct mosquitto *mosquitto_new(const char *id, bool clean_session, void *obj)
+{
+	struct mosquitto *mosq = new mosquitto{ obj, false, {}, nullptr };
+	clients.push_back(mosq);
+
+	return mosq;
+}
+
+void mosquitto_destroy(struct mosquitto *mosq)
+{
+	clients.remove(mosq);
+	delete mosq;
+}
+
+int mosquitto_username_pw_set(struct mosquitto *mosq, const char *username, const char *password)
+{
+	return MOSQ_ERR_SUCCESS;
+}
+
+int mosquitto_connect(struct mosquitto *mosq, const char *host, int port, int keepalive)
+{
+	mosq->connected = true;
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+int mosquitto_disconnect(struct mosquitto *mosq)
+{
+	mosq->connected = false;
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+int mosquitto_loop_start(struct mosquitto *mosq)
+{
+	// Messages are delivered by the simulation, no network thread is needed
+	return MOSQ_ERR_SUCCESS;
+}
+
+int mosquitto_loop_stop(struct mosquitto *mosq, bool force)
+{
+	return MOSQ_ERR_SUCCESS;
+}
+
+int mosquitto_publish(struct mosquitto *mosq, int *mid, const char *topic, int payloadlen, const void *payload, int qos, bool retain)
+{
+	if (!mosq->connected) {
+		return MOSQ_ERR_NO_CONN;
+	}
+
+	std::string message((const char *)payload, payloadlen);
+
+	sim::recordCommand("mqtt", topic, message);
+
+	// Delivery is deferred, so subscribers never run inside the publisher call stack
+	pendingMessages.emplace_back(topic, message);
+
+	std::string topicName(topic);
+	if (deviceEcho && topicName.compare(0, 5, "cmnd/") == 0) {
+		pendingMessages.emplace_back("stat/" + topicName.substr(5), message);
+	}
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+int mosquitto_subscribe(struct mosquitto *mosq, int *mid, const char *sub, int qos)
+{
+	if (!mosq->connected) {
+		return MOSQ_ERR_NO_CONN;
+	}
+
+	mosq->subscriptions.push_back(sub);
+
+	return MOSQ_ERR_SUCCESS;
+}
+
+void mosquitto_message_callback_set(struct mosquitto *mosq, 
+	void (*on_message)(struct mosquitto *, void *, const struct mosquitto_message *))
+{
+	mosq->on_message = on_message;
+}
+
+const char *mosquitto_strerror(int mosq_errno)
+{
+	switch (mosq_errno) {
+	case MOSQ_ERR_SUCCESS:
+		return "No error.";
+	case MOSQ_ERR_INVAL:
+		return "Invalid function arguments provided.";
+	case MOSQ_ERR_NO_CONN:
+		return "The client is not currently connected.";
+	default:
+		return "Unknown error.";
+	}
+}
+
+void sim::injectMessage(const std::string& topic, const std::string& payload)
+{
+	pendingMessages.emplace_back(topic, payload);
+}
+
+void sim::setDeviceEcho(bool echo)
+{
+	deviceEcho = echo;
+}
+
+size_t sim::deliverMessages()
+{
+	size_t delivered = 0;
+
+	while (!pendingMessages.empty()) {
+		auto pending = pendingMessages.front();
+		pendingMessages.pop_front();
+
+		struct mosquitto_message message{ 0, &pending.first[0], &pending.second[0], 
+			(int)pending.second.size(), 2, true };
+
+		// Callbacks may create or destroy clients, iterate over a snapshot
+		std::vector<struct mosquitto *> receivers(clients.begin(), clients.end());
+		for (auto client : receivers) {
+			if (std::find(clients.begin(), clients.end(), client) == clients.end() 
+				|| client->on_message == nullptr || !client->connected) {
+				continue;
+			}
+
+			for (auto& subscription : client->subscriptions) {
+				if (EventGraph::topicMatches(subscription, pending.first)) {
+					client->on_message(client, client->userdata, &message);
+					break;
+				}
+			}
+		}
+
+		++delivered;
+	}
+
+	return delivered;
+}
@@ -0,0 +1,54 @@
+#ifndef DOMOTIC_PI_SIM_MOSQUITTO
+#define DOMOTIC_PI_SIM_MOSQUITTO
+
+/**
+ *	Simulated subset of libmosquitto: every client is connected to the same in-process
+ *	broker, published messages are reported to the simulation command stream and queued
+ *	for delivery to matching subscriptions when the simulation drains the broker.
+ */
+
+#include <stdbool.h>
+
+#define MOSQ_ERR_SUCCESS 0
+#define MOSQ_ERR_INVAL 3
+#define MOSQ_ERR_NO_CONN 4
+
+struct mosquitto;
+
+struct mosquitto_message {
+	int mid;
+	char *topic;
+	void *payload;
+	int payloadlen;
+	int qos;
+	bool retain;
+};
+
+int mosquitto_lib_init(void);
+
+int mosquitto_lib_cleanup(void);
+
+struct mosquitto *mosquitto_new(const char *id, bool clean_session, void *obj);
+
+void mosquitto_destroy(struct mosquitto *mosq);
+
+int mosquitto_username_pw_set(struct mosquitto *mosq, const char *username, const char *password);
+
+int mosquitto_connect(struct mosquitto *mosq, const char *host, int port, int keepalive);
+
+int mosquitto_disconnect(struct mosquitto *mosq);
+
+int mosquitto_loop_start(struct mosquitto *mosq);
+
+int mosquitto_loop_stop(struct mosquitto *mosq, bool force);
+
+int mosquitto_publish(struct mosquitto *mosq, int *mid, const char *topic, int payloadlen, const void *payload, int qos, bool retain);
+
+int mosquitto_subscribe(struct mosquitto *mosq, int *mid, const char *sub, int qos);
+
+void mosquitto_message_callback_set(struct mosquitto *mosq, 
+	void (*on_message)(struct mosquitto *, void *, const struct mosquitto_message *));
+
+const char *mosquitto_strerror(int mosq_errno);
+
+#endif // !DOMOTIC_PI_SIM_MOSQUITTO
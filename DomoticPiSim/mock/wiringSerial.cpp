@@ -0,0 +1,78 @@
+#include <wiringSerial.h>
+
+#include <Simulation.h>
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <set>
+#include <string>
+#include <unistd.h>
+
+using namespace domotic_pi;
+
+namespace {
+
+	std::map<int, std::string> ports;
+	std::set<int> devices;
+	int nextFd = 100;
+
+}
+
+int serialOpen(const char *device, const int baud)
+{
+	// Existing devices (ie. pseudo terminals of a test harness) are really opened
+	int fd = open(device, O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (fd >= 0) {
+		devices.insert(fd);
+	}
+	else {
+		fd = nextFd++;
+	}
+
+	ports[fd] = device;
+
+	return fd;
+}
+
+void serialClose(const int fd)
+{
+	if (devices.erase(fd)) {
+		close(fd);
+	}
+
+	ports.erase(fd);
+}
+
+void serialPuts(const int fd, const char *s)
+{
+	if (devices.count(fd) && write(fd, s, strlen(s)) < 0) {
+		return;
+	}
+
+	sim::recordCommand("serial", ports[fd], s);
+}
+
+void serialPrintf(const int fd, const char *message, ...)
+{
+	char buffer[1024];
+
+	va_list args;
+	va_start(args, message);
+	vsnprintf(buffer, sizeof(buffer), message, args);
+	va_end(args);
+
+	serialPuts(fd, buffer);
+}
+
+int serialDataAvail(const int fd)
+{
+	return 0;
+}
+
+int serialGetchar(const int fd)
+{
+	return -1;
+}
@@ -0,0 +1,23 @@
+#ifndef DOMOTIC_PI_SIM_WIRING_SERIAL
+#define DOMOTIC_PI_SIM_WIRING_SERIAL
+
+/**
+ *	Simulated subset of wiringPi serial library: ports always open, written data
+ *	is reported to the simulation command stream and nothing is ever received.
+ *	Ports naming an existing device (ie. a pseudo terminal) are opened for real instead,
+ *	data being written to and read from the device as well.
+ */
+
+int serialOpen(const char *device, const int baud);
+
+void serialClose(const int fd);
+
+void serialPuts(const int fd, const char *s);
+
+void serialPrintf(const int fd, const char *message, ...);
+
+int serialDataAvail(const int fd);
+
+int serialGetchar(const int fd);
+
+#endif // !DOMOTIC_PI_SIM_WIRING_SERIAL
@@ -0,0 +1,140 @@
+#ifndef DOMOTIC_PI_BANK_SAMPLER
+#define DOMOTIC_PI_BANK_SAMPLER
+
+#include "domoticPiDefine.h"
+#include "IGpioBackend.h"
+#include "TimerWheel.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace domotic_pi {
+
+	/**
+	 *	Periodic sampler of input pins: all the sampled pins are read in one backend operation
+	 *	at a fixed rate, edges are found by XOR-ing each bank against the previous snapshot.
+	 *	CPU cost depends on the sampling rate only, not on the edge rate, and the last snapshot
+	 *	is available to read pin levels without accessing the GPIO.
+	 *
+	 *	Sampling runs on the timer wheel, edges of one sample are delivered on the wheel thread
+	 *	with the sample time.
+	 */
+	class BankSampler {
+	public:
+		/**
+		 *	@param gpio backend the pins are read from
+		 */
+		BankSampler(GpioBackend_ptr gpio);
+
+		BankSampler(const BankSampler&) = delete;
+		BankSampler& operator= (const BankSampler&) = delete;
+		~BankSampler();
+
+		/**
+		 *	@brief Get the sampler shared by the library for a GPIO chip, reading the chip backend
+		 *
+		 *	@return sampler instance, kept alive while at least one reference exists
+		 *
+		 *	@throw out_of_range if no backend has been set for the chip (see IGpioBackend::load)
+		 */
+		static const std::shared_ptr<BankSampler> load(unsigned int chip = 0);
+
+		/**
+		 *	@brief Start sampling given input pin, its snapshot level is read immediately
+		 *
+		 *	@throw out_of_range if pin is outside library boundaries
+		 */
+		void addPin(int pin);
+
+		/**
+		 *	@brief Stop sampling given pin, clearing its edge callback
+		 *
+		 *	@note Waits for the edges of a running sample to be delivered, unless called from
+		 *		  an edge callback: once returned the callback is never called again
+		 */
+		void removePin(int pin);
+
+		/**
+		 *	@brief Set the edges notified for given sampled pin
+		 *
+		 *	@param pin sampled pin number
+		 *	@param edge edges to be notified (edge_none disables notifications and drops the callback,
+		 *		  waiting for a running sample as removePin does)
+		 *	@param callback function called on each notified edge, if null only
+		 *		  the edge of the already registered callback is changed
+		 *
+		 *	@return 0 on success, non-zero if the pin is not sampled
+		 */
+		int setEdgeCallback(int pin, GpioEdge edge, GpioEdgeCallback callback);
+
+		/**
+		 *	@brief Get the level of given pin in the last snapshot
+		 */
+		int getLevel(int pin) const;
+
+		/**
+		 *	@brief Set the sampling period (rounded up to the timer wheel resolution)
+		 */
+		void setInterval(std::chrono::milliseconds interval);
+
+		std::chrono::milliseconds getInterval() const;
+
+		/**
+		 *	@brief Get the number of samples taken so far
+		 */
+		uint64_t getSampleCount() const;
+
+		/**
+		 *	@brief Get the number of edges notified so far
+		 */
+		uint64_t getEdgeCount() const;
+
+	private:
+		//	Sampled pins and notified edges, replaced as a whole so a sample can
+		//	deliver its edges without holding the sampler lock
+		struct Subscriptions {
+			GpioLevels mask{};
+			GpioLevels rising{};
+			GpioLevels falling{};
+			std::array<GpioEdgeCallback, DOMOTIC_PI_MAX_PIN + 1> callbacks;
+		};
+
+		static std::array<std::shared_ptr<BankSampler>, DOMOTIC_PI_MAX_CHIPS> _bankSamplers;
+
+		const GpioBackend_ptr _gpio;
+		const std::shared_ptr<TimerWheel> _timerWheel;
+		Timer_ptr _sampleTimer;
+
+		mutable std::mutex _samplerLock;
+		std::shared_ptr<const Subscriptions> _subscriptions;
+		std::chrono::milliseconds _interval;
+
+		//	Thread delivering the edges of a sample, default id if none
+		std::thread::id _deliveringThread;
+		std::condition_variable _sampleDone;
+
+		std::array<std::atomic<uint64_t>, gpioBankCount> _levels;
+		std::atomic<uint64_t> _sampleCount;
+		std::atomic<uint64_t> _edgeCount;
+
+		/**
+		 *	@brief Sample timer callback, reads all the sampled pins and notifies their edges
+		 */
+		void _sample();
+
+		/**
+		 *	@brief Wait for the edges of a running sample to be delivered, unless
+		 *		   called from the delivering thread, called with sampler lock held
+		 */
+		void _wait_sample(std::unique_lock<std::mutex>& lock);
+	};
+
+}
+
+#endif // !DOMOTIC_PI_BANK_SAMPLER
@@ -7,7 +7,9 @@ namespace domotic_pi {
 	{
 		single_press = 0,
 		double_press = 1,
-		long_press   = 2
+		long_press   = 2,
+		multi_press  = 3,
+		hold_repeat  = 4
 	};
 
 }
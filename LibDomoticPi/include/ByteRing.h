@@ -0,0 +1,100 @@
+#ifndef DOMOTIC_PI_BYTE_RING
+#define DOMOTIC_PI_BYTE_RING
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace domotic_pi {
+
+	/**
+	 *	Fixed size byte ring buffer, filled directly by read(2) calls and consumed in place.
+	 *	Offsets are relative to the oldest byte held. The buffer is allocated once and never
+	 *	grows: the producer is expected to consume or drop data when it is full.
+	 *
+	 *	@note Not thread safe, owners serialize producer and consumer
+	 */
+	class ByteRing {
+	public:
+		static constexpr size_t npos = (size_t)-1;
+
+		/**
+		 *	@param capacity buffer size in bytes, rounded up to a power of two
+		 */
+		ByteRing(size_t capacity);
+
+		ByteRing(const ByteRing&) = delete;
+		ByteRing& operator= (const ByteRing&) = delete;
+
+		size_t capacity() const;
+
+		/**
+		 *	@brief Get the number of bytes held
+		 */
+		size_t size() const;
+
+		/**
+		 *	@brief Get the number of bytes that can still be written
+		 */
+		size_t space() const;
+
+		/**
+		 *	@brief Get the contiguous free area following the newest byte, to be filled by a read
+		 *
+		 *	@return pointer to the free area and its length, 0 when the buffer is full
+		 */
+		std::pair<char *, size_t> writeSpan();
+
+		/**
+		 *	@brief Append given number of bytes, written in the area returned by writeSpan
+		 */
+		void commit(size_t length);
+
+		/**
+		 *	@brief Get the byte at given offset
+		 */
+		uint8_t at(size_t offset) const;
+
+		/**
+		 *	@brief Find the first occurrence of a byte
+		 *
+		 *	@param value byte to look for
+		 *	@param from offset the search starts at
+		 *
+		 *	@return offset of the byte, npos if not found
+		 */
+		size_t find(char value, size_t from = 0) const;
+
+		/**
+		 *	@brief Get a view of held bytes
+		 *
+		 *	@note The view points into the buffer unless the bytes wrap around its end, they are
+		 *		  then copied to scratch. It stays valid until the bytes are consumed or scratch is changed.
+		 *
+		 *	@param offset offset of the first byte
+		 *	@param length number of bytes
+		 *	@param scratch buffer used for wrapped bytes, grown as needed
+		 */
+		std::string_view view(size_t offset, size_t length, std::vector<char>& scratch) const;
+
+		/**
+		 *	@brief Drop given number of bytes, oldest first
+		 */
+		void consume(size_t length);
+
+		void clear();
+
+	private:
+		std::vector<char> _buffer;
+		const size_t _mask;
+
+		// Free running positions of the oldest byte and of the next byte to write
+		size_t _head;
+		size_t _tail;
+	};
+
+}
+
+#endif // !DOMOTIC_PI_BYTE_RING
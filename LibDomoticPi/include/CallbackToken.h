@@ -1,7 +1,8 @@
 #ifndef DOMOTIC_PI_CALLBACK_TOKEN
 #define DOMOTIC_PI_CALLBACK_TOKEN
 
-#include <functional>
+#include "InplaceFunction.h"
+
 #include <memory>
 
 namespace domotic_pi {
@@ -11,14 +12,16 @@ namespace domotic_pi {
 		/**
 		 *	@brief Initialize a callback token which will call given function when destructed
 		 *
+		 *	@note The function is stored inline in the token, without further allocations
+		 *
 		 *	@param removeCallbackFunction function to be called at object destruction
 		 */
-		CallbackToken(std::function<void()> removeCallbackFunction = nullptr);
+		CallbackToken(InplaceFunction<void()> removeCallbackFunction = nullptr);
 
 		virtual ~CallbackToken();
 
 	private:
-		std::function<void()> _removeCallbackFunction;
+		const InplaceFunction<void()> _removeCallbackFunction;
 	};
 
 	typedef std::shared_ptr<CallbackToken> CallbackToken_ptr;
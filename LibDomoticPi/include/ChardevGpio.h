@@ -0,0 +1,162 @@
+#ifndef DOMOTIC_PI_CHARDEV_GPIO
+#define DOMOTIC_PI_CHARDEV_GPIO
+
+#include "domoticPiDefine.h"
+#include "IGpioBackend.h"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace domotic_pi {
+
+	/**
+	 *	GPIO backend on top of the Linux GPIO character device (uAPI v2), pins are line offsets
+	 *	of the chip (a gpio-sim chip can be used for tests).
+	 *
+	 *	The kernel cannot add lines to a line request, so output lines are requested lazily: the
+	 *	lines set up since the last write are requested together, at their current values, by the
+	 *	next write. Outputs set up before the first write share one request and are switched at the
+	 *	same moment by a batch, while the outputs already driven are never requested again (unless
+	 *	a line of their request is switched back to input).
+	 *
+	 *	Each input line has its own request and all of them are watched by one epoll set served by
+	 *	a single event thread, which delivers edges with their kernel timestamp.
+	 */
+	class ChardevGpio : public IGpioBackend {
+	public:
+		/**
+		 *	@param chipPath path of the GPIO chip device
+		 */
+		ChardevGpio(const std::string& chipPath = DOMOTIC_PI_GPIO_CHIP);
+
+		~ChardevGpio();
+
+		int setup() override;
+
+		const char * getName() const override;
+
+		void setMode(int pin, GpioMode mode) override;
+
+		void setPull(int pin, GpioPull pull) override;
+
+		void write(int pin, int value) override;
+
+		int read(int pin) override;
+
+		/**
+		 *	@note Output lines sharing a request are switched at the same moment by one line
+		 *		  values request, lines of different requests back to back under the backend lock
+		 */
+		void writeBanks(const GpioBanks& banks) override;
+
+		/**
+		 *	@note Input lines having their own request, each one is read by its own
+		 *		  ioctl but the snapshot is taken without releasing the backend lock
+		 */
+		void readBanks(const GpioLevels& mask, GpioLevels& levels) override;
+
+		/**
+		 *	@note Waits for the running callback of the line, unless called from the event thread,
+		 *		  and edge_none drops the callback: once disabled the callback is never called again
+		 */
+		int setEdgeCallback(int pin, GpioEdge edge, GpioEdgeCallback callback) override;
+
+		/**
+		 *	@brief Get the number of edges received from input lines
+		 */
+		uint64_t getEdgeCount() const;
+
+		/**
+		 *	@brief Get the number of edges lost by the kernel on line event buffer overflow
+		 */
+		uint64_t getDroppedEdgeCount() const;
+
+	private:
+		//	Epoll key of the wakeup eventfd, line keys hold request generation and pin
+		static constexpr uint64_t _wakeupKey = ~(uint64_t)0;
+
+		//	Line request shared by the output lines requested together, released with its last line
+		struct OutputRequest {
+			int fd;
+
+			~OutputRequest();
+		};
+
+		struct Line {
+			GpioMode mode = gpio_input;
+			GpioPull pull = pull_off;
+			GpioEdge edge = edge_none;
+			GpioEdgeCallback callback;
+			int value = 0;
+			int fd = -1;
+			std::shared_ptr<OutputRequest> output;
+			unsigned int index = 0;
+			uint32_t generation = 0;
+			uint64_t seqno = 0;
+		};
+
+		const std::string _chipPath;
+		int _chipFd;
+
+		mutable std::mutex _gpioLock;
+		std::array<Line, DOMOTIC_PI_MAX_PIN + 1> _lines;
+
+		//	Pin whose edge callback is running on the event thread, -1 if none
+		int _runningPin;
+		std::condition_variable _callbackDone;
+
+		int _epollFd;
+		int _wakeupFd;
+		std::atomic<bool> _eventRunning;
+		std::thread _eventThread;
+		std::atomic<uint64_t> _edgeCount;
+		std::atomic<uint64_t> _droppedEdges;
+
+		/**
+		 *	@brief Request given input line again with its current pull and edge,
+		 *		   adding it to the epoll set if edges are requested
+		 *
+		 *	@return 0 on success, non-zero on error
+		 */
+		int _request_input(int pin);
+
+		/**
+		 *	@brief Request together the output lines set up and not driven yet, at their last written value
+		 *
+		 *	@return 0 on success, non-zero on error
+		 */
+		int _request_outputs();
+
+		/**
+		 *	@brief Release the request of given line, if any
+		 */
+		void _release(int pin);
+
+		/**
+		 *	@brief Wake the event thread up (ie. to stop it)
+		 */
+		void _wakeup();
+
+		/**
+		 *	@brief Event thread body, waiting for edges on input lines
+		 */
+		void _event_loop();
+
+		/**
+		 *	@brief Drain and deliver pending edges of given line
+		 *
+		 *	@param pin line offset
+		 *	@param generation request generation the events have been queued for
+		 */
+		void _read_events(int pin, uint32_t generation);
+	};
+
+}
+
+#endif // !DOMOTIC_PI_CHARDEV_GPIO
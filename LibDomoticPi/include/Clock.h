@@ -0,0 +1,54 @@
+#ifndef DOMOTIC_PI_CLOCK
+#define DOMOTIC_PI_CLOCK
+
+#include "domoticPiDefine.h"
+
+#include <atomic>
+#include <chrono>
+
+namespace domotic_pi {
+
+	/**
+	 *	Monotonic time source used by the library for timers, debounce, rate limits and tracing.
+	 *	It follows steady_clock by default; it can be switched to a virtual clock which only
+	 *	moves when explicitly advanced (ie. offline simulation), in which case the timer wheel
+	 *	has to be driven manually through TimerWheel::advance.
+	 */
+	class Clock {
+	public:
+		Clock() = delete;
+
+		/**
+		 *	@brief Get current time point
+		 */
+		static Timestamp now();
+
+		/**
+		 *	@brief Switch to virtual time, starting from current steady clock time
+		 *
+		 *	@note Must be called before any timer wheel user is created
+		 */
+		static void setVirtual();
+
+		/**
+		 *	@brief Check whether virtual time is in use
+		 */
+		static bool isVirtual();
+
+		/**
+		 *	@brief Move virtual time forward to given time point
+		 *
+		 *	@note Time never goes back: earlier time points are ignored
+		 *
+		 *	@param timePoint time point to move the virtual clock to
+		 */
+		static void advanceTo(Timestamp timePoint);
+
+	private:
+		static std::atomic<bool> _virtual;
+		static std::atomic<Timestamp::rep> _virtualNow;
+	};
+
+}
+
+#endif // !DOMOTIC_PI_CLOCK
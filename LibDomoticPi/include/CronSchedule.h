@@ -0,0 +1,59 @@
+#ifndef DOMOTIC_PI_CRON_SCHEDULE
+#define DOMOTIC_PI_CRON_SCHEDULE
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace domotic_pi {
+
+	/**
+	 *	Cron-style schedule expression with the standard five fields:
+	 *	minute (0-59), hour (0-23), day of month (1-31), month (1-12) and
+	 *	day of week (0-7, both 0 and 7 are Sunday).
+	 *	Each field accepts '*', single values, ranges 'a-b', a '/n' step after '*' or
+	 *	after a range and comma separated lists of them; '@hourly', '@daily', '@weekly',
+	 *	'@monthly' and '@yearly' shortcuts are accepted too.
+	 *	Schedules are evaluated against local time.
+	 */
+	class CronSchedule {
+	public:
+		/**
+		 *	@brief Parse given cron expression
+		 *
+		 *	@param expression cron expression to parse
+		 *
+		 *	@throw domotic_pi_exception if the expression is not valid
+		 */
+		CronSchedule(const std::string& expression);
+
+		/**
+		 *	@brief Get the expression this schedule has been initialized from
+		 */
+		const std::string& getExpression() const;
+
+		/**
+		 *	@brief Compute the first time point matching this schedule strictly after given one
+		 *
+		 *	@param after time point to start the search from
+		 *
+		 *	@return next matching time point, or time_point::max() if the schedule never matches
+		 */
+		std::chrono::system_clock::time_point next(std::chrono::system_clock::time_point after) const;
+
+	private:
+		const std::string _expression;
+		uint64_t _minutes;
+		uint64_t _hours;
+		uint64_t _daysOfMonth;
+		uint64_t _months;
+		uint64_t _daysOfWeek;
+		bool _anyDayOfMonth;
+		bool _anyDayOfWeek;
+
+		static uint64_t _parse_field(const std::string& field, int min, int max);
+	};
+
+}
+
+#endif // !DOMOTIC_PI_CRON_SCHEDULE
@@ -2,12 +2,16 @@
 #define DOMOTIC_PI_DIGITAL_BUTTON
 
 #include "domoticPiDefine.h"
+#include "BankSampler.h"
 #include "IButtonStateGenerator.h"
 #include "IInput.h"
 #include "InputFactory.h"
 #include "Pin.h"
+#include "TimerWheel.h"
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -34,6 +38,7 @@ namespace domotic_pi {
 		 *	@param pud pull up/down state required by this input
 		 *	@param doublePressDuration time duration within a double state change is translated to a double press event
 		 *	@param longPressDuration time duration current state has to be maintained to trigger a long press event
+		 *	@param chip index of the GPIO chip the pin belongs to
 		 *
 		 *	@throw domotic_pi_exception if the pinNumber is already in use
 		 *	@throw out_of_range if pinNumber is outside library boundaries
@@ -43,23 +48,84 @@ namespace domotic_pi {
 			int pinNumber, 
 			int pud,
 			const std::chrono::milliseconds doublePressDuration = std::chrono::milliseconds::zero(),
-			const std::chrono::milliseconds longPressDuration = std::chrono::milliseconds::zero());
+			const std::chrono::milliseconds longPressDuration = std::chrono::milliseconds::zero(),
+			unsigned int chip = 0);
 
 		DigitalButton(const DigitalButton&) = delete;
 		DigitalButton& operator= (const DigitalButton&) = delete;
 		virtual ~DigitalButton();
 
+		/**
+		 *	@note Sampled buttons return the level of the last bank sample, without accessing the GPIO
+		 */
 		int getValue() const override;
 
+		/**
+		 *	@brief Choose between interrupts and the shared bank sampler to detect pin edges
+		 *
+		 *	@note Sampled pins do not go through the edge storm guard, their edge rate being
+		 *		  bounded by the sampling rate
+		 *
+		 *	@param sampled true to sample the pin periodically, false to use interrupts
+		 *
+		 *	@throw domotic_pi_exception	If something goes wrong in the GPIO backend
+		 */
+		void setSampled(bool sampled);
+
+		bool isSampled() const;
+
 		/**
 		 *	@brief Change ISR trigger mode for this input
 		 *
 		 *	@param isr_mode ISR mode to use (if ISR is disabled related isr functions are cleared.)
 		 *
-		 *	@throw domotic_pi_exception	If something goes wrong in wiringPi
+		 *	@throw domotic_pi_exception	If something goes wrong in the GPIO backend
 		 */
 		void setISRMode(int isr_mode);
 
+		/**
+		 *	@brief Configure the edge storm guard: when edges come faster than given rate the pin
+		 *		   interrupts are disabled and the pin is sampled periodically, level changes seen by
+		 *		   the sampler are notified as edges. Interrupts are restored once the pin level has
+		 *		   not changed for the calm period.
+		 *
+		 *	@param rate edges per second allowed on average (one second of edges can come in a row), 0 disables the guard
+		 *	@param pollInterval sampling period while in a storm
+		 *	@param calmPeriod time without level change before returning to interrupts
+		 */
+		void setStormGuard(double rate, std::chrono::milliseconds pollInterval, std::chrono::milliseconds calmPeriod);
+
+		double getStormRate() const;
+
+		std::chrono::milliseconds getStormPollInterval() const;
+
+		std::chrono::milliseconds getStormCalmPeriod() const;
+
+		/**
+		 *	@brief Check whether the pin is currently sampled because of an edge storm
+		 */
+		bool isPolling() const;
+
+		/**
+		 *	@brief Get the number of switches from interrupts to sampling
+		 */
+		uint64_t getPollingSwitchCount() const;
+
+		/**
+		 *	@brief Get the number of switches from sampling back to interrupts
+		 */
+		uint64_t getInterruptSwitchCount() const;
+
+		/**
+		 *	@brief Get the total time spent sampling, current storm included
+		 */
+		std::chrono::milliseconds getPollingTime() const;
+
+		/**
+		 *	@note Adds the storm guard state and mode switch counters
+		 */
+		rapidjson::Document stats_to_json() const override;
+
 		/**
 		 *	@brief Serialize current object to json document
 		 *
@@ -73,8 +139,33 @@ namespace domotic_pi {
 
 #ifdef DOMOTIC_PI_THREAD_SAFE
 		std::mutex _isrMode;
+		mutable std::mutex _stormLock;
 #endif // DOMOTIC_PI_THREAD_SAFE
 
+		const std::shared_ptr<TimerWheel> _timerWheel;
+		Timer_ptr _pollTimer;
+
+		//	Bank sampler reading the pin, null when interrupts are used
+		std::shared_ptr<BankSampler> _sampler;
+
+		//	Storm guard configuration and token bucket
+		double _stormRate;
+		std::chrono::milliseconds _stormPollInterval;
+		std::chrono::milliseconds _stormCalmPeriod;
+		double _stormTokens;
+		Timestamp _stormRefill;
+
+		//	Sampling state while in a storm
+		bool _polling;
+		bool _interruptsMuted;
+		int _polledLevel;
+		Timestamp _lastPolledChange;
+		Timestamp _pollingSince;
+
+		std::atomic<uint64_t> _pollingSwitches;
+		std::atomic<uint64_t> _interruptSwitches;
+		uint64_t _pollingTimeMs;
+
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
 		hap::IntCharacteristics_ptr _stateInfo;
 		CallbackToken_ptr _doublePressToken;
@@ -85,8 +176,40 @@ namespace domotic_pi {
 		 *	@brief Object related function binded to ISR for this input.
 		 *
 		 *	This function will call all the registered callbacks on ISR trigger.
+		 *
+		 *	@param value pin level after the edge
+		 *	@param timestamp time the edge has been detected at
+		 */
+		void input_ISR(int value, Timestamp timestamp);
+
+		/**
+		 *	@brief Set edge notifications on the bank sampler or on the GPIO backend
+		 *
+		 *	@return 0 on success, non-zero on error
+		 */
+		int _set_edge_callback(GpioEdge edge, GpioEdgeCallback callback);
+
+		/**
+		 *	@brief Notify an edge to HomeKit, gesture recognition and registered callbacks
+		 */
+		void _edge(int value, Timestamp timestamp);
+
+		/**
+		 *	@brief Check an edge against the storm guard, switching to sampling if the rate is exceeded
+		 *
+		 *	Interrupts are disabled by the first sample, on the timer wheel thread, edges being
+		 *	discarded until then.
+		 *
+		 *	@return true if the edge has to be notified
+		 */
+		bool _storm_allows(Timestamp timestamp);
+
+		/**
+		 *	@brief Sampling timer callback, notifies level changes and restores interrupts once calm
+		 *
+		 *	Changes are notified while interrupts are disabled, so edges have a single producer at a time.
 		 */
-		void input_ISR();
+		void _poll_expired();
 
 		static const bool _factoryRegistration;
 		static std::shared_ptr<DigitalButton> from_json(const rapidjson::Value& config, DomoticNode_ptr parentNode);
@@ -17,16 +17,17 @@ namespace domotic_pi {
 		 *
 		 *	@param id unique identifier for this output
 		 *	@param pinNumber pin number to be used by this output
+		 *	@param chip index of the GPIO chip the pin belongs to
 		 */
-		DigitalSwitch(const std::string& id, int pinNumber);
+		DigitalSwitch(const std::string& id, int pinNumber, unsigned int chip = 0);
 
 		DigitalSwitch(const DigitalSwitch&) = delete;
 		DigitalSwitch& operator= (const DigitalSwitch&) = delete;
 		virtual ~DigitalSwitch();
 		
-		void setState(OutState newState) override;
+		void setState(OutState newState, Timestamp timestamp = Timestamp()) override;
 
-		void setValue(int newValue) override;
+		void setValue(int newValue, Timestamp timestamp = Timestamp()) override;
 
 		rapidjson::Document to_json() const override;
 
@@ -35,6 +36,11 @@ namespace domotic_pi {
 		hap::BoolCharacteristics_ptr _stateInfo;
 #endif
 
+		/**
+		 *	@brief Write current value to the pin, or to the write batch open on this thread
+		 */
+		void _write_pin();
+
 		static const bool _factoryRegistration;
 		static std::shared_ptr<DigitalSwitch> from_json(const rapidjson::Value& config, DomoticNode_ptr parentNode);
 
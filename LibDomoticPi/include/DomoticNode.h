@@ -35,6 +35,14 @@ namespace domotic_pi {
 
 		rapidjson::Document to_json() const;
 
+		/**
+		 *	@brief Report runtime statistics of this node modules
+		 *
+		 *	@return json object with per-input filtered changes counters, per-event trigger latency
+		 *			and circuit breaker state, per-output command and feedback latency
+		 */
+		rapidjson::Document stats_to_json() const;
+
 		/**
 		 *		Inputs handlers
 		 */
@@ -0,0 +1,124 @@
+#ifndef DOMOTIC_PI_EVENT_DISPATCHER
+#define DOMOTIC_PI_EVENT_DISPATCHER
+
+#include "domoticPiDefine.h"
+#include "EventPriority.h"
+#include "LatencyHistogram.h"
+#include "ProgrammedEvent.h"
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <rapidjson/document.h>
+#include <string>
+#include <thread>
+
+namespace domotic_pi {
+
+	/**
+	 *	Queue of programmed events triggered by inputs, shared by the library.
+	 *	Each priority has its own FIFO queue served by a single dispatch thread, which
+	 *	always runs the highest priority event pending: a safety event triggered while
+	 *	cosmetic ones are backed up is run as soon as the current event completes, and
+	 *	triggers of the same priority are run in the same order they were notified.
+	 *
+	 *	When the library Clock is virtual, no dispatch thread is started: queued events
+	 *	run only when the clock owner calls drain.
+	 */
+	class EventDispatcher {
+	public:
+		static constexpr size_t priorityCount = low_priority + 1;
+
+		EventDispatcher();
+
+		EventDispatcher(const EventDispatcher&) = delete;
+		EventDispatcher& operator= (const EventDispatcher&) = delete;
+		~EventDispatcher();
+
+		/**
+		 *	@brief Get the event dispatcher instance shared by the library
+		 *
+		 *	@return event dispatcher instance, kept alive while at least one reference exists
+		 */
+		static const std::shared_ptr<EventDispatcher> load();
+
+		/**
+		 *	@brief Queue given event to be triggered according to its priority
+		 *
+		 *	@param programmedEvent event to trigger (the queue keeps only a weak reference)
+		 *	@param timestamp source timestamp of the change triggering the event
+		 */
+		void dispatch(const std::shared_ptr<ProgrammedEvent>& programmedEvent, Timestamp timestamp);
+
+		/**
+		 *	@brief Run every queued event on the calling thread, highest priority first
+		 *
+		 *	@return number of events run
+		 */
+		size_t drain();
+
+		/**
+		 *	@brief Get number of events currently waiting with given priority
+		 */
+		size_t getQueueDepth(EventPriority priority) const;
+
+		/**
+		 *	@brief Get highest number of events waited at once with given priority
+		 */
+		size_t getMaxQueueDepth(EventPriority priority) const;
+
+		/**
+		 *	@brief Get latency from trigger source to the start of events with given priority
+		 */
+		const LatencyHistogram& getLatency(EventPriority priority) const;
+
+		/**
+		 *	@brief Get configuration name of given priority
+		 */
+		static const char * getPriorityName(EventPriority priority);
+
+		/**
+		 *	@brief Get priority from its configuration name
+		 *
+		 *	@throw domotic_pi_exception if the name is not a valid priority
+		 */
+		static EventPriority getPriority(const std::string& priorityName);
+
+		/**
+		 *	@brief Report queue depth and latency statistics as json object, per priority
+		 */
+		rapidjson::Document stats_to_json() const;
+
+	private:
+		struct Dispatch {
+			std::weak_ptr<ProgrammedEvent> programmedEvent;
+			Timestamp timestamp;
+		};
+
+		static std::shared_ptr<EventDispatcher> _eventDispatcher;
+
+		mutable std::mutex _queueLock;
+		std::condition_variable _queueChange;
+		std::array<std::deque<Dispatch>, priorityCount> _queues;
+		std::array<size_t, priorityCount> _maxDepth;
+		std::array<LatencyHistogram, priorityCount> _latency;
+		bool _dispatchRunning;
+		std::thread _dispatchThread;
+
+		void _dispatch_loop();
+
+		/**
+		 *	@brief Pop the first event of the highest priority queue not empty
+		 *
+		 *	@return false if every queue is empty
+		 */
+		bool _pop(Dispatch& dispatch, EventPriority& priority);
+
+		void _run(const Dispatch& dispatch, EventPriority priority);
+	};
+
+}
+
+#endif // !DOMOTIC_PI_EVENT_DISPATCHER
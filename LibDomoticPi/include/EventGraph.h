@@ -0,0 +1,64 @@
+#ifndef DOMOTIC_PI_EVENT_GRAPH
+#define DOMOTIC_PI_EVENT_GRAPH
+
+#include "domoticPiDefine.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace domotic_pi {
+
+	/**
+	 *	Dependency graph of a domotic node: inputs trigger programmed events, events set
+	 *	outputs, outputs generate traffic on comm topics and inputs listening to those
+	 *	topics change in turn. Any cycle in this graph is a potential feedback loop.
+	 */
+	class EventGraph {
+	public:
+		/**
+		 *	@brief Build the dependency graph of given node current modules
+		 *
+		 *	@param node domotic node to inspect
+		 */
+		EventGraph(const DomoticNode& node);
+
+		/**
+		 *	@brief Get number of vertices (modules and topics) in the graph
+		 */
+		size_t getVertexCount() const;
+
+		/**
+		 *	@brief Find dependency cycles in the graph
+		 *
+		 *	@note Each back edge found by a depth first visit is reported as a cycle,
+		 *		  so every strongly connected component appears at least once
+		 *
+		 *	@return list of cycles, each one as the ordered list of its vertex descriptions
+		 *			(the first vertex is repeated at the end to close the loop)
+		 */
+		std::vector<std::vector<std::string>> findCycles() const;
+
+		/**
+		 *	@brief Check if a topic filter matches a topic name (mqtt '+' and '#' wildcards allowed)
+		 *
+		 *	@param filter topic filter to match
+		 *	@param topic topic name to check
+		 *
+		 *	@return true if the topic matches the filter
+		 */
+		static bool topicMatches(const std::string& filter, const std::string& topic);
+
+	private:
+		std::vector<std::string> _vertices;
+		std::vector<std::vector<size_t>> _edges;
+		std::map<std::string, size_t> _vertexIndex;
+
+		size_t _vertex(const std::string& description);
+
+		void _edge(size_t from, size_t to);
+	};
+
+}
+
+#endif // !DOMOTIC_PI_EVENT_GRAPH
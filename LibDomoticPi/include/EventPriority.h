@@ -0,0 +1,19 @@
+#ifndef DOMOTIC_PI_EVENT_PRIORITY
+#define DOMOTIC_PI_EVENT_PRIORITY
+
+namespace domotic_pi {
+
+	/**
+	 *	Programmed event dispatch priority, lower values are dispatched first.
+	 *	Safety events also bypass input debounce, rate limit and circuit breaker.
+	 */
+	enum EventPriority {
+		safety_priority = 0,
+		high_priority   = 1,
+		normal_priority = 2,
+		low_priority    = 3
+	};
+
+}
+
+#endif // !DOMOTIC_PI_EVENT_PRIORITY
@@ -0,0 +1,255 @@
+#ifndef DOMOTIC_PI_GESTURE_RECOGNIZER
+#define DOMOTIC_PI_GESTURE_RECOGNIZER
+
+#include "ButtonState.h"
+#include "domoticPiDefine.h"
+#include "SpscRing.h"
+#include "TimerWheel.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace domotic_pi {
+
+	/**
+	 *	Gesture recognition service shared by every button of the library.
+	 *	Buttons report timestamped press and release edges, and every gesture deadline
+	 *	of every button is kept in a single deadline queue served by one timer of the
+	 *	shared timer wheel: no thread is needed per button and the number of threads
+	 *	does not depend on the number of buttons.
+	 *
+	 *	Each button runs an explicit state machine over edge timestamps:
+	 *	- idle: a press starts a click
+	 *	- pressed: a release counts the click; holding past the long press duration
+	 *	  is a long press, then hold repeats follow at the hold repeat interval
+	 *	- released: a new press within the multi-click window continues the clicks,
+	 *	  otherwise the counted clicks are reported as single, double or multi press
+	 *	Once the maximum number of clicks is reached the gesture is reported at once,
+	 *	so a single press is reported only when no other click can follow.
+	 *
+	 *	Deadlines are computed from edge timestamps and an edge past a pending deadline
+	 *	first serves it, so recognition does not depend on how late edges are processed.
+	 *
+	 *	Edges are captured without locking into a wait-free ring per button, and the
+	 *	edge processing thread is woken at most once per burst to process every buffered
+	 *	edge of every button in one batch. When the library Clock is virtual no thread
+	 *	is started and edges are processed on the reporting thread.
+	 */
+	class GestureRecognizer {
+	public:
+
+		class Button {
+		public:
+			Button(
+				std::chrono::milliseconds multiClickWindow,
+				std::chrono::milliseconds longPressDuration,
+				std::function<void(ButtonState, unsigned int)> notify);
+
+			Button(const Button&) = delete;
+			Button& operator= (const Button&) = delete;
+
+		private:
+			enum State {
+				idle_state,
+				pressed_state,
+				released_state,
+				holding_state
+			};
+
+			const std::chrono::milliseconds _multiClickWindow;
+			const std::chrono::milliseconds _longPressDuration;
+			const std::function<void(ButtonState, unsigned int)> _notify;
+
+			// Configuration and recognition state, guarded by the recognizer lock
+			unsigned int _maxClicks;
+			std::chrono::milliseconds _holdRepeatInterval;
+			State _state;
+			unsigned int _clicks;
+			Timestamp _deadline;
+			uint64_t _generation;
+
+			struct Edge {
+				Timestamp timestamp;
+				int level;
+			};
+
+			// Edges captured from interrupts, waiting to be processed
+			SpscRing<Edge, DOMOTIC_PI_GESTURE_EDGE_RING> _edges;
+
+			// Notifications running, so removal waits for them without any lock held by callbacks
+			std::atomic<bool> _removed;
+			std::atomic<unsigned int> _notifying;
+
+			friend class GestureRecognizer;
+		};
+
+		typedef std::shared_ptr<Button> Button_ptr;
+
+		GestureRecognizer();
+
+		GestureRecognizer(const GestureRecognizer&) = delete;
+		GestureRecognizer& operator= (const GestureRecognizer&) = delete;
+		~GestureRecognizer();
+
+		/**
+		 *	@brief Get the gesture recognizer instance shared by the library
+		 *
+		 *	@return gesture recognizer instance, kept alive while at least one reference exists
+		 */
+		static const std::shared_ptr<GestureRecognizer> load();
+
+		/**
+		 *	@brief Register a new button to recognize gestures for
+		 *
+		 *	@note Gestures are notified either on the thread reporting the edge or
+		 *		  on the timer wheel thread, never while holding recognizer locks
+		 *
+		 *	@param multiClickWindow time a new click has to start within after the previous one
+		 *		  (zero reports every click as single press)
+		 *	@param longPressDuration time a press has to be held to be a long press (zero disables)
+		 *	@param notify function called with each recognized gesture and its click count
+		 *
+		 *	@return button handle to report edges with
+		 */
+		Button_ptr addButton(
+			std::chrono::milliseconds multiClickWindow,
+			std::chrono::milliseconds longPressDuration,
+			std::function<void(ButtonState, unsigned int)> notify);
+
+		/**
+		 *	@brief Stop recognizing gestures for given button
+		 *
+		 *	@note Waits for running notifications of the button to complete, except the ones
+		 *		  of the calling thread: a gesture callback can remove its own button
+		 */
+		void removeButton(const Button_ptr& button);
+
+		/**
+		 *	@brief Set multi-click and hold repeat behaviour of given button
+		 *
+		 *	@param maxClicks number of clicks reported as soon as reached (at least 1, default 2)
+		 *	@param holdRepeatInterval interval of hold repeats after a long press (zero disables)
+		 */
+		void configureButton(const Button_ptr& button, unsigned int maxClicks, std::chrono::milliseconds holdRepeatInterval);
+
+		/**
+		 *	@brief Report a button press or release edge
+		 *
+		 *	@note Never locks: edges of a button must be reported by one thread at a time
+		 *		  (ie. its interrupt thread), and are recognized asynchronously
+		 *
+		 *	@param button button handle returned by addButton
+		 *	@param pressed true for a press edge, false for a release edge
+		 *	@param timestamp time the edge has been detected at its source, call time is used if not set
+		 */
+		void buttonEdge(const Button_ptr& button, bool pressed, Timestamp timestamp = Timestamp());
+
+		/**
+		 *	@brief Report a click from a source without release information (press and release at once)
+		 *
+		 *	@note Never locks, same threading requirements of buttonEdge
+		 *
+		 *	@param button button handle returned by addButton
+		 *	@param timestamp time the click has been detected at its source, call time is used if not set
+		 */
+		void buttonClick(const Button_ptr& button, Timestamp timestamp = Timestamp());
+
+		/**
+		 *	@brief Get number of buttons currently registered
+		 */
+		size_t getButtonCount() const;
+
+		/**
+		 *	@brief Get number of edges discarded because a button edge ring was full
+		 */
+		uint64_t getDroppedEdgeCount() const;
+
+	private:
+		static constexpr int click_edge = 2;
+
+		struct Deadline {
+			Timestamp at;
+			std::weak_ptr<Button> button;
+			uint64_t generation;
+
+			bool operator> (const Deadline& other) const { return at > other.at; }
+		};
+
+		typedef std::vector<std::tuple<Button_ptr, ButtonState, unsigned int>> Notifications;
+
+		static std::shared_ptr<GestureRecognizer> _gestureRecognizer;
+
+		const std::shared_ptr<TimerWheel> _timerWheel;
+		mutable std::mutex _recognizerLock;
+		std::condition_variable _notifyDone;
+		std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> _deadlines;
+		Timer_ptr _deadlineTimer;
+		Timestamp _armedDeadline;
+		std::list<Button_ptr> _buttons;
+
+		int _wakeupFd;
+		std::atomic<bool> _wakeupPending;
+		std::atomic<bool> _edgeRunning;
+		std::thread _edgeThread;
+		std::atomic<uint64_t> _droppedEdges;
+
+		/**
+		 *	@brief Buffer an edge and wake edge processing if needed
+		 */
+		void _capture(const Button_ptr& button, int level, Timestamp timestamp);
+
+		void _edge_loop();
+
+		/**
+		 *	@brief Run the state machines on every buffered edge of every button
+		 */
+		void _process_edges();
+
+		/**
+		 *	@brief Run the state machine transitions of every button deadline up to given time
+		 *
+		 *	@note Must be called holding recognizer lock
+		 */
+		void _catch_up(const Button_ptr& button, Timestamp now, Notifications& notifications);
+
+		void _press(const Button_ptr& button, Timestamp timestamp, Notifications& notifications);
+
+		void _release(const Button_ptr& button, Timestamp timestamp, Notifications& notifications);
+
+		/**
+		 *	@brief Move button deadline, queueing it if set
+		 *
+		 *	@note Must be called holding recognizer lock
+		 */
+		void _set_deadline(const Button_ptr& button, Timestamp deadline);
+
+		/**
+		 *	@brief Serve every deadline already passed
+		 */
+		void _deadline_expired();
+
+		/**
+		 *	@brief Arm the deadline timer on the first pending deadline, if changed
+		 *
+		 *	@note Must be called holding recognizer lock
+		 */
+		void _arm_deadline();
+
+		void _notify(const Notifications& notifications);
+	};
+
+	typedef GestureRecognizer::Button_ptr GestureButton_ptr;
+
+}
+
+#endif // !DOMOTIC_PI_GESTURE_RECOGNIZER
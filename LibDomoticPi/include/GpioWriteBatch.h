@@ -0,0 +1,58 @@
+#ifndef DOMOTIC_PI_GPIO_WRITE_BATCH
+#define DOMOTIC_PI_GPIO_WRITE_BATCH
+
+#include "domoticPiDefine.h"
+#include "IGpioBackend.h"
+
+namespace domotic_pi {
+
+	/**
+	 *	Scope collecting the pin writes of the current thread, applied together through 
+	 *	IGpioBackend::writeBanks when the scope ends (ie. all the outputs switched by one event).
+	 *	Writes to other backends than the batch one are not collected, nested scopes join the outer one.
+	 */
+	class GpioWriteBatch {
+	public:
+		/**
+		 *	@brief Start collecting pin writes of the current thread
+		 *
+		 *	@param backend backend the collected writes are applied to
+		 */
+		GpioWriteBatch(GpioBackend_ptr backend);
+
+		GpioWriteBatch(const GpioWriteBatch&) = delete;
+		GpioWriteBatch& operator= (const GpioWriteBatch&) = delete;
+
+		/**
+		 *	@brief Apply collected writes, if the batch is not nested
+		 */
+		~GpioWriteBatch();
+
+		/**
+		 *	@brief Collect a pin write in the batch open on the current thread
+		 *
+		 *	@param backend backend the pin belongs to
+		 *	@param pin pin number
+		 *	@param value pin level to write
+		 *
+		 *	@return false if no batch for given backend is open, the pin has to be written directly
+		 */
+		static bool stage(const GpioBackend_ptr& backend, int pin, int value);
+
+		/**
+		 *	@brief Apply writes collected so far
+		 */
+		void commit();
+
+	private:
+		const GpioBackend_ptr _backend;
+		GpioWriteBatch * const _outer;
+		GpioBanks _banks;
+		bool _empty;
+
+		static thread_local GpioWriteBatch * _current;
+	};
+
+}
+
+#endif // !DOMOTIC_PI_GPIO_WRITE_BATCH
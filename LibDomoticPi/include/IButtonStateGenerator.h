@@ -4,31 +4,36 @@
 #include "ButtonState.h"
 #include "CallbackToken.h"
 #include "domoticPiDefine.h"
+#include "GestureRecognizer.h"
+#include "InplaceFunction.h"
 #include "Serializable.h"
 
+#include <atomic>
 #include <chrono>
-#include <condition_variable>
 #include <functional>
-#include <list>
 #include <memory>
 #include <mutex>
 #include <rapidjson/document.h>
-#include <thread>
 #include <tuple>
+#include <vector>
 
 namespace domotic_pi {
 
 	class IButtonStateGenerator : public Serializable {
 	public:
 		/**
-		 *	@brief Initialize a thread listener to trigger double press and long press events from button change information
+		 *	@brief Initialize a generator of press gesture events from button edges
 		 *
-		 *	@note Until callbacks are set through relative setter methods, event listener threads aren't started
+		 *	@note Gestures are recognized by the shared gesture recognizer (see GestureRecognizer), 
+		 *		  callbacks are run either on the thread notifying the edge or on the timer wheel thread.
+		 *		  Callbacks are kept in an immutable list replaced on each change and reclaimed once no
+		 *		  dispatch runs, so gesture dispatch neither allocates nor takes a lock (registering a
+		 *		  callback may allocate); a callback removed while a gesture is being dispatched may
+		 *		  still be called one last time by that dispatch
 		 *
-		 *	@param doublePressDuration timeout within a double state change is translated to a double press event
-		 *	@param longPressDuration time current state has to be maintained to trigger a long press event
-		 *
-		 *	@throw invalid_argument when doublePressDuration equals zero
+		 *	@param doublePressDuration time a new click has to start within after the previous one
+		 *		  to be part of the same multi-click gesture (zero reports every click as single press)
+		 *	@param longPressDuration time a press has to be held to trigger a long press event (zero disables)
 		 */
 		IButtonStateGenerator(
 			const std::chrono::milliseconds doublePressDuration, 
@@ -46,9 +51,42 @@ namespace domotic_pi {
 		static std::tuple<std::chrono::milliseconds, std::chrono::milliseconds> from_json(const rapidjson::Value& config);
 
 		/**
-		 *	@brief Set the double press event callback
+		 *	@brief Set multi-click and hold repeat attributes from given json configuration object
+		 *
+		 *	@param config configuration object containing 'maxClicks' and/or 'holdRepeatInterval' attributes to load
+		 *	@param generator state generator to configure
+		 */
+		static void from_json(const rapidjson::Value& config, IButtonStateGenerator& generator);
+
+		/**
+		 *	@brief Set multi-click and hold repeat behaviour
+		 *
+		 *	@param maxClicks number of clicks reported as soon as reached, without waiting 
+		 *		  for the multi-click window to close (at least 1, default 2)
+		 *	@param holdRepeatInterval interval of hold repeat events while the button is held 
+		 *		  after a long press (zero disables)
+		 */
+		void setGestures(unsigned int maxClicks, std::chrono::milliseconds holdRepeatInterval);
+
+		unsigned int getMaxClicks() const;
+
+		std::chrono::milliseconds getHoldRepeatInterval() const;
+
+		/**
+		 *	@brief Set the single press event callback
+		 *
+		 *	@note Single press is reported once no other click can follow, 
+		 *		  so it is delayed by the multi-click window
+		 *
+		 *	@param singlePressCallback single press event callback
 		 *
-		 *	@note The double press listener thread is started and stopped according to the presence of callbacks
+		 *	@return callback token to keep while callback needs to be enabled, when the object is 
+		 *			disposed the relative callback is not called any more
+		 */
+		CallbackToken_ptr addSinglePressCallback(std::function<void()> singlePressCallback);
+
+		/**
+		 *	@brief Set the double press event callback
 		 *	
 		 *	@param doublePressCallback double press event callback
 		 *
@@ -58,9 +96,17 @@ namespace domotic_pi {
 		CallbackToken_ptr addDoublePressCallback(std::function<void()> doublePressCallback);
 
 		/**
-		 *	@brief Set the long press event callback
+		 *	@brief Set the multi press event callback, for three or more clicks
 		 *
-		 *	@note The long press listener thread is started and stopped according to the presence of callbacks
+		 *	@param multiPressCallback multi press event callback, called with the number of clicks
+		 *
+		 *	@return callback token to keep while callback needs to be enabled, when the object is 
+		 *			disposed the relative callback is not called any more
+		 */
+		CallbackToken_ptr addMultiPressCallback(std::function<void(unsigned int)> multiPressCallback);
+
+		/**
+		 *	@brief Set the long press event callback
 		 *
 		 *	@param longPressCallback long press event callback
 		 *
@@ -70,45 +116,83 @@ namespace domotic_pi {
 		CallbackToken_ptr addLongPressCallback(std::function<void()> longPressCallback);
 
 		/**
-		 *	@brief Serialize double and long press duration as json attributes of a json object
+		 *	@brief Set the hold repeat event callback, called periodically while held after a long press
+		 *
+		 *	@param holdRepeatCallback hold repeat event callback
 		 *
-		 *	@return json object with doublePressDurtation and longPressDuration attributes
+		 *	@return callback token to keep while callback needs to be enabled, when the object is 
+		 *			disposed the relative callback is not called any more
+		 */
+		CallbackToken_ptr addHoldRepeatCallback(std::function<void()> holdRepeatCallback);
+
+		/**
+		 *	@brief Serialize gesture attributes as json attributes of a json object
+		 *
+		 *	@return json object with doublePressDuration, longPressDuration, maxClicks and holdRepeatInterval attributes
 		 */
 		rapidjson::Document to_json() const override;
 
 	protected:
 		/**
-		 *	@brief Notify button state change event to the state generator
+		 *	@brief Notify a click from a source without release information (ie. single edge interrupts)
+		 *
+		 *	@param timestamp time the change has been detected at its source, call time is used if not set
+		 */
+		void buttonStateChange(Timestamp timestamp = Timestamp());
+
+		/**
+		 *	@brief Notify a button press or release edge
+		 *
+		 *	@param pressed true when the button has been pressed, false when released
+		 *	@param timestamp time the edge has been detected at its source, call time is used if not set
 		 */
-		void buttonStateChange();
+		void buttonEdge(bool pressed, Timestamp timestamp = Timestamp());
 
 	private:
 		const std::shared_ptr<IButtonStateGenerator> _this;
 		const std::chrono::milliseconds _doublePressDuration;
 		const std::chrono::milliseconds _longPressDuration;
+		unsigned int _maxClicks;
+		std::chrono::milliseconds _holdRepeatInterval;
 
 #ifdef DOMOTIC_PI_THREAD_SAFE
-		std::mutex _doublePressCBList;
-		std::mutex _longPressCBList;
+		std::mutex _callbacksLock;
 #endif
 
-		uint32_t _doublePressCBCounter;
-		uint32_t _longPressCBCounter;
-		std::list<std::tuple<uint32_t, std::function<void()>>> _doublePressCallbacks;
-		std::list<std::tuple<uint32_t, std::function<void()>>> _longPressCallbacks;
+		typedef InplaceFunction<void(unsigned int)> GestureCallback;
+		typedef std::vector<std::tuple<uint32_t, ButtonState, GestureCallback>> CallbackList;
 
-		std::mutex _stateChangeLock;
-		std::condition_variable _buttonStateChange;
+		uint32_t _callbackCounter;
 
-		volatile bool _doublePressRunning;
-		volatile bool _longPressRunning;
-		volatile bool _doubleStateChange;
-		volatile bool _longStateChange;
-		std::thread * _doublePressCheckThread;
-		std::thread * _longPressCheckThread;
+		//	Current list, read by dispatch with a plain atomic load while counted in _dispatching
+		std::atomic<const CallbackList*> _callbacks;
+		std::atomic<unsigned int> _dispatching;
 
-		void _double_press_check();
-		void _long_press_check();
+		//	Replaced lists a dispatch may still be reading, freed by a change made while none runs
+		std::vector<std::unique_ptr<const CallbackList>> _retired;
+
+		const std::shared_ptr<GestureRecognizer> _gestureRecognizer;
+		GestureButton_ptr _gestureButton;
+
+		/**
+		 *	@brief Add a callback called for given gesture
+		 */
+		CallbackToken_ptr _add_callback(ButtonState gesture, const GestureCallback& callback);
+
+		/**
+		 *	@brief Remove the callback with given index, publishing a new callback list
+		 */
+		void _remove_callback(uint32_t cbIndex);
+
+		/**
+		 *	@brief Replace the callback list, called with callbacks lock held
+		 */
+		void _publish(std::unique_ptr<const CallbackList> callbacks);
+
+		/**
+		 *	@brief Call the callbacks of a gesture recognized on this button
+		 */
+		void _gesture(ButtonState gesture, unsigned int clicks);
 	};
 
 }
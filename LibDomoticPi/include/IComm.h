@@ -6,6 +6,7 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <utility>
 
 namespace domotic_pi {
 
@@ -38,6 +39,9 @@ namespace domotic_pi {
 
 	typedef std::shared_ptr<IComm> Comm_ptr;
 
+	// Topic (or channel) reached through a comm interface
+	typedef std::pair<Comm_ptr, std::string> CommTopic;
+
 }
 
 #endif // !DOMOTIC_PI_ICOMM
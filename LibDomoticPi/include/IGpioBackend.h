@@ -0,0 +1,158 @@
+#ifndef DOMOTIC_PI_IGPIO_BACKEND
+#define DOMOTIC_PI_IGPIO_BACKEND
+
+#include "domoticPiDefine.h"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace domotic_pi {
+
+	// Pin modes, pulls and edges keep wiringPi values, so existing configurations stay valid
+	enum GpioMode {
+		gpio_input = 0,
+		gpio_output = 1
+	};
+
+	enum GpioPull {
+		pull_off = 0,
+		pull_down = 1,
+		pull_up = 2
+	};
+
+	enum GpioEdge {
+		edge_setup = 0,
+		edge_falling = 1,
+		edge_rising = 2,
+		edge_both = 3,
+		edge_none = 4
+	};
+
+	// Pins are grouped in banks of 64, pin n being bit n % 64 of bank n / 64
+	constexpr size_t gpioBankCount = DOMOTIC_PI_MAX_PIN / 64 + 1;
+
+	/**
+	 *	Pins to be driven high (set) and low (clear) in one bank
+	 */
+	struct GpioBank {
+		uint64_t set = 0;
+		uint64_t clear = 0;
+	};
+
+	typedef std::array<GpioBank, gpioBankCount> GpioBanks;
+
+	/**
+	 *	Level (or selection) of each pin, one bit per pin and one word per bank
+	 */
+	typedef std::array<uint64_t, gpioBankCount> GpioLevels;
+
+	/**
+	 *	Function called on a pin edge with the pin level after the edge and the time it has been detected at
+	 */
+	typedef std::function<void(int level, Timestamp timestamp)> GpioEdgeCallback;
+
+	/**
+	 *	Access to the GPIO pins used by the library modules. The backend in use is shared by the
+	 *	whole library and must be chosen before the first pin is requested (see set).
+	 *	Pin numbers are backend specific: wiringPi numbering for WiringPiGpio,
+	 *	chip line offsets for ChardevGpio.
+	 */
+	class IGpioBackend {
+	public:
+		IGpioBackend() = default;
+
+		IGpioBackend(const IGpioBackend&) = delete;
+		IGpioBackend& operator= (const IGpioBackend&) = delete;
+
+		virtual ~IGpioBackend() = default;
+
+		/**
+		 *	@brief Get the backend shared by the library for a GPIO chip, the default one for this build 
+		 *		   is created at first call for chip 0
+		 *
+		 *	@note Default backend is WiringPiGpio, or ChardevGpio when built with DOMOTIC_PI_NO_WIRING_PI
+		 *
+		 *	@param chip chip index, as used by the PinRegistry
+		 *
+		 *	@throw out_of_range if no backend has been set for a chip other than 0
+		 */
+		static const std::shared_ptr<IGpioBackend> load(unsigned int chip = 0);
+
+		/**
+		 *	@brief Replace the backend shared by the library for a GPIO chip
+		 *
+		 *	@note Modules already created keep using the backend they have been created with.
+		 *		  Only chip 0 backend is set up by domoticPiInit, backends of other chips must be set up by the caller
+		 *
+		 *	@param backend backend accessing the chip pins
+		 *	@param chip chip index, as used by the PinRegistry
+		 */
+		static void set(std::shared_ptr<IGpioBackend> backend, unsigned int chip = 0);
+
+		/**
+		 *	@brief Initialize the backend, called by domoticPiInit
+		 *
+		 *	@return 0 on success, non-zero on error
+		 */
+		virtual int setup() = 0;
+
+		/**
+		 *	@brief Get backend name for logs and statistics
+		 */
+		virtual const char * getName() const = 0;
+
+		virtual void setMode(int pin, GpioMode mode) = 0;
+
+		virtual void setPull(int pin, GpioPull pull) = 0;
+
+		virtual void write(int pin, int value) = 0;
+
+		virtual int read(int pin) = 0;
+
+		/**
+		 *	@brief Write several output pins in one operation
+		 *
+		 *	@note The default implementation writes pins one by one, backends able to switch
+		 *		  several pins at the same moment override it (see their notes for which pins)
+		 *
+		 *	@param banks pins to set and clear, a pin in both masks is cleared
+		 */
+		virtual void writeBanks(const GpioBanks& banks);
+
+		/**
+		 *	@brief Read several pins in one operation
+		 *
+		 *	@note The default implementation reads pins one by one, backends able to 
+		 *		  take a consistent snapshot override it
+		 *
+		 *	@param mask pins to be read
+		 *	@param levels read levels, bits outside the mask are cleared
+		 */
+		virtual void readBanks(const GpioLevels& mask, GpioLevels& levels);
+
+		/**
+		 *	@brief Set the edges raising an interrupt on given input pin
+		 *
+		 *	@param pin input pin number
+		 *	@param edge edges to be notified (edge_none disables notifications)
+		 *	@param callback function called on each notified edge, if null only
+		 *		  the edge of the already registered callback is changed
+		 *
+		 *	@note Must not be called from an edge callback: backends may replace or wait for
+		 *		  the thread the callbacks run on
+		 *
+		 *	@return 0 on success, non-zero on error
+		 */
+		virtual int setEdgeCallback(int pin, GpioEdge edge, GpioEdgeCallback callback) = 0;
+
+	private:
+		static std::array<std::shared_ptr<IGpioBackend>, DOMOTIC_PI_MAX_CHIPS> _backends;
+	};
+
+	typedef std::shared_ptr<IGpioBackend> GpioBackend_ptr;
+
+}
+
+#endif // !DOMOTIC_PI_IGPIO_BACKEND
@@ -4,18 +4,27 @@
 #include "CallbackToken.h"
 #include "domoticPi.h"
 #include "domoticPiDefine.h"
+#include "DomoticNode.h"
+#include "EventDispatcher.h"
+#include "IComm.h"
 #include "IModule.h"
+#include "PatternMatcher.h"
 #include "ProgrammedEvent.h"
+#include "TimerWheel.h"
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <memory>
 #include <rapidjson/document.h>
 #ifdef DOMOTIC_PI_THREAD_SAFE
+#include <mutex>
 #include <shared_mutex>
 #endif // DOMOTIC_PI_THREAD_SAFE
 #include <tuple>
 #include <type_traits>
 #include <string>
+#include <vector>
 
 namespace domotic_pi {
 
@@ -53,6 +62,65 @@ namespace domotic_pi {
 
 		void removeProgrammedEvent(const std::string& programmedEventId);
 
+		/**
+		 *	@brief Get programmed events currently bound to this input
+		 */
+		std::vector<ProgrammedEvent_ptr> getProgrammedEvents() const;
+
+		/**
+		 *	@brief Get the topic filters this input listens to for value changes
+		 *
+		 *	@note Used to detect feedback loops among inputs and outputs sharing a comm interface
+		 *
+		 *	@return list of comm-topic filter pairs, empty if the input does not use any comm topic
+		 */
+		virtual std::vector<CommTopic> getListenedTopics() const;
+
+		/**
+		 *	@brief Set debounce window applied to value changes before dispatching events
+		 *
+		 *	@note The first change is dispatched immediately and opens the window, changes 
+		 *		  within the window are merged and only the last one is dispatched when
+		 *		  the window closes, if it differs from the last dispatched value
+		 *
+		 *	@param window debounce window duration, zero disables debouncing
+		 */
+		void setDebounce(std::chrono::milliseconds window);
+
+		std::chrono::milliseconds getDebounce() const;
+
+		/**
+		 *	@brief Set token bucket rate limit applied to value changes before dispatching events
+		 *
+		 *	@note Changes arriving with an empty bucket are dropped
+		 *
+		 *	@param rate changes per second refilled in the bucket, zero disables rate limiting
+		 *	@param burst bucket capacity, maximum number of changes dispatched in a row
+		 */
+		void setRateLimit(double rate, unsigned int burst = 1);
+
+		double getRateLimit() const;
+
+		unsigned int getRateLimitBurst() const;
+
+		/**
+		 *	@brief Get number of value changes dropped by the rate limiter
+		 */
+		uint64_t getDroppedCount() const;
+
+		/**
+		 *	@brief Get number of value changes merged into following ones by the debounce window
+		 */
+		uint64_t getMergedCount() const;
+
+		/**
+		 *	@brief Report input statistics as json object
+		 *
+		 *	@return json object with dropped and merged change counters, 
+		 *			extended by inputs with their own statistics
+		 */
+		virtual rapidjson::Document stats_to_json() const;
+
 		rapidjson::Document to_json() const override;
 
 	protected:
@@ -75,6 +143,17 @@ namespace domotic_pi {
 			std::shared_ptr<T> input, 
 			DomoticNode_ptr parentNode)
 		{
+			// Load change filters applied before dispatching events
+			if (config.HasMember("debounce")) {
+				input->setDebounce(std::chrono::milliseconds(config["debounce"].GetInt()));
+			}
+
+			if (config.HasMember("rateLimit")) {
+				const rapidjson::Value& rateLimit = config["rateLimit"];
+				input->setRateLimit(rateLimit["rate"].GetDouble(),
+					rateLimit.HasMember("burst") ? rateLimit["burst"].GetUint() : 1);
+			}
+
 			// Load programmed event bindings
 			if (config.HasMember("triggerEvents")) {
 				for (auto& it : config["triggerEvents"].GetArray()) {
@@ -102,17 +181,65 @@ namespace domotic_pi {
 		/**
 		 *	@brief Check for programmed events to be triggered and fires them if needed
 		 *
+		 *	@note Debounce and rate limit filters are applied before any event is dispatched,
+		 *		  except for safety priority events which are dispatched on every change
+		 *
 		 *	@param newValue new value to check programmed events for
+		 *	@param timestamp time the change has been detected at its source, 
+		 *		  call time is used if not set
 		 */
-		void valueChanged(int newValue) const;
+		void valueChanged(int newValue, Timestamp timestamp = Timestamp()) const;
 
 	private:
 		std::shared_ptr<IInput> _this;
 #ifdef DOMOTIC_PI_THREAD_SAFE
 		mutable std::shared_mutex _valueEventPairsLock;
+		mutable std::mutex _filterLock;
 #endif // DOMOTIC_PI_THREAD_SAFE
 		std::list<std::pair<int, std::weak_ptr<ProgrammedEvent>>> _valueEventPairs;
 
+		const std::shared_ptr<EventDispatcher> _eventDispatcher;
+		const std::shared_ptr<PatternMatcher> _patternMatcher;
+		const std::shared_ptr<TimerWheel> _timerWheel;
+		std::chrono::milliseconds _debounce;
+		Timer_ptr _debounceTimer;
+		mutable bool _debouncing;
+		mutable bool _pendingChange;
+		mutable int _pendingValue;
+		mutable Timestamp _pendingTimestamp;
+		mutable int _lastDispatchedValue;
+
+		double _rate;
+		unsigned int _burst;
+		mutable double _tokens;
+		mutable Timestamp _lastRefill;
+
+		mutable std::atomic<uint64_t> _droppedCount;
+		mutable std::atomic<uint64_t> _mergedCount;
+
+		/**
+		 *	@brief Close debounce window, dispatching last merged change if any
+		 */
+		void _debounce_expired() const;
+
+		/**
+		 *	@brief Take a token from the rate limit bucket
+		 *
+		 *	@note Must be called holding filter lock
+		 *
+		 *	@return true if the change can be dispatched, false if it has to be dropped
+		 */
+		bool _take_token(Timestamp now) const;
+
+		/**
+		 *	@brief Queue programmed events bound to given value on the event dispatcher
+		 *
+		 *	@note Filtered changes are fed to the pattern matcher too
+		 *
+		 *	@param safety whether to queue only safety priority events or only the others
+		 */
+		void _dispatch(int newValue, Timestamp timestamp, bool safety) const;
+
 	};
 
 	typedef std::shared_ptr<IInput> Input_ptr;
@@ -2,14 +2,19 @@
 #define DOMOTIC_PI_IOUTPUT
 
 #include "domoticPiDefine.h"
+#include "IComm.h"
 #include "IModule.h"
+#include "LatencyHistogram.h"
 #include "OutState.h"
 
+#include <atomic>
 #include <memory>
+#include <rapidjson/document.h>
 #ifdef DOMOTIC_PI_THREAD_SAFE
 #include <mutex>
 #endif // DOMOTIC_PI_THREAD_SAFE
 #include <string>
+#include <vector>
 
 namespace domotic_pi {
 
@@ -37,15 +42,49 @@ namespace domotic_pi {
 		 *	@brief Set output power state as on/off/toggle
 		 *
 		 *	@param newState state to move the output to
+		 *	@param timestamp source timestamp of the event requesting the change, 
+		 *		  if not set the command latency is not traced
 		 */
-		virtual void setState(OutState newState) = 0;
+		virtual void setState(OutState newState, Timestamp timestamp = Timestamp()) = 0;
 
 		/**
 		 *	@brief Set output to specified value
 		 *
 		 *	@param newValue value to set the output to
+		 *	@param timestamp source timestamp of the event requesting the change, 
+		 *		  if not set the command latency is not traced
 		 */
-		virtual void setValue(int newValue) = 0;
+		virtual void setValue(int newValue, Timestamp timestamp = Timestamp()) = 0;
+
+		/**
+		 *	@brief Get the topics this output generates traffic on when its value is set,
+		 *		   including feedback sent back by the device
+		 *
+		 *	@note Used to detect feedback loops among inputs and outputs sharing a comm interface
+		 *
+		 *	@return list of comm-topic pairs, empty if the output does not use any comm topic
+		 */
+		virtual std::vector<CommTopic> getProducedTopics() const;
+
+		/**
+		 *	@brief Get latency from event source to command sent to the device
+		 */
+		const LatencyHistogram& getCommandLatency() const;
+
+		/**
+		 *	@brief Get round trip latency from command sent to state feedback from the device
+		 *
+		 *	@note Only outputs receiving a state feedback (ie. mqtt stat topic) record these samples
+		 */
+		const LatencyHistogram& getFeedbackLatency() const;
+
+		/**
+		 *	@brief Report output statistics as json object
+		 *
+		 *	@return json object with command and feedback latencies, 
+		 *			extended by outputs with their own statistics
+		 */
+		virtual rapidjson::Document stats_to_json() const;
 
 	protected:
 		int _value;
@@ -53,6 +92,23 @@ namespace domotic_pi {
 		std::mutex _valueLock;
 #endif // DOMOTIC_PI_THREAD_SAFE
 
+		/**
+		 *	@brief Trace a command just sent to the device
+		 *
+		 *	@param timestamp source timestamp of the command
+		 */
+		void _trace_command(Timestamp timestamp);
+
+		/**
+		 *	@brief Trace a state feedback received from the device
+		 */
+		void _trace_feedback();
+
+	private:
+		LatencyHistogram _commandLatency;
+		LatencyHistogram _feedbackLatency;
+		std::atomic<Timestamp::rep> _lastCommand;
+
 	};
 
 	typedef std::shared_ptr<IOutput> Output_ptr;
@@ -0,0 +1,140 @@
+#ifndef DOMOTIC_PI_INPLACE_FUNCTION
+#define DOMOTIC_PI_INPLACE_FUNCTION
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace domotic_pi {
+
+	template <typename Signature, size_t Size = 48>
+	class InplaceFunction;
+
+	/**
+	 *	Callable wrapper storing the target inside a fixed size buffer: unlike std::function
+	 *	it never allocates by itself, neither when created nor when copied or called. Targets
+	 *	bigger than Size bytes are rejected at compile time; a target owning heap memory
+	 *	(ie. capturing a std::function) still allocates when copied.
+	 *
+	 *	@tparam R return type
+	 *	@tparam Args argument types
+	 *	@tparam Size storage size in bytes
+	 */
+	template <typename R, typename... Args, size_t Size>
+	class InplaceFunction<R(Args...), Size> {
+	public:
+		InplaceFunction() noexcept : _ops(nullptr) {}
+
+		InplaceFunction(std::nullptr_t) noexcept : _ops(nullptr) {}
+
+		template <typename F, typename = typename std::enable_if<
+			!std::is_same<typename std::decay<F>::type, InplaceFunction>::value>::type>
+		InplaceFunction(F&& target)
+		{
+			typedef typename std::decay<F>::type Target;
+
+			static_assert(sizeof(Target) <= Size, "InplaceFunction target does not fit the inline storage");
+			static_assert(alignof(Target) <= alignof(std::max_align_t), "InplaceFunction target alignment not supported");
+
+			new (&_storage) Target(std::forward<F>(target));
+			_ops = &_Ops<Target>::ops;
+		}
+
+		InplaceFunction(const InplaceFunction& other) : _ops(other._ops)
+		{
+			if (_ops != nullptr) {
+				_ops->copy(&_storage, &other._storage);
+			}
+		}
+
+		InplaceFunction& operator= (const InplaceFunction& other)
+		{
+			if (this != &other) {
+				reset();
+				if (other._ops != nullptr) {
+					other._ops->copy(&_storage, &other._storage);
+					_ops = other._ops;
+				}
+			}
+
+			return *this;
+		}
+
+		InplaceFunction& operator= (std::nullptr_t) noexcept
+		{
+			reset();
+			return *this;
+		}
+
+		~InplaceFunction()
+		{
+			reset();
+		}
+
+		R operator() (Args... args) const
+		{
+			return _ops->invoke(&_storage, std::forward<Args>(args)...);
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return _ops != nullptr;
+		}
+
+		bool operator== (std::nullptr_t) const noexcept
+		{
+			return _ops == nullptr;
+		}
+
+		bool operator!= (std::nullptr_t) const noexcept
+		{
+			return _ops != nullptr;
+		}
+
+		void reset() noexcept
+		{
+			if (_ops != nullptr) {
+				_ops->destroy(&_storage);
+				_ops = nullptr;
+			}
+		}
+
+	private:
+		struct Ops {
+			R (*invoke)(const void * storage, Args&&... args);
+			void (*copy)(void * storage, const void * other);
+			void (*destroy)(void * storage);
+		};
+
+		template <typename Target>
+		struct _Ops {
+			static R invoke(const void * storage, Args&&... args)
+			{
+				return (*const_cast<Target*>(static_cast<const Target*>(storage)))(std::forward<Args>(args)...);
+			}
+
+			static void copy(void * storage, const void * other)
+			{
+				new (storage) Target(*static_cast<const Target*>(other));
+			}
+
+			static void destroy(void * storage)
+			{
+				static_cast<Target*>(storage)->~Target();
+			}
+
+			static constexpr Ops ops = { &invoke, &copy, &destroy };
+		};
+
+		typename std::aligned_storage<Size, alignof(std::max_align_t)>::type _storage;
+		const Ops * _ops;
+	};
+
+	template <typename R, typename... Args, size_t Size>
+	template <typename Target>
+	constexpr typename InplaceFunction<R(Args...), Size>::Ops InplaceFunction<R(Args...), Size>::_Ops<Target>::ops;
+
+}
+
+#endif // !DOMOTIC_PI_INPLACE_FUNCTION
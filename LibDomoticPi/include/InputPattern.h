@@ -0,0 +1,102 @@
+#ifndef DOMOTIC_PI_INPUT_PATTERN
+#define DOMOTIC_PI_INPUT_PATTERN
+
+#include "domoticPiDefine.h"
+#include "Serializable.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <rapidjson/document.h>
+#include <string>
+#include <vector>
+
+namespace domotic_pi {
+
+	class ProgrammedEvent;
+
+	enum PatternType {
+		chord_pattern = 0,
+		sequence_pattern = 1
+	};
+
+	/**
+	 *	Combination of input changes triggering a programmed event:
+	 *	a chord matches when every step happens, in any order, within the window;
+	 *	a sequence matches when the steps happen in the given order within the window.
+	 *	The window is measured from the first matching step.
+	 */
+	class InputPattern : public Serializable {
+	public:
+		static constexpr size_t maxSteps = 64;
+
+		struct Step {
+			std::string inputId;
+			int value;
+		};
+
+		/**
+		 *	@brief Initialize a new input pattern bound to given programmed event
+		 *
+		 *	@param type chord or sequence
+		 *	@param steps input changes to match (use max_int as value to match any change of the input)
+		 *	@param window time all the steps have to happen within
+		 *	@param programmedEvent event to trigger when the pattern matches
+		 *
+		 *	@throw domotic_pi_exception if steps are empty or more than maxSteps
+		 */
+		InputPattern(
+			PatternType type,
+			const std::vector<Step>& steps,
+			std::chrono::milliseconds window,
+			std::weak_ptr<ProgrammedEvent> programmedEvent);
+
+		/**
+		 *	@brief Initialize a new input pattern from a json configuration
+		 *
+		 *	@param config json pattern configuration (see ProgrammedEvent schema)
+		 *	@param programmedEvent event to trigger when the pattern matches
+		 */
+		static std::shared_ptr<InputPattern> from_json(
+			const rapidjson::Value& config,
+			std::weak_ptr<ProgrammedEvent> programmedEvent);
+
+		PatternType getType() const;
+
+		const std::vector<Step>& getSteps() const;
+
+		std::chrono::milliseconds getWindow() const;
+
+		std::shared_ptr<ProgrammedEvent> getProgrammedEvent() const;
+
+		rapidjson::Document to_json() const override;
+
+	private:
+		const PatternType _type;
+		const std::vector<Step> _steps;
+		const std::chrono::milliseconds _window;
+		const std::weak_ptr<ProgrammedEvent> _programmedEvent;
+		const uint64_t _completeMask;
+
+		// Matcher state, guarded by the pattern matcher lock
+		unsigned int _activeCount;
+		uint64_t _consumedChange;
+		uint64_t _matchedChange;
+
+		/**
+		 *	@brief Find the step matched by given change after the already matched ones
+		 *
+		 *	@param matched bit mask of the steps already matched
+		 *
+		 *	@return index of the matched step, or maxSteps if the change does not advance the pattern
+		 */
+		size_t _next_step(uint64_t matched, const std::string& inputId, int value) const;
+
+		friend class PatternMatcher;
+	};
+
+	typedef std::shared_ptr<InputPattern> InputPattern_ptr;
+
+}
+
+#endif // !DOMOTIC_PI_INPUT_PATTERN
@@ -0,0 +1,80 @@
+#ifndef DOMOTIC_PI_LATENCY_HISTOGRAM
+#define DOMOTIC_PI_LATENCY_HISTOGRAM
+
+#include "domoticPiDefine.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <rapidjson/document.h>
+
+namespace domotic_pi {
+
+	/**
+	 *	Lock free latency histogram with power of two microsecond buckets:
+	 *	bucket 0 counts samples below 1 us, bucket i counts samples in [2^(i-1), 2^i) us.
+	 *	Samples can be recorded concurrently from any thread without blocking.
+	 */
+	class LatencyHistogram {
+	public:
+		static constexpr size_t bucketCount = 32;
+
+		LatencyHistogram();
+
+		LatencyHistogram(const LatencyHistogram&) = delete;
+		LatencyHistogram& operator= (const LatencyHistogram&) = delete;
+
+		/**
+		 *	@brief Add a latency sample to the histogram
+		 *
+		 *	@param latency measured latency (negative values are counted as zero)
+		 */
+		void record(std::chrono::nanoseconds latency);
+
+		/**
+		 *	@brief Add the latency elapsed from given timestamp until now
+		 *
+		 *	@note Nothing is recorded if the timestamp is not set (default constructed)
+		 *
+		 *	@param since timestamp the latency is measured from
+		 */
+		void recordSince(Timestamp since);
+
+		uint64_t getCount() const;
+
+		std::chrono::microseconds getMean() const;
+
+		std::chrono::microseconds getMax() const;
+
+		/**
+		 *	@brief Get an upper bound for the requested percentile
+		 *
+		 *	@param percentile percentile to compute in range [0, 100]
+		 *
+		 *	@return upper limit of the bucket containing the requested percentile
+		 */
+		std::chrono::microseconds getPercentile(double percentile) const;
+
+		/**
+		 *	@brief Clear all recorded samples
+		 */
+		void reset();
+
+		/**
+		 *	@brief Report recorded statistics as json object
+		 *
+		 *	@return json object with count, mean, max, 50/90/99 percentiles (us) and bucket counters
+		 */
+		rapidjson::Document to_json() const;
+
+	private:
+		std::array<std::atomic<uint64_t>, bucketCount> _buckets;
+		std::atomic<uint64_t> _count;
+		std::atomic<uint64_t> _sumUs;
+		std::atomic<uint64_t> _maxUs;
+	};
+
+}
+
+#endif // !DOMOTIC_PI_LATENCY_HISTOGRAM
@@ -5,9 +5,11 @@
 #include "MqttComm.h"
 #include "MqttSubscription.h"
 #include "OutputFactory.h"
+#include "TimerWheel.h"
 
 #include <mosquitto.h>
 #include <string>
+#include <vector>
 
 namespace domotic_pi {
 
@@ -30,9 +32,11 @@ namespace domotic_pi {
 		MqttAwning& operator= (const MqttAwning&) = delete;
 		~MqttAwning();
 
-		void setState(OutState newState) override;
+		void setState(OutState newState, Timestamp timestamp = Timestamp()) override;
 
-		void setValue(int newValue) override;
+		void setValue(int newValue, Timestamp timestamp = Timestamp()) override;
+
+		std::vector<CommTopic> getProducedTopics() const override;
 
 		rapidjson::Document to_json() const override;
 
@@ -48,6 +52,8 @@ namespace domotic_pi {
 		hap::IntCharacteristics_ptr _currentPosition;
 		hap::IntCharacteristics_ptr _targetPosition;
 		hap::IntCharacteristics_ptr _positionState;
+		const std::shared_ptr<TimerWheel> _timerWheel;
+		Timer_ptr _identifyTimer;
 #endif
 
 		void _stat_message_cb(const struct mosquitto_message * message);
@@ -17,6 +17,7 @@
 #endif // DOMOTIC_PI_THREAD_SAFE
 #include <rapidjson/document.h>
 #include <string>
+#include <vector>
 
 namespace domotic_pi {
 
@@ -46,6 +47,8 @@ public:
 
 	int getValue() const override;
 
+	std::vector<CommTopic> getListenedTopics() const override;
+
 	rapidjson::Document to_json() const override;
 
 private:
@@ -3,6 +3,7 @@
 
 #include <functional>
 #include <mosquitto.h>
+#include <string>
 
 namespace domotic_pi {
 
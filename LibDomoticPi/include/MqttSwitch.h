@@ -5,9 +5,11 @@
 #include "MqttComm.h"
 #include "MqttSubscription.h"
 #include "OutputFactory.h"
+#include "TimerWheel.h"
 
 #include <mosquitto.h>
 #include <string>
+#include <vector>
 
 namespace domotic_pi {
 
@@ -42,9 +44,11 @@ public:
 	MqttSwitch& operator= (const MqttSwitch&) = delete;
 	~MqttSwitch();
 
-	void setState(OutState newState) override;
+	void setState(OutState newState, Timestamp timestamp = Timestamp()) override;
 
-	void setValue(int newValue) override;
+	void setValue(int newValue, Timestamp timestamp = Timestamp()) override;
+
+	std::vector<CommTopic> getProducedTopics() const override;
 
 	rapidjson::Document to_json() const override;
 
@@ -59,6 +63,8 @@ private:
 
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
 	hap::BoolCharacteristics_ptr _stateInfo;
+	const std::shared_ptr<TimerWheel> _timerWheel;
+	Timer_ptr _identifyTimer;
 #endif
 
 	void _stat_message_cb(const struct mosquitto_message * message);
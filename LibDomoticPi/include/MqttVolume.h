@@ -9,6 +9,7 @@
 
 #include <memory>
 #include <mosquitto.h>
+#include <vector>
 
 namespace domotic_pi {
 
@@ -23,9 +24,11 @@ public:
 	MqttVolume& operator= (const MqttVolume&) = delete;
 	~MqttVolume();
 
-	void setState(OutState newState) override;
+	void setState(OutState newState, Timestamp timestamp = Timestamp()) override;
 
-	void setValue(int newValue) override;
+	void setValue(int newValue, Timestamp timestamp = Timestamp()) override;
+
+	std::vector<CommTopic> getProducedTopics() const override;
 
 	rapidjson::Document to_json() const override;
 
@@ -3,6 +3,7 @@
 
 #include "domoticPiDefine.h"
 
+#include <functional>
 #include <map>
 #ifdef DOMOTIC_PI_THREAD_SAFE
 #include <mutex>
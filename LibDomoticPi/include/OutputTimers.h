@@ -0,0 +1,172 @@
+#ifndef DOMOTIC_PI_OUTPUT_TIMERS
+#define DOMOTIC_PI_OUTPUT_TIMERS
+
+#include "domoticPiDefine.h"
+#include "TimerWheel.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace domotic_pi {
+
+	// How a timed action already running on an output reacts to a new trigger
+	enum TimedMode {
+		timed_retrigger = 0,	// restart the duration from the new trigger
+		timed_extend = 1		// add the duration to the remaining time
+	};
+
+	/**
+	 *	Timing of an output action: switched on for a duration (ie. staircase light, door strike)
+	 *	or driven by a train of pulses. A zero on time makes a plain action.
+	 */
+	struct TimedAction {
+		std::chrono::milliseconds on = std::chrono::milliseconds::zero();
+		std::chrono::milliseconds off = std::chrono::milliseconds::zero();
+		unsigned int pulses = 0;
+		TimedMode mode = timed_retrigger;
+	};
+
+	/**
+	 *	Scheduler of timed and pulsed output actions shared by the whole library. Every pending
+	 *	switch off runs on the timer wheel, so any number of outputs can be timed at once without
+	 *	holding a thread each.
+	 *
+	 *	Pending actions are kept by output id rather than by output object: when outputs are created
+	 *	again by a configuration reload, the new output with the same id takes over the running
+	 *	action with its original deadlines (see attach).
+	 */
+	class OutputTimers {
+	public:
+		OutputTimers();
+
+		OutputTimers(const OutputTimers&) = delete;
+		OutputTimers& operator= (const OutputTimers&) = delete;
+		~OutputTimers();
+
+		/**
+		 *	@brief Get the output timers instance shared by the library
+		 *
+		 *	@return output timers instance, kept alive while at least one reference exists
+		 */
+		static const std::shared_ptr<OutputTimers> load();
+
+		/**
+		 *	@brief Set given output to a value and switch it off after a duration
+		 *
+		 *	@note A pulse train running on the output is replaced
+		 *
+		 *	@param output output module to drive
+		 *	@param value value to set the output to (use max_int to switch it on)
+		 *	@param duration time the output stays at given value
+		 *	@param mode behaviour when the output is already timed
+		 *	@param timestamp source timestamp of the event requesting the change
+		 */
+		void switchFor(Output_ptr output, int value, std::chrono::milliseconds duration,
+			TimedMode mode = timed_retrigger, Timestamp timestamp = Timestamp());
+
+		/**
+		 *	@brief Drive given output with a train of pulses, ending switched off
+		 *
+		 *	@note Any timed action running on the output is replaced
+		 *
+		 *	@param output output module to drive
+		 *	@param value value set during each pulse (use max_int to switch it on)
+		 *	@param on pulse duration
+		 *	@param off time between two pulses
+		 *	@param count number of pulses
+		 *	@param timestamp source timestamp of the event requesting the change
+		 */
+		void pulse(Output_ptr output, int value, std::chrono::milliseconds on,
+			std::chrono::milliseconds off, unsigned int count, Timestamp timestamp = Timestamp());
+
+		/**
+		 *	@brief Run the action described by given timing on an output
+		 */
+		void perform(Output_ptr output, int value, const TimedAction& timing, Timestamp timestamp = Timestamp());
+
+		/**
+		 *	@brief Bind the pending action of an output id to given output module
+		 *
+		 *	@note Called when an output is added to a node: an output replacing one with the same id
+		 *		  is set to the current value of the running action, and a switch off which came due
+		 *		  while no output was bound is performed
+		 */
+		void attach(Output_ptr output);
+
+		/**
+		 *	@brief Stop the action running on given output, leaving the output as it is
+		 */
+		void cancel(const std::string& outputId);
+
+		/**
+		 *	@brief Get the time the running action of given output switches it off for good
+		 *
+		 *	@return end of the action, Timestamp::max() if no action is running
+		 */
+		Timestamp getDeadline(const std::string& outputId) const;
+
+		/**
+		 *	@brief Get the number of outputs with a running action
+		 */
+		size_t getPendingCount() const;
+
+	private:
+		struct Entry {
+			std::weak_ptr<IOutput> output;
+			Timer_ptr timer;
+			int value;
+			bool high;
+			bool due;
+			Timestamp phaseEnd;
+			std::chrono::milliseconds on;
+			std::chrono::milliseconds off;
+			unsigned int remainingPulses;
+
+			// Bumped by every change of the action, so a phase computed before a newer change
+			// is never applied after it; applies of one output are serialized by the apply lock
+			uint64_t generation;
+			std::recursive_mutex applyLock;
+		};
+
+		static std::shared_ptr<OutputTimers> _outputTimers;
+
+		const std::shared_ptr<TimerWheel> _timerWheel;
+
+		mutable std::mutex _timersLock;
+		std::unordered_map<std::string, std::shared_ptr<Entry>> _entries;
+
+		/**
+		 *	@brief Get the entry of given output, creating it if needed
+		 */
+		std::shared_ptr<Entry> _entry(const std::string& outputId);
+
+		/**
+		 *	@brief Arm the entry timer for the end of its current phase
+		 */
+		void _arm(Entry& entry);
+
+		/**
+		 *	@brief Entry timer callback, moves the action to its next phase
+		 */
+		void _expired(const std::string& outputId);
+
+		/**
+		 *	@brief Set an output to the level of a phase, unless the action of the entry changed
+		 *		   since given generation
+		 */
+		void _apply_entry(const std::shared_ptr<Entry>& entry, uint64_t generation,
+			const Output_ptr& output, bool high, int value, Timestamp timestamp);
+
+		/**
+		 *	@brief Set an output to the level of a phase
+		 */
+		static void _apply(const Output_ptr& output, bool high, int value, Timestamp timestamp);
+	};
+
+}
+
+#endif // !DOMOTIC_PI_OUTPUT_TIMERS
@@ -0,0 +1,89 @@
+#ifndef DOMOTIC_PI_PATTERN_MATCHER
+#define DOMOTIC_PI_PATTERN_MATCHER
+
+#include "domoticPiDefine.h"
+#include "EventDispatcher.h"
+#include "InputPattern.h"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace domotic_pi {
+
+	/**
+	 *	Incremental matcher of input patterns (chords and sequences), shared by the library.
+	 *	Patterns are indexed by the inputs able to start them, and only partially matched
+	 *	patterns are kept active: the cost of each input change depends on the active
+	 *	partial matches and on the patterns starting from that input, not on the total
+	 *	number of patterns. Matched patterns queue their event on the event dispatcher.
+	 *
+	 *	A change not advancing the partial matches of a pattern may start a new one, so a
+	 *	repeated first step is matched again from its own time (ie. A, A, B of an A then B
+	 *	sequence matches the second A with B even once the window of the first A is closed).
+	 */
+	class PatternMatcher {
+	public:
+		PatternMatcher();
+
+		PatternMatcher(const PatternMatcher&) = delete;
+		PatternMatcher& operator= (const PatternMatcher&) = delete;
+
+		/**
+		 *	@brief Get the pattern matcher instance shared by the library
+		 *
+		 *	@return pattern matcher instance, kept alive while at least one reference exists
+		 */
+		static const std::shared_ptr<PatternMatcher> load();
+
+		/**
+		 *	@brief Start matching given pattern
+		 *
+		 *	@note Only a weak reference is kept: the pattern is dropped once its owner releases it
+		 */
+		void addPattern(const InputPattern_ptr& pattern);
+
+		/**
+		 *	@brief Stop matching given pattern, dropping its partial match if any
+		 *
+		 *	@param pattern pattern to remove (if not present, nothing happens)
+		 */
+		void removePattern(const InputPattern_ptr& pattern);
+
+		/**
+		 *	@brief Feed an input change to the matcher
+		 *
+		 *	@param inputId id of the changed input
+		 *	@param value new input value
+		 *	@param timestamp source timestamp of the change
+		 */
+		void inputChanged(const std::string& inputId, int value, Timestamp timestamp);
+
+		/**
+		 *	@brief Get number of patterns currently partially matched
+		 */
+		size_t getActiveCount() const;
+
+	private:
+		struct PartialMatch {
+			InputPattern_ptr pattern;
+			uint64_t matched;
+			Timestamp start;
+		};
+
+		static std::shared_ptr<PatternMatcher> _patternMatcher;
+
+		const std::shared_ptr<EventDispatcher> _eventDispatcher;
+		mutable std::mutex _matcherLock;
+		std::unordered_map<std::string, std::vector<std::weak_ptr<InputPattern>>> _startIndex;
+		std::list<PartialMatch> _active;
+		uint64_t _changeCount;
+	};
+
+}
+
+#endif // !DOMOTIC_PI_PATTERN_MATCHER
@@ -2,46 +2,54 @@
 #define DOMOTIC_PI_PIN
 
 #include "domoticPiDefine.h"
+#include "IGpioBackend.h"
+
+#include "PinRegistry.h"
 
 #include <memory>
-#ifdef DOMOTIC_PI_THREAD_SAFE
-#include <mutex>
-#endif // DOMOTIC_PI_THREAD_SAFE
+#include <string>
 
 namespace domotic_pi {
 
 	//	This class is meant to be extended by any object willing to use a physical pin. 
 	//	This is to avoid conflicts between different objects accessing the same pin 
-	//	in different ways.
+	//	in different ways. Pin ownership is kept by the PinRegistry.
 	class Pin {
 	public:
 
 		//	Tries to lock requested pin for exclusive use
 		//
 		//	@param pin Pin number to lock. (If no pin is needed any negative value is valid)
+		//	@param owner Identifier of the module using the pin, reported on conflicts
+		//	@param required Capabilities the pin must have (see PinCapability)
+		//	@param chip Index of the GPIO chip the pin belongs to
 		//
-		//	@throws out_of_range If pin number isn't in range 0-20
-		//	@throws already_used_exception If pin is already used by another object
-		Pin(int pin);
+		//	@throws out_of_range If pin number isn't one of the chip lines
+		//	@throws domotic_pi_exception If pin is already used by another object or lacks a required capability
+		Pin(int pin, const std::string& owner = std::string(), unsigned int required = pin_cap_none, unsigned int chip = 0);
 
 		Pin(const Pin&) = delete;
 		Pin& operator= (const Pin&) = delete;
 
+		//	Resets the pin to the release state of its chip, then unlocks it
 		virtual ~Pin();
 
 		int getPin() const;
 
+		unsigned int getChip() const;
+
 	protected:
 		//	Object specific pin currently locked
 		const int _pin;
 
+		//	GPIO chip of the pin
+		const unsigned int _chip;
+
+		//	GPIO backend the pin is accessed through
+		const GpioBackend_ptr _gpio;
+
 	private:
-		//	Global pin usage vector
-		//	When a pin is locked and used _inUse[pinNumber] = true
-		static bool _inUse [];
-#ifdef DOMOTIC_PI_THREAD_SAFE
-		static std::mutex _pinLock;
-#endif // DOMOTIC_PI_THREAD_SAFE
+		const std::shared_ptr<PinRegistry> _pinRegistry;
 
 	};
 
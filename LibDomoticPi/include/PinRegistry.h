@@ -0,0 +1,175 @@
+#ifndef DOMOTIC_PI_PIN_REGISTRY
+#define DOMOTIC_PI_PIN_REGISTRY
+
+#include "domoticPiDefine.h"
+#include "IGpioBackend.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <rapidjson/document.h>
+#include <string>
+
+namespace domotic_pi {
+
+	// Pin features a module can require, combined as bit flags
+	enum PinCapability {
+		pin_cap_none = 0,
+		pin_cap_pwm = 1,		// hardware PWM channel
+		pin_cap_pull = 2,		// configurable pull up/down resistor
+		pin_cap_interrupt = 4,	// edge interrupts
+		pin_cap_all = 7
+	};
+
+	/**
+	 *	Ownership of the pins of every GPIO chip used by the library. Each chip keeps one atomic
+	 *	bitset of its pins in use: a pin is acquired by a single atomic bit set, so any number of
+	 *	modules can request their pins concurrently without serializing on a lock. Owner names are
+	 *	interned in a list kept as long as the registry, each pin pointing to its owner name.
+	 *
+	 *	Chips also carry pin metadata: number of lines, capabilities of each line and the state
+	 *	pins are reset to when released. Until declared otherwise, a chip has every pin number
+	 *	of the library, each capable of everything.
+	 */
+	class PinRegistry {
+	public:
+		PinRegistry();
+
+		PinRegistry(const PinRegistry&) = delete;
+		PinRegistry& operator= (const PinRegistry&) = delete;
+		~PinRegistry();
+
+		/**
+		 *	@brief Get the pin registry shared by the library
+		 *
+		 *	@return registry instance, kept alive while at least one reference exists
+		 */
+		static const std::shared_ptr<PinRegistry> load();
+
+		/**
+		 *	@brief Declare the lines of a GPIO chip
+		 *
+		 *	@note Meant to be called before the chip pins are requested, pins already in use are kept
+		 *
+		 *	@param chip chip index
+		 *	@param lineCount number of lines of the chip, pins from 0 to lineCount - 1 can be requested
+		 *	@param capabilities capabilities of every line of the chip
+		 *
+		 *	@throw out_of_range if chip or lineCount are outside library boundaries
+		 */
+		void declareChip(unsigned int chip, int lineCount, unsigned int capabilities = pin_cap_all);
+
+		/**
+		 *	@brief Get the number of lines of given chip, 0 if the chip index is not supported
+		 */
+		int getLineCount(unsigned int chip) const;
+
+		/**
+		 *	@brief Set the capabilities of one line (ie. the few lines wired to a PWM channel)
+		 *
+		 *	@throw out_of_range if the chip index is not supported or the pin is not one of its lines
+		 */
+		void setCapabilities(unsigned int chip, int pin, unsigned int capabilities);
+
+		unsigned int getCapabilities(unsigned int chip, int pin) const;
+
+		/**
+		 *	@brief Set the state the pins of a chip are reset to when released
+		 *
+		 *	@param chip chip index
+		 *	@param reset whether released pins are reset, if false they are left as their owner set them
+		 *	@param mode mode released pins are set to
+		 *	@param pull pull up/down state released pins are set to
+		 */
+		void setReleaseState(unsigned int chip, bool reset, GpioMode mode = DOMOTIC_PI_PIN_STANDARD_MODE,
+			GpioPull pull = DOMOTIC_PI_PIN_STANDARD_PUD);
+
+		/**
+		 *	@brief Get the state the pins of a chip are reset to when released
+		 *
+		 *	@return true if released pins are reset to given mode and pull
+		 */
+		bool getReleaseState(unsigned int chip, GpioMode& mode, GpioPull& pull) const;
+
+		/**
+		 *	@brief Lock given pin for exclusive use by a module
+		 *
+		 *	@param chip chip index
+		 *	@param pin pin number on the chip
+		 *	@param owner identifier of the requesting module, reported to later conflicting requests
+		 *	@param required capabilities the pin must have
+		 *
+		 *	@throw out_of_range if the chip index is not supported or the pin is not one of its lines
+		 *	@throw domotic_pi_exception if the pin is already in use, naming its owner,
+		 *		   or lacks one of the required capabilities
+		 */
+		void acquire(unsigned int chip, int pin, const std::string& owner, unsigned int required = pin_cap_none);
+
+		/**
+		 *	@brief Release a pin acquired by a module
+		 */
+		void release(unsigned int chip, int pin);
+
+		bool isInUse(unsigned int chip, int pin) const;
+
+		/**
+		 *	@brief Get the identifier of the module owning given pin
+		 *
+		 *	@return owner identifier, empty if the pin is free
+		 */
+		std::string getOwner(unsigned int chip, int pin) const;
+
+		/**
+		 *	@brief Get the number of pins in use over every chip
+		 */
+		size_t getUsedCount() const;
+
+		/**
+		 *	@brief Report the owner of each pin in use, grouped by chip, as json object
+		 */
+		rapidjson::Document to_json() const;
+
+	private:
+		struct Chip {
+			std::atomic<int> lineCount;
+			std::array<std::atomic<uint64_t>, gpioBankCount> used;
+			std::array<std::atomic<unsigned int>, DOMOTIC_PI_MAX_PIN + 1> capabilities;
+
+			// Interned owner names, published once the pin bit is set
+			std::array<std::atomic<const std::string*>, DOMOTIC_PI_MAX_PIN + 1> owners;
+
+			std::atomic<bool> reset;
+			std::atomic<int> releaseMode;
+			std::atomic<int> releasePull;
+		};
+
+		static std::shared_ptr<PinRegistry> _pinRegistry;
+
+		std::array<Chip, DOMOTIC_PI_MAX_CHIPS> _chips;
+
+		// Owner names ever used, pushed with a compare and swap and never removed
+		struct OwnerName {
+			const std::string name;
+			OwnerName* next;
+		};
+
+		std::atomic<OwnerName*> _ownerNames;
+
+		/**
+		 *	@brief Get the interned copy of an owner name, adding it if needed
+		 */
+		const std::string* _intern(const std::string& owner);
+
+		/**
+		 *	@brief Get given chip, checking the pin is one of its lines
+		 *
+		 *	@throw out_of_range if the chip index is not supported or the pin is not one of its lines
+		 */
+		Chip& _chip(unsigned int chip, int pin);
+		const Chip& _chip(unsigned int chip, int pin) const;
+	};
+
+}
+
+#endif // !DOMOTIC_PI_PIN_REGISTRY
@@ -1,20 +1,34 @@
 #ifndef DOMOTIC_PI_PROGRAMMED_EVENT
 #define DOMOTIC_PI_PROGRAMMED_EVENT
 
+#include "CronSchedule.h"
 #include "domoticPiDefine.h"
+#include "EventPriority.h"
+#include "IGpioBackend.h"
+#include "InputPattern.h"
+#include "LatencyHistogram.h"
+#include "OutputTimers.h"
 #include "Serializable.h"
+#include "TimerWheel.h"
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <list>
 #include <memory>
 #ifdef DOMOTIC_PI_THREAD_SAFE
+#include <mutex>
 #include <shared_mutex>
 #endif
 #include <tuple>
 #include <string>
+#include <vector>
 
 namespace domotic_pi {
-	class ProgrammedEvent : public Serializable {
+
+	class PatternMatcher;
+
+	class ProgrammedEvent : public Serializable, public std::enable_shared_from_this<ProgrammedEvent> {
 	public:
 
 		/**
@@ -53,8 +67,16 @@ namespace domotic_pi {
 		 * 
 		 *	@param outputModule output module to change value of
 		 *	@param newValue new value to set the output module to (use max_int to toggle output)
+		 *	@param delay time to wait after event trigger before the action is performed; 
+		 *		  triggering the event again while the action is pending restarts the delay
+		 *	@param timing switch the output on for a duration or drive it with pulses (see OutputTimers),
+		 *		  plain action by default
 		 */
-		void addOutputAction(Output_ptr outputModule, int newValue);
+		void addOutputAction(
+			Output_ptr outputModule, 
+			int newValue, 
+			std::chrono::milliseconds delay = std::chrono::milliseconds::zero(),
+			const TimedAction& timing = TimedAction());
 
 		/**
 		 *	@brief Remove an output module action from this programmed event
@@ -63,19 +85,170 @@ namespace domotic_pi {
 		 */
 		void removeOutputAction(const std::string& outputId);
 
+		/**
+		 *	@brief Get outputs changed by this programmed event actions
+		 */
+		std::vector<Output_ptr> getOutputs() const;
+
+		/**
+		 *	@brief Add a cron-style schedule which triggers this event
+		 *
+		 *	@param cronExpression schedule expression (see CronSchedule)
+		 *
+		 *	@throw domotic_pi_exception if the expression is not valid
+		 */
+		void addSchedule(const std::string& cronExpression);
+
+		/**
+		 *	@brief Remove a previously added schedule from this event
+		 *
+		 *	@param cronExpression schedule expression to remove (if not present, nothing happens)
+		 */
+		void removeSchedule(const std::string& cronExpression);
+
+		/**
+		 *	@brief Add a chord or sequence of input changes which triggers this event
+		 *
+		 *	@note The event must be owned by a shared pointer
+		 *
+		 *	@param type chord (any order) or sequence (given order)
+		 *	@param steps input changes to match (use max_int as value to match any change of the input)
+		 *	@param window time all the steps have to happen within, from the first one
+		 *
+		 *	@throw domotic_pi_exception if steps are empty or too many
+		 */
+		void addPattern(PatternType type, const std::vector<InputPattern::Step>& steps, std::chrono::milliseconds window);
+
+		/**
+		 *	@brief Add an already built chord or sequence which triggers this event
+		 *
+		 *	@param pattern pattern built for this event
+		 */
+		void addPattern(const InputPattern_ptr& pattern);
+
+		/**
+		 *	@brief Get chords and sequences triggering this event
+		 */
+		std::vector<InputPattern_ptr> getPatterns() const;
+
+		/**
+		 *	@brief Set the priority this event is dispatched with when triggered by inputs
+		 *
+		 *	@note Safety events bypass input debounce and rate limit as well as the circuit breaker
+		 *
+		 *	@param priority new event priority
+		 */
+		void setPriority(EventPriority priority);
+
+		EventPriority getPriority() const;
+
 		/**
 		 *	@brief Triggers all the actions currently present in this programmed event
+		 *
+		 *	@note Delayed actions are armed on the shared timer wheel, while
+		 *		  the others are performed before returning, with their pins switched in one batch
+		 *
+		 *	@note When triggers exceed the configured circuit breaker rate the event is suspended for
+		 *		  the cooldown period and triggers are discarded meanwhile (except for safety events)
+		 *
+		 *	@param timestamp source timestamp of the change triggering the event, 
+		 *		  trigger time is used if not set
+		 */
+		void triggerEvent(Timestamp timestamp = Timestamp()) const;
+
+		/**
+		 *	@brief Get latency from trigger source to all immediate actions performed
+		 */
+		const LatencyHistogram& getLatency() const;
+
+		/**
+		 *	@brief Configure the circuit breaker protecting from trigger storms (ie. feedback loops)
+		 *
+		 *	@param maxRate maximum sustained triggers per second, zero disables the breaker
+		 *	@param cooldown time the event stays suspended once the breaker trips
+		 */
+		void setCircuitBreaker(double maxRate, std::chrono::milliseconds cooldown);
+
+		double getCircuitBreakerRate() const;
+
+		std::chrono::milliseconds getCircuitBreakerCooldown() const;
+
+		/**
+		 *	@brief Check whether the event is currently suspended by its circuit breaker
+		 */
+		bool isSuspended() const;
+
+		/**
+		 *	@brief Resume a suspended event before its cooldown expires
 		 */
-		void triggerEvent() const;
+		void resume();
+
+		/**
+		 *	@brief Get number of triggers discarded while the event was suspended
+		 */
+		uint64_t getDiscardedCount() const;
+
+		/**
+		 *	@brief Get number of times the circuit breaker tripped
+		 */
+		uint64_t getTripCount() const;
 
 		rapidjson::Document to_json() const override;
 
 	private:
+		struct OutputAction {
+			std::weak_ptr<IOutput> output;
+			int value;
+			std::chrono::milliseconds delay;
+			Timer_ptr delayTimer;
+			TimedAction timing;
+		};
+
+		struct Schedule {
+			CronSchedule cron;
+			Timer_ptr timer;
+			std::chrono::system_clock::time_point nextTrigger;
+		};
+
 		const std::string _id;
+		const std::shared_ptr<TimerWheel> _timerWheel;
+		const std::shared_ptr<OutputTimers> _outputTimers;
+		const std::shared_ptr<IGpioBackend> _gpio;
+		const std::shared_ptr<PatternMatcher> _patternMatcher;
 #ifdef DOMOTIC_PI_THREAD_SAFE
-		mutable std::shared_mutex _outputValuePairsLock;
+		mutable std::shared_mutex _outputActionsLock;
+		mutable std::mutex _schedulesLock;
+		mutable std::mutex _patternsLock;
 #endif
-		std::list<std::pair<std::weak_ptr<IOutput>, int>> _outputValuePairs;
+		std::list<OutputAction> _outputActions;
+		std::list<Schedule> _schedules;
+		std::list<InputPattern_ptr> _patterns;
+		mutable LatencyHistogram _latency;
+		std::atomic<EventPriority> _priority;
+
+#ifdef DOMOTIC_PI_THREAD_SAFE
+		mutable std::mutex _breakerLock;
+#endif
+		double _breakerRate;
+		std::chrono::milliseconds _breakerCooldown;
+		Timer_ptr _resumeTimer;
+		mutable double _breakerTokens;
+		mutable Timestamp _breakerRefill;
+		mutable std::atomic<bool> _suspended;
+		mutable std::atomic<uint64_t> _discardedCount;
+		mutable std::atomic<uint64_t> _tripCount;
+
+		/**
+		 *	@brief Account a new trigger in the circuit breaker
+		 *
+		 *	@return false if the trigger has to be discarded
+		 */
+		bool _breaker_allows(Timestamp now) const;
+
+		static void _perform_action(const std::weak_ptr<IOutput>& output, int value, const TimedAction& timing,
+			const std::shared_ptr<OutputTimers>& outputTimers, Timestamp timestamp);
+
+		void _arm_schedule(Schedule& schedule);
 
 	};
 
@@ -0,0 +1,201 @@
+#ifndef DOMOTIC_PI_PULSE_COUNTER
+#define DOMOTIC_PI_PULSE_COUNTER
+
+#include "domoticPiDefine.h"
+#include "IInput.h"
+#include "InputFactory.h"
+#include "Pin.h"
+#include "TimerWheel.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace domotic_pi {
+
+	/**
+	 *	Pulse counting input for utility meters (S0 energy meters, water and gas meters).
+	 *	Pulses are counted by the edge interrupt with a single atomic increment, the pulse rate
+	 *	is derived over a sliding window from periodic samples of the counter.
+	 *
+	 *	The input value is the pulse rate in pulses per hour (ie. watts for a 1000 pulses/kWh meter).
+	 *	Programmed events are never fired per pulse: the value is notified only when the rate
+	 *	crosses one of the configured thresholds and, if set, at each report interval.
+	 */
+	class PulseCounter :
+		public Pin,
+		public IInput,
+		protected InputFactory {
+
+	public:
+
+		/**
+		 *	@brief Initialize a new pulse counter
+		 *
+		 *	@note required pin number must not be already in use by another object
+		 *
+		 *	@param id unique identifier for this input
+		 *	@param pinNumber pin number the meter pulse output is wired to
+		 *	@param pud pull up/down state required by the meter output
+		 *	@param edge pin edges counted as pulses
+		 *	@param chip index of the GPIO chip the pin belongs to
+		 *
+		 *	@throw domotic_pi_exception if the pinNumber is already in use or edges can not be enabled
+		 *	@throw out_of_range if pinNumber is outside library boundaries
+		 */
+		PulseCounter(
+			const std::string& id,
+			int pinNumber,
+			int pud,
+			GpioEdge edge = edge_rising,
+			unsigned int chip = 0);
+
+		PulseCounter(const PulseCounter&) = delete;
+		PulseCounter& operator= (const PulseCounter&) = delete;
+		virtual ~PulseCounter();
+
+		/**
+		 *	@brief Get the pulse rate over the sliding window, in pulses per hour
+		 */
+		int getValue() const override;
+
+		/**
+		 *	@brief Get the pulse rate over the sliding window, in pulses per second
+		 */
+		double getRate() const;
+
+		/**
+		 *	@brief Get the total number of pulses counted, persisted total included
+		 */
+		uint64_t getTotal() const;
+
+		/**
+		 *	@brief Reset the pulse total (ie. to the meter reading)
+		 */
+		void setTotal(uint64_t total);
+
+		/**
+		 *	@brief Set the sliding window the rate is computed over
+		 *
+		 *	@note The window can not be shorter than the counter sampling period
+		 */
+		void setWindow(std::chrono::milliseconds window);
+
+		std::chrono::milliseconds getWindow() const;
+
+		/**
+		 *	@brief Set the rates (in pulses per hour) notified when crossed in either direction
+		 */
+		void setThresholds(const std::vector<int>& thresholds);
+
+		std::vector<int> getThresholds() const;
+
+		/**
+		 *	@brief Set the interval the current rate is notified at, whether it crossed a threshold or not
+		 *
+		 *	@param interval report interval, zero disables periodic reports
+		 */
+		void setReportInterval(std::chrono::milliseconds interval);
+
+		std::chrono::milliseconds getReportInterval() const;
+
+		/**
+		 *	@brief Set the file the pulse total is persisted to, loading the total it holds if any
+		 *
+		 *	@note The total is saved periodically when it changed, by a thread of the counter started
+		 *		  with persistence, and when the counter is destroyed. Each save is synced to the disk
+		 *
+		 *	@param stateFile file path, empty to disable persistence
+		 */
+		void setStateFile(const std::string& stateFile);
+
+		std::string getStateFile() const;
+
+		/**
+		 *	@note Adds the pulse total and the current rate
+		 */
+		rapidjson::Document stats_to_json() const override;
+
+		/**
+		 *	@brief Serialize current object to json document
+		 *
+		 *	@return json document representation for current object
+		 */
+		rapidjson::Document to_json() const override;
+
+	private:
+		const int _pud;
+		const GpioEdge _edge;
+
+		//	Pulse counter, the only state touched by the edge interrupt
+		std::atomic<uint64_t> _pulses;
+
+		const std::shared_ptr<TimerWheel> _timerWheel;
+		Timer_ptr _sampleTimer;
+
+		mutable std::mutex _counterLock;
+
+		//	Counter samples covering the sliding window, oldest first
+		std::deque<std::pair<Timestamp, uint64_t>> _samples;
+		std::chrono::milliseconds _window;
+		std::atomic<double> _rate;
+
+		std::vector<int> _thresholds;
+		int _notifiedValue;
+		std::chrono::milliseconds _reportInterval;
+		Timestamp _lastReport;
+
+		std::string _stateFile;
+		uint64_t _savedTotal;
+		Timestamp _lastSave;
+
+		//	Saves requested by the sample timer, written by the save thread
+		std::condition_variable _saveChange;
+		std::thread _saveThread;
+		bool _saveRunning;
+		bool _saveRequested;
+		uint64_t _saveTotal;
+
+		/**
+		 *	@brief Object related function binded to the pin edges, counts one pulse
+		 */
+		void input_ISR(int value, Timestamp timestamp);
+
+		/**
+		 *	@brief Sample timer callback, updates the rate and notifies it if needed
+		 */
+		void _sample();
+
+		/**
+		 *	@brief Number of thresholds below or equal to given rate
+		 */
+		size_t _band(int value) const;
+
+		/**
+		 *	@brief Save thread loop, writes the requested totals until the counter is destroyed
+		 */
+		void _save_loop();
+
+		/**
+		 *	@brief Write given total to a state file, syncing it and its directory to the disk
+		 *
+		 *	@return false if the total could not be saved
+		 */
+		bool _save_total(const std::string& stateFile, uint64_t total) const;
+
+		static const bool _factoryRegistration;
+		static std::shared_ptr<PulseCounter> from_json(const rapidjson::Value& config, DomoticNode_ptr parentNode);
+
+	};
+
+}
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef DOMOTIC_PI_PWM_OUTPUT
+#define DOMOTIC_PI_PWM_OUTPUT
+
+#include "IOutput.h"
+#include "OutputFactory.h"
+#include "Pin.h"
+#include "PwmScheduler.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace domotic_pi {
+
+	/**
+	 *	Dimmable output driven by software PWM on an onboard pin, values are duty cycles in percent.
+	 *	All PWM outputs share the edges schedule and thread of the PwmScheduler.
+	 */
+	class PwmOutput : public Pin, public IOutput, protected OutputFactory {
+
+	public:
+		/**
+		 *	@brief Initialize a new PWM output using an onboard pin
+		 *
+		 *	@param id unique identifier for this output
+		 *	@param pinNumber pin number to be used by this output
+		 *	@param frequency PWM frequency in Hz
+		 *	@param chip index of the GPIO chip the pin belongs to
+		 *
+		 *	@throw out_of_range if pinNumber is outside library boundaries or frequency is not positive
+		 */
+		PwmOutput(const std::string& id, int pinNumber, double frequency = DOMOTIC_PI_PWM_FREQUENCY, unsigned int chip = 0);
+
+		PwmOutput(const PwmOutput&) = delete;
+		PwmOutput& operator= (const PwmOutput&) = delete;
+		virtual ~PwmOutput();
+
+		/**
+		 *	@brief Get current duty cycle in percent
+		 */
+		int getValue() const override;
+
+		/**
+		 *	@note Switching on restores the last non-zero duty cycle
+		 */
+		void setState(OutState newState, Timestamp timestamp = Timestamp()) override;
+
+		/**
+		 *	@brief Set the duty cycle in percent, applied from next PWM period
+		 *
+		 *	@note Never blocks: the new duty cycle is handed to the scheduler atomically
+		 */
+		void setValue(int newValue, Timestamp timestamp = Timestamp()) override;
+
+		double getFrequency() const;
+
+		/**
+		 *	@note Adds the PWM scheduler edge count and jitter
+		 */
+		rapidjson::Document stats_to_json() const override;
+
+		rapidjson::Document to_json() const override;
+
+	private:
+		const double _frequency;
+		const std::shared_ptr<PwmScheduler> _pwmScheduler;
+		PwmChannel_ptr _channel;
+
+		std::atomic<int> _duty;
+		std::atomic<int> _onDuty;
+
+		static const bool _factoryRegistration;
+		static std::shared_ptr<PwmOutput> from_json(const rapidjson::Value& config, DomoticNode_ptr parentNode);
+
+	};
+
+}
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef DOMOTIC_PI_PWM_SCHEDULER
+#define DOMOTIC_PI_PWM_SCHEDULER
+
+#include "domoticPiDefine.h"
+#include "IGpioBackend.h"
+#include "LatencyHistogram.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <rapidjson/document.h>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace domotic_pi {
+
+	/**
+	 *	Software PWM engine shared by every PWM pin. Channel edges are kept in one schedule
+	 *	sorted by time, a single thread sleeps until the earliest edge and switches all the pins
+	 *	due at that time in one backend write. Duty cycles are latched at each period start,
+	 *	so they can be changed at any time without locking and without glitches.
+	 *
+	 *	The lateness of each edge against its planned time is recorded as jitter.
+	 *
+	 *	When the library Clock is virtual, no thread is started: edges are produced only when
+	 *	the clock owner calls advance after moving the clock forward.
+	 */
+	class PwmScheduler {
+	public:
+
+		class Channel {
+		public:
+			Channel(int pin, std::chrono::nanoseconds period);
+
+			Channel(const Channel&) = delete;
+			Channel& operator= (const Channel&) = delete;
+
+			int getPin() const;
+
+			std::chrono::nanoseconds getPeriod() const;
+
+			/**
+			 *	@brief Set the duty cycle applied from next period, without blocking
+			 *
+			 *	@param duty fraction of the period the pin is high, clamped to [0, 1]
+			 */
+			void setDuty(double duty);
+
+			double getDuty() const;
+
+		private:
+			static constexpr uint32_t _dutyScale = 1 << 16;
+
+			const int _pin;
+			const std::chrono::nanoseconds _period;
+			std::atomic<uint32_t> _duty;
+
+			// Owned by the scheduler
+			bool _removed;
+			int _level;
+			Timestamp _periodStart;
+
+			friend class PwmScheduler;
+		};
+
+		typedef std::shared_ptr<Channel> Channel_ptr;
+
+		/**
+		 *	@param gpio backend the PWM pins are written to
+		 */
+		PwmScheduler(GpioBackend_ptr gpio);
+
+		PwmScheduler(const PwmScheduler&) = delete;
+		PwmScheduler& operator= (const PwmScheduler&) = delete;
+		~PwmScheduler();
+
+		/**
+		 *	@brief Get the PWM scheduler shared by the library for a GPIO chip, writing to the chip backend
+		 *
+		 *	@return scheduler instance, kept alive while at least one reference exists
+		 *
+		 *	@throw out_of_range if no backend has been set for the chip (see IGpioBackend::load)
+		 */
+		static const std::shared_ptr<PwmScheduler> load(unsigned int chip = 0);
+
+		/**
+		 *	@brief Start generating PWM on given output pin, with a zero duty cycle
+		 *
+		 *	@note The scheduler thread is started with the first channel
+		 *
+		 *	@param pin output pin number
+		 *	@param period PWM period
+		 *
+		 *	@return channel handle, used to change its duty cycle
+		 */
+		Channel_ptr addChannel(int pin, std::chrono::nanoseconds period);
+
+		/**
+		 *	@brief Stop generating PWM on given channel, leaving its pin low
+		 */
+		void removeChannel(const Channel_ptr& channel);
+
+		/**
+		 *	@brief Get the time the next edge is due at
+		 *
+		 *	@return next edge time point, Timestamp::max() if no channel is active
+		 */
+		Timestamp getNextEdge() const;
+
+		/**
+		 *	@brief Produce on the calling thread all the edges due at current Clock time
+		 *
+		 *	@note Meant to drive the scheduler on a virtual Clock, where no thread is running
+		 */
+		void advance();
+
+		/**
+		 *	@brief Get the lateness of edges against their planned time
+		 */
+		const LatencyHistogram& getJitter() const;
+
+		/**
+		 *	@brief Get the number of edges produced so far
+		 */
+		uint64_t getEdgeCount() const;
+
+		/**
+		 *	@brief Report edge count and jitter as json object
+		 */
+		rapidjson::Document stats_to_json() const;
+
+	private:
+		// Planned edge: due time and channel
+		typedef std::tuple<Timestamp, Channel_ptr> Edge;
+
+		struct EdgeLater {
+			bool operator() (const Edge& a, const Edge& b) const {
+				return std::get<0>(a) > std::get<0>(b);
+			}
+		};
+
+		static std::array<std::shared_ptr<PwmScheduler>, DOMOTIC_PI_MAX_CHIPS> _pwmSchedulers;
+
+		const GpioBackend_ptr _gpio;
+
+		mutable std::mutex _pwmLock;
+		std::condition_variable _scheduleChange;
+		std::priority_queue<Edge, std::vector<Edge>, EdgeLater> _schedule;
+		bool _running;
+		std::thread _pwmThread;
+
+		LatencyHistogram _jitter;
+		std::atomic<uint64_t> _edgeCount;
+
+		/**
+		 *	@brief Switch all the pins due at given time and plan their next edge, called with lock held
+		 */
+		void _serve(Timestamp now);
+
+		/**
+		 *	@brief Scheduler thread body
+		 */
+		void _pwm_loop();
+	};
+
+	typedef PwmScheduler::Channel_ptr PwmChannel_ptr;
+
+}
+
+#endif // !DOMOTIC_PI_PWM_SCHEDULER
@@ -0,0 +1,124 @@
+#ifndef DOMOTIC_PI_SERIAL_INPUT
+#define DOMOTIC_PI_SERIAL_INPUT
+
+#include "CallbackToken.h"
+#include "domoticPiDefine.h"
+#include "IInput.h"
+#include "InputFactory.h"
+#include "SerialInterface.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <rapidjson/document.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace domotic_pi {
+
+	// Layout of the frames read by a serial input
+	enum SerialInputFormat {
+		serial_text = 0,	// key, ':', '=' or ' ' separator, decimal value (ie. "b1:1")
+		serial_binary = 1	// key byte followed by a 1 to 4 bytes big endian signed value
+	};
+
+	/**
+	 *	Input reading its value from the frames received on a serial interface, ie. buttons and
+	 *	sensors attached to a microcontroller. Several inputs can share one serial interface, each
+	 *	one handling the frames starting with its key.
+	 *
+	 *	Frames are handled as soon as the serial reader thread receives them, without polling.
+	 */
+	class SerialInput :
+		public IInput,
+		protected InputFactory {
+
+	public:
+		/**
+		 *	@brief Initialize a new serial input
+		 *
+		 *	@param id unique identifier for this input
+		 *	@param serialComm serial interface the frames are received from
+		 *	@param key key identifying the frames of this input, a single byte for the binary format
+		 *	@param format layout of the frames
+		 *
+		 *	@throw domotic_pi_exception if serialComm is null or key is not valid for the format
+		 */
+		SerialInput(
+			const std::string& id,
+			std::shared_ptr<SerialInterface> serialComm,
+			const std::string& key,
+			SerialInputFormat format = serial_text);
+
+		SerialInput(const SerialInput&) = delete;
+		SerialInput& operator= (const SerialInput&) = delete;
+		virtual ~SerialInput();
+
+		int getValue() const override;
+
+		const std::string& getKey() const;
+
+		SerialInputFormat getFormat() const;
+
+		/**
+		 *	@brief Choose whether every frame is notified, or only value changes
+		 *
+		 *	@note Needed by devices sending the same value for each action (ie. a push button sending a click)
+		 */
+		void setRepeat(bool repeat);
+
+		bool getRepeat() const;
+
+		/**
+		 *	@brief Get the number of frames with this input key and a valid value
+		 */
+		uint64_t getFrameCount() const;
+
+		/**
+		 *	@brief Get the number of frames with this input key and an invalid value
+		 */
+		uint64_t getMalformedCount() const;
+
+		std::vector<CommTopic> getListenedTopics() const override;
+
+		/**
+		 *	@note Adds the frame and malformed frame counts
+		 */
+		rapidjson::Document stats_to_json() const override;
+
+		rapidjson::Document to_json() const override;
+
+	private:
+		const std::shared_ptr<SerialInterface> _serial;
+		const std::string _key;
+		const SerialInputFormat _format;
+
+		std::atomic<int> _value;
+		std::atomic<bool> _repeat;
+
+		std::atomic<uint64_t> _frames;
+		std::atomic<uint64_t> _malformed;
+
+		CallbackToken_ptr _frameToken;
+
+		/**
+		 *	@brief Frame callback, runs on the serial reader thread
+		 */
+		void _frame_received(std::string_view frame, Timestamp timestamp);
+
+		/**
+		 *	@brief Extract the value of a frame
+		 *
+		 *	@return false if the frame is not for this input, or malformed (counted)
+		 */
+		bool _parse(std::string_view frame, int& value);
+
+		static const bool _factoryRegistration;
+		static std::shared_ptr<SerialInput> from_json(const rapidjson::Value& config, DomoticNode_ptr parentNode);
+
+	};
+
+}
+
+#endif // !DOMOTIC_PI_SERIAL_INPUT
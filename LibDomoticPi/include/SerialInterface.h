@@ -1,26 +1,52 @@
 #ifndef DOMOTIC_PI_SERIAL_INTERFACE
 #define DOMOTIC_PI_SERIAL_INTERFACE
 
+#include "ByteRing.h"
+#include "CallbackToken.h"
 #include "CommFactory.h"
 #include "domoticPiDefine.h"
 #include "IComm.h"
+#include "LatencyHistogram.h"
 #include "Pin.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
 #include <memory>
-#ifdef DOMOTIC_PI_THREAD_SAFE
 #include <mutex>
-#endif // DOMOTIC_PI_THREAD_SAFE
 #include <rapidjson/document.h>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 namespace domotic_pi {
 
+	class SerialLink;
+
+	// How received bytes are split into frames
+	enum SerialFraming {
+		framing_delimiter = 0,	// frames end with a delimiter byte, not part of the frame
+		framing_length = 1		// frames start with their big endian length on 1 or 2 bytes
+	};
+
+	/**
+	 *	Function called with each received frame and the time it has been read at.
+	 *	The frame points into the receive buffer and is only valid during the call.
+	 */
+	typedef std::function<void(std::string_view frame, Timestamp timestamp)> SerialFrameCallback;
+
 	class SerialInterface : public IComm, protected CommFactory {
 	public:
 
-		/**	
+		/**
 		 *	@brief Lock needed pins and initializes serial communication interface.
 		 *
+		 *	@note Frames are delimited by new lines until the framing is changed
+		 *
 		 *	@param id Unique identifier for this comm module
 		 *	@param port Serial device port (ie. /dev/serial0)
 		 *	@param speed Serial port baud rate
@@ -50,34 +76,222 @@ namespace domotic_pi {
 		*/
 		int getBaudRate() const;
 
-		/**	
-		 *	@brief Read all available data from serial interface if available.
-		 *	
-		 *	@note In case of read error or empty buffer an empty string is returned.
+		/**
+		 *	@brief Split received bytes into frames ended by given delimiter
+		 *
+		 *	@note Bytes already received and not handled yet are dropped
+		 */
+		void setDelimiter(char delimiter);
+
+		/**
+		 *	@brief Split received bytes into frames prefixed by their length
+		 *
+		 *	@note Bytes already received and not handled yet are dropped
+		 *
+		 *	@param bytes size of the big endian length prefix, 1 or 2
+		 *
+		 *	@throws out_of_range if bytes is neither 1 nor 2
+		 */
+		void setLengthPrefix(unsigned int bytes);
+
+		SerialFraming getFraming() const;
+
+		char getDelimiter() const;
+
+		unsigned int getLengthPrefix() const;
+
+		/**
+		 *	@brief Get notified of each received frame
+		 *
+		 *	@note The receiving thread is started with the first callback (or read). Callbacks are
+		 *		  called from that thread and must not call read. While at least one callback is set,
+		 *		  frames are consumed by callbacks only.
 		 *
-		 *	@return Message read from serial interface.
+		 *	@param callback function called with each complete frame
+		 *
+		 *	@return token removing the callback when destroyed, after any running call of the callback returned
+		 */
+		CallbackToken_ptr addFrameCallback(SerialFrameCallback callback);
+
+		/**
+		 *	@brief Get the oldest complete frame received, without blocking.
+		 *
+		 *	@note Frames are buffered from the first call on. In case of read error or no
+		 *		  complete frame an empty string is returned.
+		 *
+		 *	@return Frame read from serial interface.
 		 */
 		std::string read();
 
 		/**
-		 *	@brief Writes given string to serial interface
+		 *	@brief Queue given string to be written to serial interface, without waiting for the transmission
+		 *
+		 *	@note Queued commands are written in order, batched in a single write by the writer thread.
+		 *		  With a virtual Clock, there is no writer thread and the message is written at once.
 		 *
 		 *	@param message Message to write to serial interface.
+		 *	@param key if not empty, a command queued with the same key and not written yet is replaced
+		 *		   by this one (ie. the id of the output the command is for)
+		 */
+		void write(const std::string& message, const std::string& key = std::string());
+
+		/**
+		 *	@brief Queue given bytes to be written to serial interface, zero bytes included
+		 *
+		 *	@param data bytes to write
+		 *	@param length number of bytes to write
+		 */
+		void write(const uint8_t* data, size_t length);
+
+		/**
+		 *	@brief Wait until every queued command has been written
 		 */
-		void write(const std::string& message);
+		void flush();
+
+		/**
+		 *	@brief Get the number of commands waiting to be written
+		 */
+		size_t getTxQueueDepth() const;
+
+		/**
+		 *	@brief Get the time taken by commands from being queued to being written
+		 */
+		const LatencyHistogram& getTxDrainLatency() const;
+
+		/**
+		 *	@brief Get the binary command protocol of this interface, started on first call
+		 *
+		 *	@note Starting the protocol switches received frames to a 1 byte length prefix
+		 *
+		 *	@return link shared by the outputs of this interface
+		 */
+		std::shared_ptr<SerialLink> getLink();
+
+		uint64_t getReceivedBytes() const;
+
+		uint64_t getReceivedFrames() const;
+
+		/**
+		 *	@brief Get the number of received bytes dropped: buffer full or frame longer than the buffer
+		 */
+		uint64_t getDroppedBytes() const;
+
+		/**
+		 *	@brief Report received bytes, frames and dropped bytes, written bytes, commands, coalesced commands,
+		 *		   write calls, queue depth and drain latency as json object, with binary link statistics if started
+		 */
+		rapidjson::Document stats_to_json() const;
 
 		rapidjson::Document to_json() const override;
 
 	private:
+		typedef std::map<uint64_t, SerialFrameCallback> FrameCallbacks;
+
+		struct TxCommand {
+			std::string key;
+			std::string data;
+			bool binary;
+			Timestamp queued;
+		};
+
 		const std::string _port;
 		const int _baudRate;
 		Pin _pinTX;
 		Pin _pinRX;
 		int _serial;
-#ifdef DOMOTIC_PI_THREAD_SAFE
-		std::mutex _txOwn;
-		std::mutex _rxOwn;
-#endif
+
+		// Transmit side, shared by the writer thread and write
+		mutable std::mutex _txLock;
+		std::condition_variable _txChange;
+		std::deque<TxCommand> _txQueue;
+		std::vector<char> _txBatch;
+		bool _txWriting;
+		bool _writerRunning;
+		std::thread _writerThread;
+		LatencyHistogram _txDrain;
+
+		std::atomic<uint64_t> _txBytes;
+		std::atomic<uint64_t> _txCommands;
+		std::atomic<uint64_t> _txCoalesced;
+		std::atomic<uint64_t> _txWrites;
+
+		// Receive side, shared by the reader thread and read
+		mutable std::mutex _rxLock;
+		ByteRing _rxRing;
+		std::vector<char> _rxScratch;
+		size_t _rxScanned;
+		bool _rxDiscarding;
+		size_t _rxSkip;
+		SerialFraming _framing;
+		char _delimiter;
+		unsigned int _lengthPrefix;
+
+		std::mutex _callbacksLock;
+		std::shared_ptr<const FrameCallbacks> _frameCallbacks;
+		uint64_t _nextCallbackId;
+
+		mutable std::mutex _linkOwn;
+		std::shared_ptr<SerialLink> _link;
+
+		std::thread _readerThread;
+		std::atomic<std::thread::id> _readerId;
+		int _epollFd;
+		int _wakeupFd;
+		std::atomic<bool> _readerRunning;
+
+		std::atomic<uint64_t> _rxBytes;
+		std::atomic<uint64_t> _rxFrames;
+		std::atomic<uint64_t> _rxDropped;
+
+		/**
+		 *	@brief Queue a command, or write it at once without writer thread
+		 */
+		void _enqueue(TxCommand command);
+
+		/**
+		 *	@brief Writer thread body, writes all the queued commands at once
+		 */
+		void _writer_loop();
+
+		/**
+		 *	@brief Write given bytes, retrying partial writes
+		 *
+		 *	@return false if the write failed
+		 */
+		bool _write_all(const char* data, size_t length);
+
+		/**
+		 *	@brief Start the reader thread if not running, called with rx lock held
+		 */
+		void _start_reader();
+
+		/**
+		 *	@brief Reader thread body, reads available bytes into the ring and delivers frames
+		 */
+		void _reader_loop();
+
+		/**
+		 *	@brief Read available bytes into the ring, making room if it is full, called with rx lock held
+		 *
+		 *	@return false when the port can not be read anymore
+		 */
+		bool _receive();
+
+		/**
+		 *	@brief Locate the oldest complete frame held, called with rx lock held
+		 *
+		 *	@param offset frame offset in the ring
+		 *	@param length frame length
+		 *	@param total bytes to consume once the frame is handled, framing included
+		 *
+		 *	@return true if a complete frame is held
+		 */
+		bool _next_frame(size_t& offset, size_t& length, size_t& total);
+
+		/**
+		 *	@brief Drop bytes to make room in a full ring, called with rx lock held
+		 */
+		void _make_room();
 
 		static const bool _factoryRegistration;
 		static std::shared_ptr<SerialInterface> from_json(const rapidjson::Value& config, DomoticNode_ptr parentNode);
@@ -86,4 +300,4 @@ namespace domotic_pi {
 
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,174 @@
+#ifndef DOMOTIC_PI_SERIAL_LINK
+#define DOMOTIC_PI_SERIAL_LINK
+
+#include "CallbackToken.h"
+#include "domoticPiDefine.h"
+#include "TimerWheel.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <rapidjson/document.h>
+#include <string_view>
+#include <vector>
+
+namespace domotic_pi {
+
+	class SerialInterface;
+
+	// Type byte of the binary serial link frames
+	enum SerialLinkFrame {
+		link_set = 0x01,	// host to device: seq, module index, big endian value
+		link_ack = 0x02,	// device to host: seq and module index of the applied command
+		link_nack = 0x03	// device to host: seq and module index of a command to send again
+	};
+
+	/**
+	 *	Binary command protocol shared by the serial outputs of one serial interface.
+	 *
+	 *	Each frame is prefixed by its length on one byte and ends with the CRC16 (CCITT, big endian)
+	 *	of every preceding byte, length included:
+	 *		set:		len = 9 | 0x01 | seq | index | value (4 bytes, big endian) | crc16
+	 *		ack, nack:	len = 5 | 0x02 or 0x03 | seq | index | crc16
+	 *
+	 *	Up to window commands are sent without waiting for their ack, the next ones are queued.
+	 *	A command not acked within the ack timeout, or nacked, is sent again with the same sequence
+	 *	number after a delay doubling with each attempt, and given up after the configured retries.
+	 *	Commands set an absolute value, so a device receiving a command twice applies it twice harmlessly.
+	 *
+	 *	A newer command for a module supersedes its queued or unacked one: the older value
+	 *	is never sent (again), so a slow device does not replay outdated values. The sequence number
+	 *	of a superseded command stays reserved until its ack comes back or it times out, acks being
+	 *	matched on sequence number and module index.
+	 *
+	 *	@note Binary serial inputs sharing the interface must not use the ack and nack type bytes as key
+	 */
+	class SerialLink {
+	public:
+
+		/**
+		 *	@brief Start the protocol on given serial interface
+		 *
+		 *	@note Frames received on the interface are switched to a 1 byte length prefix
+		 *
+		 *	@param serial interface the frames are exchanged on, must outlive the link
+		 */
+		SerialLink(SerialInterface& serial);
+
+		SerialLink(const SerialLink&) = delete;
+		SerialLink& operator= (const SerialLink&) = delete;
+		~SerialLink();
+
+		/**
+		 *	@brief Compute the CRC16 (CCITT, 0x1021 polynomial, 0xffff initial value) of given bytes
+		 */
+		static uint16_t crc16(const uint8_t* data, size_t length, uint16_t crc = 0xffff);
+
+		/**
+		 *	@brief Send a set command to given module, without waiting for its ack
+		 *
+		 *	@param index module index on the device
+		 *	@param value value to set
+		 */
+		void send(uint8_t index, int32_t value);
+
+		/**
+		 *	@brief Set the number of commands sent without waiting for their ack
+		 *
+		 *	@throws out_of_range if window is not between 1 and 64
+		 */
+		void setWindow(unsigned int window);
+
+		unsigned int getWindow() const;
+
+		void setAckTimeout(std::chrono::milliseconds timeout);
+
+		std::chrono::milliseconds getAckTimeout() const;
+
+		/**
+		 *	@brief Set the number of times a command is sent again before being given up
+		 */
+		void setRetries(unsigned int retries);
+
+		unsigned int getRetries() const;
+
+		/**
+		 *	@brief Get the number of commands sent and not acked yet, queued ones included and superseded ones excluded
+		 */
+		size_t getPendingCount() const;
+
+		/**
+		 *	@brief Report sent frames, retransmissions, acks, failures, superseded commands and
+		 *		   received frames with a wrong CRC as json object
+		 */
+		rapidjson::Document stats_to_json() const;
+
+	private:
+		struct Command {
+			uint8_t seq;
+			uint8_t index;
+			int32_t value;
+			unsigned int attempts;
+			Timestamp deadline;
+			bool superseded;
+		};
+
+		SerialInterface& _serial;
+		const std::shared_ptr<TimerWheel> _timerWheel;
+
+		mutable std::mutex _linkLock;
+		std::vector<Command> _inFlight;
+		std::deque<Command> _queued;
+		uint8_t _nextSeq;
+		unsigned int _window;
+		std::chrono::milliseconds _ackTimeout;
+		unsigned int _retries;
+
+		TimerWheel::Timer_ptr _retransmitTimer;
+		CallbackToken_ptr _frameToken;
+
+		std::atomic<uint64_t> _txFrames;
+		std::atomic<uint64_t> _retransmits;
+		std::atomic<uint64_t> _acked;
+		std::atomic<uint64_t> _failed;
+		std::atomic<uint64_t> _superseded;
+		std::atomic<uint64_t> _crcErrors;
+
+		/**
+		 *	@brief Frame callback, runs on the serial reader thread
+		 */
+		void _frame_received(std::string_view frame);
+
+		/**
+		 *	@brief Retransmit timer callback, runs on the timer wheel thread
+		 */
+		void _retransmit();
+
+		/**
+		 *	@brief Write the set frame of given command, called with link lock held
+		 */
+		void _transmit(Command& command);
+
+		/**
+		 *	@brief Get the time to wait for the ack of a command sent given number of times
+		 */
+		std::chrono::milliseconds _backoff(unsigned int attempts) const;
+
+		/**
+		 *	@brief Send queued commands while the window allows it, called with link lock held
+		 */
+		void _fill_window();
+
+		/**
+		 *	@brief Arm the retransmit timer on the closest deadline, called with link lock held
+		 */
+		void _arm_timer();
+
+	};
+
+}
+
+#endif // !DOMOTIC_PI_SERIAL_LINK
@@ -5,7 +5,9 @@
 #include "IOutput.h"
 #include "OutputFactory.h"
 #include "SerialInterface.h"
+#include "SerialLink.h"
 
+#include <memory>
 #include <string>
 
 namespace domotic_pi {
@@ -13,19 +15,38 @@ namespace domotic_pi {
 	class SerialOutput : public IOutput, protected OutputFactory {
 
 	public:
+		/**
+		 *	@brief Initialize a new serial output
+		 *
+		 *	@param id unique identifier for this output, prefix of its text commands
+		 *	@param serialComm serial interface the commands are sent on
+		 *	@param min_range lowest value of the output
+		 *	@param max_range highest value of the output
+		 *	@param linkIndex module index on the device to send binary commands through the
+		 *		   interface link, or -1 to send text commands
+		 *
+		 *	@throw domotic_pi_exception if serialComm is null
+		 *	@throw out_of_range if linkIndex is above 255
+		 */
 		SerialOutput(
 			const std::string& id, 
 			std::shared_ptr<SerialInterface> serialComm, 
 			int min_range, 
-			int max_range);
+			int max_range,
+			int linkIndex = -1);
 
 		SerialOutput(const SerialOutput&) = delete;
 		SerialOutput& operator= (const SerialOutput&) = delete;
 		virtual ~SerialOutput();
 
-		void setState(OutState newState) override;
+		void setState(OutState newState, Timestamp timestamp = Timestamp()) override;
 
-		void setValue(int newValue) override;
+		void setValue(int newValue, Timestamp timestamp = Timestamp()) override;
+
+		/**
+		 *	@brief Get the module index of binary commands, -1 for text commands
+		 */
+		int getLinkIndex() const;
 
 		rapidjson::Document to_json() const override;
 
@@ -33,6 +54,8 @@ namespace domotic_pi {
 		std::shared_ptr<SerialInterface> _serial;
 		int _range_min;
 		int _range_max;
+		const int _linkIndex;
+		std::shared_ptr<SerialLink> _link;
 
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
 		hap::BoolCharacteristics_ptr _stateInfo;
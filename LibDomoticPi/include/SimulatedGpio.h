@@ -0,0 +1,164 @@
+#ifndef DOMOTIC_PI_SIMULATED_GPIO
+#define DOMOTIC_PI_SIMULATED_GPIO
+
+#include "domoticPiDefine.h"
+#include "IGpioBackend.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace domotic_pi {
+
+	/**
+	 *	In memory GPIO backend: input levels are driven by the owner, edges are raised on the calling
+	 *	thread (or on the edge generator thread) and every write is recorded with its timestamp.
+	 *	Allows to run, test and benchmark GPIO modules on any machine.
+	 */
+	class SimulatedGpio : public IGpioBackend {
+	public:
+		/**
+		 *	Pin write recorded by the simulator, writes applied in one operation share the batch number
+		 */
+		struct Write {
+			Timestamp timestamp;
+			int pin;
+			int value;
+			uint64_t batch;
+		};
+
+		typedef std::function<void(const Write&)> WriteCallback;
+
+		SimulatedGpio();
+
+		~SimulatedGpio();
+
+		int setup() override;
+
+		const char * getName() const override;
+
+		void setMode(int pin, GpioMode mode) override;
+
+		/**
+		 *	@note Floating input pins settle to the pull level
+		 */
+		void setPull(int pin, GpioPull pull) override;
+
+		void write(int pin, int value) override;
+
+		int read(int pin) override;
+
+		/**
+		 *	@note All pins change together, with one timestamp and one batch number
+		 */
+		void writeBanks(const GpioBanks& banks) override;
+
+		/**
+		 *	@note All pins are read under one lock, giving a consistent snapshot
+		 */
+		void readBanks(const GpioLevels& mask, GpioLevels& levels) override;
+
+		int setEdgeCallback(int pin, GpioEdge edge, GpioEdgeCallback callback) override;
+
+		/**
+		 *	@brief Drive an input pin to given level, raising its edge callback on the calling thread if the edge matches
+		 *
+		 *	@param pin pin number
+		 *	@param level new pin level (0 or 1)
+		 *	@param timestamp time the edge is reported at, Clock time if not set
+		 *
+		 *	@return true if an edge callback has been raised
+		 */
+		bool setLevel(int pin, int level, Timestamp timestamp = Timestamp());
+
+		/**
+		 *	@brief Toggle an input pin given number of times without waiting, stamping edges as if
+		 *		   they were spaced by given interval starting from now
+		 *
+		 *	@return number of edge callbacks raised
+		 */
+		size_t injectEdges(int pin, size_t count, std::chrono::nanoseconds interval);
+
+		/**
+		 *	@brief Toggle an input pin at given rate on the edge generator thread, until stopped
+		 *
+		 *	@param pin pin number
+		 *	@param rate edges per second
+		 *
+		 *	@throw domotic_pi_exception on a virtual clock, where edges have to be injected by the clock owner
+		 */
+		void startEdgeGenerator(int pin, double rate);
+
+		/**
+		 *	@brief Stop the edge generator of given pin (all generators if negative)
+		 */
+		void stopEdgeGenerator(int pin = -1);
+
+		/**
+		 *	@brief Get the number of edge callbacks raised so far
+		 */
+		uint64_t getEdgeCount() const;
+
+		/**
+		 *	@brief Set a function called on each write, on the writing thread
+		 */
+		void setWriteCallback(WriteCallback callback);
+
+		/**
+		 *	@brief Enable or disable write recording (enabled by default)
+		 */
+		void setRecordWrites(bool record);
+
+		/**
+		 *	@brief Get the writes recorded so far, in write order
+		 */
+		std::vector<Write> getWrites() const;
+
+		/**
+		 *	@brief Check whether the last recorded write of each given pin has been applied
+		 *		   in the same operation as the others
+		 *
+		 *	@return false if any pin has no recorded write or has been written separately
+		 */
+		bool writtenTogether(const std::vector<int>& pins) const;
+
+		void clearWrites();
+
+	private:
+		struct Pin {
+			GpioMode mode = gpio_input;
+			int level = 0;
+			GpioEdge edge = edge_none;
+			GpioEdgeCallback callback;
+		};
+
+		mutable std::mutex _gpioLock;
+		std::array<Pin, DOMOTIC_PI_MAX_PIN + 1> _pins;
+		std::atomic<uint64_t> _edgeCount;
+
+		bool _recordWrites;
+		uint64_t _batchCounter;
+		std::vector<Write> _writes;
+		WriteCallback _writeCallback;
+
+		//	Edge generators with their interval and next edge time, served by one thread
+		std::map<int, std::pair<std::chrono::nanoseconds, Timestamp>> _generators;
+		std::condition_variable _generatorChange;
+		bool _generatorRunning;
+		std::thread _generatorThread;
+
+		/**
+		 *	@brief Generator thread body
+		 */
+		void _generator_loop();
+	};
+
+}
+
+#endif // !DOMOTIC_PI_SIMULATED_GPIO
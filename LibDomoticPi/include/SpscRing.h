@@ -0,0 +1,91 @@
+#ifndef DOMOTIC_PI_SPSC_RING
+#define DOMOTIC_PI_SPSC_RING
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace domotic_pi {
+
+	/**
+	 *	Wait-free bounded ring buffer for one producer thread and one consumer thread.
+	 *	Neither push nor pop ever lock or allocate, so the producer side can be used
+	 *	from interrupt callbacks.
+	 *
+	 *	@tparam T trivially copyable item type
+	 *	@tparam Capacity maximum number of items, must be a power of two
+	 */
+	template <typename T, size_t Capacity>
+	class SpscRing {
+		static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+	public:
+		SpscRing() : _head(0), _tail(0) {}
+
+		SpscRing(const SpscRing&) = delete;
+		SpscRing& operator= (const SpscRing&) = delete;
+
+		/**
+		 *	@brief Append an item, producer side only
+		 *
+		 *	@return false if the ring is full and the item has been discarded
+		 */
+		bool push(const T& item)
+		{
+			size_t head = _head.load(std::memory_order_relaxed);
+			if (head - _tail.load(std::memory_order_acquire) == Capacity) {
+				return false;
+			}
+
+			_items[head & (Capacity - 1)] = item;
+			_head.store(head + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		/**
+		 *	@brief Remove the oldest item, consumer side only
+		 *
+		 *	@return false if the ring is empty
+		 */
+		bool pop(T& item)
+		{
+			size_t tail = _tail.load(std::memory_order_relaxed);
+			if (tail == _head.load(std::memory_order_acquire)) {
+				return false;
+			}
+
+			item = _items[tail & (Capacity - 1)];
+			_tail.store(tail + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		/**
+		 *	@brief Get number of items currently stored (approximate while the other side is running)
+		 */
+		size_t size() const
+		{
+			return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+		}
+
+		bool empty() const
+		{
+			return size() == 0;
+		}
+
+		static constexpr size_t capacity()
+		{
+			return Capacity;
+		}
+
+	private:
+		// Producer and consumer indexes on separate cache lines
+		alignas(64) std::atomic<size_t> _head;
+		alignas(64) std::atomic<size_t> _tail;
+		std::array<T, Capacity> _items;
+	};
+
+}
+
+#endif // !DOMOTIC_PI_SPSC_RING
@@ -0,0 +1,186 @@
+#ifndef DOMOTIC_PI_TIMER_WHEEL
+#define DOMOTIC_PI_TIMER_WHEEL
+
+#include "domoticPiDefine.h"
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace domotic_pi {
+
+	/**
+	 *	Hierarchical timer wheel shared by every library module needing a deferred
+	 *	action. All the timers are served by a single thread, insert, re-arm and
+	 *	cancel operations are constant time and never allocate once the timer
+	 *	object has been created.
+	 *
+	 *	Timer resolution is DOMOTIC_PI_TIMER_TICK_MS milliseconds.
+	 *
+	 *	When the library Clock is virtual, no wheel thread is started: timers expire
+	 *	only when the clock owner calls advance after moving the clock forward.
+	 */
+	class TimerWheel {
+	public:
+
+		class Timer {
+		public:
+			Timer(std::function<void()> callback);
+
+			Timer(const Timer&) = delete;
+			Timer& operator= (const Timer&) = delete;
+
+		private:
+			const std::function<void()> _callback;
+			uint64_t _expireTick;
+			uint8_t _level;
+			uint8_t _slot;
+			Timer * _prev;
+			Timer * _next;
+
+			// Reference held by the wheel while the timer is armed
+			std::shared_ptr<Timer> _armed;
+
+			friend class TimerWheel;
+		};
+
+		typedef std::shared_ptr<Timer> Timer_ptr;
+
+		TimerWheel();
+
+		TimerWheel(const TimerWheel&) = delete;
+		TimerWheel& operator= (const TimerWheel&) = delete;
+		~TimerWheel();
+
+		/**
+		 *	@brief Get the timer wheel instance shared by the library
+		 *
+		 *	@return timer wheel instance, kept alive while at least one reference exists
+		 */
+		static const std::shared_ptr<TimerWheel> load();
+
+		/**
+		 *	@brief Create a new disarmed timer with given callback
+		 *
+		 *	@note The callback is run on the timer wheel thread: it should return
+		 *		  quickly since it delays every other timer expiring after it
+		 *
+		 *	@param callback function to call on timer expiration
+		 *
+		 *	@return disarmed timer to be armed through arm method
+		 */
+		Timer_ptr newTimer(std::function<void()> callback);
+
+		/**
+		 *	@brief Arm given timer to expire after the requested delay
+		 *
+		 *	@note If the timer is already pending its expiration is moved to
+		 *		  the new deadline
+		 *
+		 *	@param timer timer to arm
+		 *	@param delay time to wait before timer expiration
+		 */
+		void arm(const Timer_ptr& timer, std::chrono::milliseconds delay);
+
+		/**
+		 *	@brief Create and arm a new timer
+		 *
+		 *	@note The timer is kept alive by the wheel until it expires, so the returned
+		 *		  handle is only needed to cancel or re-arm the timer
+		 *
+		 *	@param delay time to wait before timer expiration
+		 *	@param callback function to call on timer expiration
+		 *
+		 *	@return armed timer handle
+		 */
+		Timer_ptr schedule(std::chrono::milliseconds delay, std::function<void()> callback);
+
+		/**
+		 *	@brief Disarm given timer if pending
+		 *
+		 *	@note When called outside the wheel thread, this method waits for the
+		 *		  timer callback to return if it is running
+		 *
+		 *	@param timer timer to disarm
+		 */
+		void cancel(const Timer_ptr& timer);
+
+		/**
+		 *	@brief Check if given timer is waiting for its expiration
+		 */
+		bool isArmed(const Timer_ptr& timer) const;
+
+		/**
+		 *	@brief Get number of timers currently armed on the wheel
+		 */
+		size_t getArmedCount() const;
+
+		/**
+		 *	@brief Get the time point the wheel has to be served at next
+		 *
+		 *	@return next expiration (or internal cascade) time point, Timestamp::max() if no timer is armed
+		 */
+		Timestamp getNextExpiry() const;
+
+		/**
+		 *	@brief Expire on the calling thread all the timers due at current Clock time
+		 *
+		 *	@note Meant to drive the wheel on a virtual Clock, where no wheel thread is running
+		 */
+		void advance();
+
+	private:
+		static constexpr unsigned _levelBits = 6;
+		static constexpr unsigned _levels = 4;
+		static constexpr uint64_t _slots = 1 << _levelBits;
+		static constexpr uint64_t _slotMask = _slots - 1;
+		static constexpr uint64_t _maxDelta = (uint64_t)1 << (_levelBits * _levels);
+
+		static std::shared_ptr<TimerWheel> _timerWheel;
+
+		const Timestamp _start;
+		const std::chrono::steady_clock::duration _tick;
+
+		mutable std::mutex _wheelLock;
+		std::condition_variable _wheelChange;
+		std::array<std::array<Timer *, _slots>, _levels> _wheel;
+		std::array<uint64_t, _levels> _occupied;
+		uint64_t _currentTick;
+		uint64_t _wakeTick;
+		size_t _armedCount;
+
+		Timer * _running;
+		std::thread::id _wheelThreadId;
+		bool _wheelRunning;
+		std::thread _wheelThread;
+
+		uint64_t _now_tick() const;
+
+		uint64_t _next_event_tick() const;
+
+		void _link(Timer * timer);
+
+		void _unlink(Timer * timer);
+
+		void _cascade(unsigned level);
+
+		/**
+		 *	@brief Move current tick up to given one, running expired timers callbacks
+		 *
+		 *	@note Must be called holding given wheel lock, which is released during callbacks
+		 */
+		void _expire(uint64_t nowTick, std::unique_lock<std::mutex>& lock);
+
+		void _wheel_loop();
+	};
+
+	typedef TimerWheel::Timer_ptr Timer_ptr;
+
+}
+
+#endif // !DOMOTIC_PI_TIMER_WHEEL
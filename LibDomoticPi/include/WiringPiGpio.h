@@ -0,0 +1,49 @@
+#ifndef DOMOTIC_PI_WIRING_PI_GPIO
+#define DOMOTIC_PI_WIRING_PI_GPIO
+
+#include "domoticPiDefine.h"
+
+// Built only when wiringPi support is enabled
+#ifdef DOMOTIC_PI_WIRING_PI
+
+#include "IGpioBackend.h"
+
+#include <array>
+#include <atomic>
+
+namespace domotic_pi {
+
+	/**
+	 *	GPIO backend on top of wiringPi, using wiringPi pin numbering
+	 */
+	class WiringPiGpio : public IGpioBackend {
+	public:
+		WiringPiGpio();
+
+		int setup() override;
+
+		const char * getName() const override;
+
+		void setMode(int pin, GpioMode mode) override;
+
+		void setPull(int pin, GpioPull pull) override;
+
+		void write(int pin, int value) override;
+
+		int read(int pin) override;
+
+		/**
+		 *	@note Edges are stamped when the wiringPi interrupt thread is woken up
+		 */
+		int setEdgeCallback(int pin, GpioEdge edge, GpioEdgeCallback callback) override;
+
+	private:
+		//	Edge currently requested for each pin, to know the level of single edge interrupts
+		std::array<std::atomic<int>, DOMOTIC_PI_MAX_PIN + 1> _edges;
+	};
+
+}
+
+#endif // DOMOTIC_PI_WIRING_PI
+
+#endif // !DOMOTIC_PI_WIRING_PI_GPIO
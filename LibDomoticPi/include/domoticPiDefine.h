@@ -7,7 +7,10 @@
 // Enables mutex lock in setter functions
 #define DOMOTIC_PI_THREAD_SAFE
 
+// Apple HomeKit support, can be left out by defining DOMOTIC_PI_NO_APPLE_HOMEKIT (ie. simulator build)
+#ifndef DOMOTIC_PI_NO_APPLE_HOMEKIT
 #define DOMOTIC_PI_APPLE_HOMEKIT
+#endif
 
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
 
@@ -19,18 +22,117 @@
 
 #endif // DOMOTIC_PI_APPLE_HOMEKIT
 
+// wiringPi GPIO backend, can be left out by defining DOMOTIC_PI_NO_WIRING_PI (ie. boards other than
+// Raspberry Pi, GPIO is then accessed through the Linux character device)
+#ifndef DOMOTIC_PI_NO_WIRING_PI
+#define DOMOTIC_PI_WIRING_PI
+#endif
+
 
 // Highest valid pin number
 #ifndef DOMOTIC_PI_MAX_PIN
 #define DOMOTIC_PI_MAX_PIN 63
 #endif
 
-// Standard pin mode and pull up/down state to reset pins after usage
+// Number of GPIO chips pins can be requested on, chip 0 being the default one
+#ifndef DOMOTIC_PI_MAX_CHIPS
+#define DOMOTIC_PI_MAX_CHIPS 4
+#endif
+
+// Standard pin mode and pull up/down state to reset pins after usage (default release state of every chip)
 #ifndef DOMOTIC_PI_PIN_STANDARD_MODE
-#define DOMOTIC_PI_PIN_STANDARD_MODE INPUT
+#define DOMOTIC_PI_PIN_STANDARD_MODE gpio_input
 #endif
 #ifndef DOMOTIC_PI_PIN_STANDARD_PUD
-#define DOMOTIC_PI_PIN_STANDARD_PUD PUD_DOWN
+#define DOMOTIC_PI_PIN_STANDARD_PUD pull_down
+#endif
+
+// GPIO chip used by the character device backend
+#ifndef DOMOTIC_PI_GPIO_CHIP
+#define DOMOTIC_PI_GPIO_CHIP "/dev/gpiochip0"
+#endif
+
+// Edges buffered by the kernel for each input line of the character device backend,
+// and edges read at once by its event thread
+#ifndef DOMOTIC_PI_GPIO_EVENT_BUFFER
+#define DOMOTIC_PI_GPIO_EVENT_BUFFER 64
+#endif
+#ifndef DOMOTIC_PI_GPIO_EPOLL_EVENTS
+#define DOMOTIC_PI_GPIO_EPOLL_EVENTS 16
+#endif
+
+// Receive ring buffer of each serial interface in bytes (power of two), also the longest frame received
+#ifndef DOMOTIC_PI_SERIAL_RX_BUFFER
+#define DOMOTIC_PI_SERIAL_RX_BUFFER 4096
+#endif
+
+// Commands waiting for the writer thread of each serial interface, callers wait when it is full
+#ifndef DOMOTIC_PI_SERIAL_TX_QUEUE
+#define DOMOTIC_PI_SERIAL_TX_QUEUE 64
+#endif
+
+// Binary serial link: commands sent without waiting for their ack, ack timeout in milliseconds
+// and retransmissions before a command is given up
+#ifndef DOMOTIC_PI_SERIAL_LINK_WINDOW
+#define DOMOTIC_PI_SERIAL_LINK_WINDOW 4
+#endif
+#ifndef DOMOTIC_PI_SERIAL_LINK_ACK_MS
+#define DOMOTIC_PI_SERIAL_LINK_ACK_MS 50
+#endif
+#ifndef DOMOTIC_PI_SERIAL_LINK_RETRIES
+#define DOMOTIC_PI_SERIAL_LINK_RETRIES 3
+#endif
+
+// Timer wheel resolution in milliseconds
+#ifndef DOMOTIC_PI_TIMER_TICK_MS
+#define DOMOTIC_PI_TIMER_TICK_MS 10
+#endif
+
+// Button edges buffered between interrupt and gesture processing, per button (power of two)
+#ifndef DOMOTIC_PI_GESTURE_EDGE_RING
+#define DOMOTIC_PI_GESTURE_EDGE_RING 64
+#endif
+
+// Bank sampler period in milliseconds, for inputs sampled instead of interrupting
+#ifndef DOMOTIC_PI_BANK_SAMPLE_MS
+#define DOMOTIC_PI_BANK_SAMPLE_MS 10
+#endif
+
+// Pulse counter sampling period, default rate window and total persistence period in milliseconds
+#ifndef DOMOTIC_PI_PULSE_SAMPLE_MS
+#define DOMOTIC_PI_PULSE_SAMPLE_MS 1000
+#endif
+#ifndef DOMOTIC_PI_PULSE_WINDOW_MS
+#define DOMOTIC_PI_PULSE_WINDOW_MS 60000
+#endif
+#ifndef DOMOTIC_PI_PULSE_PERSIST_MS
+#define DOMOTIC_PI_PULSE_PERSIST_MS 60000
+#endif
+
+// Default software PWM frequency in Hz
+#ifndef DOMOTIC_PI_PWM_FREQUENCY
+#define DOMOTIC_PI_PWM_FREQUENCY 100
+#endif
+
+// Default button edge storm guard: edges per second above which a pin is sampled instead of
+// interrupting, sampling period, and how long the pin must stay quiet to return to interrupts
+#ifndef DOMOTIC_PI_STORM_RATE
+#define DOMOTIC_PI_STORM_RATE 200
+#endif
+#ifndef DOMOTIC_PI_STORM_POLL_MS
+#define DOMOTIC_PI_STORM_POLL_MS 20
+#endif
+#ifndef DOMOTIC_PI_STORM_CALM_MS
+#define DOMOTIC_PI_STORM_CALM_MS 2000
+#endif
+
+// Default programmed event circuit breaker: maximum sustained triggers per second
+// before the event is suspended (0, disabled unless configured), and how long it stays suspended
+#ifndef DOMOTIC_PI_EVENT_BREAKER_RATE
+#define DOMOTIC_PI_EVENT_BREAKER_RATE 0
+#endif
+#ifndef DOMOTIC_PI_EVENT_BREAKER_COOLDOWN_MS
+#define DOMOTIC_PI_EVENT_BREAKER_COOLDOWN_MS 10000
 #endif
 
 #define DOMOTIC_PI_JSON_INPUT "Input.json"
@@ -39,10 +141,14 @@
 #define DOMOTIC_PI_JSON_PROGRAMMED_EVENT "ProgrammedEvent.json"
 #define DOMOTIC_PI_JSON_DOMOTIC_NODE "DomoticNode.json"
 
+#include <chrono>
 #include <memory>
 
 namespace domotic_pi {
 
+	// Monotonic time point stamped at event source and carried down to output commands
+	typedef std::chrono::steady_clock::time_point Timestamp;
+
 	class IInput;
 	typedef std::shared_ptr<IInput> Input_ptr;
 
@@ -2,6 +2,7 @@
 #define DOMOTIC_PI_EXCEPTIONS
 
 #include <exception>
+#include <string>
 
 namespace domotic_pi {
 
@@ -12,15 +13,19 @@ namespace domotic_pi {
 
 		}
 
+		domotic_pi_exception(const std::string& message) : _message(message) {
+
+		}
+
 		virtual ~domotic_pi_exception() {}
 
 		virtual const char * what() const throw()
 		{
-			return _message;
+			return _message.c_str();
 		}
 
 	private:
-		const char * _message;
+		const std::string _message;
 	};
 
 }
@@ -7,22 +7,49 @@
 #include "exceptions.h"
 #include "ButtonState.h"
 #include "OutState.h"
+#include "EventPriority.h"
 
 #include "Pin.h"
+#include "PinRegistry.h"
+#include "IGpioBackend.h"
+#include "GpioWriteBatch.h"
+#ifdef DOMOTIC_PI_WIRING_PI
+#include "WiringPiGpio.h"
+#endif
+#include "ChardevGpio.h"
+#include "SimulatedGpio.h"
+#include "BankSampler.h"
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
 #include "IAHKAccessory.h"
 #endif
 #include "IModule.h"
 #include "Serializable.h"
+#include "Clock.h"
+#include "EventDispatcher.h"
+#include "EventGraph.h"
+#include "GestureRecognizer.h"
+#include "InputPattern.h"
+#include "PatternMatcher.h"
+#include "LatencyHistogram.h"
+#include "InplaceFunction.h"
+#include "SpscRing.h"
+#include "ByteRing.h"
+#include "TimerWheel.h"
+#include "OutputTimers.h"
+#include "PwmScheduler.h"
+#include "CronSchedule.h"
 
 #include "InputFactory.h"
 #include "IInput.h"
 #include "DigitalButton.h"
 #include "MqttButton.h"
+#include "PulseCounter.h"
+#include "SerialInput.h"
 
 #include "OutputFactory.h"
 #include "IOutput.h"
 #include "DigitalSwitch.h"
+#include "PwmOutput.h"
 #include "MqttSwitch.h"
 #include "MqttVolume.h"
 #include "SerialOutput.h"
@@ -31,6 +58,7 @@
 #include "IComm.h"
 #include "MqttComm.h"
 #include "SerialInterface.h"
+#include "SerialLink.h"
 
 #include "DomoticNode.h"
 
@@ -0,0 +1,249 @@
+#include <BankSampler.h>
+
+#include <Clock.h>
+#include <domoticPi.h>
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+using namespace domotic_pi;
+
+std::array<std::shared_ptr<BankSampler>, DOMOTIC_PI_MAX_CHIPS> BankSampler::_bankSamplers;
+
+BankSampler::BankSampler(GpioBackend_ptr gpio)
+	: _gpio(gpio), _timerWheel(TimerWheel::load()),
+	_subscriptions(std::make_shared<const Subscriptions>()),
+	_interval(std::chrono::milliseconds(DOMOTIC_PI_BANK_SAMPLE_MS)),
+	_sampleCount(0), _edgeCount(0)
+{
+	for (auto& level : _levels) {
+		level.store(0, std::memory_order_relaxed);
+	}
+
+	_sampleTimer = _timerWheel->newTimer([this] {
+		_sample();
+	});
+}
+
+BankSampler::~BankSampler()
+{
+	_timerWheel->cancel(_sampleTimer);
+}
+
+const std::shared_ptr<BankSampler> BankSampler::load(unsigned int chip)
+{
+	GpioBackend_ptr gpio = IGpioBackend::load(chip);
+
+	if (_bankSamplers[chip] == nullptr) {
+		_bankSamplers[chip] = std::make_shared<BankSampler>(gpio);
+	}
+
+	return _bankSamplers[chip];
+}
+
+void BankSampler::addPin(int pin)
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		console->error("BankSampler::addPin : pin number must be between 0 and " STR(DOMOTIC_PI_MAX_PIN) ".");
+		throw std::out_of_range("Pin number must be between 0 and " STR(DOMOTIC_PI_MAX_PIN) ".");
+	}
+
+	std::unique_lock<std::mutex> lock(_samplerLock);
+
+	size_t bank = pin / 64;
+	uint64_t bit = (uint64_t)1 << (pin % 64);
+
+	if (_subscriptions->mask[bank] & bit) {
+		return;
+	}
+
+	auto subscriptions = std::make_shared<Subscriptions>(*_subscriptions);
+	subscriptions->mask[bank] |= bit;
+
+	// Seed the snapshot so the first sample does not report the current level as an edge
+	if (_gpio->read(pin)) {
+		_levels[bank].fetch_or(bit, std::memory_order_relaxed);
+	}
+	else {
+		_levels[bank].fetch_and(~bit, std::memory_order_relaxed);
+	}
+
+	_subscriptions = subscriptions;
+
+	if (!_timerWheel->isArmed(_sampleTimer)) {
+		_timerWheel->arm(_sampleTimer, _interval);
+	}
+
+	console->info("BankSampler::addPin : pin {} sampled every {} ms.", pin, (long long)_interval.count());
+}
+
+void BankSampler::removePin(int pin)
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(_samplerLock);
+
+	size_t bank = pin / 64;
+	uint64_t bit = (uint64_t)1 << (pin % 64);
+
+	auto subscriptions = std::make_shared<Subscriptions>(*_subscriptions);
+	subscriptions->mask[bank] &= ~bit;
+	subscriptions->rising[bank] &= ~bit;
+	subscriptions->falling[bank] &= ~bit;
+	subscriptions->callbacks[pin] = nullptr;
+
+	// Sample timer stops by itself once no pin is left
+	_subscriptions = subscriptions;
+
+	// Edges are delivered from a snapshot, which may still hold the callback
+	_wait_sample(lock);
+}
+
+int BankSampler::setEdgeCallback(int pin, GpioEdge edge, GpioEdgeCallback callback)
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		return -1;
+	}
+
+	std::unique_lock<std::mutex> lock(_samplerLock);
+
+	size_t bank = pin / 64;
+	uint64_t bit = (uint64_t)1 << (pin % 64);
+
+	if (!(_subscriptions->mask[bank] & bit)) {
+		return -1;
+	}
+
+	auto subscriptions = std::make_shared<Subscriptions>(*_subscriptions);
+
+	subscriptions->rising[bank] &= ~bit;
+	subscriptions->falling[bank] &= ~bit;
+	if (edge == edge_rising || edge == edge_both) {
+		subscriptions->rising[bank] |= bit;
+	}
+	if (edge == edge_falling || edge == edge_both) {
+		subscriptions->falling[bank] |= bit;
+	}
+
+	if (edge == edge_none) {
+		subscriptions->callbacks[pin] = nullptr;
+	}
+	else if (callback != nullptr) {
+		subscriptions->callbacks[pin] = callback;
+	}
+
+	_subscriptions = subscriptions;
+
+	if (edge == edge_none) {
+		_wait_sample(lock);
+	}
+
+	return 0;
+}
+
+int BankSampler::getLevel(int pin) const
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		return 0;
+	}
+
+	return (_levels[pin / 64].load(std::memory_order_relaxed) >> (pin % 64)) & 1;
+}
+
+void BankSampler::setInterval(std::chrono::milliseconds interval)
+{
+	std::unique_lock<std::mutex> lock(_samplerLock);
+	_interval = std::max(interval, std::chrono::milliseconds(DOMOTIC_PI_TIMER_TICK_MS));
+}
+
+std::chrono::milliseconds BankSampler::getInterval() const
+{
+	std::unique_lock<std::mutex> lock(_samplerLock);
+	return _interval;
+}
+
+uint64_t BankSampler::getSampleCount() const
+{
+	return _sampleCount.load(std::memory_order_relaxed);
+}
+
+uint64_t BankSampler::getEdgeCount() const
+{
+	return _edgeCount.load(std::memory_order_relaxed);
+}
+
+void BankSampler::_sample()
+{
+	std::shared_ptr<const Subscriptions> subscriptions;
+	GpioLevels edges{};
+	GpioLevels levels;
+	Timestamp timestamp;
+
+	{
+		std::unique_lock<std::mutex> lock(_samplerLock);
+
+		subscriptions = _subscriptions;
+		bool sampling = false;
+		for (uint64_t mask : subscriptions->mask) {
+			sampling = sampling || mask != 0;
+		}
+
+		if (!sampling) {
+			return;
+		}
+
+		_gpio->readBanks(subscriptions->mask, levels);
+		timestamp = Clock::now();
+
+		for (size_t bank = 0; bank < levels.size(); ++bank) {
+			uint64_t mask = subscriptions->mask[bank];
+			uint64_t previous = _levels[bank].load(std::memory_order_relaxed);
+			uint64_t changed = (previous ^ levels[bank]) & mask;
+
+			edges[bank] = (changed & levels[bank] & subscriptions->rising[bank])
+				| (changed & ~levels[bank] & subscriptions->falling[bank]);
+
+			_levels[bank].store((previous & ~mask) | levels[bank], std::memory_order_relaxed);
+		}
+
+		_sampleCount.fetch_add(1, std::memory_order_relaxed);
+		_timerWheel->arm(_sampleTimer, _interval);
+
+		_deliveringThread = std::this_thread::get_id();
+	}
+
+	for (size_t bank = 0; bank < edges.size(); ++bank) {
+		for (uint64_t pins = edges[bank]; pins; pins &= pins - 1) {
+			int bit = __builtin_ctzll(pins);
+			const GpioEdgeCallback& callback = subscriptions->callbacks[bank * 64 + bit];
+			if (callback == nullptr) {
+				continue;
+			}
+
+			_edgeCount.fetch_add(1, std::memory_order_relaxed);
+
+			try {
+				callback((levels[bank] >> bit) & 1, timestamp);
+			}
+			catch (std::exception& e) {
+				console->warn("BankSampler::_sample : exception during edge callback : {}", e.what());
+			}
+		}
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(_samplerLock);
+		_deliveringThread = std::thread::id();
+	}
+	_sampleDone.notify_all();
+}
+
+void BankSampler::_wait_sample(std::unique_lock<std::mutex>& lock)
+{
+	_sampleDone.wait(lock, [this] {
+		return _deliveringThread == std::thread::id() || _deliveringThread == std::this_thread::get_id();
+	});
+}
@@ -0,0 +1,104 @@
+#include <ByteRing.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace domotic_pi;
+
+static size_t roundCapacity(size_t capacity)
+{
+	size_t rounded = 1;
+	while (rounded < capacity) {
+		rounded <<= 1;
+	}
+
+	return rounded;
+}
+
+ByteRing::ByteRing(size_t capacity)
+	: _buffer(roundCapacity(capacity)), _mask(_buffer.size() - 1), _head(0), _tail(0)
+{
+}
+
+size_t ByteRing::capacity() const
+{
+	return _buffer.size();
+}
+
+size_t ByteRing::size() const
+{
+	return _tail - _head;
+}
+
+size_t ByteRing::space() const
+{
+	return _buffer.size() - size();
+}
+
+std::pair<char *, size_t> ByteRing::writeSpan()
+{
+	size_t start = _tail & _mask;
+
+	return { _buffer.data() + start, std::min(space(), _buffer.size() - start) };
+}
+
+void ByteRing::commit(size_t length)
+{
+	_tail += std::min(length, space());
+}
+
+uint8_t ByteRing::at(size_t offset) const
+{
+	return (uint8_t)_buffer[(_head + offset) & _mask];
+}
+
+size_t ByteRing::find(char value, size_t from) const
+{
+	// At most two contiguous segments to scan
+	while (from < size()) {
+		size_t start = (_head + from) & _mask;
+		size_t length = std::min(size() - from, _buffer.size() - start);
+
+		const char * found = (const char *)memchr(_buffer.data() + start, value, length);
+		if (found != nullptr) {
+			return from + (found - (_buffer.data() + start));
+		}
+
+		from += length;
+	}
+
+	return npos;
+}
+
+std::string_view ByteRing::view(size_t offset, size_t length, std::vector<char>& scratch) const
+{
+	size_t start = (_head + offset) & _mask;
+	if (start + length <= _buffer.size()) {
+		return std::string_view(_buffer.data() + start, length);
+	}
+
+	size_t first = _buffer.size() - start;
+	if (scratch.size() < length) {
+		scratch.resize(length);
+	}
+
+	memcpy(scratch.data(), _buffer.data() + start, first);
+	memcpy(scratch.data() + first, _buffer.data(), length - first);
+
+	return std::string_view(scratch.data(), length);
+}
+
+void ByteRing::consume(size_t length)
+{
+	_head += std::min(length, size());
+
+	// Restart from the buffer start when empty, so next reads get the largest contiguous area
+	if (_head == _tail) {
+		_head = _tail = 0;
+	}
+}
+
+void ByteRing::clear()
+{
+	_head = _tail = 0;
+}
@@ -6,7 +6,7 @@
 
 using namespace domotic_pi;
 
-CallbackToken::CallbackToken(std::function<void()> removeCallbackFunction) 
+CallbackToken::CallbackToken(InplaceFunction<void()> removeCallbackFunction) 
 	: _removeCallbackFunction(removeCallbackFunction)
 {
 }
@@ -0,0 +1,583 @@
+#include <ChardevGpio.h>
+
+#include <Clock.h>
+#include <domoticPi.h>
+#include <exceptions.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace domotic_pi;
+
+ChardevGpio::OutputRequest::~OutputRequest()
+{
+	close(fd);
+}
+
+ChardevGpio::ChardevGpio(const std::string& chipPath)
+	: _chipPath(chipPath), _chipFd(-1), _runningPin(-1), _epollFd(-1), _wakeupFd(-1), _eventRunning(false),
+	_edgeCount(0), _droppedEdges(0)
+{
+}
+
+ChardevGpio::~ChardevGpio()
+{
+	_eventRunning = false;
+
+	if (_eventThread.joinable()) {
+		_wakeup();
+		_eventThread.join();
+	}
+
+	for (int pin = 0; pin <= DOMOTIC_PI_MAX_PIN; ++pin) {
+		_release(pin);
+	}
+
+	if (_wakeupFd >= 0) {
+		close(_wakeupFd);
+	}
+
+	if (_epollFd >= 0) {
+		close(_epollFd);
+	}
+
+	if (_chipFd >= 0) {
+		close(_chipFd);
+	}
+}
+
+int ChardevGpio::setup()
+{
+	if (_chipFd >= 0) {
+		return 0;
+	}
+
+	_chipFd = open(_chipPath.c_str(), O_RDWR | O_CLOEXEC);
+	if (_chipFd < 0) {
+		console->error("ChardevGpio::setup : could not open GPIO chip '{}' ({}).", _chipPath, strerror(errno));
+		return -1;
+	}
+
+	_epollFd = epoll_create1(EPOLL_CLOEXEC);
+	_wakeupFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (_epollFd < 0 || _wakeupFd < 0) {
+		console->error("ChardevGpio::setup : epoll or eventfd creation failed ({}).", strerror(errno));
+		return -1;
+	}
+
+	struct epoll_event wakeupEvent;
+	wakeupEvent.events = EPOLLIN;
+	wakeupEvent.data.u64 = _wakeupKey;
+	if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, _wakeupFd, &wakeupEvent) < 0) {
+		console->error("ChardevGpio::setup : could not watch eventfd ({}).", strerror(errno));
+		return -1;
+	}
+
+	_eventRunning = true;
+	_eventThread = std::thread(&ChardevGpio::_event_loop, this);
+
+	console->info("ChardevGpio::setup : GPIO chip '{}' opened.", _chipPath);
+
+	return 0;
+}
+
+const char * ChardevGpio::getName() const
+{
+	return "chardev";
+}
+
+uint64_t ChardevGpio::getEdgeCount() const
+{
+	return _edgeCount.load(std::memory_order_relaxed);
+}
+
+uint64_t ChardevGpio::getDroppedEdgeCount() const
+{
+	return _droppedEdges.load(std::memory_order_relaxed);
+}
+
+void ChardevGpio::setMode(int pin, GpioMode mode)
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(_gpioLock);
+
+	Line& line = _lines[pin];
+	int retval = 0;
+
+	if (_chipFd < 0) {
+		errno = ENODEV;
+		retval = -1;
+	}
+	else if (mode == gpio_output) {
+		// Requested with the other new outputs by the next write, driven ones are left untouched
+		if (line.mode != gpio_output) {
+			_release(pin);
+			line.mode = mode;
+		}
+	}
+	else {
+		// Other lines of the output request can only be kept by requesting them again
+		std::shared_ptr<OutputRequest> output = line.output;
+		bool regroup = output != nullptr;
+		if (regroup) {
+			for (auto& it : _lines) {
+				if (it.output == output) {
+					it.output.reset();
+				}
+			}
+			output.reset();
+		}
+
+		line.mode = mode;
+		retval = _request_input(pin);
+
+		if (retval == 0 && regroup) {
+			retval = _request_outputs();
+		}
+	}
+
+	if (retval) {
+		console->error("ChardevGpio::setMode : could not set mode {} for line {} ({}).", mode, pin, strerror(errno));
+		throw domotic_pi_exception("GPIO line request failed.");
+	}
+}
+
+void ChardevGpio::setPull(int pin, GpioPull pull)
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(_gpioLock);
+
+	_lines[pin].pull = pull;
+
+	// Bias of output lines is not configurable
+	if (_lines[pin].mode != gpio_input) {
+		return;
+	}
+
+	if (_request_input(pin)) {
+		console->error("ChardevGpio::setPull : could not set pull {} for line {} ({}).", pull, pin, strerror(errno));
+		throw domotic_pi_exception("GPIO line request failed.");
+	}
+}
+
+void ChardevGpio::write(int pin, int value)
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(_gpioLock);
+
+	Line& line = _lines[pin];
+	line.value = value ? 1 : 0;
+
+	if (line.mode != gpio_output) {
+		console->warn("ChardevGpio::write : line {} is not an output.", pin);
+		return;
+	}
+
+	// Newly set up line, driven at the written value by its request
+	if (line.output == nullptr) {
+		if (_request_outputs()) {
+			console->error("ChardevGpio::write : could not request line {} ({}).", pin, strerror(errno));
+		}
+		return;
+	}
+
+	struct gpio_v2_line_values values;
+	values.mask = (uint64_t)1 << line.index;
+	values.bits = line.value ? values.mask : 0;
+
+	if (ioctl(line.output->fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) < 0) {
+		console->error("ChardevGpio::write : could not write line {} ({}).", pin, strerror(errno));
+	}
+}
+
+void ChardevGpio::writeBanks(const GpioBanks& banks)
+{
+	std::unique_lock<std::mutex> lock(_gpioLock);
+
+	// Values of each output request written, in the order requests are met
+	std::vector<std::pair<OutputRequest*, struct gpio_v2_line_values>> requests;
+	bool pending = false;
+
+	for (size_t bank = 0; bank < banks.size(); ++bank) {
+		for (uint64_t pins = banks[bank].set | banks[bank].clear; pins; pins &= pins - 1) {
+			int bit = __builtin_ctzll(pins);
+			int pin = (int)(bank * 64 + bit);
+			if (pin > DOMOTIC_PI_MAX_PIN) {
+				break;
+			}
+
+			Line& line = _lines[pin];
+			line.value = banks[bank].clear & ((uint64_t)1 << bit) ? 0 : 1;
+
+			if (line.mode != gpio_output) {
+				continue;
+			}
+
+			// Newly set up lines are driven at their written value by their request
+			if (line.output == nullptr) {
+				pending = true;
+				continue;
+			}
+
+			auto request = std::find_if(requests.begin(), requests.end(), [&line](const auto& it) {
+				return it.first == line.output.get();
+			});
+			if (request == requests.end()) {
+				request = requests.insert(requests.end(), { line.output.get(), gpio_v2_line_values{ 0, 0 } });
+			}
+
+			request->second.mask |= (uint64_t)1 << line.index;
+			if (line.value) {
+				request->second.bits |= (uint64_t)1 << line.index;
+			}
+		}
+	}
+
+	if (pending && _request_outputs()) {
+		console->error("ChardevGpio::writeBanks : could not request new output lines ({}).", strerror(errno));
+	}
+
+	for (auto& it : requests) {
+		if (ioctl(it.first->fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &it.second) < 0) {
+			console->error("ChardevGpio::writeBanks : could not write lines ({}).", strerror(errno));
+		}
+	}
+}
+
+int ChardevGpio::read(int pin)
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		return 0;
+	}
+
+	std::unique_lock<std::mutex> lock(_gpioLock);
+
+	const Line& line = _lines[pin];
+	if (line.mode == gpio_output || line.fd < 0) {
+		return line.value;
+	}
+
+	struct gpio_v2_line_values values;
+	values.mask = 1;
+	values.bits = 0;
+
+	if (ioctl(line.fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0) {
+		console->error("ChardevGpio::read : could not read line {} ({}).", pin, strerror(errno));
+		return 0;
+	}
+
+	return values.bits & 1 ? 1 : 0;
+}
+
+void ChardevGpio::readBanks(const GpioLevels& mask, GpioLevels& levels)
+{
+	std::unique_lock<std::mutex> lock(_gpioLock);
+
+	for (size_t bank = 0; bank < mask.size(); ++bank) {
+		levels[bank] = 0;
+		for (uint64_t pins = mask[bank]; pins; pins &= pins - 1) {
+			int bit = __builtin_ctzll(pins);
+			int pin = (int)(bank * 64 + bit);
+			if (pin > DOMOTIC_PI_MAX_PIN) {
+				break;
+			}
+
+			const Line& line = _lines[pin];
+			int value = line.value;
+
+			if (line.mode == gpio_input && line.fd >= 0) {
+				struct gpio_v2_line_values values;
+				values.mask = 1;
+				values.bits = 0;
+
+				if (ioctl(line.fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0) {
+					console->error("ChardevGpio::readBanks : could not read line {} ({}).", pin, strerror(errno));
+					continue;
+				}
+				value = values.bits & 1 ? 1 : 0;
+			}
+
+			levels[bank] |= (uint64_t)value << bit;
+		}
+	}
+}
+
+int ChardevGpio::setEdgeCallback(int pin, GpioEdge edge, GpioEdgeCallback callback)
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		return -1;
+	}
+
+	std::unique_lock<std::mutex> lock(_gpioLock);
+
+	Line& line = _lines[pin];
+	if (line.mode != gpio_input) {
+		return -1;
+	}
+
+	// Wait for running callback to complete, unless it is the one changing its edges,
+	// so the caller can release what the callback is bound to once disabled
+	if (std::this_thread::get_id() != _eventThread.get_id()) {
+		_callbackDone.wait(lock, [&] { return _runningPin != pin; });
+	}
+
+	line.edge = edge;
+	if (edge == edge_none) {
+		line.callback = nullptr;
+	}
+	else if (callback != nullptr) {
+		line.callback = callback;
+	}
+
+	int retval = _request_input(pin);
+	if (retval) {
+		console->error("ChardevGpio::setEdgeCallback : could not set edge {} for line {} ({}).",
+			edge, pin, strerror(errno));
+	}
+
+	return retval;
+}
+
+int ChardevGpio::_request_input(int pin)
+{
+	if (_chipFd < 0) {
+		errno = ENODEV;
+		return -1;
+	}
+
+	Line& line = _lines[pin];
+	_release(pin);
+
+	struct gpio_v2_line_request request;
+	memset(&request, 0, sizeof(request));
+
+	request.offsets[0] = pin;
+	request.num_lines = 1;
+	strncpy(request.consumer, "domoticPi", sizeof(request.consumer) - 1);
+
+	request.config.flags = GPIO_V2_LINE_FLAG_INPUT;
+	request.config.flags |= line.pull == pull_up ? GPIO_V2_LINE_FLAG_BIAS_PULL_UP :
+		line.pull == pull_down ? GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN : GPIO_V2_LINE_FLAG_BIAS_DISABLED;
+
+	if (line.edge == edge_rising || line.edge == edge_both) {
+		request.config.flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+	}
+	if (line.edge == edge_falling || line.edge == edge_both) {
+		request.config.flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+	}
+
+	request.event_buffer_size = DOMOTIC_PI_GPIO_EVENT_BUFFER;
+
+	if (ioctl(_chipFd, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+		return -1;
+	}
+
+	line.fd = request.fd;
+	line.seqno = 0;
+	++line.generation;
+
+	if (line.edge == edge_none || line.edge == edge_setup) {
+		return 0;
+	}
+
+	// Events are drained until the line is empty, the event thread must never block on it
+	fcntl(line.fd, F_SETFL, fcntl(line.fd, F_GETFL) | O_NONBLOCK);
+
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.u64 = ((uint64_t)line.generation << 32) | (uint32_t)pin;
+
+	return epoll_ctl(_epollFd, EPOLL_CTL_ADD, line.fd, &event);
+}
+
+int ChardevGpio::_request_outputs()
+{
+	std::vector<int> pins;
+	for (int pin = 0; pin <= DOMOTIC_PI_MAX_PIN; ++pin) {
+		if (_lines[pin].mode == gpio_output && _lines[pin].output == nullptr) {
+			pins.push_back(pin);
+		}
+	}
+
+	for (size_t first = 0; first < pins.size(); first += GPIO_V2_LINES_MAX) {
+		if (_chipFd < 0) {
+			errno = ENODEV;
+			return -1;
+		}
+
+		struct gpio_v2_line_request request;
+		memset(&request, 0, sizeof(request));
+
+		strncpy(request.consumer, "domoticPi", sizeof(request.consumer) - 1);
+		request.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+
+		// Lines start at their last written value
+		uint64_t values = 0;
+		request.num_lines = (uint32_t)std::min<size_t>(pins.size() - first, GPIO_V2_LINES_MAX);
+		for (uint32_t i = 0; i < request.num_lines; ++i) {
+			request.offsets[i] = pins[first + i];
+			if (_lines[pins[first + i]].value) {
+				values |= (uint64_t)1 << i;
+			}
+		}
+
+		request.config.num_attrs = 1;
+		request.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+		request.config.attrs[0].attr.values = values;
+		request.config.attrs[0].mask = request.num_lines == 64 ? ~(uint64_t)0 : ((uint64_t)1 << request.num_lines) - 1;
+
+		if (ioctl(_chipFd, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+			return -1;
+		}
+
+		auto output = std::make_shared<OutputRequest>();
+		output->fd = request.fd;
+
+		for (uint32_t i = 0; i < request.num_lines; ++i) {
+			_lines[pins[first + i]].output = output;
+			_lines[pins[first + i]].index = i;
+		}
+	}
+
+	return 0;
+}
+
+void ChardevGpio::_release(int pin)
+{
+	Line& line = _lines[pin];
+
+	if (line.fd >= 0) {
+		// Only input lines with edges are watched, removing others fails harmlessly
+		epoll_ctl(_epollFd, EPOLL_CTL_DEL, line.fd, nullptr);
+		close(line.fd);
+	}
+
+	line.fd = -1;
+	line.output.reset();
+}
+
+void ChardevGpio::_wakeup()
+{
+	if (_wakeupFd < 0) {
+		return;
+	}
+
+	uint64_t wakeup = 1;
+	if (::write(_wakeupFd, &wakeup, sizeof(wakeup)) < 0 && errno != EAGAIN) {
+		console->error("ChardevGpio::_wakeup : could not wake event thread ({}).", strerror(errno));
+	}
+}
+
+void ChardevGpio::_event_loop()
+{
+	std::array<struct epoll_event, DOMOTIC_PI_GPIO_EPOLL_EVENTS> events;
+
+	while (_eventRunning) {
+		int count = epoll_wait(_epollFd, events.data(), events.size(), -1);
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			console->error("ChardevGpio::_event_loop : epoll wait failed ({}).", strerror(errno));
+			break;
+		}
+
+		for (int i = 0; i < count; ++i) {
+			if (events[i].data.u64 == _wakeupKey) {
+				uint64_t wakeups;
+				if (::read(_wakeupFd, &wakeups, sizeof(wakeups)) < 0 && errno != EAGAIN) {
+					console->error("ChardevGpio::_event_loop : eventfd read failed ({}).", strerror(errno));
+				}
+				continue;
+			}
+
+			_read_events((int)(events[i].data.u64 & 0xffffffff), (uint32_t)(events[i].data.u64 >> 32));
+		}
+	}
+}
+
+void ChardevGpio::_read_events(int pin, uint32_t generation)
+{
+	std::array<struct gpio_v2_line_event, DOMOTIC_PI_GPIO_EPOLL_EVENTS> lineEvents;
+	ssize_t size;
+
+	do {
+		GpioEdgeCallback callback;
+
+		{
+			// The line may have been requested again since the event has been queued
+			std::unique_lock<std::mutex> lock(_gpioLock);
+
+			Line& line = _lines[pin];
+			if (line.generation != generation || line.fd < 0) {
+				return;
+			}
+
+			size = ::read(line.fd, lineEvents.data(), sizeof(lineEvents));
+			if (size <= 0) {
+				if (size < 0 && errno != EAGAIN) {
+					console->error("ChardevGpio::_read_events : could not read line {} events ({}).", pin, strerror(errno));
+				}
+				return;
+			}
+
+			// Sequence numbers skipped by the kernel are edges lost on event buffer overflow
+			for (size_t i = 0; i < size / sizeof(struct gpio_v2_line_event); ++i) {
+				if (line.seqno != 0 && lineEvents[i].line_seqno > line.seqno + 1) {
+					_droppedEdges.fetch_add(lineEvents[i].line_seqno - line.seqno - 1, std::memory_order_relaxed);
+				}
+				line.seqno = lineEvents[i].line_seqno;
+			}
+
+			callback = line.callback;
+			if (callback != nullptr) {
+				_runningPin = pin;
+			}
+		}
+
+		size_t count = size / sizeof(struct gpio_v2_line_event);
+		_edgeCount.fetch_add(count, std::memory_order_relaxed);
+
+		if (callback == nullptr) {
+			continue;
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+			// Line events are stamped by the kernel on CLOCK_MONOTONIC, the steady clock base on Linux
+			Timestamp timestamp = Clock::isVirtual() ? Clock::now() : Timestamp(
+				std::chrono::duration_cast<Timestamp::duration>(std::chrono::nanoseconds(lineEvents[i].timestamp_ns)));
+
+			try {
+				callback(lineEvents[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE ? 1 : 0, timestamp);
+			}
+			catch (std::exception& e) {
+				console->warn("ChardevGpio::_read_events : exception during edge callback : {}", e.what());
+			}
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(_gpioLock);
+			_runningPin = -1;
+		}
+		_callbackDone.notify_all();
+	} while ((size_t)size == sizeof(lineEvents));
+}
@@ -0,0 +1,35 @@
+#include <Clock.h>
+
+using namespace domotic_pi;
+
+std::atomic<bool> Clock::_virtual(false);
+std::atomic<Timestamp::rep> Clock::_virtualNow(0);
+
+Timestamp Clock::now()
+{
+	if (_virtual.load(std::memory_order_relaxed)) {
+		return Timestamp(Timestamp::duration(_virtualNow.load(std::memory_order_acquire)));
+	}
+
+	return std::chrono::steady_clock::now();
+}
+
+void Clock::setVirtual()
+{
+	// Start from real time, so a virtual time point is never mistaken for an unset timestamp
+	_virtualNow.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_release);
+	_virtual.store(true, std::memory_order_release);
+}
+
+bool Clock::isVirtual()
+{
+	return _virtual.load(std::memory_order_relaxed);
+}
+
+void Clock::advanceTo(Timestamp timePoint)
+{
+	Timestamp::rep target = timePoint.time_since_epoch().count();
+	Timestamp::rep current = _virtualNow.load(std::memory_order_relaxed);
+
+	while (target > current && !_virtualNow.compare_exchange_weak(current, target, std::memory_order_acq_rel));
+}
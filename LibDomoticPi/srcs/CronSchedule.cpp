@@ -0,0 +1,171 @@
+#include <CronSchedule.h>
+
+#include <domoticPi.h>
+#include <exceptions.h>
+
+#include <ctime>
+#include <sstream>
+#include <vector>
+
+using namespace domotic_pi;
+
+CronSchedule::CronSchedule(const std::string& expression) : _expression(expression)
+{
+	std::string cronExpression = expression;
+
+	// Expand shortcut expressions
+	if (cronExpression == "@hourly") {
+		cronExpression = "0 * * * *";
+	}
+	else if (cronExpression == "@daily" || cronExpression == "@midnight") {
+		cronExpression = "0 0 * * *";
+	}
+	else if (cronExpression == "@weekly") {
+		cronExpression = "0 0 * * 0";
+	}
+	else if (cronExpression == "@monthly") {
+		cronExpression = "0 0 1 * *";
+	}
+	else if (cronExpression == "@yearly" || cronExpression == "@annually") {
+		cronExpression = "0 0 1 1 *";
+	}
+
+	std::istringstream fieldStream(cronExpression);
+	std::vector<std::string> fields;
+	std::string field;
+	while (fieldStream >> field) {
+		fields.push_back(field);
+	}
+
+	if (fields.size() != 5) {
+		console->error("CronSchedule::ctor : expression '{}' must have 5 fields.", expression.c_str());
+		throw domotic_pi_exception("Cron expression must have 5 fields.");
+	}
+
+	_minutes = _parse_field(fields[0], 0, 59);
+	_hours = _parse_field(fields[1], 0, 23);
+	_daysOfMonth = _parse_field(fields[2], 1, 31);
+	_months = _parse_field(fields[3], 1, 12);
+	_daysOfWeek = _parse_field(fields[4], 0, 7);
+
+	// Sunday can be both 0 and 7
+	if (_daysOfWeek & (1 << 7)) {
+		_daysOfWeek |= 1;
+	}
+
+	_anyDayOfMonth = fields[2] == "*";
+	_anyDayOfWeek = fields[4] == "*";
+}
+
+const std::string& CronSchedule::getExpression() const
+{
+	return _expression;
+}
+
+std::chrono::system_clock::time_point CronSchedule::next(std::chrono::system_clock::time_point after) const
+{
+	std::time_t afterTime = std::chrono::system_clock::to_time_t(after);
+	std::tm candidate;
+	localtime_r(&afterTime, &candidate);
+
+	// Start from the beginning of the next minute
+	candidate.tm_sec = 0;
+	candidate.tm_min += 1;
+
+	auto normalize = [&candidate] {
+		candidate.tm_isdst = -1;
+		return std::mktime(&candidate);
+	};
+	normalize();
+
+	// Four years of non matching days is enough to say the schedule never matches
+	for (int i = 0; i < 4 * 366 * 24; ++i) {
+		if (!(_months & ((uint64_t)1 << (candidate.tm_mon + 1)))) {
+			candidate.tm_mon += 1;
+			candidate.tm_mday = 1;
+			candidate.tm_hour = 0;
+			candidate.tm_min = 0;
+			normalize();
+			continue;
+		}
+
+		// When both day fields are restricted, matching any of them is enough (standard cron behaviour)
+		bool domMatch = _daysOfMonth & ((uint64_t)1 << candidate.tm_mday);
+		bool dowMatch = _daysOfWeek & ((uint64_t)1 << candidate.tm_wday);
+		bool dayMatch = _anyDayOfMonth || _anyDayOfWeek ? domMatch && dowMatch : domMatch || dowMatch;
+		if (!dayMatch) {
+			candidate.tm_mday += 1;
+			candidate.tm_hour = 0;
+			candidate.tm_min = 0;
+			normalize();
+			continue;
+		}
+
+		if (!(_hours & ((uint64_t)1 << candidate.tm_hour))) {
+			candidate.tm_hour += 1;
+			candidate.tm_min = 0;
+			normalize();
+			continue;
+		}
+
+		if (!(_minutes & ((uint64_t)1 << candidate.tm_min))) {
+			candidate.tm_min += 1;
+			normalize();
+			continue;
+		}
+
+		return std::chrono::system_clock::from_time_t(normalize());
+	}
+
+	console->warn("CronSchedule::next : expression '{}' never matches.", _expression.c_str());
+
+	return std::chrono::system_clock::time_point::max();
+}
+
+uint64_t CronSchedule::_parse_field(const std::string& field, int min, int max)
+{
+	uint64_t mask = 0;
+	std::istringstream itemStream(field);
+	std::string item;
+
+	while (std::getline(itemStream, item, ',')) {
+		int first = min;
+		int last = max;
+		int step = 1;
+
+		try {
+			size_t stepPos = item.find('/');
+			std::string range = item.substr(0, stepPos);
+			if (stepPos != std::string::npos) {
+				step = std::stoi(item.substr(stepPos + 1));
+			}
+
+			if (range != "*") {
+				size_t rangePos = range.find('-');
+				first = std::stoi(range.substr(0, rangePos));
+				last = rangePos != std::string::npos ? std::stoi(range.substr(rangePos + 1))
+					: stepPos != std::string::npos ? max : first;
+			}
+		}
+		catch (std::exception& e) {
+			console->error("CronSchedule::_parse_field : could not parse field '{}' : {}", field.c_str(), e.what());
+			throw domotic_pi_exception("Cron expression field not valid.");
+		}
+
+		if (first < min || last > max || first > last || step < 1) {
+			console->error("CronSchedule::_parse_field : field '{}' out of range {}-{}.", field.c_str(), min, max);
+			throw domotic_pi_exception("Cron expression field out of range.");
+		}
+
+		for (int value = first; value <= last; value += step) {
+			mask |= (uint64_t)1 << value;
+		}
+	}
+
+	if (mask == 0) {
+		console->error("CronSchedule::_parse_field : empty field in cron expression.");
+		throw domotic_pi_exception("Cron expression field not valid.");
+	}
+
+	return mask;
+}
@@ -1,12 +1,13 @@
 #include <DigitalButton.h>
 
+#include <Clock.h>
 #include <domoticPi.h>
 #include <exceptions.h>
 
+#include <algorithm>
 #include <exception>
 #include <rapidjson/stringbuffer.h>
 #include <stdexcept>
-#include <wiringPi.h>
 
 using namespace domotic_pi;
 
@@ -18,26 +19,38 @@ DigitalButton::DigitalButton(
 	int pinNumber, 
 	int pud,
 	const std::chrono::milliseconds doublePressDuration,
-	const std::chrono::milliseconds longPressDuration) :
-	Pin(pinNumber), 
+	const std::chrono::milliseconds longPressDuration,
+	unsigned int chip) :
+	Pin(pinNumber, id, pud != pull_off ? pin_cap_pull : pin_cap_none, chip), 
 	IInput(id), 
 	IButtonStateGenerator(doublePressDuration, longPressDuration), 
-	_pud(pud), _isr_mode(INT_EDGE_NONE)
+	_pud(pud), _isr_mode(edge_none),
+	_timerWheel(TimerWheel::load()),
+	_stormRate(DOMOTIC_PI_STORM_RATE),
+	_stormPollInterval(std::chrono::milliseconds(DOMOTIC_PI_STORM_POLL_MS)),
+	_stormCalmPeriod(std::chrono::milliseconds(DOMOTIC_PI_STORM_CALM_MS)),
+	_stormTokens(DOMOTIC_PI_STORM_RATE), _stormRefill(Clock::now()),
+	_polling(false), _interruptsMuted(false), _polledLevel(0),
+	_pollingSwitches(0), _interruptSwitches(0), _pollingTimeMs(0)
 {
 	if (pinNumber < 0) {
 		console->error("DigitalButton::ctor : pin number must be a valid pin for a digital input.");
 		throw std::out_of_range("Pin number must be between 0 and " STR(DOMOTIC_PI_MAX_PIN) ".");
 	}
 
-	pinMode(pinNumber, INPUT);
+	_gpio->setMode(pinNumber, gpio_input);
 	console->info("DigitalButton::ctor : pin {} set to INPUT mode.", pinNumber);
 
 	// Set required pull up/down mode
-	pullUpDnControl(pinNumber, pud);
+	_gpio->setPull(pinNumber, (GpioPull)pud);
 
 	console->info("DigitalButton::ctor : pin {} set as digital input with pud '{}'.", 
 		pinNumber, pud);
 
+	_pollTimer = _timerWheel->newTimer([this] {
+		_poll_expired();
+	});
+
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
 	_ahkAccessory = std::make_shared<hap::Accessory>();
 
@@ -62,28 +75,45 @@ DigitalButton::~DigitalButton()
 {
 	//	Disable interrupt if needed
 	try {
-		setISRMode(INT_EDGE_NONE);
+		setISRMode(edge_none);
 	}
 	catch (domotic_pi_exception& dpe) {
 		console->error("DigitalButton::dtor : error clearing ISR calls : {}", dpe.what());
 	}
+
+	_timerWheel->cancel(_pollTimer);
+
+	if (_sampler != nullptr) {
+		_sampler->removePin(getPin());
+	}
 }
 
-void DigitalButton::input_ISR()
+void DigitalButton::input_ISR(int value, Timestamp timestamp)
 {
-	console->info("DigitalButton::input_ISR : ISR call execution for input '{}'.", getID().c_str());
+	console->debug("DigitalButton::input_ISR : ISR call execution for input '{}'.", getID().c_str());
 
-	if (_isr_mode == INT_EDGE_NONE) {
+	if (_isr_mode == edge_none || (_sampler == nullptr && !_storm_allows(timestamp))) {
 		return;
 	}
 
+	_edge(value, timestamp);
+}
+
+void DigitalButton::_edge(int value, Timestamp timestamp)
+{
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
 	_stateInfo->setValue(0);
 #endif // DOMOTIC_PI_APPLE_HOMEKIT
 
-	buttonStateChange();
+	// Press and release are known only when both edges are notified, the button rests at its pull level
+	if (_isr_mode == edge_both) {
+		buttonEdge(value != (_pud == pull_up ? 1 : 0), timestamp);
+	}
+	else {
+		buttonStateChange(timestamp);
+	}
 
-	valueChanged(_isr_mode == INT_EDGE_BOTH ? getValue() : _isr_mode == INT_EDGE_RISING ? 1 : 0);
+	valueChanged(value, timestamp);
 }
 
 void DigitalButton::setISRMode(int isr_mode)
@@ -98,13 +128,34 @@ void DigitalButton::setISRMode(int isr_mode)
 	std::unique_lock<std::mutex> lck(_isrMode);
 #endif
 
+	{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+		std::unique_lock<std::mutex> stormLock(_stormLock);
+#endif
+
+		// While sampling, interrupts are restored with the new mode once the storm is over
+		if (_polling && isr_mode != edge_none) {
+			_isr_mode = isr_mode;
+			return;
+		}
+
+		if (_polling) {
+			_polling = false;
+			_interruptsMuted = false;
+			_pollingTimeMs += std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - _pollingSince).count();
+		}
+	}
+
+	_timerWheel->cancel(_pollTimer);
+
 	int retval;
 
 	// When switching from disabled to enabled bind instance function
-	if (_isr_mode == INT_EDGE_NONE)
-		retval = wiringPiISR(getPin(), isr_mode, std::bind(&DigitalButton::input_ISR, this));
+	if (_isr_mode == edge_none)
+		retval = _set_edge_callback((GpioEdge)isr_mode, 
+			std::bind(&DigitalButton::input_ISR, this, std::placeholders::_1, std::placeholders::_2));
 	else	// Else change isr mode only
-		retval = wiringPiISR(getPin(), isr_mode, nullptr);
+		retval = _set_edge_callback((GpioEdge)isr_mode, nullptr);
 
 	if (retval) {
 		console->error("DigitalButton::setISRMode : error while changing ISR mode for input '{}' "
@@ -120,7 +171,236 @@ void DigitalButton::setISRMode(int isr_mode)
 
 int DigitalButton::getValue() const
 {
-	return digitalRead(getPin());
+	if (_sampler != nullptr) {
+		return _sampler->getLevel(getPin());
+	}
+
+	return _gpio->read(getPin());
+}
+
+void DigitalButton::setSampled(bool sampled)
+{
+	if (sampled == (_sampler != nullptr)) {
+		return;
+	}
+
+	// Edges are moved from the current source to the new one with the same mode
+	int isr_mode = _isr_mode;
+	setISRMode(edge_none);
+
+	if (sampled) {
+		_sampler = BankSampler::load(getChip());
+		_sampler->addPin(getPin());
+	}
+	else {
+		_sampler->removePin(getPin());
+		_sampler = nullptr;
+	}
+
+	setISRMode(isr_mode);
+
+	console->info("DigitalButton::setSampled : input '{}' edges detected by {}.", getID().c_str(),
+		sampled ? "bank sampling" : "interrupts");
+}
+
+bool DigitalButton::isSampled() const
+{
+	return _sampler != nullptr;
+}
+
+int DigitalButton::_set_edge_callback(GpioEdge edge, GpioEdgeCallback callback)
+{
+	if (_sampler != nullptr) {
+		return _sampler->setEdgeCallback(getPin(), edge, callback);
+	}
+
+	return _gpio->setEdgeCallback(getPin(), edge, callback);
+}
+
+void DigitalButton::setStormGuard(double rate, std::chrono::milliseconds pollInterval, std::chrono::milliseconds calmPeriod)
+{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> lock(_stormLock);
+#endif
+
+	_stormRate = rate > 0 ? rate : 0;
+	_stormPollInterval = std::max(pollInterval, std::chrono::milliseconds(DOMOTIC_PI_TIMER_TICK_MS));
+	_stormCalmPeriod = std::max(calmPeriod, _stormPollInterval);
+	_stormTokens = std::max(1.0, _stormRate);
+}
+
+double DigitalButton::getStormRate() const
+{
+	return _stormRate;
+}
+
+std::chrono::milliseconds DigitalButton::getStormPollInterval() const
+{
+	return _stormPollInterval;
+}
+
+std::chrono::milliseconds DigitalButton::getStormCalmPeriod() const
+{
+	return _stormCalmPeriod;
+}
+
+bool DigitalButton::isPolling() const
+{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> lock(_stormLock);
+#endif
+
+	return _polling;
+}
+
+uint64_t DigitalButton::getPollingSwitchCount() const
+{
+	return _pollingSwitches.load(std::memory_order_relaxed);
+}
+
+uint64_t DigitalButton::getInterruptSwitchCount() const
+{
+	return _interruptSwitches.load(std::memory_order_relaxed);
+}
+
+std::chrono::milliseconds DigitalButton::getPollingTime() const
+{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> lock(_stormLock);
+#endif
+
+	uint64_t pollingTimeMs = _pollingTimeMs;
+	if (_polling) {
+		pollingTimeMs += std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - _pollingSince).count();
+	}
+
+	return std::chrono::milliseconds(pollingTimeMs);
+}
+
+rapidjson::Document DigitalButton::stats_to_json() const
+{
+	rapidjson::Document stats = IInput::stats_to_json();
+
+	rapidjson::Value stormGuard(rapidjson::kObjectType);
+	stormGuard.AddMember("polling", isPolling(), stats.GetAllocator());
+	stormGuard.AddMember("to_polling", getPollingSwitchCount(), stats.GetAllocator());
+	stormGuard.AddMember("to_interrupts", getInterruptSwitchCount(), stats.GetAllocator());
+	stormGuard.AddMember("polling_ms", (uint64_t)getPollingTime().count(), stats.GetAllocator());
+	stats.AddMember("stormGuard", stormGuard, stats.GetAllocator());
+
+	return stats;
+}
+
+bool DigitalButton::_storm_allows(Timestamp timestamp)
+{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> lock(_stormLock);
+#endif
+
+	// Interrupts already queued when sampling started are discarded, the sampler sees the level
+	if (_polling) {
+		return false;
+	}
+
+	if (_stormRate == 0) {
+		return true;
+	}
+
+	// Token bucket holding one second of edges at maximum rate, and at least
+	// one edge so that rates below one per second can ever be reached
+	if (timestamp > _stormRefill) {
+		_stormTokens = std::min(std::max(1.0, _stormRate),
+			_stormTokens + std::chrono::duration<double>(timestamp - _stormRefill).count() * _stormRate);
+		_stormRefill = timestamp;
+	}
+
+	if (_stormTokens >= 1) {
+		_stormTokens -= 1;
+		return true;
+	}
+
+	// Edge storm : sample the pin until it calms down, interrupts being disabled by the
+	// first sample since backends cannot change them from their edge callbacks
+	_polling = true;
+	_pollingSince = Clock::now();
+	_lastPolledChange = _pollingSince;
+	_polledLevel = _gpio->read(getPin());
+	_pollingSwitches.fetch_add(1, std::memory_order_relaxed);
+
+	_timerWheel->arm(_pollTimer, std::chrono::milliseconds::zero());
+
+	console->warn("DigitalButton::_storm_allows : edges on input '{}' above {} per second, "
+		"pin {} sampled every {} ms until quiet for {} ms.", getID().c_str(), _stormRate, getPin(),
+		(long long)_stormPollInterval.count(), (long long)_stormCalmPeriod.count());
+
+	return false;
+}
+
+void DigitalButton::_poll_expired()
+{
+	Timestamp now = Clock::now();
+	int level = _gpio->read(getPin());
+	bool changed = false;
+	bool mute = false;
+	bool restore = false;
+	int isrMode;
+
+	{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+		std::unique_lock<std::mutex> lock(_stormLock);
+#endif
+
+		if (!_polling) {
+			return;
+		}
+
+		isrMode = _isr_mode;
+
+		if (!_interruptsMuted) {
+			_interruptsMuted = true;
+			mute = true;
+		}
+
+		if (level != _polledLevel) {
+			_polledLevel = level;
+			_lastPolledChange = now;
+			changed = true;
+		}
+
+		if (now - _lastPolledChange >= _stormCalmPeriod) {
+			// Quiet again : back to interrupts with a full bucket
+			_polling = false;
+			_pollingTimeMs += std::chrono::duration_cast<std::chrono::milliseconds>(now - _pollingSince).count();
+			_stormTokens = std::max(1.0, _stormRate);
+			_stormRefill = now;
+			_interruptsMuted = false;
+			_interruptSwitches.fetch_add(1, std::memory_order_relaxed);
+			restore = true;
+		}
+		else {
+			_timerWheel->arm(_pollTimer, _stormPollInterval);
+		}
+	}
+
+	if (mute && _gpio->setEdgeCallback(getPin(), edge_none, nullptr)) {
+		console->error("DigitalButton::_poll_expired : could not disable interrupts for input '{}'.", getID().c_str());
+	}
+
+	// Sampled changes are notified as the edges the interrupt mode would have reported,
+	// before interrupts are back so the edge callback and the sampler never notify concurrently
+	if (changed && (isrMode == edge_both || (isrMode == edge_rising && level) || (isrMode == edge_falling && !level))) {
+		_edge(level, now);
+	}
+
+	if (restore) {
+		// Callback has been dropped with the interrupts
+		if (_gpio->setEdgeCallback(getPin(), (GpioEdge)isrMode,
+			std::bind(&DigitalButton::input_ISR, this, std::placeholders::_1, std::placeholders::_2))) {
+			console->error("DigitalButton::_poll_expired : could not restore interrupts for input '{}'.", getID().c_str());
+		}
+
+		console->warn("DigitalButton::_poll_expired : input '{}' quiet again, back to interrupts.", getID().c_str());
+	}
 }
 
 std::shared_ptr<DigitalButton> DigitalButton::from_json(const rapidjson::Value& config, DomoticNode_ptr parentNode)
@@ -132,9 +412,24 @@ std::shared_ptr<DigitalButton> DigitalButton::from_json(const rapidjson::Value&
 		config["pin"].GetInt(),
 		config["pud"].GetInt(),
 		std::get<0>(durations),
-		std::get<1>(durations));
+		std::get<1>(durations),
+		config.HasMember("chip") ? config["chip"].GetUint() : 0);
+
+	if (config.HasMember("sampled")) {
+		digitalInput->setSampled(config["sampled"].GetBool());
+	}
+
+	if (config.HasMember("stormGuard")) {
+		const rapidjson::Value& stormGuard = config["stormGuard"];
+		digitalInput->setStormGuard(stormGuard["rate"].GetDouble(),
+			std::chrono::milliseconds(stormGuard.HasMember("pollInterval") ? 
+				stormGuard["pollInterval"].GetInt() : DOMOTIC_PI_STORM_POLL_MS),
+			std::chrono::milliseconds(stormGuard.HasMember("calmPeriod") ? 
+				stormGuard["calmPeriod"].GetInt() : DOMOTIC_PI_STORM_CALM_MS));
+	}
 
 	digitalInput->setISRMode(config["isr_mode"].GetInt());
+	IButtonStateGenerator::from_json(config, *digitalInput);
 
 	// Set IInput base class attributes
 	IInput::from_json<DigitalButton>(config, digitalInput, parentNode);
@@ -157,8 +452,25 @@ rapidjson::Document DigitalButton::to_json() const
 	input.AddMember("type", "DigitalButton", input.GetAllocator());
 
 	input.AddMember("pin", _pin, input.GetAllocator());
+	if (_chip != 0) {
+		input.AddMember("chip", _chip, input.GetAllocator());
+	}
 	input.AddMember("pud", _pud, input.GetAllocator());
 	input.AddMember("isr_mode", _isr_mode, input.GetAllocator());
 
+	if (_sampler != nullptr) {
+		input.AddMember("sampled", true, input.GetAllocator());
+	}
+
+	if (_stormRate != DOMOTIC_PI_STORM_RATE 
+		|| _stormPollInterval != std::chrono::milliseconds(DOMOTIC_PI_STORM_POLL_MS)
+		|| _stormCalmPeriod != std::chrono::milliseconds(DOMOTIC_PI_STORM_CALM_MS)) {
+		rapidjson::Value stormGuard(rapidjson::kObjectType);
+		stormGuard.AddMember("rate", _stormRate, input.GetAllocator());
+		stormGuard.AddMember("pollInterval", (int64_t)_stormPollInterval.count(), input.GetAllocator());
+		stormGuard.AddMember("calmPeriod", (int64_t)_stormCalmPeriod.count(), input.GetAllocator());
+		input.AddMember("stormGuard", stormGuard, input.GetAllocator());
+	}
+
 	return input;
 }
\ No newline at end of file
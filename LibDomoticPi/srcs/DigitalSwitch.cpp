@@ -1,24 +1,24 @@
 #include <DigitalSwitch.h>
 
 #include <domoticPi.h>
+#include <GpioWriteBatch.h>
 
 #include <stdexcept>
-#include <wiringPi.h>
 
 using namespace domotic_pi;
 
 const bool DigitalSwitch::_factoryRegistration =
 	OutputFactory::initializer_registration("DigitalSwitch", DigitalSwitch::from_json);
 
-DigitalSwitch::DigitalSwitch(const std::string& id, int pinNumber) 
-	: Pin(pinNumber), IOutput(id)
+DigitalSwitch::DigitalSwitch(const std::string& id, int pinNumber, unsigned int chip) 
+	: Pin(pinNumber, id, pin_cap_none, chip), IOutput(id)
 {
 	if (pinNumber < 0) {
 		console->error("DigitalSwitch::ctor : pin number must be a valid pin for a digital output.");
 		throw std::out_of_range("Pin number must be between 0 and " STR(DOMOTIC_PI_MAX_PIN) ".");
 	}
 
-	pinMode(pinNumber, OUTPUT);
+	_gpio->setMode(pinNumber, gpio_output);
 	console->info("DigitalSwitch::ctor : pin {} set to OUTPUT mode.", pinNumber);
 
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
@@ -44,7 +44,7 @@ DigitalSwitch::~DigitalSwitch()
 {
 }
 
-void DigitalSwitch::setState(OutState newState)
+void DigitalSwitch::setState(OutState newState, Timestamp timestamp)
 {
 #ifdef DOMOTIC_PI_THREAD_SAFE
 	std::unique_lock<std::mutex> lck(_valueLock);
@@ -52,7 +52,9 @@ void DigitalSwitch::setState(OutState newState)
 
 	_value = newState == TOGGLE ? !_value : newState;
 
-	digitalWrite(getPin(), _value);
+	_write_pin();
+
+	_trace_command(timestamp);
 
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
 	_stateInfo->setValue(_value);
@@ -61,7 +63,7 @@ void DigitalSwitch::setState(OutState newState)
 	console->info("DigitalSwitch::setState : output '{}' set to '{}'.", getID(), _value);
 }
 
-void DigitalSwitch::setValue(int newValue)
+void DigitalSwitch::setValue(int newValue, Timestamp timestamp)
 {
 	if (newValue < 0)
 		newValue = 0;
@@ -72,7 +74,9 @@ void DigitalSwitch::setValue(int newValue)
 
 	_value = newValue;
 
-	digitalWrite(getPin(), _value);
+	_write_pin();
+
+	_trace_command(timestamp);
 
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
 	_stateInfo->setValue(_value);
@@ -81,11 +85,20 @@ void DigitalSwitch::setValue(int newValue)
 	console->info("DigitalSwitch::setValue : output '{}' set to '{}'.", getID(), _value);
 }
 
+void DigitalSwitch::_write_pin()
+{
+	// Pins switched by the same event are written together
+	if (!GpioWriteBatch::stage(_gpio, getPin(), _value)) {
+		_gpio->write(getPin(), _value);
+	}
+}
+
 std::shared_ptr<DigitalSwitch> DigitalSwitch::from_json(const rapidjson::Value& config, DomoticNode_ptr parentNode)
 {
 	return std::make_shared<DigitalSwitch>(
 		config["id"].GetString(),
-		config["pin"].GetInt());
+		config["pin"].GetInt(),
+		config.HasMember("chip") ? config["chip"].GetUint() : 0);
 }
 
 rapidjson::Document DigitalSwitch::to_json() const
@@ -97,6 +110,9 @@ rapidjson::Document DigitalSwitch::to_json() const
 	output.AddMember("type", "DigitalSwitch", output.GetAllocator());
 
 	output.AddMember("pin", _pin, output.GetAllocator());
+	if (_chip != 0) {
+		output.AddMember("chip", _chip, output.GetAllocator());
+	}
 
 	return output;
 }
\ No newline at end of file
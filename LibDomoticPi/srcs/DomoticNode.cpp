@@ -1,11 +1,14 @@
 #include <DomoticNode.h>
 
 #include <domoticPi.h>
+#include <EventDispatcher.h>
+#include <EventGraph.h>
 #include <exceptions.h>
 #include <IInput.h>
 #include <InputFactory.h>
 #include <IOutput.h>
 #include <OutputFactory.h>
+#include <OutputTimers.h>
 #include <SerialInterface.h>
 
 #include <algorithm>
@@ -80,6 +83,17 @@ DomoticNode_ptr DomoticNode::from_json(const rapidjson::Value& config, bool chec
 	if (config.HasMember("name"))
 		domoticNode->setName(config["name"].GetString());
 
+	// Report feedback loops among inputs, events, outputs and topics
+	for (auto& cycle : EventGraph(*domoticNode).findCycles()) {
+		std::string cyclePath;
+		for (auto& vertex : cycle) {
+			cyclePath += cyclePath.empty() ? vertex : " -> " + vertex;
+		}
+
+		console->warn("DomoticNode::from_json : feedback loop detected in node '{}' : {}",
+			domoticNode->getID().c_str(), cyclePath.c_str());
+	}
+
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
 	// Enable Apple HomeKit if required
 	if (config.HasMember("homekit")) {
@@ -218,25 +232,30 @@ const std::vector<Output_ptr>& DomoticNode::getOutputs() const
 
 bool DomoticNode::addOutput(Output_ptr output)
 {
+	{
 #ifdef DOMOTIC_PI_THREAD_SAFE
-	std::unique_lock<std::shared_mutex> lock(_outputsLock);
+		std::unique_lock<std::shared_mutex> lock(_outputsLock);
 #endif // DOMOTIC_PI_THREAD_SAFE
 
-	// Search for conflicting id in present outputs
-	auto it = std::find_if(_outputs.begin(), _outputs.end(),
-		[output](const Output_ptr& o) { return output->getID() == o->getID(); });
+		// Search for conflicting id in present outputs
+		auto it = std::find_if(_outputs.begin(), _outputs.end(),
+			[output](const Output_ptr& o) { return output->getID() == o->getID(); });
 
-	// If conflict exists return immediately
-	if (it != _outputs.end())
-		return false;
+		// If conflict exists return immediately
+		if (it != _outputs.end())
+			return false;
 
-	_outputs.push_back(output);
+		_outputs.push_back(output);
 
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
-	if(output->hasAHKAccessory()) {
-		hap::AccessorySet::getInstance().addAccessory(output->getAHKAccessory());
-	}
+		if(output->hasAHKAccessory()) {
+			hap::AccessorySet::getInstance().addAccessory(output->getAHKAccessory());
+		}
 #endif
+	}
+
+	// Take over timed actions left running by a previous output with the same id
+	OutputTimers::load()->attach(output);
 
 	return true;
 }
@@ -375,6 +394,76 @@ void DomoticNode::removeProgrammedEvent(const std::string& id)
 	});
 }
 
+rapidjson::Document DomoticNode::stats_to_json() const
+{
+	rapidjson::Document stats(rapidjson::kObjectType);
+
+	// Changes filtered out before dispatching events and input specific counters, per input
+	rapidjson::Value inputs(rapidjson::kObjectType);
+	{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+		std::shared_lock<std::shared_mutex> lock(_inputsLock);
+#endif // DOMOTIC_PI_THREAD_SAFE
+
+		for (auto& it : _inputs) {
+			rapidjson::Value id;
+			id.SetString(it->getID().c_str(), stats.GetAllocator());
+
+			rapidjson::Value inputStats(it->stats_to_json(), stats.GetAllocator());
+
+			inputs.AddMember(id, inputStats, stats.GetAllocator());
+		}
+	}
+	stats.AddMember("inputs", inputs, stats.GetAllocator());
+
+	// Trigger source to immediate actions performed and circuit breaker state, per programmed event
+	rapidjson::Value programmedEvents(rapidjson::kObjectType);
+	{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+		std::shared_lock<std::shared_mutex> lock(_programmedEventsLock);
+#endif // DOMOTIC_PI_THREAD_SAFE
+
+		for (auto& it : _programmedEvents) {
+			rapidjson::Value id;
+			id.SetString(it->getID().c_str(), stats.GetAllocator());
+
+			rapidjson::Value eventStats(rapidjson::kObjectType);
+			rapidjson::Value eventLatency(it->getLatency().to_json(), stats.GetAllocator());
+			eventStats.AddMember("latency", eventLatency, stats.GetAllocator());
+			eventStats.AddMember("suspended", it->isSuspended(), stats.GetAllocator());
+			eventStats.AddMember("trips", it->getTripCount(), stats.GetAllocator());
+			eventStats.AddMember("discarded", it->getDiscardedCount(), stats.GetAllocator());
+
+			programmedEvents.AddMember(id, eventStats, stats.GetAllocator());
+		}
+	}
+	stats.AddMember("programmedEvents", programmedEvents, stats.GetAllocator());
+
+	// Trigger source to command sent, command to feedback received and output specific statistics, per output
+	rapidjson::Value outputs(rapidjson::kObjectType);
+	{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+		std::shared_lock<std::shared_mutex> lock(_outputsLock);
+#endif // DOMOTIC_PI_THREAD_SAFE
+
+		for (auto& it : _outputs) {
+			rapidjson::Value id;
+			id.SetString(it->getID().c_str(), stats.GetAllocator());
+
+			rapidjson::Value outputStats(it->stats_to_json(), stats.GetAllocator());
+
+			outputs.AddMember(id, outputStats, stats.GetAllocator());
+		}
+	}
+	stats.AddMember("outputs", outputs, stats.GetAllocator());
+
+	// Queue depth and trigger source to event start latency, per dispatch priority
+	rapidjson::Value dispatch(EventDispatcher::load()->stats_to_json(), stats.GetAllocator());
+	stats.AddMember("dispatch", dispatch, stats.GetAllocator());
+
+	return stats;
+}
+
 rapidjson::Document DomoticNode::to_json() const
 {
 	console->debug("DomoticNode::to_json : serializing node '{}'.", _id.c_str());
@@ -0,0 +1,190 @@
+#include <EventDispatcher.h>
+
+#include <Clock.h>
+#include <domoticPi.h>
+#include <exceptions.h>
+
+#include <exception>
+
+using namespace domotic_pi;
+
+std::shared_ptr<EventDispatcher> EventDispatcher::_eventDispatcher;
+
+static const char * priorityNames[EventDispatcher::priorityCount] = { "safety", "high", "normal", "low" };
+
+EventDispatcher::EventDispatcher()
+	: _maxDepth(), _dispatchRunning(true)
+{
+	// On a virtual clock queued events are run by the clock owner through drain
+	if (!Clock::isVirtual()) {
+		_dispatchThread = std::thread(&EventDispatcher::_dispatch_loop, this);
+	}
+
+	console->debug("EventDispatcher::ctor : event dispatcher started.");
+}
+
+EventDispatcher::~EventDispatcher()
+{
+	std::unique_lock<std::mutex> lock(_queueLock);
+	_dispatchRunning = false;
+	_queueChange.notify_all();
+	lock.unlock();
+
+	if (_dispatchThread.joinable()) {
+		_dispatchThread.join();
+	}
+
+	console->debug("EventDispatcher::dtor : event dispatcher stopped.");
+}
+
+const std::shared_ptr<EventDispatcher> EventDispatcher::load()
+{
+	if (_eventDispatcher == nullptr) {
+		_eventDispatcher = std::make_shared<EventDispatcher>();
+	}
+
+	return _eventDispatcher;
+}
+
+void EventDispatcher::dispatch(const std::shared_ptr<ProgrammedEvent>& programmedEvent, Timestamp timestamp)
+{
+	if (programmedEvent == nullptr) {
+		return;
+	}
+
+	EventPriority priority = programmedEvent->getPriority();
+
+	std::unique_lock<std::mutex> lock(_queueLock);
+
+	auto& queue = _queues[priority];
+	queue.push_back(Dispatch{ programmedEvent, timestamp });
+
+	if (queue.size() > _maxDepth[priority]) {
+		_maxDepth[priority] = queue.size();
+	}
+
+	_queueChange.notify_all();
+}
+
+size_t EventDispatcher::drain()
+{
+	size_t count = 0;
+
+	Dispatch dispatch;
+	EventPriority priority;
+
+	std::unique_lock<std::mutex> lock(_queueLock);
+	while (_pop(dispatch, priority)) {
+		lock.unlock();
+		_run(dispatch, priority);
+		++count;
+		lock.lock();
+	}
+
+	return count;
+}
+
+size_t EventDispatcher::getQueueDepth(EventPriority priority) const
+{
+	std::unique_lock<std::mutex> lock(_queueLock);
+
+	return _queues[priority].size();
+}
+
+size_t EventDispatcher::getMaxQueueDepth(EventPriority priority) const
+{
+	std::unique_lock<std::mutex> lock(_queueLock);
+
+	return _maxDepth[priority];
+}
+
+const LatencyHistogram& EventDispatcher::getLatency(EventPriority priority) const
+{
+	return _latency[priority];
+}
+
+const char * EventDispatcher::getPriorityName(EventPriority priority)
+{
+	return priorityNames[priority];
+}
+
+EventPriority EventDispatcher::getPriority(const std::string& priorityName)
+{
+	for (size_t priority = 0; priority < priorityCount; ++priority) {
+		if (priorityName == priorityNames[priority]) {
+			return (EventPriority)priority;
+		}
+	}
+
+	console->error("EventDispatcher::getPriority : '{}' is not a valid event priority.", priorityName.c_str());
+	throw domotic_pi_exception("Not valid event priority.");
+}
+
+rapidjson::Document EventDispatcher::stats_to_json() const
+{
+	rapidjson::Document stats(rapidjson::kObjectType);
+
+	for (size_t priority = 0; priority < priorityCount; ++priority) {
+		rapidjson::Value priorityStats(rapidjson::kObjectType);
+		priorityStats.AddMember("depth", (uint64_t)getQueueDepth((EventPriority)priority), stats.GetAllocator());
+		priorityStats.AddMember("maxDepth", (uint64_t)getMaxQueueDepth((EventPriority)priority), stats.GetAllocator());
+
+		rapidjson::Value latency(_latency[priority].to_json(), stats.GetAllocator());
+		priorityStats.AddMember("latency", latency, stats.GetAllocator());
+
+		stats.AddMember(rapidjson::StringRef(priorityNames[priority]), priorityStats, stats.GetAllocator());
+	}
+
+	return stats;
+}
+
+void EventDispatcher::_dispatch_loop()
+{
+	Dispatch dispatch;
+	EventPriority priority;
+
+	std::unique_lock<std::mutex> lock(_queueLock);
+
+	while (_dispatchRunning) {
+		if (!_pop(dispatch, priority)) {
+			_queueChange.wait(lock);
+			continue;
+		}
+
+		lock.unlock();
+		_run(dispatch, priority);
+		lock.lock();
+	}
+}
+
+bool EventDispatcher::_pop(Dispatch& dispatch, EventPriority& priority)
+{
+	for (size_t it = 0; it < priorityCount; ++it) {
+		if (!_queues[it].empty()) {
+			dispatch = std::move(_queues[it].front());
+			_queues[it].pop_front();
+			priority = (EventPriority)it;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void EventDispatcher::_run(const Dispatch& dispatch, EventPriority priority)
+{
+	auto programmedEvent = dispatch.programmedEvent.lock();
+	if (programmedEvent == nullptr) {
+		return;
+	}
+
+	_latency[priority].recordSince(dispatch.timestamp);
+
+	try {
+		programmedEvent->triggerEvent(dispatch.timestamp);
+	}
+	catch (std::exception& e) {
+		console->warn("EventDispatcher::_run : exception during programmed event {} call : {}",
+			programmedEvent->getID().c_str(), e.what());
+	}
+}
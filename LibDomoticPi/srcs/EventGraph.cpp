@@ -0,0 +1,158 @@
+#include <EventGraph.h>
+
+#include <DomoticNode.h>
+#include <IComm.h>
+#include <IInput.h>
+#include <IOutput.h>
+
+#include <algorithm>
+#include <functional>
+
+using namespace domotic_pi;
+
+EventGraph::EventGraph(const DomoticNode& node)
+{
+	// Inputs trigger their bound events
+	for (auto& input : node.getInputs()) {
+		size_t inputVertex = _vertex("input '" + input->getID() + "'");
+
+		for (auto& programmedEvent : input->getProgrammedEvents()) {
+			_edge(inputVertex, _vertex("event '" + programmedEvent->getID() + "'"));
+		}
+	}
+
+	// Inputs taking part in chords and sequences trigger their events too
+	for (auto& programmedEvent : node.getProgrammedEvents()) {
+		size_t eventVertex = _vertex("event '" + programmedEvent->getID() + "'");
+
+		for (auto& pattern : programmedEvent->getPatterns()) {
+			for (auto& step : pattern->getSteps()) {
+				_edge(_vertex("input '" + step.inputId + "'"), eventVertex);
+			}
+		}
+	}
+
+	// Events set their outputs
+	for (auto& programmedEvent : node.getProgrammedEvents()) {
+		size_t eventVertex = _vertex("event '" + programmedEvent->getID() + "'");
+
+		for (auto& output : programmedEvent->getOutputs()) {
+			_edge(eventVertex, _vertex("output '" + output->getID() + "'"));
+		}
+	}
+
+	// Outputs produce topics, which reach inputs listening on the same comm interface
+	for (auto& output : node.getOutputs()) {
+		size_t outputVertex = _vertex("output '" + output->getID() + "'");
+
+		for (auto& produced : output->getProducedTopics()) {
+			size_t topicVertex = _vertex("topic '" + produced.first->getID() + ":" + produced.second + "'");
+			_edge(outputVertex, topicVertex);
+
+			for (auto& input : node.getInputs()) {
+				for (auto& listened : input->getListenedTopics()) {
+					if (listened.first == produced.first && topicMatches(listened.second, produced.second)) {
+						_edge(topicVertex, _vertex("input '" + input->getID() + "'"));
+					}
+				}
+			}
+		}
+	}
+}
+
+size_t EventGraph::getVertexCount() const
+{
+	return _vertices.size();
+}
+
+std::vector<std::vector<std::string>> EventGraph::findCycles() const
+{
+	enum Color { WHITE, GRAY, BLACK };
+
+	std::vector<std::vector<std::string>> cycles;
+	std::vector<Color> colors(_vertices.size(), WHITE);
+	std::vector<size_t> path;
+
+	std::function<void(size_t)> visit = [&](size_t vertex) {
+		colors[vertex] = GRAY;
+		path.push_back(vertex);
+
+		for (size_t next : _edges[vertex]) {
+			if (colors[next] == WHITE) {
+				visit(next);
+			}
+			else if (colors[next] == GRAY) {
+				// Back edge: the cycle is the path suffix starting at next
+				std::vector<std::string> cycle;
+				for (auto it = std::find(path.begin(), path.end(), next); it != path.end(); ++it) {
+					cycle.push_back(_vertices[*it]);
+				}
+				cycle.push_back(_vertices[next]);
+
+				cycles.push_back(cycle);
+			}
+		}
+
+		path.pop_back();
+		colors[vertex] = BLACK;
+	};
+
+	for (size_t vertex = 0; vertex < _vertices.size(); ++vertex) {
+		if (colors[vertex] == WHITE) {
+			visit(vertex);
+		}
+	}
+
+	return cycles;
+}
+
+bool EventGraph::topicMatches(const std::string& filter, const std::string& topic)
+{
+	size_t filterPos = 0;
+	size_t topicPos = 0;
+
+	while (filterPos <= filter.size()) {
+		size_t filterEnd = std::min(filter.find('/', filterPos), filter.size());
+		std::string filterLevel = filter.substr(filterPos, filterEnd - filterPos);
+
+		// Multi level wildcard matches everything left, parent level included
+		if (filterLevel == "#") {
+			return true;
+		}
+
+		if (topicPos > topic.size()) {
+			return false;
+		}
+
+		size_t topicEnd = std::min(topic.find('/', topicPos), topic.size());
+		if (filterLevel != "+" && filterLevel != topic.substr(topicPos, topicEnd - topicPos)) {
+			return false;
+		}
+
+		filterPos = filterEnd + 1;
+		topicPos = topicEnd + 1;
+	}
+
+	return topicPos > topic.size();
+}
+
+size_t EventGraph::_vertex(const std::string& description)
+{
+	auto it = _vertexIndex.find(description);
+	if (it != _vertexIndex.end()) {
+		return it->second;
+	}
+
+	_vertices.push_back(description);
+	_edges.emplace_back();
+	_vertexIndex[description] = _vertices.size() - 1;
+
+	return _vertices.size() - 1;
+}
+
+void EventGraph::_edge(size_t from, size_t to)
+{
+	if (std::find(_edges[from].begin(), _edges[from].end(), to) == _edges[from].end()) {
+		_edges[from].push_back(to);
+	}
+}
@@ -0,0 +1,379 @@
+#include <GestureRecognizer.h>
+
+#include <Clock.h>
+#include <domoticPi.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace domotic_pi;
+
+namespace {
+
+	// Buttons notified by the calling thread, nested when a callback reports edges on a virtual clock
+	thread_local std::vector<const GestureRecognizer::Button*> notifyingButtons;
+
+}
+
+std::shared_ptr<GestureRecognizer> GestureRecognizer::_gestureRecognizer;
+
+GestureRecognizer::Button::Button(
+	std::chrono::milliseconds multiClickWindow,
+	std::chrono::milliseconds longPressDuration,
+	std::function<void(ButtonState, unsigned int)> notify)
+	: _multiClickWindow(multiClickWindow), _longPressDuration(longPressDuration), _notify(notify),
+	_maxClicks(2), _holdRepeatInterval(std::chrono::milliseconds::zero()),
+	_state(idle_state), _clicks(0), _deadline(Timestamp::max()), _generation(0), _removed(false), _notifying(0)
+{
+}
+
+GestureRecognizer::GestureRecognizer()
+	: _timerWheel(TimerWheel::load()), _armedDeadline(Timestamp::max()), 
+	_wakeupFd(-1), _wakeupPending(false), _edgeRunning(true), _droppedEdges(0)
+{
+	_deadlineTimer = _timerWheel->newTimer([this] {
+		_deadline_expired();
+	});
+
+	// On a virtual clock edges are processed by the reporting thread
+	if (Clock::isVirtual()) {
+		return;
+	}
+
+	_wakeupFd = eventfd(0, EFD_CLOEXEC);
+	if (_wakeupFd < 0) {
+		console->error("GestureRecognizer::ctor : eventfd creation failed ({}), "
+			"edges will be processed on interrupt threads.", strerror(errno));
+		return;
+	}
+
+	_edgeThread = std::thread(&GestureRecognizer::_edge_loop, this);
+}
+
+GestureRecognizer::~GestureRecognizer()
+{
+	_edgeRunning = false;
+
+	if (_edgeThread.joinable()) {
+		uint64_t wakeup = 1;
+		if (write(_wakeupFd, &wakeup, sizeof(wakeup)) < 0) {
+			console->error("GestureRecognizer::dtor : could not wake edge thread ({}).", strerror(errno));
+		}
+
+		_edgeThread.join();
+	}
+
+	if (_wakeupFd >= 0) {
+		close(_wakeupFd);
+	}
+
+	_timerWheel->cancel(_deadlineTimer);
+}
+
+const std::shared_ptr<GestureRecognizer> GestureRecognizer::load()
+{
+	if (_gestureRecognizer == nullptr) {
+		_gestureRecognizer = std::make_shared<GestureRecognizer>();
+	}
+
+	return _gestureRecognizer;
+}
+
+GestureButton_ptr GestureRecognizer::addButton(
+	std::chrono::milliseconds multiClickWindow,
+	std::chrono::milliseconds longPressDuration,
+	std::function<void(ButtonState, unsigned int)> notify)
+{
+	auto button = std::make_shared<Button>(multiClickWindow, longPressDuration, notify);
+
+	std::unique_lock<std::mutex> lock(_recognizerLock);
+	_buttons.push_back(button);
+
+	return button;
+}
+
+void GestureRecognizer::removeButton(const Button_ptr& button)
+{
+	if (button == nullptr) {
+		return;
+	}
+
+	if (button->_removed.exchange(true)) {
+		return;
+	}
+
+	// Pending deadlines of the button are dropped when served
+	std::unique_lock<std::mutex> lock(_recognizerLock);
+	_buttons.remove(button);
+
+	// Notifications of the calling thread are the ones removing the button
+	unsigned int own = (unsigned int)std::count(notifyingButtons.begin(), notifyingButtons.end(), button.get());
+	_notifyDone.wait(lock, [&] { return button->_notifying.load() <= own; });
+}
+
+void GestureRecognizer::configureButton(
+	const Button_ptr& button, 
+	unsigned int maxClicks, 
+	std::chrono::milliseconds holdRepeatInterval)
+{
+	std::unique_lock<std::mutex> lock(_recognizerLock);
+
+	button->_maxClicks = maxClicks > 0 ? maxClicks : 1;
+	button->_holdRepeatInterval = holdRepeatInterval > std::chrono::milliseconds::zero() ? 
+		holdRepeatInterval : std::chrono::milliseconds::zero();
+}
+
+void GestureRecognizer::buttonEdge(const Button_ptr& button, bool pressed, Timestamp timestamp)
+{
+	_capture(button, pressed ? 1 : 0, timestamp);
+}
+
+void GestureRecognizer::buttonClick(const Button_ptr& button, Timestamp timestamp)
+{
+	_capture(button, click_edge, timestamp);
+}
+
+size_t GestureRecognizer::getButtonCount() const
+{
+	std::unique_lock<std::mutex> lock(_recognizerLock);
+
+	return _buttons.size();
+}
+
+uint64_t GestureRecognizer::getDroppedEdgeCount() const
+{
+	return _droppedEdges.load(std::memory_order_relaxed);
+}
+
+void GestureRecognizer::_capture(const Button_ptr& button, int level, Timestamp timestamp)
+{
+	if (timestamp == Timestamp()) {
+		timestamp = Clock::now();
+	}
+
+	if (!button->_edges.push(Button::Edge{ timestamp, level })) {
+		_droppedEdges.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (!_edgeThread.joinable()) {
+		_process_edges();
+		return;
+	}
+
+	// Only the first edge of a burst wakes the edge thread up
+	if (!_wakeupPending.exchange(true, std::memory_order_acq_rel)) {
+		uint64_t wakeup = 1;
+		if (write(_wakeupFd, &wakeup, sizeof(wakeup)) < 0) {
+			_wakeupPending = false;
+		}
+	}
+}
+
+void GestureRecognizer::_edge_loop()
+{
+	while (_edgeRunning) {
+		uint64_t wakeups;
+		if (read(_wakeupFd, &wakeups, sizeof(wakeups)) < 0 && errno != EINTR) {
+			console->error("GestureRecognizer::_edge_loop : eventfd read failed ({}).", strerror(errno));
+			break;
+		}
+
+		// Clear before draining, so edges captured meanwhile wake the thread again
+		_wakeupPending.store(false, std::memory_order_release);
+
+		_process_edges();
+	}
+}
+
+void GestureRecognizer::_process_edges()
+{
+	Notifications notifications;
+
+	{
+		std::unique_lock<std::mutex> lock(_recognizerLock);
+
+		Button::Edge edge;
+		for (auto& button : _buttons) {
+			while (button->_edges.pop(edge)) {
+				if (edge.level == click_edge) {
+					_press(button, edge.timestamp, notifications);
+					_release(button, edge.timestamp, notifications);
+				}
+				else if (edge.level) {
+					_press(button, edge.timestamp, notifications);
+				}
+				else {
+					_release(button, edge.timestamp, notifications);
+				}
+			}
+		}
+
+		_arm_deadline();
+	}
+
+	_notify(notifications);
+}
+
+void GestureRecognizer::_catch_up(const Button_ptr& button, Timestamp now, Notifications& notifications)
+{
+	while (button->_deadline <= now) {
+		Timestamp deadline = button->_deadline;
+
+		switch (button->_state) {
+		case Button::pressed_state:
+			// Held long enough: long press, then hold repeats while still held
+			notifications.emplace_back(button, long_press, button->_clicks + 1);
+			button->_state = Button::holding_state;
+			button->_clicks = 0;
+			_set_deadline(button, button->_holdRepeatInterval > std::chrono::milliseconds::zero() ?
+				deadline + button->_holdRepeatInterval : Timestamp::max());
+			break;
+
+		case Button::holding_state:
+			notifications.emplace_back(button, hold_repeat, 1);
+			_set_deadline(button, deadline + button->_holdRepeatInterval);
+			break;
+
+		case Button::released_state:
+			// No other click started in time, report the clicks counted so far
+			notifications.emplace_back(button, 
+				button->_clicks == 1 ? single_press : button->_clicks == 2 ? double_press : multi_press, 
+				button->_clicks);
+			button->_state = Button::idle_state;
+			button->_clicks = 0;
+			_set_deadline(button, Timestamp::max());
+			break;
+
+		default:
+			_set_deadline(button, Timestamp::max());
+			break;
+		}
+	}
+}
+
+void GestureRecognizer::_press(const Button_ptr& button, Timestamp timestamp, Notifications& notifications)
+{
+	_catch_up(button, timestamp, notifications);
+
+	if (button->_state != Button::idle_state && button->_state != Button::released_state) {
+		return;
+	}
+
+	button->_state = Button::pressed_state;
+	_set_deadline(button, button->_longPressDuration > std::chrono::milliseconds::zero() ?
+		timestamp + button->_longPressDuration : Timestamp::max());
+}
+
+void GestureRecognizer::_release(const Button_ptr& button, Timestamp timestamp, Notifications& notifications)
+{
+	_catch_up(button, timestamp, notifications);
+
+	if (button->_state == Button::holding_state) {
+		button->_state = Button::idle_state;
+		_set_deadline(button, Timestamp::max());
+		return;
+	}
+
+	if (button->_state != Button::pressed_state) {
+		return;
+	}
+
+	++button->_clicks;
+
+	// Wait for more clicks only while they can still change the gesture
+	if (button->_clicks < button->_maxClicks && button->_multiClickWindow > std::chrono::milliseconds::zero()) {
+		button->_state = Button::released_state;
+		_set_deadline(button, timestamp + button->_multiClickWindow);
+		return;
+	}
+
+	notifications.emplace_back(button,
+		button->_clicks == 1 ? single_press : button->_clicks == 2 ? double_press : multi_press,
+		button->_clicks);
+	button->_state = Button::idle_state;
+	button->_clicks = 0;
+	_set_deadline(button, Timestamp::max());
+}
+
+void GestureRecognizer::_set_deadline(const Button_ptr& button, Timestamp deadline)
+{
+	// Queued deadlines of previous generations are dropped when served
+	++button->_generation;
+	button->_deadline = deadline;
+
+	if (deadline != Timestamp::max()) {
+		_deadlines.push(Deadline{ deadline, button, button->_generation });
+	}
+}
+
+void GestureRecognizer::_deadline_expired()
+{
+	Notifications notifications;
+
+	{
+		std::unique_lock<std::mutex> lock(_recognizerLock);
+
+		_armedDeadline = Timestamp::max();
+		Timestamp now = Clock::now();
+
+		while (!_deadlines.empty() && _deadlines.top().at <= now) {
+			Deadline deadline = _deadlines.top();
+			_deadlines.pop();
+
+			Button_ptr button = deadline.button.lock();
+			if (button != nullptr && deadline.generation == button->_generation) {
+				_catch_up(button, deadline.at, notifications);
+			}
+		}
+
+		_arm_deadline();
+	}
+
+	_notify(notifications);
+}
+
+void GestureRecognizer::_arm_deadline()
+{
+	if (_deadlines.empty() || _deadlines.top().at >= _armedDeadline) {
+		return;
+	}
+
+	_armedDeadline = _deadlines.top().at;
+
+	// Round up, so the timer never expires before the deadline
+	auto delay = std::chrono::ceil<std::chrono::milliseconds>(_armedDeadline - Clock::now());
+	_timerWheel->arm(_deadlineTimer, delay);
+}
+
+void GestureRecognizer::_notify(const Notifications& notifications)
+{
+	for (auto& it : notifications) {
+		const Button_ptr& button = std::get<0>(it);
+
+		// Counted before checking removal, so a removal either skips or waits for the callback
+		button->_notifying++;
+
+		if (!button->_removed) {
+			notifyingButtons.push_back(button.get());
+
+			try {
+				button->_notify(std::get<1>(it), std::get<2>(it));
+			}
+			catch (std::exception& e) {
+				console->warn("GestureRecognizer::_notify : exception during gesture notification : {}", e.what());
+			}
+
+			notifyingButtons.pop_back();
+		}
+
+		button->_notifying--;
+		if (button->_removed) {
+			std::unique_lock<std::mutex> lock(_recognizerLock);
+			_notifyDone.notify_all();
+		}
+	}
+}
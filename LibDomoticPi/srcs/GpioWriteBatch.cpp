@@ -0,0 +1,70 @@
+#include <GpioWriteBatch.h>
+
+#include <domoticPi.h>
+
+#include <exception>
+
+using namespace domotic_pi;
+
+thread_local GpioWriteBatch * GpioWriteBatch::_current = nullptr;
+
+GpioWriteBatch::GpioWriteBatch(GpioBackend_ptr backend)
+	: _backend(backend), _outer(_current), _banks(), _empty(true)
+{
+	if (_outer == nullptr) {
+		_current = this;
+	}
+}
+
+GpioWriteBatch::~GpioWriteBatch()
+{
+	if (_outer != nullptr) {
+		return;
+	}
+
+	_current = nullptr;
+
+	try {
+		commit();
+	}
+	catch (std::exception& e) {
+		console->error("GpioWriteBatch::dtor : exception while applying pin writes : {}", e.what());
+	}
+}
+
+bool GpioWriteBatch::stage(const GpioBackend_ptr& backend, int pin, int value)
+{
+	GpioWriteBatch * batch = _current;
+	if (batch == nullptr || batch->_backend != backend || pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		return false;
+	}
+
+	// Last write of a pin wins
+	GpioBank& bank = batch->_banks[pin / 64];
+	uint64_t bit = (uint64_t)1 << (pin % 64);
+	if (value) {
+		bank.set |= bit;
+		bank.clear &= ~bit;
+	}
+	else {
+		bank.clear |= bit;
+		bank.set &= ~bit;
+	}
+
+	batch->_empty = false;
+
+	return true;
+}
+
+void GpioWriteBatch::commit()
+{
+	if (_empty) {
+		return;
+	}
+
+	GpioBanks banks = _banks;
+	_banks = GpioBanks();
+	_empty = true;
+
+	_backend->writeBanks(banks);
+}
@@ -1,3 +1,8 @@
+#include <domoticPiDefine.h>
+
+// Built only when Apple HomeKit support is enabled
+#ifdef DOMOTIC_PI_APPLE_HOMEKIT
+
 #include <IAHKAccessory.h>
 
 using namespace domotic_pi;
@@ -18,4 +23,6 @@ bool IAHKAccessory::hasAHKAccessory() const
 const hap::Accessory_ptr IAHKAccessory::getAHKAccessory() const
 {
 	return _ahkAccessory;
-}
\ No newline at end of file
+}
+
+#endif // DOMOTIC_PI_APPLE_HOMEKIT
@@ -9,33 +9,23 @@ using namespace domotic_pi;
 IButtonStateGenerator::IButtonStateGenerator(
 	const std::chrono::milliseconds doublePressDuration,
 	const std::chrono::milliseconds longPressDuration)
-	: _this(this),
+	: _this(this, [](IButtonStateGenerator*) {}),
 	_doublePressDuration(doublePressDuration), _longPressDuration(longPressDuration),
-	_doublePressCBCounter(0), _longPressCBCounter(0), 
-	_doublePressRunning(false), _longPressRunning(false), 
-	_doubleStateChange(false), _longStateChange(false), 
-	_doublePressCheckThread(nullptr), _longPressCheckThread(nullptr)
+	_maxClicks(2), _holdRepeatInterval(std::chrono::milliseconds::zero()),
+	_callbackCounter(0), _callbacks(new CallbackList()), _dispatching(0),
+	_gestureRecognizer(GestureRecognizer::load())
 {
+	_gestureButton = _gestureRecognizer->addButton(doublePressDuration, longPressDuration, 
+		[this](ButtonState gesture, unsigned int clicks) {
+			_gesture(gesture, clicks);
+		});
 }
 
 IButtonStateGenerator::~IButtonStateGenerator()
 {
-	_doublePressRunning = false;
-	_longPressRunning = false;
+	_gestureRecognizer->removeButton(_gestureButton);
 
-	_buttonStateChange.notify_all();
-
-	if (_doublePressCheckThread != nullptr) {
-		console->debug("IButtonStateGenerator::dtor : stopping double press check thread.");
-		_doublePressCheckThread->join();
-		delete _doublePressCheckThread;
-	}
-
-	if (_longPressCheckThread != nullptr) {
-		console->debug("IButtonStateGenerator::dtor : stopping long press check thread.");
-		_longPressCheckThread->join();
-		delete _longPressCheckThread;
-	}
+	delete _callbacks.load();
 }
 
 std::tuple<std::chrono::milliseconds, std::chrono::milliseconds> IButtonStateGenerator::from_json(const rapidjson::Value& config)
@@ -53,125 +43,93 @@ std::tuple<std::chrono::milliseconds, std::chrono::milliseconds> IButtonStateGen
 	return durations;
 }
 
-void IButtonStateGenerator::buttonStateChange()
+void IButtonStateGenerator::from_json(const rapidjson::Value& config, IButtonStateGenerator& generator)
 {
-	std::unique_lock<std::mutex> lock(_stateChangeLock);
-	_doubleStateChange = true;
-	_longStateChange = true;
-	_buttonStateChange.notify_all();
+	generator.setGestures(
+		config.HasMember("maxClicks") ? config["maxClicks"].GetUint() : generator.getMaxClicks(),
+		config.HasMember("holdRepeatInterval") ? 
+			std::chrono::milliseconds(config["holdRepeatInterval"].GetInt()) : generator.getHoldRepeatInterval());
 }
 
-CallbackToken_ptr IButtonStateGenerator::addDoublePressCallback(std::function<void()> doublePressCallback)
+void IButtonStateGenerator::setGestures(unsigned int maxClicks, std::chrono::milliseconds holdRepeatInterval)
 {
-	if (_doublePressDuration == std::chrono::milliseconds::zero() || doublePressCallback == nullptr) {
-		return std::make_shared<CallbackToken>();
-	}
-
-	// If double press check thread is off, start it now
-	if (_doublePressCheckThread == nullptr) {
-		console->debug("IButtonStateGenerator::addDoublePressCallback : starting double press check thread.");
-		_doublePressRunning = true;
-		_doublePressCheckThread = new std::thread(&IButtonStateGenerator::_double_press_check, this);
-	}
+	_maxClicks = maxClicks > 0 ? maxClicks : 1;
+	_holdRepeatInterval = holdRepeatInterval > std::chrono::milliseconds::zero() ? 
+		holdRepeatInterval : std::chrono::milliseconds::zero();
 
-#ifdef DOMOTIC_PI_THREAD_SAFE
-	std::unique_lock<std::mutex> lock(_doublePressCBList);
-#endif // DOMOTIC_PI_THREAD_SAFE
+	_gestureRecognizer->configureButton(_gestureButton, _maxClicks, _holdRepeatInterval);
+}
 
-	_doublePressCallbacks.push_back(std::make_tuple(_doublePressCBCounter, doublePressCallback));
+unsigned int IButtonStateGenerator::getMaxClicks() const
+{
+	return _maxClicks;
+}
 
-	console->debug("IButtonStateGenerator::addDoublePressCallback : callback added.");
+std::chrono::milliseconds IButtonStateGenerator::getHoldRepeatInterval() const
+{
+	return _holdRepeatInterval;
+}
 
-	auto weak_parent = std::weak_ptr<IButtonStateGenerator>(_this);
-	uint32_t cbIndex = _doublePressCBCounter++;
+void IButtonStateGenerator::buttonStateChange(Timestamp timestamp)
+{
+	_gestureRecognizer->buttonClick(_gestureButton, timestamp);
+}
 
-	return std::make_shared<CallbackToken>([weak_parent, cbIndex] {
-		if (weak_parent.expired()) {
-			console->debug("IButtonStateGenerator::__removeDoublePress_lambda : parent "
-				"expired before callback was removed.");
-			return;
-		}
+void IButtonStateGenerator::buttonEdge(bool pressed, Timestamp timestamp)
+{
+	_gestureRecognizer->buttonEdge(_gestureButton, pressed, timestamp);
+}
 
-		auto parent = weak_parent.lock();
-		
-#ifdef DOMOTIC_PI_THREAD_SAFE
-		std::unique_lock<std::mutex> lock(parent->_doublePressCBList);
-#endif // DOMOTIC_PI_THREAD_SAFE
-		for (auto cb = parent->_doublePressCallbacks.begin(); cb != parent->_doublePressCallbacks.end(); ++cb) {
-			if (std::get<0>(*cb) == cbIndex) {
-				parent->_doublePressCallbacks.erase(cb);
-				console->debug("IButtonStateGenerator::__removeDoublePress_lambda : "
-					"callback {} removed from parent.", cbIndex);
-				break;
-			}
-		}
+CallbackToken_ptr IButtonStateGenerator::addSinglePressCallback(std::function<void()> singlePressCallback)
+{
+	if (singlePressCallback == nullptr) {
+		return std::make_shared<CallbackToken>();
+	}
 
-		// If double press callbacks list is empty, stop listener thread
-		if (parent->_doublePressCallbacks.empty()) {
-			console->debug("IButtonStateGenerator::__removeDoublePress_lambda : stopping double press check thread.");
-			parent->_doublePressRunning = false;
-			parent->_buttonStateChange.notify_all();
-			parent->_doublePressCheckThread->join();
-			delete parent->_doublePressCheckThread;
-			parent->_doublePressCheckThread = nullptr;
-		}
+	return _add_callback(single_press, [singlePressCallback](unsigned int) {
+		singlePressCallback();
 	});
 }
 
-CallbackToken_ptr IButtonStateGenerator::addLongPressCallback(std::function<void()> longPressCallback)
+CallbackToken_ptr IButtonStateGenerator::addDoublePressCallback(std::function<void()> doublePressCallback)
 {
-	if (_longPressDuration == std::chrono::milliseconds::zero() || longPressCallback == nullptr) {
+	if (_doublePressDuration == std::chrono::milliseconds::zero() || doublePressCallback == nullptr) {
 		return std::make_shared<CallbackToken>();
 	}
 
-	// If long press check thread is off, start it now
-	if (_longPressCheckThread == nullptr) {
-		console->debug("IButtonStateGenerator::addLongPressCallback : starting long press check thread.");
-		_longPressRunning = true;
-		_longPressCheckThread = new std::thread(&IButtonStateGenerator::_long_press_check, this);
-	}
-
-#ifdef DOMOTIC_PI_THREAD_SAFE
-	std::unique_lock<std::mutex> lock(_longPressCBList);
-#endif // DOMOTIC_PI_THREAD_SAFE
+	return _add_callback(double_press, [doublePressCallback](unsigned int) {
+		doublePressCallback();
+	});
+}
 
-	_longPressCallbacks.push_back(std::make_tuple(_longPressCBCounter, longPressCallback));
+CallbackToken_ptr IButtonStateGenerator::addMultiPressCallback(std::function<void(unsigned int)> multiPressCallback)
+{
+	if (_doublePressDuration == std::chrono::milliseconds::zero() || multiPressCallback == nullptr) {
+		return std::make_shared<CallbackToken>();
+	}
 
-	console->debug("IButtonStateGenerator::addLongPressCallback : callback added.");
+	return _add_callback(multi_press, multiPressCallback);
+}
 
-	auto weak_parent = std::weak_ptr<IButtonStateGenerator>(_this);
-	uint32_t cbIndex = _longPressCBCounter++;
+CallbackToken_ptr IButtonStateGenerator::addLongPressCallback(std::function<void()> longPressCallback)
+{
+	if (_longPressDuration == std::chrono::milliseconds::zero() || longPressCallback == nullptr) {
+		return std::make_shared<CallbackToken>();
+	}
 
-	return std::make_shared<CallbackToken>([weak_parent, cbIndex]() {
-		if (weak_parent.expired()) {
-			console->debug("IButtonStateGenerator::__removeLongPress_lambda : parent "
-				"expired before callback was removed.");
-			return;
-		}
+	return _add_callback(long_press, [longPressCallback](unsigned int) {
+		longPressCallback();
+	});
+}
 
-		auto parent = weak_parent.lock();
-		
-#ifdef DOMOTIC_PI_THREAD_SAFE
-		std::unique_lock<std::mutex> lock(parent->_longPressCBList);
-#endif // DOMOTIC_PI_THREAD_SAFE
-		for (auto cb = parent->_longPressCallbacks.begin(); cb != parent->_longPressCallbacks.end(); ++cb) {
-			if (std::get<0>(*cb) == cbIndex) {
-				parent->_longPressCallbacks.erase(cb);
-				console->debug("IButtonStateGenerator::__removeLongPress_lambda : "
-					"callback {} removed from parent.", cbIndex);
-				break;
-			}
-		}
+CallbackToken_ptr IButtonStateGenerator::addHoldRepeatCallback(std::function<void()> holdRepeatCallback)
+{
+	if (_longPressDuration == std::chrono::milliseconds::zero() || holdRepeatCallback == nullptr) {
+		return std::make_shared<CallbackToken>();
+	}
 
-		// If long press callbacks list is empty, stop listener thread
-		if (parent->_longPressCallbacks.empty()) {
-			console->debug("IButtonStateGenerator::__removeLongPress_lambda : stopping long press check thread.");
-			parent->_longPressRunning = false;
-			parent->_buttonStateChange.notify_all();
-			parent->_longPressCheckThread->join();
-			delete parent->_longPressCheckThread;
-			parent->_longPressCheckThread = nullptr;
-		}
+	return _add_callback(hold_repeat, [holdRepeatCallback](unsigned int) {
+		holdRepeatCallback();
 	});
 }
 
@@ -187,81 +145,99 @@ rapidjson::Document IButtonStateGenerator::to_json() const
 		durationObject.AddMember("longPressDuration", _longPressDuration.count(), durationObject.GetAllocator());
 	}
 
+	if (_maxClicks != 2) {
+		durationObject.AddMember("maxClicks", _maxClicks, durationObject.GetAllocator());
+	}
+
+	if (_holdRepeatInterval != std::chrono::milliseconds::zero()) {
+		durationObject.AddMember("holdRepeatInterval", _holdRepeatInterval.count(), durationObject.GetAllocator());
+	}
+
 	return durationObject;
 }
 
-void IButtonStateGenerator::_double_press_check()
+CallbackToken_ptr IButtonStateGenerator::_add_callback(ButtonState gesture, const GestureCallback& callback)
 {
-	while (_doublePressRunning)
-	{
-		// Wait for first button change event
-		std::unique_lock<std::mutex> lock(_stateChangeLock);
-		while (!_doubleStateChange) {
-			_buttonStateChange.wait(lock);
-			if (!_doublePressRunning) {
-				return;
-			}
-		}
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> lock(_callbacksLock);
+#endif // DOMOTIC_PI_THREAD_SAFE
 
-		// State change flag reset
-		_doubleStateChange = false;
+	// Copy on write : dispatch keeps using the list it loaded while a new one is published
+	auto callbacks = std::make_unique<CallbackList>(*_callbacks.load());
+	callbacks->push_back(std::make_tuple(_callbackCounter, gesture, callback));
+	_publish(std::move(callbacks));
 
-		// Wait for the second button change event during the specified time duration 
-		std::cv_status wakeStatus = _buttonStateChange.wait_for(lock, _doublePressDuration);
+	console->debug("IButtonStateGenerator::_add_callback : callback for gesture {} added.", gesture);
 
-		// If button change event happens before the time duration expires, trigger relative callback
-		if (wakeStatus != std::cv_status::timeout) {
-			console->debug("IButtonStateGenerator::_double_press_check : double press event triggered.");
+	auto weak_parent = std::weak_ptr<IButtonStateGenerator>(_this);
+	uint32_t cbIndex = _callbackCounter++;
+
+	return std::make_shared<CallbackToken>([weak_parent, cbIndex] {
+		auto parent = weak_parent.lock();
+		if (parent == nullptr) {
+			console->debug("IButtonStateGenerator::__removeCallback_lambda : parent "
+				"expired before callback was removed.");
+			return;
+		}
+
+		parent->_remove_callback(cbIndex);
+	});
+}
+
+void IButtonStateGenerator::_remove_callback(uint32_t cbIndex)
+{
 #ifdef DOMOTIC_PI_THREAD_SAFE
-			std::unique_lock<std::mutex> cbLock(_doublePressCBList);
+	std::unique_lock<std::mutex> lock(_callbacksLock);
 #endif // DOMOTIC_PI_THREAD_SAFE
-			for (auto doublePressTuple : _doublePressCallbacks) {
-				try {
-					std::get<1>(doublePressTuple)();
-				}
-				catch (std::exception& e) {
-					console->warn("IButtonStateGenerator::_double_press_check : exception "
-						"during double press callback call : ", e.what());
-				}
-			}
+
+	const CallbackList* current = _callbacks.load();
+	auto callbacks = std::make_unique<CallbackList>();
+	callbacks->reserve(current->size());
+
+	for (auto& cb : *current) {
+		if (std::get<0>(cb) != cbIndex) {
+			callbacks->push_back(cb);
 		}
 	}
+
+	if (callbacks->size() != current->size()) {
+		_publish(std::move(callbacks));
+		console->debug("IButtonStateGenerator::_remove_callback : callback {} removed.", cbIndex);
+	}
 }
 
-void IButtonStateGenerator::_long_press_check()
+void IButtonStateGenerator::_publish(std::unique_ptr<const CallbackList> callbacks)
 {
-	while (_longPressRunning)
-	{
-		// Wait for first button change event
-		std::unique_lock<std::mutex> lock(_stateChangeLock);
-		while (!_longStateChange) {
-			_buttonStateChange.wait(lock);
-			if (!_longPressRunning) {
-				return;
-			}
-		}
+	_retired.emplace_back(_callbacks.exchange(callbacks.release()));
 
-		// State change flag reset
-		_longStateChange = false;
+	// A dispatch starting from now loads the new list: with none running, replaced lists are unused
+	if (_dispatching.load() == 0) {
+		_retired.clear();
+	}
+}
 
-		// Wait for the second button change event during the specified time duration 
-		std::cv_status wakeStatus = _buttonStateChange.wait_for(lock, _longPressDuration);
+void IButtonStateGenerator::_gesture(ButtonState gesture, unsigned int clicks)
+{
+	console->debug("IButtonStateGenerator::_gesture : gesture {} triggered ({} clicks).", gesture, clicks);
 
-		// If button change event doesn't happen during the long press time span, trigger relative callback
-		if (wakeStatus == std::cv_status::timeout) {
-			console->debug("IButtonStateGenerator::_long_press_check : long press event triggered.");
-#ifdef DOMOTIC_PI_THREAD_SAFE
-			std::unique_lock<std::mutex> cbLock(_longPressCBList);
-#endif // DOMOTIC_PI_THREAD_SAFE
-			for (auto longPressTuple : _longPressCallbacks) {
-				try {
-					std::get<1>(longPressTuple)();
-				}
-				catch (std::exception& e) {
-					console->warn("IButtonStateGenerator::_long_press_check : exception "
-						"during long press callback call : ", e.what());
-				}
-			}
+	// The loaded list stays valid even if callbacks are added or removed meanwhile,
+	// since replaced lists are not freed while a dispatch is counted
+	_dispatching.fetch_add(1);
+	const CallbackList* callbacks = _callbacks.load();
+
+	for (auto& callbackTuple : *callbacks) {
+		if (std::get<1>(callbackTuple) != gesture) {
+			continue;
+		}
+
+		try {
+			std::get<2>(callbackTuple)(clicks);
+		}
+		catch (std::exception& e) {
+			console->warn("IButtonStateGenerator::_gesture : exception "
+				"during gesture callback call : {}", e.what());
 		}
 	}
-}
\ No newline at end of file
+
+	_dispatching.fetch_sub(1);
+}
@@ -0,0 +1,64 @@
+#include <IGpioBackend.h>
+
+#include <ChardevGpio.h>
+#include <WiringPiGpio.h>
+
+#include <stdexcept>
+#include <string>
+
+using namespace domotic_pi;
+
+std::array<std::shared_ptr<IGpioBackend>, DOMOTIC_PI_MAX_CHIPS> IGpioBackend::_backends;
+
+const std::shared_ptr<IGpioBackend> IGpioBackend::load(unsigned int chip)
+{
+	if (chip >= _backends.size()) {
+		throw std::out_of_range("Chip index must be lower than " STR(DOMOTIC_PI_MAX_CHIPS) ".");
+	}
+
+	if (_backends[chip] == nullptr) {
+		if (chip != 0) {
+			throw std::out_of_range("No GPIO backend set for chip " + std::to_string(chip) + ".");
+		}
+
+#ifdef DOMOTIC_PI_WIRING_PI
+		_backends[chip] = std::make_shared<WiringPiGpio>();
+#else
+		_backends[chip] = std::make_shared<ChardevGpio>();
+#endif // DOMOTIC_PI_WIRING_PI
+	}
+
+	return _backends[chip];
+}
+
+void IGpioBackend::set(std::shared_ptr<IGpioBackend> backend, unsigned int chip)
+{
+	if (chip >= _backends.size()) {
+		throw std::out_of_range("Chip index must be lower than " STR(DOMOTIC_PI_MAX_CHIPS) ".");
+	}
+
+	_backends[chip] = backend;
+}
+
+void IGpioBackend::writeBanks(const GpioBanks& banks)
+{
+	for (size_t bank = 0; bank < banks.size(); ++bank) {
+		for (uint64_t changed = banks[bank].set | banks[bank].clear; changed; changed &= changed - 1) {
+			int bit = __builtin_ctzll(changed);
+			write((int)(bank * 64 + bit), (banks[bank].clear >> bit) & 1 ? 0 : 1);
+		}
+	}
+}
+
+void IGpioBackend::readBanks(const GpioLevels& mask, GpioLevels& levels)
+{
+	for (size_t bank = 0; bank < mask.size(); ++bank) {
+		levels[bank] = 0;
+		for (uint64_t pins = mask[bank]; pins; pins &= pins - 1) {
+			int bit = __builtin_ctzll(pins);
+			if (read((int)(bank * 64 + bit))) {
+				levels[bank] |= (uint64_t)1 << bit;
+			}
+		}
+	}
+}
@@ -1,18 +1,27 @@
 #include <IInput.h>
 
+#include <Clock.h>
 #include <domoticPi.h>
 
+#include <algorithm>
 #include <exception>
 
 using namespace domotic_pi;
 
 IInput::IInput(const std::string& id) 
-	: IModule(id), _this(this), _valueEventPairs()
+	: IModule(id), _this(this, [](IInput*) {}), _valueEventPairs(),
+	_eventDispatcher(EventDispatcher::load()), _patternMatcher(PatternMatcher::load()), _timerWheel(TimerWheel::load()), _debounce(std::chrono::milliseconds::zero()), 
+	_debouncing(false), _pendingChange(false), _pendingValue(0), _lastDispatchedValue(0),
+	_rate(0), _burst(1), _tokens(1), _droppedCount(0), _mergedCount(0)
 {
+	_debounceTimer = _timerWheel->newTimer([this] {
+		_debounce_expired();
+	});
 }
 
 IInput::~IInput() 
 {
+	_timerWheel->cancel(_debounceTimer);
 }
 
 void IInput::addProgrammedEvent(ProgrammedEvent_ptr progEvent, int triggerValue)
@@ -55,24 +64,214 @@ void IInput::removeProgrammedEvent(const std::string& programmedEventId)
 	}
 }
 
-void IInput::valueChanged(int newValue) const
+std::vector<ProgrammedEvent_ptr> IInput::getProgrammedEvents() const
 {
 #ifdef DOMOTIC_PI_THREAD_SAFE
 	std::shared_lock<std::shared_mutex> lock(_valueEventPairsLock);
 #endif // DOMOTIC_PI_THREAD_SAFE
 
-	for (auto& valueEvent : _valueEventPairs) {
-		try {
-			if ((valueEvent.first == std::numeric_limits<int>::max() || valueEvent.first == newValue) 
-				&& !valueEvent.second.expired()) {
-				valueEvent.second.lock()->triggerEvent();
+	std::vector<ProgrammedEvent_ptr> programmedEvents;
+	for (auto& it : _valueEventPairs) {
+		ProgrammedEvent_ptr programmedEvent = it.second.lock();
+		if (programmedEvent != nullptr) {
+			programmedEvents.push_back(programmedEvent);
+		}
+	}
+
+	return programmedEvents;
+}
+
+std::vector<CommTopic> IInput::getListenedTopics() const
+{
+	return std::vector<CommTopic>();
+}
+
+void IInput::setDebounce(std::chrono::milliseconds window)
+{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> lock(_filterLock);
+#endif // DOMOTIC_PI_THREAD_SAFE
+
+	_debounce = window > std::chrono::milliseconds::zero() ? window : std::chrono::milliseconds::zero();
+
+	console->debug("IInput::setDebounce : input {} debounce window set to {} ms.", 
+		_id.c_str(), _debounce.count());
+}
+
+std::chrono::milliseconds IInput::getDebounce() const
+{
+	return _debounce;
+}
+
+void IInput::setRateLimit(double rate, unsigned int burst)
+{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> lock(_filterLock);
+#endif // DOMOTIC_PI_THREAD_SAFE
+
+	_rate = rate > 0 ? rate : 0;
+	_burst = burst > 0 ? burst : 1;
+
+	// Start with a full bucket
+	_tokens = _burst;
+	_lastRefill = Clock::now();
+
+	console->debug("IInput::setRateLimit : input {} rate limit set to {} changes/s (burst {}).", 
+		_id.c_str(), _rate, _burst);
+}
+
+double IInput::getRateLimit() const
+{
+	return _rate;
+}
+
+unsigned int IInput::getRateLimitBurst() const
+{
+	return _burst;
+}
+
+uint64_t IInput::getDroppedCount() const
+{
+	return _droppedCount.load(std::memory_order_relaxed);
+}
+
+uint64_t IInput::getMergedCount() const
+{
+	return _mergedCount.load(std::memory_order_relaxed);
+}
+
+rapidjson::Document IInput::stats_to_json() const
+{
+	rapidjson::Document stats(rapidjson::kObjectType);
+
+	stats.AddMember("dropped", getDroppedCount(), stats.GetAllocator());
+	stats.AddMember("merged", getMergedCount(), stats.GetAllocator());
+
+	return stats;
+}
+
+void IInput::valueChanged(int newValue, Timestamp timestamp) const
+{
+	if (timestamp == Timestamp()) {
+		timestamp = Clock::now();
+	}
+
+	// Safety events see every change, ahead of any filter
+	_dispatch(newValue, timestamp, true);
+
+	{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+		std::unique_lock<std::mutex> lock(_filterLock);
+#endif // DOMOTIC_PI_THREAD_SAFE
+
+		if (_debounce > std::chrono::milliseconds::zero()) {
+			// Within the window keep only the last change, it will be dispatched on window close
+			if (_debouncing) {
+				if (_pendingChange) {
+					_mergedCount.fetch_add(1, std::memory_order_relaxed);
+				}
+
+				_pendingChange = true;
+				_pendingValue = newValue;
+				_pendingTimestamp = timestamp;
+				return;
 			}
+
+			_debouncing = true;
+			_timerWheel->arm(_debounceTimer, _debounce);
+		}
+
+		if (!_take_token(Clock::now())) {
+			console->debug("IInput::valueChanged : change to {} dropped by rate limit on input {}.", 
+				newValue, _id.c_str());
+			return;
+		}
+
+		_lastDispatchedValue = newValue;
+	}
+
+	_dispatch(newValue, timestamp, false);
+}
+
+void IInput::_debounce_expired() const
+{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> lock(_filterLock);
+#endif // DOMOTIC_PI_THREAD_SAFE
+
+	if (!_pendingChange) {
+		_debouncing = false;
+		return;
+	}
+
+	_pendingChange = false;
+	int newValue = _pendingValue;
+	Timestamp timestamp = _pendingTimestamp;
+
+	// Settled back to the value already dispatched, nothing changed for the events
+	if (newValue == _lastDispatchedValue) {
+		_mergedCount.fetch_add(1, std::memory_order_relaxed);
+		_debouncing = false;
+		return;
+	}
+
+	// Keep the window open after the trailing change too
+	_timerWheel->arm(_debounceTimer, _debounce);
+
+	if (!_take_token(Clock::now())) {
+		console->debug("IInput::_debounce_expired : change to {} dropped by rate limit on input {}.", 
+			newValue, _id.c_str());
+		return;
+	}
+
+	_lastDispatchedValue = newValue;
+
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	lock.unlock();
+#endif // DOMOTIC_PI_THREAD_SAFE
+
+	_dispatch(newValue, timestamp, false);
+}
+
+bool IInput::_take_token(Timestamp now) const
+{
+	if (_rate <= 0) {
+		return true;
+	}
+
+	// Refill the bucket with tokens earned since last change
+	double elapsed = std::chrono::duration<double>(now - _lastRefill).count();
+	_tokens = std::min<double>(_burst, _tokens + elapsed * _rate);
+	_lastRefill = now;
+
+	if (_tokens < 1) {
+		_droppedCount.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	_tokens -= 1;
+
+	return true;
+}
+
+void IInput::_dispatch(int newValue, Timestamp timestamp, bool safety) const
+{
+	if (!safety) {
+		_patternMatcher->inputChanged(_id, newValue, timestamp);
+	}
+
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::shared_lock<std::shared_mutex> lock(_valueEventPairsLock);
+#endif // DOMOTIC_PI_THREAD_SAFE
+
+	for (auto& valueEvent : _valueEventPairs) {
+		if (valueEvent.first != std::numeric_limits<int>::max() && valueEvent.first != newValue) {
+			continue;
 		}
-		catch (std::exception& e) {
-			console->warn("IInput::valueChanged : exception during programmed "
-				"event {} call from input {} : {}", 
-				valueEvent.second.expired() ? "'removed event'" : valueEvent.second.lock()->getID().c_str(), 
-				_id.c_str(), e.what());
+
+		ProgrammedEvent_ptr programmedEvent = valueEvent.second.lock();
+		if (programmedEvent != nullptr && (programmedEvent->getPriority() == safety_priority) == safety) {
+			_eventDispatcher->dispatch(programmedEvent, timestamp);
 		}
 	}
 }
@@ -109,5 +308,16 @@ rapidjson::Document IInput::to_json() const
 
 	input.AddMember("triggerEvents", triggerEvents, input.GetAllocator());
 
+	if (_debounce > std::chrono::milliseconds::zero()) {
+		input.AddMember("debounce", (int)_debounce.count(), input.GetAllocator());
+	}
+
+	if (_rate > 0) {
+		rapidjson::Value rateLimit(rapidjson::kObjectType);
+		rateLimit.AddMember("rate", _rate, input.GetAllocator());
+		rateLimit.AddMember("burst", _burst, input.GetAllocator());
+		input.AddMember("rateLimit", rateLimit, input.GetAllocator());
+	}
+
 	return input;
 }
\ No newline at end of file
@@ -1,9 +1,11 @@
 #include <IOutput.h>
 
+#include <Clock.h>
+
 using namespace domotic_pi;
 
 IOutput::IOutput(const std::string& id) 
-	: IModule(id)
+	: IModule(id), _value(0), _lastCommand(0)
 {
 }
 
@@ -14,4 +16,48 @@ IOutput::~IOutput()
 int IOutput::getValue() const
 {
 	return _value;
+}
+
+std::vector<CommTopic> IOutput::getProducedTopics() const
+{
+	return std::vector<CommTopic>();
+}
+
+const LatencyHistogram& IOutput::getCommandLatency() const
+{
+	return _commandLatency;
+}
+
+const LatencyHistogram& IOutput::getFeedbackLatency() const
+{
+	return _feedbackLatency;
+}
+
+rapidjson::Document IOutput::stats_to_json() const
+{
+	rapidjson::Document stats(rapidjson::kObjectType);
+
+	rapidjson::Value command(_commandLatency.to_json(), stats.GetAllocator());
+	stats.AddMember("command", command, stats.GetAllocator());
+	rapidjson::Value feedback(_feedbackLatency.to_json(), stats.GetAllocator());
+	stats.AddMember("feedback", feedback, stats.GetAllocator());
+
+	return stats;
+}
+
+void IOutput::_trace_command(Timestamp timestamp)
+{
+	_commandLatency.recordSince(timestamp);
+
+	_lastCommand.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+void IOutput::_trace_feedback()
+{
+	// Only the first feedback after a command is a round trip sample
+	Timestamp::rep lastCommand = _lastCommand.exchange(0, std::memory_order_relaxed);
+
+	if (lastCommand != 0) {
+		_feedbackLatency.recordSince(Timestamp(Timestamp::duration(lastCommand)));
+	}
 }
\ No newline at end of file
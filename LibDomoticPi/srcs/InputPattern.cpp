@@ -0,0 +1,109 @@
+#include <InputPattern.h>
+
+#include <domoticPi.h>
+#include <exceptions.h>
+#include <ProgrammedEvent.h>
+
+#include <limits>
+
+using namespace domotic_pi;
+
+InputPattern::InputPattern(
+	PatternType type,
+	const std::vector<Step>& steps,
+	std::chrono::milliseconds window,
+	std::weak_ptr<ProgrammedEvent> programmedEvent)
+	: _type(type), _steps(steps), _window(window), _programmedEvent(programmedEvent),
+	_completeMask(steps.size() >= maxSteps ? ~(uint64_t)0 : ((uint64_t)1 << steps.size()) - 1),
+	_activeCount(0), _consumedChange(0), _matchedChange(0)
+{
+	if (_steps.empty() || _steps.size() > maxSteps) {
+		console->error("InputPattern::ctor : pattern must have between 1 and {} steps.", maxSteps);
+		throw domotic_pi_exception("Not valid number of input pattern steps.");
+	}
+}
+
+std::shared_ptr<InputPattern> InputPattern::from_json(
+	const rapidjson::Value& config,
+	std::weak_ptr<ProgrammedEvent> programmedEvent)
+{
+	std::vector<Step> steps;
+	for (auto& it : config["steps"].GetArray()) {
+		steps.push_back(Step{ it["inputId"].GetString(), 
+			it.HasMember("triggerValue") ? it["triggerValue"].GetInt() : std::numeric_limits<int>::max() });
+	}
+
+	// Window is expressed in seconds
+	return std::make_shared<InputPattern>(
+		std::string(config["type"].GetString()) == "sequence" ? sequence_pattern : chord_pattern,
+		steps,
+		std::chrono::milliseconds((long long)(config["window"].GetDouble() * 1000)),
+		programmedEvent);
+}
+
+PatternType InputPattern::getType() const
+{
+	return _type;
+}
+
+const std::vector<InputPattern::Step>& InputPattern::getSteps() const
+{
+	return _steps;
+}
+
+std::chrono::milliseconds InputPattern::getWindow() const
+{
+	return _window;
+}
+
+std::shared_ptr<ProgrammedEvent> InputPattern::getProgrammedEvent() const
+{
+	return _programmedEvent.lock();
+}
+
+rapidjson::Document InputPattern::to_json() const
+{
+	rapidjson::Document pattern(rapidjson::kObjectType);
+
+	pattern.AddMember("type", rapidjson::StringRef(_type == sequence_pattern ? "sequence" : "chord"), pattern.GetAllocator());
+	pattern.AddMember("window", _window.count() / 1000.0, pattern.GetAllocator());
+
+	rapidjson::Value steps(rapidjson::kArrayType);
+	for (auto& it : _steps) {
+		rapidjson::Value step(rapidjson::kObjectType);
+
+		rapidjson::Value inputId;
+		inputId.SetString(it.inputId.c_str(), pattern.GetAllocator());
+		step.AddMember("inputId", inputId, pattern.GetAllocator());
+
+		if (it.value != std::numeric_limits<int>::max()) {
+			step.AddMember("triggerValue", it.value, pattern.GetAllocator());
+		}
+
+		steps.PushBack(step, pattern.GetAllocator());
+	}
+	pattern.AddMember("steps", steps, pattern.GetAllocator());
+
+	return pattern;
+}
+
+size_t InputPattern::_next_step(uint64_t matched, const std::string& inputId, int value) const
+{
+	auto stepMatches = [&](const Step& step) {
+		return step.inputId == inputId && (step.value == std::numeric_limits<int>::max() || step.value == value);
+	};
+
+	// Sequences can only advance on the step following the matched ones
+	if (_type == sequence_pattern) {
+		size_t next = __builtin_popcountll(matched);
+		return next < _steps.size() && stepMatches(_steps[next]) ? next : maxSteps;
+	}
+
+	for (size_t step = 0; step < _steps.size(); ++step) {
+		if (!(matched & ((uint64_t)1 << step)) && stepMatches(_steps[step])) {
+			return step;
+		}
+	}
+
+	return maxSteps;
+}
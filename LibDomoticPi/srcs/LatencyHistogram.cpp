@@ -0,0 +1,108 @@
+#include <LatencyHistogram.h>
+
+#include <Clock.h>
+
+#include <algorithm>
+
+using namespace domotic_pi;
+
+LatencyHistogram::LatencyHistogram()
+{
+	reset();
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds latency)
+{
+	uint64_t latencyUs = latency.count() > 0 ?
+		std::chrono::duration_cast<std::chrono::microseconds>(latency).count() : 0;
+
+	// Bucket index is the position of the highest set bit
+	size_t bucket = latencyUs ? 64 - __builtin_clzll(latencyUs) : 0;
+	if (bucket >= bucketCount) {
+		bucket = bucketCount - 1;
+	}
+
+	_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	_count.fetch_add(1, std::memory_order_relaxed);
+	_sumUs.fetch_add(latencyUs, std::memory_order_relaxed);
+
+	uint64_t maxUs = _maxUs.load(std::memory_order_relaxed);
+	while (latencyUs > maxUs && !_maxUs.compare_exchange_weak(maxUs, latencyUs, std::memory_order_relaxed));
+}
+
+void LatencyHistogram::recordSince(Timestamp since)
+{
+	if (since == Timestamp()) {
+		return;
+	}
+
+	record(Clock::now() - since);
+}
+
+uint64_t LatencyHistogram::getCount() const
+{
+	return _count.load(std::memory_order_relaxed);
+}
+
+std::chrono::microseconds LatencyHistogram::getMean() const
+{
+	uint64_t count = getCount();
+
+	return std::chrono::microseconds(count ? _sumUs.load(std::memory_order_relaxed) / count : 0);
+}
+
+std::chrono::microseconds LatencyHistogram::getMax() const
+{
+	return std::chrono::microseconds(_maxUs.load(std::memory_order_relaxed));
+}
+
+std::chrono::microseconds LatencyHistogram::getPercentile(double percentile) const
+{
+	uint64_t count = getCount();
+	if (count == 0) {
+		return std::chrono::microseconds::zero();
+	}
+
+	uint64_t rank = (uint64_t)(count * percentile / 100.0);
+	uint64_t seen = 0;
+
+	for (size_t bucket = 0; bucket < bucketCount; ++bucket) {
+		seen += _buckets[bucket].load(std::memory_order_relaxed);
+		if (seen > rank) {
+			return std::min(std::chrono::microseconds((uint64_t)1 << bucket), getMax());
+		}
+	}
+
+	return getMax();
+}
+
+void LatencyHistogram::reset()
+{
+	for (auto& bucket : _buckets) {
+		bucket.store(0, std::memory_order_relaxed);
+	}
+
+	_count.store(0, std::memory_order_relaxed);
+	_sumUs.store(0, std::memory_order_relaxed);
+	_maxUs.store(0, std::memory_order_relaxed);
+}
+
+rapidjson::Document LatencyHistogram::to_json() const
+{
+	rapidjson::Document histogram(rapidjson::kObjectType);
+
+	histogram.AddMember("count", getCount(), histogram.GetAllocator());
+	histogram.AddMember("mean_us", (uint64_t)getMean().count(), histogram.GetAllocator());
+	histogram.AddMember("p50_us", (uint64_t)getPercentile(50).count(), histogram.GetAllocator());
+	histogram.AddMember("p90_us", (uint64_t)getPercentile(90).count(), histogram.GetAllocator());
+	histogram.AddMember("p99_us", (uint64_t)getPercentile(99).count(), histogram.GetAllocator());
+	histogram.AddMember("max_us", (uint64_t)getMax().count(), histogram.GetAllocator());
+
+	rapidjson::Value buckets(rapidjson::kArrayType);
+	for (auto& bucket : _buckets) {
+		buckets.PushBack(bucket.load(std::memory_order_relaxed), histogram.GetAllocator());
+	}
+	histogram.AddMember("buckets", buckets, histogram.GetAllocator());
+
+	return histogram;
+}
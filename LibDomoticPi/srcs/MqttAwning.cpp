@@ -1,6 +1,7 @@
 #include <MqttAwning.h>
 
 #include <CommFactory.h>
+#include <DomoticNode.h>
 #include <domoticPi.h>
 #include <exceptions.h>
 
@@ -18,6 +19,9 @@ MqttAwning::MqttAwning(
 	_cmndTopic("cmnd/" + mqttTopic), _statTopic("stat/" + mqttTopic),
 	_statSubscription(_mqttComm->subscribe(_statTopic,
 		std::bind(&MqttAwning::_stat_message_cb, this, std::placeholders::_1)))
+#ifdef DOMOTIC_PI_APPLE_HOMEKIT
+	, _timerWheel(TimerWheel::load())
+#endif
 {
 	if (mqttComm == nullptr) {
 		console->error("MqttAwning::ctor : given mqtt comm interface can not be null.");
@@ -25,14 +29,18 @@ MqttAwning::MqttAwning(
 	}
 
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
+	// Identify blinks the device: switched off again by the timer wheel
+	_identifyTimer = _timerWheel->newTimer([this] {
+		this->setState(OFF);
+	});
+
 	_ahkAccessory = std::make_shared<hap::Accessory>();
 
 	_ahkAccessory->addInfoService(getName(), DOMOTIC_PI_APPLE_HOMEKIT_MANUFACTURER,
 		typeid(MqttAwning).name(), _id, "1.0.0",
 		[this](bool oldValue, bool newValue, void* sender) {
 		this->setState(ON);
-		std::this_thread::sleep_for(std::chrono::seconds(1));
-		this->setState(OFF);
+		_timerWheel->arm(_identifyTimer, std::chrono::seconds(1));
 	});
 
 	_ahkAccessory->addWindowCoveringService(&_targetPosition, &_currentPosition, &_positionState, &_nameInfo);
@@ -52,10 +60,14 @@ MqttAwning::MqttAwning(
 
 MqttAwning::~MqttAwning()
 {
+#ifdef DOMOTIC_PI_APPLE_HOMEKIT
+	_timerWheel->cancel(_identifyTimer);
+#endif
+
 	delete _statSubscription;
 }
 
-void MqttAwning::setValue(int newValue)
+void MqttAwning::setValue(int newValue, Timestamp timestamp)
 {
 	if (newValue > 100) {
 		newValue = 100;
@@ -88,23 +100,25 @@ void MqttAwning::setValue(int newValue)
 
 	_mqttComm->publish(_cmndTopic, message);
 
+	_trace_command(timestamp);
+
 	console->info("MqttAwning::setValue : output '{}' set to '{}'.", _id.c_str(), _value);
 }
 
-void MqttAwning::setState(OutState newState)
+void MqttAwning::setState(OutState newState, Timestamp timestamp)
 {
 	switch (newState) {
 	case ON:
-		setValue(100);
+		setValue(100, timestamp);
 		break;
 	case OFF:
-		setValue(0);
+		setValue(0, timestamp);
 		break;
 	case TOGGLE:
 		if (_value > 0)
-			setValue(0);
+			setValue(0, timestamp);
 		else
-			setValue(100);
+			setValue(100, timestamp);
 		break;
 	default:
 		break;
@@ -130,6 +144,12 @@ std::shared_ptr<MqttAwning> MqttAwning::from_json(const rapidjson::Value& config
 		mqttComm);
 }
 
+std::vector<CommTopic> MqttAwning::getProducedTopics() const
+{
+	// Commands are published on cmnd topic, the device answers on stat topic
+	return std::vector<CommTopic>{ { _mqttComm, _cmndTopic }, { _mqttComm, _statTopic } };
+}
+
 rapidjson::Document MqttAwning::to_json() const
 {
 	rapidjson::Document output = IOutput::to_json();
@@ -162,6 +182,8 @@ void MqttAwning::_stat_message_cb(const struct mosquitto_message * message)
 	std::unique_lock<std::mutex> lck(_valueLock);
 #endif
 
+	_trace_feedback();
+
 	_value = std::atoi(messageString.c_str());
 
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
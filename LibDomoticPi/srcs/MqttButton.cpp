@@ -1,12 +1,12 @@
 #include <MqttButton.h>
 
+#include <Clock.h>
 #include <CommFactory.h>
 #include <domoticPi.h>
 
 #include <exception>
 #include <exceptions.h>
 #include <tuple>
-#include <wiringPi.h>
 
 using namespace domotic_pi;
 
@@ -64,6 +64,11 @@ int MqttButton::getValue() const
 	return _value;
 }
 
+std::vector<CommTopic> MqttButton::getListenedTopics() const
+{
+	return std::vector<CommTopic>{ { _mqttComm, _cmndTopic } };
+}
+
 std::shared_ptr<MqttButton> MqttButton::from_json(const rapidjson::Value& config, DomoticNode_ptr parentNode)
 {
 	const rapidjson::Value& mqttInterface = config["comm"];
@@ -86,6 +91,8 @@ std::shared_ptr<MqttButton> MqttButton::from_json(const rapidjson::Value& config
 		std::get<0>(durations),
 		std::get<1>(durations));
 
+	IButtonStateGenerator::from_json(config, *mqttButton);
+
 	// Set base class attributes from json configuration
 	IInput::from_json(config, mqttButton, parentNode);
 
@@ -119,6 +126,9 @@ rapidjson::Document MqttButton::to_json() const
 
 void MqttButton::_stat_message_cb(const struct mosquitto_message * message)
 {
+	// Stamp message arrival before anything else to trace full event latency
+	Timestamp timestamp = Clock::now();
+
 	// Read and lowercase received message
 	std::string messageString((char *)message->payload, message->payloadlen);
 
@@ -139,5 +149,8 @@ void MqttButton::_stat_message_cb(const struct mosquitto_message * message)
 
 	console->info("MqttButton::_stat_message_cb : input '{}' changed value to '{}'.", getID().c_str(), _value);
 
-	valueChanged(_value);
+	// Each message is a click for gesture recognition
+	buttonStateChange(timestamp);
+
+	valueChanged(_value, timestamp);
 }
\ No newline at end of file
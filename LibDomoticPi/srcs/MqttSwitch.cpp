@@ -1,13 +1,13 @@
 #include <MqttSwitch.h>
 
 #include <CommFactory.h>
+#include <DomoticNode.h>
 #include <domoticPi.h>
 #include <exceptions.h>
 
 #include <algorithm>
 #include <chrono>
 #include <functional>
-#include <thread>
 
 using namespace domotic_pi;
 
@@ -24,6 +24,9 @@ MqttSwitch::MqttSwitch(
 	_statSubscription(_mqttComm->subscribe(_statTopic,
 		std::bind(&MqttSwitch::_stat_message_cb, this, std::placeholders::_1))),
 	_range_min(0), _range_max(1)
+#ifdef DOMOTIC_PI_APPLE_HOMEKIT
+	, _timerWheel(TimerWheel::load())
+#endif
 {
 	if (mqttComm == nullptr) {
 		console->error("MqttSwitch::ctor : given mqtt comm interface can not be null.");
@@ -31,14 +34,18 @@ MqttSwitch::MqttSwitch(
 	}
 
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
+	// Identify blinks the device: switched off again by the timer wheel
+	_identifyTimer = _timerWheel->newTimer([this] {
+		this->setState(OFF);
+	});
+
 	_ahkAccessory = std::make_shared<hap::Accessory>();
 
 	_ahkAccessory->addInfoService(getName(), DOMOTIC_PI_APPLE_HOMEKIT_MANUFACTURER,
 		typeid(MqttSwitch).name(), _id, "1.0.0", 
 		[this](bool oldValue, bool newValue, void* sender) {
 			this->setState(ON);
-			std::this_thread::sleep_for(std::chrono::seconds(2));
-			this->setState(OFF);
+			_timerWheel->arm(_identifyTimer, std::chrono::seconds(2));
 		});
 
 	_ahkAccessory->addSwitchService(&_stateInfo, &_nameInfo);
@@ -58,10 +65,14 @@ MqttSwitch::MqttSwitch(
 
 MqttSwitch::~MqttSwitch()
 {
+#ifdef DOMOTIC_PI_APPLE_HOMEKIT
+	_timerWheel->cancel(_identifyTimer);
+#endif
+
 	delete _statSubscription;
 }
 
-void MqttSwitch::setValue(int newValue)
+void MqttSwitch::setValue(int newValue, Timestamp timestamp)
 {
 #ifdef DOMOTIC_PI_THREAD_SAFE
 	std::unique_lock<std::mutex> lck(_valueLock);
@@ -77,23 +88,25 @@ void MqttSwitch::setValue(int newValue)
 
 	_mqttComm->publish(_cmndTopic, message);
 
+	_trace_command(timestamp);
+
 	console->info("MqttSwitch::setValue : output '{}' set to '{}'.", _id.c_str(), _value);
 }
 
-void MqttSwitch::setState(OutState newState)
+void MqttSwitch::setState(OutState newState, Timestamp timestamp)
 {
 	switch (newState) {
 	case ON:
-		setValue(_range_max);
+		setValue(_range_max, timestamp);
 		break;
 	case OFF:
-		setValue(_range_min);
+		setValue(_range_min, timestamp);
 		break;
 	case TOGGLE:
 		if (_value > _range_min)
-			setValue(_range_min);
+			setValue(_range_min, timestamp);
 		else
-			setValue(_range_max);
+			setValue(_range_max, timestamp);
 		break;
 	default:
 		break;
@@ -119,6 +132,12 @@ std::shared_ptr<MqttSwitch> MqttSwitch::from_json(const rapidjson::Value& config
 		mqttComm);
 }
 
+std::vector<CommTopic> MqttSwitch::getProducedTopics() const
+{
+	// Commands are published on cmnd topic, the device answers on stat topic
+	return std::vector<CommTopic>{ { _mqttComm, _cmndTopic }, { _mqttComm, _statTopic } };
+}
+
 rapidjson::Document MqttSwitch::to_json() const
 {
 	rapidjson::Document output = IOutput::to_json();
@@ -153,6 +172,8 @@ void MqttSwitch::_stat_message_cb(const struct mosquitto_message * message)
 	std::unique_lock<std::mutex> lck(_valueLock);
 #endif
 
+	_trace_feedback();
+
 	if (messageString.compare("on") == 0) {
 		_value = _range_max;
 	}
@@ -1,6 +1,7 @@
 #include <MqttVolume.h>
 
 #include <CommFactory.h>
+#include <DomoticNode.h>
 #include <domoticPi.h>
 #include <exceptions.h>
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
@@ -60,24 +61,24 @@ MqttVolume::~MqttVolume()
 	delete _volumeStat;
 }
 
-void MqttVolume::setState(OutState newState)
+void MqttVolume::setState(OutState newState, Timestamp timestamp)
 {
 	switch (newState)
 	{
 	case ON: {
-		setValue(_range_max);
+		setValue(_range_max, timestamp);
 	}
 		break;
 	case OFF: {
-		setValue(_range_min);
+		setValue(_range_min, timestamp);
 	}
 		break;
 	case TOGGLE: {
 		if (_value == _range_min) {
-			setValue(_range_max);
+			setValue(_range_max, timestamp);
 		}
 		else {
-			setValue(_range_min);
+			setValue(_range_min, timestamp);
 		}
 	}
 		break;
@@ -86,7 +87,7 @@ void MqttVolume::setState(OutState newState)
 	}
 }
 
-void MqttVolume::setValue(int newValue)
+void MqttVolume::setValue(int newValue, Timestamp timestamp)
 {
 	if (newValue < _range_min) {
 		newValue = _range_min;
@@ -101,6 +102,8 @@ void MqttVolume::setValue(int newValue)
 
 	_mqttComm->publish(_volCmndTopic, std::to_string(newValue));
 
+	_trace_command(timestamp);
+
 	console->info("MqttVolume::setValue : output '{}' set to '{}'.", getID(), _value);
 }
 
@@ -123,6 +126,12 @@ std::shared_ptr<MqttVolume> MqttVolume::from_json(const rapidjson::Value& config
 		mqttComm);
 }
 
+std::vector<CommTopic> MqttVolume::getProducedTopics() const
+{
+	// Commands are published on cmnd topic, the device answers on stat topic
+	return std::vector<CommTopic>{ { _mqttComm, _volCmndTopic }, { _mqttComm, _volStatTopic } };
+}
+
 rapidjson::Document MqttVolume::to_json() const
 {
 	rapidjson::Document output = IOutput::to_json();
@@ -156,6 +165,8 @@ void MqttVolume::_vol_stat_cb(const struct mosquitto_message * message)
 	std::unique_lock<std::mutex> lock(_valueLock);
 #endif // DOMOTIC_PI_THREAD_SAFE
 
+	_trace_feedback();
+
 	if (messageString.compare("on") == 0) {
 		_value = _range_max;
 	}
@@ -0,0 +1,331 @@
+#include <OutputTimers.h>
+
+#include <Clock.h>
+#include <domoticPi.h>
+#include <IOutput.h>
+
+#include <algorithm>
+#include <exception>
+#include <limits>
+#include <vector>
+
+using namespace domotic_pi;
+
+std::shared_ptr<OutputTimers> OutputTimers::_outputTimers;
+
+OutputTimers::OutputTimers()
+	: _timerWheel(TimerWheel::load())
+{
+}
+
+OutputTimers::~OutputTimers()
+{
+	std::vector<Timer_ptr> timers;
+
+	{
+		std::unique_lock<std::mutex> lock(_timersLock);
+		for (auto& it : _entries) {
+			timers.push_back(it.second->timer);
+		}
+	}
+
+	for (auto& timer : timers) {
+		_timerWheel->cancel(timer);
+	}
+}
+
+const std::shared_ptr<OutputTimers> OutputTimers::load()
+{
+	if (_outputTimers == nullptr) {
+		_outputTimers = std::make_shared<OutputTimers>();
+	}
+
+	return _outputTimers;
+}
+
+void OutputTimers::switchFor(Output_ptr output, int value, std::chrono::milliseconds duration,
+	TimedMode mode, Timestamp timestamp)
+{
+	Timestamp now = Clock::now();
+	std::shared_ptr<Entry> entry;
+	uint64_t generation;
+
+	{
+		std::unique_lock<std::mutex> lock(_timersLock);
+
+		entry = _entry(output->getID());
+		bool timed = entry->phaseEnd != Timestamp::max() && entry->high && entry->remainingPulses == 0;
+
+		// Extending only makes sense on an output already switched on for a duration
+		if (timed && mode == timed_extend) {
+			entry->phaseEnd += duration;
+		}
+		else {
+			entry->phaseEnd = now + duration;
+		}
+
+		entry->output = output;
+		entry->value = value;
+		entry->high = true;
+		entry->due = false;
+		entry->on = duration;
+		entry->off = std::chrono::milliseconds::zero();
+		entry->remainingPulses = 0;
+		generation = ++entry->generation;
+
+		_arm(*entry);
+	}
+
+	console->debug("OutputTimers::switchFor : output '{}' switched to {} for {} ms.",
+		output->getID().c_str(), value, (long long)duration.count());
+
+	_apply_entry(entry, generation, output, true, value, timestamp);
+}
+
+void OutputTimers::pulse(Output_ptr output, int value, std::chrono::milliseconds on,
+	std::chrono::milliseconds off, unsigned int count, Timestamp timestamp)
+{
+	if (count == 0) {
+		cancel(output->getID());
+		return;
+	}
+
+	std::shared_ptr<Entry> entry;
+	uint64_t generation;
+
+	{
+		std::unique_lock<std::mutex> lock(_timersLock);
+
+		entry = _entry(output->getID());
+
+		entry->output = output;
+		entry->value = value;
+		entry->high = true;
+		entry->due = false;
+		entry->phaseEnd = Clock::now() + on;
+		entry->on = on;
+		entry->off = off;
+		entry->remainingPulses = count - 1;
+		generation = ++entry->generation;
+
+		_arm(*entry);
+	}
+
+	console->debug("OutputTimers::pulse : output '{}' driven by {} pulses of {} ms every {} ms.",
+		output->getID().c_str(), count, (long long)on.count(), (long long)(on + off).count());
+
+	_apply_entry(entry, generation, output, true, value, timestamp);
+}
+
+void OutputTimers::perform(Output_ptr output, int value, const TimedAction& timing, Timestamp timestamp)
+{
+	if (timing.pulses > 0) {
+		pulse(output, value, timing.on, timing.off, timing.pulses, timestamp);
+	}
+	else {
+		switchFor(output, value, timing.on, timing.mode, timestamp);
+	}
+}
+
+void OutputTimers::attach(Output_ptr output)
+{
+	std::shared_ptr<Entry> entry;
+	uint64_t generation;
+	bool high;
+	int value;
+
+	{
+		std::unique_lock<std::mutex> lock(_timersLock);
+
+		auto it = _entries.find(output->getID());
+		if (it == _entries.end() || it->second->phaseEnd == Timestamp::max()) {
+			return;
+		}
+
+		entry = it->second;
+		entry->output = output;
+
+		// Phase change missed while no output was bound: performed by the timer right away
+		if (entry->due) {
+			_timerWheel->arm(entry->timer, std::chrono::milliseconds::zero());
+			return;
+		}
+
+		generation = entry->generation;
+		high = entry->high;
+		value = entry->value;
+	}
+
+	console->info("OutputTimers::attach : output '{}' resumes its running timed action.", output->getID().c_str());
+
+	_apply_entry(entry, generation, output, high, value, Timestamp());
+}
+
+void OutputTimers::cancel(const std::string& outputId)
+{
+	Timer_ptr timer;
+
+	{
+		std::unique_lock<std::mutex> lock(_timersLock);
+
+		auto it = _entries.find(outputId);
+		if (it == _entries.end()) {
+			return;
+		}
+
+		it->second->phaseEnd = Timestamp::max();
+		it->second->remainingPulses = 0;
+		it->second->generation++;
+		timer = it->second->timer;
+	}
+
+	_timerWheel->cancel(timer);
+}
+
+Timestamp OutputTimers::getDeadline(const std::string& outputId) const
+{
+	std::unique_lock<std::mutex> lock(_timersLock);
+
+	auto it = _entries.find(outputId);
+	if (it == _entries.end() || it->second->phaseEnd == Timestamp::max()) {
+		return Timestamp::max();
+	}
+
+	const Entry& entry = *it->second;
+	if (entry.high) {
+		return entry.phaseEnd + entry.remainingPulses * (entry.off + entry.on);
+	}
+
+	return entry.phaseEnd + entry.remainingPulses * entry.on + (entry.remainingPulses - 1) * entry.off;
+}
+
+size_t OutputTimers::getPendingCount() const
+{
+	std::unique_lock<std::mutex> lock(_timersLock);
+
+	return std::count_if(_entries.begin(), _entries.end(), [](const auto& it) {
+		return it.second->phaseEnd != Timestamp::max();
+	});
+}
+
+std::shared_ptr<OutputTimers::Entry> OutputTimers::_entry(const std::string& outputId)
+{
+	auto& entry = _entries[outputId];
+
+	// Entries are kept once created, their timer being reused by the next action
+	if (entry == nullptr) {
+		entry = std::make_shared<Entry>();
+		entry->timer = _timerWheel->newTimer([this, outputId] {
+			_expired(outputId);
+		});
+		entry->phaseEnd = Timestamp::max();
+		entry->generation = 0;
+	}
+
+	return entry;
+}
+
+void OutputTimers::_arm(Entry& entry)
+{
+	auto delay = std::chrono::ceil<std::chrono::milliseconds>(entry.phaseEnd - Clock::now());
+	_timerWheel->arm(entry.timer, delay);
+}
+
+void OutputTimers::_expired(const std::string& outputId)
+{
+	std::shared_ptr<Entry> entryPtr;
+	uint64_t generation;
+	Output_ptr output;
+	bool high;
+	int value;
+
+	{
+		std::unique_lock<std::mutex> lock(_timersLock);
+
+		auto it = _entries.find(outputId);
+		if (it == _entries.end() || it->second->phaseEnd == Timestamp::max()) {
+			return;
+		}
+
+		entryPtr = it->second;
+		auto& entry = *entryPtr;
+		Timestamp now = Clock::now();
+
+		// Deadline moved forward by an extension meanwhile
+		if (!entry.due && entry.phaseEnd > now) {
+			_arm(entry);
+			return;
+		}
+
+		output = entry.output.lock();
+		if (output == nullptr) {
+			// Output being reloaded: the phase change is performed once an output is attached again
+			entry.due = true;
+			return;
+		}
+
+		// Late phases restart from now, so a reload never shortens the following ones
+		Timestamp phaseStart = entry.due ? now : entry.phaseEnd;
+		entry.due = false;
+
+		if (entry.high && entry.remainingPulses > 0) {
+			entry.high = false;
+			entry.phaseEnd = phaseStart + entry.off;
+		}
+		else if (!entry.high) {
+			entry.high = true;
+			entry.remainingPulses--;
+			entry.phaseEnd = phaseStart + entry.on;
+		}
+		else {
+			entry.high = false;
+			entry.phaseEnd = Timestamp::max();
+		}
+
+		if (entry.phaseEnd != Timestamp::max()) {
+			_arm(entry);
+		}
+
+		generation = ++entry.generation;
+		high = entry.high;
+		value = entry.value;
+	}
+
+	try {
+		_apply_entry(entryPtr, generation, output, high, value, Timestamp());
+	}
+	catch (std::exception& e) {
+		console->error("OutputTimers::_expired : could not drive output '{}' : {}", outputId.c_str(), e.what());
+	}
+}
+
+void OutputTimers::_apply_entry(const std::shared_ptr<Entry>& entry, uint64_t generation,
+	const Output_ptr& output, bool high, int value, Timestamp timestamp)
+{
+	// Recursive: driving the output may trigger an event acting on the same output
+	std::unique_lock<std::recursive_mutex> applyLock(entry->applyLock);
+
+	{
+		std::unique_lock<std::mutex> lock(_timersLock);
+
+		// Newer change of the action, already applied or waiting for the apply lock
+		if (entry->generation != generation) {
+			return;
+		}
+	}
+
+	_apply(output, high, value, timestamp);
+}
+
+void OutputTimers::_apply(const Output_ptr& output, bool high, int value, Timestamp timestamp)
+{
+	if (!high) {
+		output->setState(OFF, timestamp);
+	}
+	else if (value == std::numeric_limits<int>::max()) {
+		output->setState(ON, timestamp);
+	}
+	else {
+		output->setValue(value, timestamp);
+	}
+}
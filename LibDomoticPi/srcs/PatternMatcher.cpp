@@ -0,0 +1,208 @@
+#include <PatternMatcher.h>
+
+#include <domoticPi.h>
+#include <ProgrammedEvent.h>
+
+#include <algorithm>
+
+using namespace domotic_pi;
+
+std::shared_ptr<PatternMatcher> PatternMatcher::_patternMatcher;
+
+PatternMatcher::PatternMatcher()
+	: _eventDispatcher(EventDispatcher::load()), _changeCount(0)
+{
+}
+
+const std::shared_ptr<PatternMatcher> PatternMatcher::load()
+{
+	if (_patternMatcher == nullptr) {
+		_patternMatcher = std::make_shared<PatternMatcher>();
+	}
+
+	return _patternMatcher;
+}
+
+void PatternMatcher::addPattern(const InputPattern_ptr& pattern)
+{
+	std::unique_lock<std::mutex> lock(_matcherLock);
+
+	// Sequences can start only from their first step, chords from any of them
+	std::vector<std::string> startInputs;
+	if (pattern->getType() == sequence_pattern) {
+		startInputs.push_back(pattern->getSteps().front().inputId);
+	}
+	else {
+		for (auto& it : pattern->getSteps()) {
+			if (std::find(startInputs.begin(), startInputs.end(), it.inputId) == startInputs.end()) {
+				startInputs.push_back(it.inputId);
+			}
+		}
+	}
+
+	for (auto& it : startInputs) {
+		_startIndex[it].push_back(pattern);
+	}
+
+	console->debug("PatternMatcher::addPattern : {} pattern with {} steps added.",
+		pattern->getType() == sequence_pattern ? "sequence" : "chord", pattern->getSteps().size());
+}
+
+void PatternMatcher::removePattern(const InputPattern_ptr& pattern)
+{
+	std::unique_lock<std::mutex> lock(_matcherLock);
+
+	// Meanwhile expired patterns are removed from the visited buckets
+	for (auto& it : pattern->getSteps()) {
+		auto bucket = _startIndex.find(it.inputId);
+		if (bucket == _startIndex.end()) {
+			continue;
+		}
+
+		auto& patterns = bucket->second;
+		patterns.erase(std::remove_if(patterns.begin(), patterns.end(), [&pattern](const std::weak_ptr<InputPattern>& weak) {
+			InputPattern_ptr indexed = weak.lock();
+			return indexed == nullptr || indexed == pattern;
+		}), patterns.end());
+
+		if (patterns.empty()) {
+			_startIndex.erase(bucket);
+		}
+	}
+
+	_active.remove_if([&pattern](const PartialMatch& match) {
+		return match.pattern == pattern;
+	});
+	pattern->_activeCount = 0;
+
+	console->debug("PatternMatcher::removePattern : {} pattern with {} steps removed.",
+		pattern->getType() == sequence_pattern ? "sequence" : "chord", pattern->getSteps().size());
+}
+
+void PatternMatcher::inputChanged(const std::string& inputId, int value, Timestamp timestamp)
+{
+	std::vector<ProgrammedEvent_ptr> matchedEvents;
+
+	{
+		std::unique_lock<std::mutex> lock(_matcherLock);
+
+		uint64_t change = ++_changeCount;
+
+		// Advance partial matches, dropping the ones whose window is closed
+		for (auto it = _active.begin(); it != _active.end();) {
+			InputPattern& pattern = *it->pattern;
+
+			if (timestamp - it->start > pattern._window) {
+				pattern._activeCount--;
+				it = _active.erase(it);
+				continue;
+			}
+
+			size_t step = pattern._next_step(it->matched, inputId, value);
+			if (step == InputPattern::maxSteps) {
+				++it;
+				continue;
+			}
+
+			it->matched |= (uint64_t)1 << step;
+			pattern._consumedChange = change;
+
+			if (it->matched != pattern._completeMask) {
+				++it;
+				continue;
+			}
+
+			// Several partial matches of the pattern may be completed by the same change
+			if (pattern._matchedChange != change) {
+				pattern._matchedChange = change;
+
+				ProgrammedEvent_ptr programmedEvent = pattern.getProgrammedEvent();
+				if (programmedEvent != nullptr) {
+					matchedEvents.push_back(programmedEvent);
+				}
+			}
+
+			pattern._activeCount--;
+			it = _active.erase(it);
+		}
+
+		// Other partial matches of a matched pattern are dropped, as the steps they matched
+		// may have been matched by the completed one as well
+		for (auto it = _active.begin(); it != _active.end();) {
+			if (it->pattern->_matchedChange == change) {
+				it->pattern->_activeCount--;
+				it = _active.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+
+		// Start new partial matches on patterns which this change begins without advancing them
+		auto bucket = _startIndex.find(inputId);
+		if (bucket != _startIndex.end()) {
+			auto& patterns = bucket->second;
+
+			for (auto it = patterns.begin(); it != patterns.end();) {
+				InputPattern_ptr pattern = it->lock();
+				if (pattern == nullptr) {
+					it = patterns.erase(it);
+					continue;
+				}
+				++it;
+
+				if (pattern->_consumedChange == change) {
+					continue;
+				}
+
+				size_t step = pattern->_next_step(0, inputId, value);
+				if (step == InputPattern::maxSteps) {
+					continue;
+				}
+
+				uint64_t matched = (uint64_t)1 << step;
+				if (matched == pattern->_completeMask) {
+					ProgrammedEvent_ptr programmedEvent = pattern->getProgrammedEvent();
+					if (programmedEvent != nullptr) {
+						matchedEvents.push_back(programmedEvent);
+					}
+					continue;
+				}
+
+				// A partial match holding only the same step is moved to this change, which leaves it more time
+				auto restarted = _active.end();
+				if (pattern->_activeCount > 0) {
+					restarted = std::find_if(_active.begin(), _active.end(), [&pattern, matched](const PartialMatch& match) {
+						return match.pattern == pattern && match.matched == matched;
+					});
+				}
+
+				if (restarted != _active.end()) {
+					restarted->start = timestamp;
+					continue;
+				}
+
+				pattern->_activeCount++;
+				_active.push_back(PartialMatch{ pattern, matched, timestamp });
+			}
+
+			if (patterns.empty()) {
+				_startIndex.erase(bucket);
+			}
+		}
+	}
+
+	for (auto& it : matchedEvents) {
+		console->debug("PatternMatcher::inputChanged : pattern matched on input '{}', triggering event '{}'.",
+			inputId.c_str(), it->getID().c_str());
+
+		_eventDispatcher->dispatch(it, timestamp);
+	}
+}
+
+size_t PatternMatcher::getActiveCount() const
+{
+	std::unique_lock<std::mutex> lock(_matcherLock);
+
+	return _active.size();
+}
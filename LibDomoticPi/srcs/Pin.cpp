@@ -1,42 +1,20 @@
 #include <Pin.h>
 
 #include <domoticPi.h>
-#include <exceptions.h>
 
-#include <stdexcept>
-#include <wiringPi.h>
+#include <exception>
 
 using namespace domotic_pi;
 
-bool Pin::_inUse[DOMOTIC_PI_MAX_PIN];
-#ifdef DOMOTIC_PI_THREAD_SAFE
-std::mutex Pin::_pinLock;
-#endif
-
-Pin::Pin(int pin) : _pin(pin) {
+Pin::Pin(int pin, const std::string& owner, unsigned int required, unsigned int chip) 
+	: _pin(pin), _chip(chip), _gpio(IGpioBackend::load(pin < 0 ? 0 : chip)), _pinRegistry(PinRegistry::load()) {
 	// When pin number is negative, no pin is requested
 	if (pin < 0) 
 		return;
 
-	if (pin > DOMOTIC_PI_MAX_PIN) {
-		console->error("Pin::ctor : pin {} not present.", pin);
-		throw std::out_of_range("Pin number must be between 0 and " STR(DOMOTIC_PI_MAX_PIN) ".");
-	}
-
-#ifdef DOMOTIC_PI_THREAD_SAFE
-	std::unique_lock<std::mutex> lck(_pinLock);
-#endif
-
-	// If requested pin is already in use throw
-	if (_inUse[pin]) {
-		console->error("Pin::ctor : pin {} is already in use.", pin);
-		throw domotic_pi_exception("Requested pin is alreay in use.");
-	}
-
-	// Else set pin in use and release lock
-	_inUse[pin] = true;
+	_pinRegistry->acquire(chip, pin, owner, required);
 
-	console->info("Pin::ctor : pin {} locked.", pin);
+	console->info("Pin::ctor : pin {} of chip {} locked by '{}'.", pin, chip, owner.c_str());
 }
 
 Pin::~Pin() {
@@ -44,20 +22,28 @@ Pin::~Pin() {
 	if (_pin < 0)
 		return;
 
-#ifdef DOMOTIC_PI_THREAD_SAFE
-	std::unique_lock<std::mutex> lck(_pinLock);
-#endif
-
-	// Reset pin status to not in use when destroying the object
-	_inUse[_pin] = false;
+	// Reset pin mode and pull before another object can lock it
+	GpioMode mode;
+	GpioPull pull;
+	if (_pinRegistry->getReleaseState(_chip, mode, pull)) {
+		try {
+			_gpio->setMode(getPin(), mode);
+			_gpio->setPull(getPin(), pull);
+		}
+		catch (std::exception& e) {
+			console->error("Pin::dtor : could not reset pin {} : {}", _pin, e.what());
+		}
+	}
 
-	// Reset pin mode and pull to standard state
-	pinMode(getPin(), DOMOTIC_PI_PIN_STANDARD_MODE);
-	pullUpDnControl(getPin(), DOMOTIC_PI_PIN_STANDARD_PUD);
+	_pinRegistry->release(_chip, _pin);
 
-	console->info("Pin::dtor : pin {} unlocked.", _pin);
+	console->info("Pin::dtor : pin {} of chip {} unlocked.", _pin, _chip);
 }
 
 int Pin::getPin() const {
 	return _pin;
-}
\ No newline at end of file
+}
+
+unsigned int Pin::getChip() const {
+	return _chip;
+}
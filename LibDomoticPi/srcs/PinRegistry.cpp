@@ -0,0 +1,263 @@
+#include <PinRegistry.h>
+
+#include <domoticPi.h>
+#include <exceptions.h>
+
+#include <stdexcept>
+
+using namespace domotic_pi;
+
+std::shared_ptr<PinRegistry> PinRegistry::_pinRegistry;
+
+// Readable list of capability flags, for logs and errors
+static std::string capabilityNames(unsigned int capabilities)
+{
+	static const char * names[] = { "pwm", "pull", "interrupt" };
+
+	std::string result;
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+		if (capabilities & (1u << i)) {
+			result += result.empty() ? names[i] : std::string(", ") + names[i];
+		}
+	}
+
+	return result;
+}
+
+PinRegistry::PinRegistry()
+	: _ownerNames(nullptr)
+{
+	for (size_t chip = 0; chip < _chips.size(); ++chip) {
+		Chip& it = _chips[chip];
+
+		it.lineCount = DOMOTIC_PI_MAX_PIN + 1;
+		for (auto& bank : it.used) {
+			bank = 0;
+		}
+		for (auto& capabilities : it.capabilities) {
+			capabilities = pin_cap_all;
+		}
+		for (auto& owner : it.owners) {
+			owner = nullptr;
+		}
+
+		it.reset = true;
+		it.releaseMode = DOMOTIC_PI_PIN_STANDARD_MODE;
+		it.releasePull = DOMOTIC_PI_PIN_STANDARD_PUD;
+	}
+}
+
+PinRegistry::~PinRegistry()
+{
+	for (OwnerName* name = _ownerNames.load(); name != nullptr; ) {
+		OwnerName* next = name->next;
+		delete name;
+		name = next;
+	}
+}
+
+const std::shared_ptr<PinRegistry> PinRegistry::load()
+{
+	if (_pinRegistry == nullptr) {
+		_pinRegistry = std::make_shared<PinRegistry>();
+	}
+
+	return _pinRegistry;
+}
+
+void PinRegistry::declareChip(unsigned int chip, int lineCount, unsigned int capabilities)
+{
+	if (chip >= _chips.size()) {
+		console->error("PinRegistry::declareChip : chip {} not supported.", chip);
+		throw std::out_of_range("Chip index must be lower than " STR(DOMOTIC_PI_MAX_CHIPS) ".");
+	}
+
+	if (lineCount < 0 || lineCount > DOMOTIC_PI_MAX_PIN + 1) {
+		console->error("PinRegistry::declareChip : chip {} can not have {} lines.", chip, lineCount);
+		throw std::out_of_range("Chip lines must be numbered between 0 and " STR(DOMOTIC_PI_MAX_PIN) ".");
+	}
+
+	Chip& it = _chips[chip];
+	for (auto& pinCapabilities : it.capabilities) {
+		pinCapabilities.store(capabilities, std::memory_order_relaxed);
+	}
+	it.lineCount.store(lineCount, std::memory_order_release);
+
+	console->info("PinRegistry::declareChip : chip {} declared with {} lines ({}).",
+		chip, lineCount, capabilityNames(capabilities).c_str());
+}
+
+int PinRegistry::getLineCount(unsigned int chip) const
+{
+	return chip < _chips.size() ? _chips[chip].lineCount.load(std::memory_order_acquire) : 0;
+}
+
+void PinRegistry::setCapabilities(unsigned int chip, int pin, unsigned int capabilities)
+{
+	_chip(chip, pin).capabilities[pin].store(capabilities, std::memory_order_relaxed);
+}
+
+unsigned int PinRegistry::getCapabilities(unsigned int chip, int pin) const
+{
+	return _chip(chip, pin).capabilities[pin].load(std::memory_order_relaxed);
+}
+
+void PinRegistry::setReleaseState(unsigned int chip, bool reset, GpioMode mode, GpioPull pull)
+{
+	if (chip >= _chips.size()) {
+		throw std::out_of_range("Chip index must be lower than " STR(DOMOTIC_PI_MAX_CHIPS) ".");
+	}
+
+	Chip& it = _chips[chip];
+	it.releaseMode.store(mode, std::memory_order_relaxed);
+	it.releasePull.store(pull, std::memory_order_relaxed);
+	it.reset.store(reset, std::memory_order_relaxed);
+}
+
+bool PinRegistry::getReleaseState(unsigned int chip, GpioMode& mode, GpioPull& pull) const
+{
+	if (chip >= _chips.size()) {
+		return false;
+	}
+
+	const Chip& it = _chips[chip];
+	mode = (GpioMode)it.releaseMode.load(std::memory_order_relaxed);
+	pull = (GpioPull)it.releasePull.load(std::memory_order_relaxed);
+
+	return it.reset.load(std::memory_order_relaxed);
+}
+
+void PinRegistry::acquire(unsigned int chip, int pin, const std::string& owner, unsigned int required)
+{
+	Chip& it = _chip(chip, pin);
+
+	unsigned int missing = required & ~it.capabilities[pin].load(std::memory_order_relaxed);
+	if (missing) {
+		console->error("PinRegistry::acquire : pin {} of chip {} requested by '{}' has no {} capability.",
+			pin, chip, owner.c_str(), capabilityNames(missing).c_str());
+		throw domotic_pi_exception("Pin " + std::to_string(pin) + " of chip " + std::to_string(chip) +
+			" has no " + capabilityNames(missing) + " capability.");
+	}
+
+	// Only the request setting the bit owns the pin
+	uint64_t bit = (uint64_t)1 << (pin % 64);
+	if (it.used[pin / 64].fetch_or(bit, std::memory_order_acq_rel) & bit) {
+		const std::string* current = it.owners[pin].load(std::memory_order_acquire);
+		std::string currentOwner = current != nullptr ? *current : "a module being created";
+
+		console->error("PinRegistry::acquire : pin {} of chip {} requested by '{}' is already in use by '{}'.",
+			pin, chip, owner.c_str(), currentOwner.c_str());
+		throw domotic_pi_exception("Pin " + std::to_string(pin) + " of chip " + std::to_string(chip) +
+			" is already in use by '" + currentOwner + "'.");
+	}
+
+	it.owners[pin].store(_intern(owner), std::memory_order_release);
+}
+
+void PinRegistry::release(unsigned int chip, int pin)
+{
+	Chip& it = _chip(chip, pin);
+
+	it.owners[pin].store(nullptr, std::memory_order_release);
+	it.used[pin / 64].fetch_and(~((uint64_t)1 << (pin % 64)), std::memory_order_acq_rel);
+}
+
+bool PinRegistry::isInUse(unsigned int chip, int pin) const
+{
+	const Chip& it = _chip(chip, pin);
+
+	return (it.used[pin / 64].load(std::memory_order_acquire) >> (pin % 64)) & 1;
+}
+
+std::string PinRegistry::getOwner(unsigned int chip, int pin) const
+{
+	const std::string* owner = _chip(chip, pin).owners[pin].load(std::memory_order_acquire);
+
+	return owner != nullptr ? *owner : std::string();
+}
+
+size_t PinRegistry::getUsedCount() const
+{
+	size_t count = 0;
+
+	for (auto& it : _chips) {
+		for (auto& bank : it.used) {
+			count += __builtin_popcountll(bank.load(std::memory_order_relaxed));
+		}
+	}
+
+	return count;
+}
+
+rapidjson::Document PinRegistry::to_json() const
+{
+	rapidjson::Document pins(rapidjson::kObjectType);
+
+	for (size_t chip = 0; chip < _chips.size(); ++chip) {
+		const Chip& it = _chips[chip];
+		rapidjson::Value owners(rapidjson::kObjectType);
+
+		for (size_t bank = 0; bank < it.used.size(); ++bank) {
+			for (uint64_t used = it.used[bank].load(std::memory_order_acquire); used; used &= used - 1) {
+				int pin = (int)(bank * 64 + __builtin_ctzll(used));
+				const std::string* owner = it.owners[pin].load(std::memory_order_acquire);
+
+				rapidjson::Value key(std::to_string(pin).c_str(), pins.GetAllocator());
+				rapidjson::Value value(owner != nullptr ? owner->c_str() : "", pins.GetAllocator());
+				owners.AddMember(key, value, pins.GetAllocator());
+			}
+		}
+
+		if (owners.MemberCount() > 0) {
+			rapidjson::Value key(std::to_string(chip).c_str(), pins.GetAllocator());
+			pins.AddMember(key, owners, pins.GetAllocator());
+		}
+	}
+
+	return pins;
+}
+
+const std::string* PinRegistry::_intern(const std::string& owner)
+{
+	OwnerName* head = _ownerNames.load(std::memory_order_acquire);
+	for (OwnerName* it = head; it != nullptr; it = it->next) {
+		if (it->name == owner) {
+			return &it->name;
+		}
+	}
+
+	OwnerName* name = new OwnerName{ owner, head };
+
+	// Names pushed meanwhile are checked before trying again, so each name is interned once
+	while (!_ownerNames.compare_exchange_weak(name->next, name, std::memory_order_acq_rel, std::memory_order_acquire)) {
+		for (OwnerName* it = name->next; it != head; it = it->next) {
+			if (it->name == owner) {
+				delete name;
+				return &it->name;
+			}
+		}
+		head = name->next;
+	}
+
+	return &name->name;
+}
+
+PinRegistry::Chip& PinRegistry::_chip(unsigned int chip, int pin)
+{
+	return const_cast<Chip&>(static_cast<const PinRegistry&>(*this)._chip(chip, pin));
+}
+
+const PinRegistry::Chip& PinRegistry::_chip(unsigned int chip, int pin) const
+{
+	if (chip >= _chips.size()) {
+		console->error("PinRegistry : chip {} not supported.", chip);
+		throw std::out_of_range("Chip index must be lower than " STR(DOMOTIC_PI_MAX_CHIPS) ".");
+	}
+
+	if (pin < 0 || pin >= getLineCount(chip)) {
+		console->error("PinRegistry : pin {} not present on chip {}.", pin, chip);
+		throw std::out_of_range("Pin number must be between 0 and the last line of its chip.");
+	}
+
+	return _chips[chip];
+}
@@ -1,19 +1,52 @@
 #include <ProgrammedEvent.h>
 
+#include <Clock.h>
 #include <DomoticNode.h>
 #include <domoticPi.h>
+#include <EventDispatcher.h>
 #include <exceptions.h>
+#include <GpioWriteBatch.h>
 #include <IOutput.h>
+#include <PatternMatcher.h>
+
+#include <algorithm>
+#include <exception>
+#include <limits>
 
 using namespace domotic_pi;
 
-ProgrammedEvent::ProgrammedEvent(const std::string& id) : _id(id)
+ProgrammedEvent::ProgrammedEvent(const std::string& id) 
+	: _id(id), _timerWheel(TimerWheel::load()), _outputTimers(OutputTimers::load()), _gpio(IGpioBackend::load()), _patternMatcher(PatternMatcher::load()), _priority(normal_priority),
+	_breakerRate(DOMOTIC_PI_EVENT_BREAKER_RATE), 
+	_breakerCooldown(std::chrono::milliseconds(DOMOTIC_PI_EVENT_BREAKER_COOLDOWN_MS)),
+	_breakerTokens(DOMOTIC_PI_EVENT_BREAKER_RATE), _breakerRefill(Clock::now()),
+	_suspended(false), _discardedCount(0), _tripCount(0)
 {
+	_resumeTimer = _timerWheel->newTimer([this] {
+		resume();
+	});
 }
 
 ProgrammedEvent::~ProgrammedEvent()
 {
-	_outputValuePairs.clear();
+	_timerWheel->cancel(_resumeTimer);
+
+	// Pending schedules and delayed actions must not outlive the event
+	for (auto& it : _schedules) {
+		_timerWheel->cancel(it.timer);
+	}
+	_schedules.clear();
+
+	for (auto& it : _outputActions) {
+		_timerWheel->cancel(it.delayTimer);
+	}
+	_outputActions.clear();
+
+	// Partial matches of the patterns must not trigger a deleted event
+	for (auto& it : _patterns) {
+		_patternMatcher->removePattern(it);
+	}
+	_patterns.clear();
 }
 
 std::shared_ptr<ProgrammedEvent> ProgrammedEvent::from_json(
@@ -45,11 +78,31 @@ std::shared_ptr<ProgrammedEvent> ProgrammedEvent::from_json(
 	for (auto& it : actions) {
 		Output_ptr output = parentNode->getOutput(it["outputId"].GetString());
 		if (output != nullptr) {
+			// Action delay is expressed in seconds
+			std::chrono::milliseconds delay = it.HasMember("delay") ? 
+				std::chrono::milliseconds((long long)(it["delay"].GetDouble() * 1000)) : std::chrono::milliseconds::zero();
+
+			// Durations of timed and pulsed actions are expressed in seconds too
+			TimedAction timing;
+			if (it.HasMember("pulses")) {
+				const rapidjson::Value& pulses = it["pulses"];
+				timing.pulses = pulses["count"].GetUint();
+				timing.on = std::chrono::milliseconds((long long)(pulses["on"].GetDouble() * 1000));
+				timing.off = pulses.HasMember("off") ?
+					std::chrono::milliseconds((long long)(pulses["off"].GetDouble() * 1000)) : timing.on;
+			}
+			else if (it.HasMember("duration")) {
+				timing.on = std::chrono::milliseconds((long long)(it["duration"].GetDouble() * 1000));
+				if (it.HasMember("mode") && std::string(it["mode"].GetString()) == "extend") {
+					timing.mode = timed_extend;
+				}
+			}
 
-			pe->_outputValuePairs.push_back(
-				std::make_pair(
-					std::weak_ptr<IOutput>(output), 
-					it.HasMember("outputValue") ? it["outputValue"].GetInt() : std::numeric_limits<int>::max()));
+			pe->addOutputAction(
+				output, 
+				it.HasMember("outputValue") ? it["outputValue"].GetInt() : std::numeric_limits<int>::max(),
+				delay,
+				timing);
 		}
 		else {
 			console->warn("ProgrammedEvent::from_json : output {} not found in node {}",
@@ -57,6 +110,34 @@ std::shared_ptr<ProgrammedEvent> ProgrammedEvent::from_json(
 		}
 	}
 
+	if (config.HasMember("priority")) {
+		pe->setPriority(EventDispatcher::getPriority(config["priority"].GetString()));
+	}
+
+	// Override default circuit breaker settings, cooldown is expressed in seconds
+	if (config.HasMember("circuitBreaker")) {
+		const rapidjson::Value& breaker = config["circuitBreaker"];
+		pe->setCircuitBreaker(
+			breaker["maxRate"].GetDouble(),
+			breaker.HasMember("cooldown") ? 
+				std::chrono::milliseconds((long long)(breaker["cooldown"].GetDouble() * 1000)) : 
+				std::chrono::milliseconds(DOMOTIC_PI_EVENT_BREAKER_COOLDOWN_MS));
+	}
+
+	// Load cron schedules triggering this event
+	if (config.HasMember("schedules")) {
+		for (auto& it : config["schedules"].GetArray()) {
+			pe->addSchedule(it.GetString());
+		}
+	}
+
+	// Load input chords and sequences triggering this event
+	if (config.HasMember("patterns")) {
+		for (auto& it : config["patterns"].GetArray()) {
+			pe->addPattern(InputPattern::from_json(it, pe));
+		}
+	}
+
 	// Add new programmed event to parent node
 	parentNode->addProgrammedEvent(pe);
 
@@ -71,60 +152,351 @@ const std::string &ProgrammedEvent::getID() const
 	return _id;
 }
 
-void ProgrammedEvent::addOutputAction(Output_ptr outputModule, int newValue)
+void ProgrammedEvent::addOutputAction(Output_ptr outputModule, int newValue, std::chrono::milliseconds delay,
+	const TimedAction& timing)
 {
 #ifdef DOMOTIC_PI_THREAD_SAFE
-	std::unique_lock<std::shared_mutex> lock(_outputValuePairsLock);
+	std::unique_lock<std::shared_mutex> lock(_outputActionsLock);
 #endif
 	// If given output is already present erase it and insert the new occurence in the list
 	// Meanwhile expired pointers are removed
-	for (auto it = _outputValuePairs.begin(); it != _outputValuePairs.end(); ++it) {
-		if (it->first.expired() || it->first.lock()->getID() == outputModule->getID()) {
-			_outputValuePairs.erase(it);
+	for (auto it = _outputActions.begin(); it != _outputActions.end();) {
+		if (it->output.expired() || it->output.lock()->getID() == outputModule->getID()) {
+			_timerWheel->cancel(it->delayTimer);
+			it = _outputActions.erase(it);
+		}
+		else {
+			++it;
 		}
 	}
 
-	// Make and push the new output-value pair in the list
-	_outputValuePairs.push_back(std::make_pair(std::weak_ptr<IOutput>(outputModule), newValue));
+	// Make and push the new output action in the list
+	OutputAction action{ outputModule, newValue, delay, nullptr, timing };
+
+	// Delayed actions get their own timer, re-armed on each event trigger
+	if (delay > std::chrono::milliseconds::zero()) {
+		std::weak_ptr<IOutput> output(outputModule);
+		auto outputTimers = _outputTimers;
+		action.delayTimer = _timerWheel->newTimer([output, newValue, timing, outputTimers] {
+			_perform_action(output, newValue, timing, outputTimers, Timestamp());
+		});
+	}
+
+	_outputActions.push_back(action);
 
-	console->debug("ProgrammedEvent::addOutputAction : action for output '{}' at value {} added to event ''.",
-		outputModule->getID().c_str(), newValue, _id.c_str());
+	console->debug("ProgrammedEvent::addOutputAction : action for output '{}' at value {} "
+		"with {} ms delay added to event '{}'.",
+		outputModule->getID().c_str(), newValue, (long long)delay.count(), _id.c_str());
 }
 
 void ProgrammedEvent::removeOutputAction(const std::string& outputId)
 {
 #ifdef DOMOTIC_PI_THREAD_SAFE
-	std::unique_lock<std::shared_mutex> lock(_outputValuePairsLock);
+	std::unique_lock<std::shared_mutex> lock(_outputActionsLock);
 #endif
 
 	// Remove required value and check for expired pointer meanwhile
-	for (auto it = _outputValuePairs.begin(); it != _outputValuePairs.end(); ++it) {
-		if (it->first.expired() || it->first.lock()->getID() == outputId) {
-			_outputValuePairs.erase(it);
+	for (auto it = _outputActions.begin(); it != _outputActions.end();) {
+		if (it->output.expired() || it->output.lock()->getID() == outputId) {
+			console->debug("ProgrammedEvent::removeOutputAction : action for output '{}' at value {} removed from event '{}'.",
+				outputId.c_str(), it->value, _id.c_str());
 
-			console->debug("ProgrammedEvent::removeOutputAction : action for output '{}' at value {} removed from event ''.",
-				outputId.c_str(), it->second, _id.c_str());
+			_timerWheel->cancel(it->delayTimer);
+			it = _outputActions.erase(it);
+		}
+		else {
+			++it;
 		}
 	}
 }
 
-void ProgrammedEvent::triggerEvent() const
+std::vector<Output_ptr> ProgrammedEvent::getOutputs() const
 {
 #ifdef DOMOTIC_PI_THREAD_SAFE
-	std::shared_lock<std::shared_mutex> lock(_outputValuePairsLock);
+	std::shared_lock<std::shared_mutex> lock(_outputActionsLock);
 #endif
 
-	// Set each output to stored value
-	for (auto& it : _outputValuePairs) {
-		if (!it.first.expired()) {
-			if (it.second == std::numeric_limits<int>::max()) {
-				it.first.lock()->setState(TOGGLE);
-			}
-			else {
-				it.first.lock()->setValue(it.second);
-			}
+	std::vector<Output_ptr> outputs;
+	for (auto& it : _outputActions) {
+		Output_ptr output = it.output.lock();
+		if (output != nullptr) {
+			outputs.push_back(output);
+		}
+	}
+
+	return outputs;
+}
+
+void ProgrammedEvent::addSchedule(const std::string& cronExpression)
+{
+	// Parse before touching the list, so invalid expressions leave the event unchanged
+	CronSchedule cron(cronExpression);
+
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> lock(_schedulesLock);
+#endif
+
+	for (auto& it : _schedules) {
+		if (it.cron.getExpression() == cronExpression) {
+			return;
+		}
+	}
+
+	_schedules.push_back(Schedule{ cron, nullptr, std::chrono::system_clock::time_point::min() });
+	Schedule& schedule = _schedules.back();
+
+	schedule.timer = _timerWheel->newTimer([this, &schedule] {
+		console->info("ProgrammedEvent::__schedule_lambda : event '{}' triggered by schedule '{}'.",
+			_id.c_str(), schedule.cron.getExpression().c_str());
+
+		try {
+			triggerEvent();
+		}
+		catch (std::exception& e) {
+			console->warn("ProgrammedEvent::__schedule_lambda : exception during scheduled "
+				"trigger of event '{}' : {}", _id.c_str(), e.what());
+		}
+
+		_arm_schedule(schedule);
+	});
+
+	_arm_schedule(schedule);
+
+	console->debug("ProgrammedEvent::addSchedule : schedule '{}' added to event '{}'.",
+		cronExpression.c_str(), _id.c_str());
+}
+
+void ProgrammedEvent::removeSchedule(const std::string& cronExpression)
+{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> lock(_schedulesLock);
+#endif
+
+	for (auto it = _schedules.begin(); it != _schedules.end(); ++it) {
+		if (it->cron.getExpression() == cronExpression) {
+			_timerWheel->cancel(it->timer);
+			_schedules.erase(it);
+
+			console->debug("ProgrammedEvent::removeSchedule : schedule '{}' removed from event '{}'.",
+				cronExpression.c_str(), _id.c_str());
+			break;
+		}
+	}
+}
+
+void ProgrammedEvent::addPattern(
+	PatternType type, 
+	const std::vector<InputPattern::Step>& steps, 
+	std::chrono::milliseconds window)
+{
+	addPattern(std::make_shared<InputPattern>(type, steps, window, weak_from_this()));
+}
+
+void ProgrammedEvent::addPattern(const InputPattern_ptr& pattern)
+{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> lock(_patternsLock);
+#endif
+
+	_patterns.push_back(pattern);
+	_patternMatcher->addPattern(pattern);
+
+	console->debug("ProgrammedEvent::addPattern : {} of {} inputs within {} ms added to event '{}'.",
+		pattern->getType() == sequence_pattern ? "sequence" : "chord", pattern->getSteps().size(),
+		(long long)pattern->getWindow().count(), _id.c_str());
+}
+
+std::vector<InputPattern_ptr> ProgrammedEvent::getPatterns() const
+{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> lock(_patternsLock);
+#endif
+
+	return std::vector<InputPattern_ptr>(_patterns.begin(), _patterns.end());
+}
+
+void ProgrammedEvent::setPriority(EventPriority priority)
+{
+	_priority = priority;
+
+	console->debug("ProgrammedEvent::setPriority : event '{}' priority set to '{}'.",
+		_id.c_str(), EventDispatcher::getPriorityName(priority));
+}
+
+EventPriority ProgrammedEvent::getPriority() const
+{
+	return _priority;
+}
+
+void ProgrammedEvent::triggerEvent(Timestamp timestamp) const
+{
+	if (timestamp == Timestamp()) {
+		timestamp = Clock::now();
+	}
+
+	// Safety events must never be held back
+	if (_priority != safety_priority && !_breaker_allows(Clock::now())) {
+		return;
+	}
+
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::shared_lock<std::shared_mutex> lock(_outputActionsLock);
+#endif
+
+	// Pins of immediate actions are switched together once all the actions are performed
+	GpioWriteBatch gpioBatch(_gpio);
+
+	// Set each output to stored value, or restart the delay of delayed ones
+	for (auto& it : _outputActions) {
+		if (it.delayTimer != nullptr) {
+			_timerWheel->arm(it.delayTimer, it.delay);
 		}
+		else {
+			_perform_action(it.output, it.value, it.timing, _outputTimers, timestamp);
+		}
+	}
+
+	gpioBatch.commit();
+
+	_latency.recordSince(timestamp);
+}
+
+const LatencyHistogram& ProgrammedEvent::getLatency() const
+{
+	return _latency;
+}
+
+void ProgrammedEvent::setCircuitBreaker(double maxRate, std::chrono::milliseconds cooldown)
+{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> lock(_breakerLock);
+#endif
+
+	_breakerRate = maxRate > 0 ? maxRate : 0;
+	_breakerCooldown = cooldown > std::chrono::milliseconds::zero() ? cooldown : std::chrono::milliseconds::zero();
+
+	// Allow up to one second of triggers at maximum rate in a row, at least one
+	_breakerTokens = std::max(1.0, _breakerRate);
+	_breakerRefill = Clock::now();
+
+	console->debug("ProgrammedEvent::setCircuitBreaker : event '{}' breaker set to {} triggers/s, {} ms cooldown.",
+		_id.c_str(), _breakerRate, (long long)_breakerCooldown.count());
+}
+
+double ProgrammedEvent::getCircuitBreakerRate() const
+{
+	return _breakerRate;
+}
+
+std::chrono::milliseconds ProgrammedEvent::getCircuitBreakerCooldown() const
+{
+	return _breakerCooldown;
+}
+
+bool ProgrammedEvent::isSuspended() const
+{
+	return _suspended;
+}
+
+void ProgrammedEvent::resume()
+{
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> lock(_breakerLock);
+#endif
+
+	if (!_suspended) {
+		return;
+	}
+
+	_suspended = false;
+	_breakerTokens = std::max(1.0, _breakerRate);
+	_breakerRefill = Clock::now();
+
+	console->warn("ProgrammedEvent::resume : event '{}' resumed after {} discarded triggers.",
+		_id.c_str(), getDiscardedCount());
+}
+
+uint64_t ProgrammedEvent::getDiscardedCount() const
+{
+	return _discardedCount.load(std::memory_order_relaxed);
+}
+
+uint64_t ProgrammedEvent::getTripCount() const
+{
+	return _tripCount.load(std::memory_order_relaxed);
+}
+
+bool ProgrammedEvent::_breaker_allows(Timestamp now) const
+{
+	if (_suspended) {
+		_discardedCount.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> lock(_breakerLock);
+#endif
+
+	if (_breakerRate <= 0) {
+		return true;
+	}
+
+	// Token bucket holding one second of triggers at maximum rate, and at least
+	// one trigger so that rates below one per second can ever be reached
+	double elapsed = std::chrono::duration<double>(now - _breakerRefill).count();
+	_breakerTokens = std::min(std::max(1.0, _breakerRate), _breakerTokens + elapsed * _breakerRate);
+	_breakerRefill = now;
+
+	if (_breakerTokens >= 1) {
+		_breakerTokens -= 1;
+		return true;
 	}
+
+	_suspended = true;
+	_tripCount.fetch_add(1, std::memory_order_relaxed);
+	_discardedCount.fetch_add(1, std::memory_order_relaxed);
+
+	_timerWheel->arm(_resumeTimer, _breakerCooldown);
+
+	console->error("ProgrammedEvent::_breaker_allows : event '{}' triggered above {} times/s, "
+		"suspended for {} ms (possible feedback loop).", _id.c_str(), _breakerRate, (long long)_breakerCooldown.count());
+
+	return false;
+}
+
+void ProgrammedEvent::_perform_action(const std::weak_ptr<IOutput>& output, int value, const TimedAction& timing,
+	const std::shared_ptr<OutputTimers>& outputTimers, Timestamp timestamp)
+{
+	auto outputModule = output.lock();
+	if (outputModule == nullptr) {
+		return;
+	}
+
+	// Timed actions switch the output off later through the shared output timers
+	if (timing.on > std::chrono::milliseconds::zero()) {
+		outputTimers->perform(outputModule, value, timing, timestamp);
+	}
+	else if (value == std::numeric_limits<int>::max()) {
+		outputModule->setState(TOGGLE, timestamp);
+	}
+	else {
+		outputModule->setValue(value, timestamp);
+	}
+}
+
+void ProgrammedEvent::_arm_schedule(Schedule& schedule)
+{
+	// Never compute next occurrence from an earlier time than the one just served,
+	// so a timer expiring slightly ahead of wall clock does not fire twice
+	auto now = std::chrono::system_clock::now();
+	schedule.nextTrigger = schedule.cron.next(std::max(now, schedule.nextTrigger));
+
+	if (schedule.nextTrigger == std::chrono::system_clock::time_point::max()) {
+		return;
+	}
+
+	_timerWheel->arm(schedule.timer, 
+		std::chrono::duration_cast<std::chrono::milliseconds>(schedule.nextTrigger - now));
 }
 
 rapidjson::Document ProgrammedEvent::to_json() const
@@ -137,15 +509,15 @@ rapidjson::Document ProgrammedEvent::to_json() const
 	programmedEvent.AddMember("id", id, programmedEvent.GetAllocator());
 
 #ifdef DOMOTIC_PI_THREAD_SAFE
-	std::shared_lock<std::shared_mutex> lock(_outputValuePairsLock);
+	std::shared_lock<std::shared_mutex> lock(_outputActionsLock);
 #endif
 
 	// Set each output action from this event
 	rapidjson::Value outputActions(rapidjson::kArrayType);
-	for (auto& it : _outputValuePairs) {
+	for (auto& it : _outputActions) {
 		// Only still valid actions are set
-		if (!it.first.expired()) {
-			auto output = it.first.lock();
+		if (!it.output.expired()) {
+			auto output = it.output.lock();
 
 			rapidjson::Value outputAction(rapidjson::kObjectType);
 
@@ -154,17 +526,79 @@ rapidjson::Document ProgrammedEvent::to_json() const
 			outputAction.AddMember("outputId", outputId, programmedEvent.GetAllocator());
 
 			// Output value should be set only when necessary
-			if (it.second != std::numeric_limits<int>::max()) {
+			if (it.value != std::numeric_limits<int>::max()) {
 				rapidjson::Value outputValue;
-				outputValue.SetInt(it.second);
+				outputValue.SetInt(it.value);
 				outputAction.AddMember("outputValue", outputValue, programmedEvent.GetAllocator());
 			}
 
+			if (it.delay != std::chrono::milliseconds::zero()) {
+				rapidjson::Value delay;
+				delay.SetDouble(it.delay.count() / 1000.0);
+				outputAction.AddMember("delay", delay, programmedEvent.GetAllocator());
+			}
+
+			if (it.timing.pulses > 0) {
+				rapidjson::Value pulses(rapidjson::kObjectType);
+				pulses.AddMember("count", it.timing.pulses, programmedEvent.GetAllocator());
+				pulses.AddMember("on", it.timing.on.count() / 1000.0, programmedEvent.GetAllocator());
+				pulses.AddMember("off", it.timing.off.count() / 1000.0, programmedEvent.GetAllocator());
+				outputAction.AddMember("pulses", pulses, programmedEvent.GetAllocator());
+			}
+			else if (it.timing.on > std::chrono::milliseconds::zero()) {
+				outputAction.AddMember("duration", it.timing.on.count() / 1000.0, programmedEvent.GetAllocator());
+				if (it.timing.mode == timed_extend) {
+					outputAction.AddMember("mode", "extend", programmedEvent.GetAllocator());
+				}
+			}
+
 			outputActions.PushBack(outputAction, programmedEvent.GetAllocator());
 		}
 	}
 
 	programmedEvent.AddMember("outputActions", outputActions, programmedEvent.GetAllocator());
 
+	if (_priority != normal_priority) {
+		programmedEvent.AddMember("priority", 
+			rapidjson::StringRef(EventDispatcher::getPriorityName(_priority)), programmedEvent.GetAllocator());
+	}
+
+	if (_breakerRate != DOMOTIC_PI_EVENT_BREAKER_RATE 
+		|| _breakerCooldown != std::chrono::milliseconds(DOMOTIC_PI_EVENT_BREAKER_COOLDOWN_MS)) {
+		rapidjson::Value breaker(rapidjson::kObjectType);
+		breaker.AddMember("maxRate", _breakerRate, programmedEvent.GetAllocator());
+		breaker.AddMember("cooldown", _breakerCooldown.count() / 1000.0, programmedEvent.GetAllocator());
+		programmedEvent.AddMember("circuitBreaker", breaker, programmedEvent.GetAllocator());
+	}
+
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> schedulesLock(_schedulesLock);
+#endif
+
+	if (!_schedules.empty()) {
+		rapidjson::Value schedules(rapidjson::kArrayType);
+		for (auto& it : _schedules) {
+			rapidjson::Value cronExpression;
+			cronExpression.SetString(it.cron.getExpression().c_str(), programmedEvent.GetAllocator());
+			schedules.PushBack(cronExpression, programmedEvent.GetAllocator());
+		}
+
+		programmedEvent.AddMember("schedules", schedules, programmedEvent.GetAllocator());
+	}
+
+#ifdef DOMOTIC_PI_THREAD_SAFE
+	std::unique_lock<std::mutex> patternsLock(_patternsLock);
+#endif
+
+	if (!_patterns.empty()) {
+		rapidjson::Value patterns(rapidjson::kArrayType);
+		for (auto& it : _patterns) {
+			rapidjson::Value pattern(it->to_json(), programmedEvent.GetAllocator());
+			patterns.PushBack(pattern, programmedEvent.GetAllocator());
+		}
+
+		programmedEvent.AddMember("patterns", patterns, programmedEvent.GetAllocator());
+	}
+
 	return programmedEvent;
 }
\ No newline at end of file
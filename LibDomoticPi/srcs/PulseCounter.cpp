@@ -0,0 +1,420 @@
+#include <PulseCounter.h>
+
+#include <Clock.h>
+#include <domoticPi.h>
+#include <exceptions.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace domotic_pi;
+
+const bool PulseCounter::_factoryRegistration =
+	InputFactory::initializer_registration("PulseCounter", PulseCounter::from_json);
+
+PulseCounter::PulseCounter(
+	const std::string& id,
+	int pinNumber,
+	int pud,
+	GpioEdge edge,
+	unsigned int chip) :
+	Pin(pinNumber, id, pin_cap_interrupt | (pud != pull_off ? pin_cap_pull : pin_cap_none), chip),
+	IInput(id),
+	_pud(pud), _edge(edge), _pulses(0),
+	_timerWheel(TimerWheel::load()),
+	_window(std::chrono::milliseconds(DOMOTIC_PI_PULSE_WINDOW_MS)), _rate(0),
+	_notifiedValue(0), _reportInterval(std::chrono::milliseconds::zero()),
+	_lastReport(Clock::now()), _savedTotal(0), _lastSave(Clock::now()),
+	_saveRunning(false), _saveRequested(false), _saveTotal(0)
+{
+	if (pinNumber < 0) {
+		console->error("PulseCounter::ctor : pin number must be a valid pin for a pulse counter.");
+		throw std::out_of_range("Pin number must be between 0 and " STR(DOMOTIC_PI_MAX_PIN) ".");
+	}
+
+	if (edge != edge_rising && edge != edge_falling && edge != edge_both) {
+		console->error("PulseCounter::ctor : pulses must be counted on rising, falling or both edges.");
+		throw domotic_pi_exception("Invalid pulse counter edge.");
+	}
+
+	_gpio->setMode(pinNumber, gpio_input);
+	_gpio->setPull(pinNumber, (GpioPull)pud);
+
+	_samples.emplace_back(Clock::now(), 0);
+
+	_sampleTimer = _timerWheel->newTimer([this] {
+		_sample();
+	});
+	_timerWheel->arm(_sampleTimer, std::chrono::milliseconds(DOMOTIC_PI_PULSE_SAMPLE_MS));
+
+	if (_gpio->setEdgeCallback(pinNumber, edge,
+		std::bind(&PulseCounter::input_ISR, this, std::placeholders::_1, std::placeholders::_2))) {
+		console->error("PulseCounter::ctor : could not enable edges on pin {}.", pinNumber);
+		_timerWheel->cancel(_sampleTimer);
+		throw domotic_pi_exception("Pulse counter edges could not be enabled.");
+	}
+
+	console->info("PulseCounter::ctor : pin {} counting pulses with pud '{}' and edge '{}'.",
+		pinNumber, pud, (int)edge);
+}
+
+PulseCounter::~PulseCounter()
+{
+	if (_gpio->setEdgeCallback(_pin, edge_none, nullptr)) {
+		console->error("PulseCounter::dtor : could not disable edges on pin {}.", _pin);
+	}
+
+	_timerWheel->cancel(_sampleTimer);
+
+	std::unique_lock<std::mutex> lock(_counterLock);
+
+	if (_saveThread.joinable()) {
+		_saveRunning = false;
+		_saveChange.notify_all();
+
+		lock.unlock();
+		_saveThread.join();
+		lock.lock();
+	}
+
+	uint64_t total = _pulses.load(std::memory_order_relaxed);
+	if (!_stateFile.empty() && total != _savedTotal && _save_total(_stateFile, total)) {
+		_savedTotal = total;
+	}
+}
+
+int PulseCounter::getValue() const
+{
+	return (int)std::lround(_rate.load(std::memory_order_relaxed) * 3600);
+}
+
+double PulseCounter::getRate() const
+{
+	return _rate.load(std::memory_order_relaxed);
+}
+
+uint64_t PulseCounter::getTotal() const
+{
+	return _pulses.load(std::memory_order_relaxed);
+}
+
+void PulseCounter::setTotal(uint64_t total)
+{
+	std::unique_lock<std::mutex> lock(_counterLock);
+
+	// Samples are shifted with the counter, so the rate is not affected
+	uint64_t previous = _pulses.exchange(total, std::memory_order_relaxed);
+	for (auto& sample : _samples) {
+		sample.second += total - previous;
+	}
+
+	console->info("PulseCounter::setTotal : pulse total of input '{}' set to {}.", getID().c_str(), total);
+}
+
+void PulseCounter::setWindow(std::chrono::milliseconds window)
+{
+	std::unique_lock<std::mutex> lock(_counterLock);
+	_window = std::max(window, std::chrono::milliseconds(DOMOTIC_PI_PULSE_SAMPLE_MS));
+}
+
+std::chrono::milliseconds PulseCounter::getWindow() const
+{
+	std::unique_lock<std::mutex> lock(_counterLock);
+	return _window;
+}
+
+void PulseCounter::setThresholds(const std::vector<int>& thresholds)
+{
+	std::unique_lock<std::mutex> lock(_counterLock);
+
+	_thresholds = thresholds;
+	std::sort(_thresholds.begin(), _thresholds.end());
+	_thresholds.erase(std::unique(_thresholds.begin(), _thresholds.end()), _thresholds.end());
+}
+
+std::vector<int> PulseCounter::getThresholds() const
+{
+	std::unique_lock<std::mutex> lock(_counterLock);
+	return _thresholds;
+}
+
+void PulseCounter::setReportInterval(std::chrono::milliseconds interval)
+{
+	std::unique_lock<std::mutex> lock(_counterLock);
+
+	_reportInterval = std::max(interval, std::chrono::milliseconds::zero());
+	_lastReport = Clock::now();
+}
+
+std::chrono::milliseconds PulseCounter::getReportInterval() const
+{
+	std::unique_lock<std::mutex> lock(_counterLock);
+	return _reportInterval;
+}
+
+void PulseCounter::setStateFile(const std::string& stateFile)
+{
+	std::unique_lock<std::mutex> lock(_counterLock);
+
+	_stateFile = stateFile;
+	if (_stateFile.empty()) {
+		return;
+	}
+
+	// Virtual clock runs single threaded, saves are written by the sample timer
+	if (!_saveThread.joinable() && !Clock::isVirtual()) {
+		_saveRunning = true;
+		_saveThread = std::thread(&PulseCounter::_save_loop, this);
+	}
+
+	std::ifstream state(_stateFile);
+	uint64_t total;
+
+	if (!(state >> total)) {
+		console->warn("PulseCounter::setStateFile : no pulse total in '{}' for input '{}', starting from {}.",
+			_stateFile.c_str(), getID().c_str(), _pulses.load(std::memory_order_relaxed));
+		return;
+	}
+
+	uint64_t previous = _pulses.exchange(total, std::memory_order_relaxed);
+	for (auto& sample : _samples) {
+		sample.second += total - previous;
+	}
+	_savedTotal = total;
+
+	console->info("PulseCounter::setStateFile : pulse total {} loaded for input '{}'.", total, getID().c_str());
+}
+
+std::string PulseCounter::getStateFile() const
+{
+	std::unique_lock<std::mutex> lock(_counterLock);
+	return _stateFile;
+}
+
+rapidjson::Document PulseCounter::stats_to_json() const
+{
+	rapidjson::Document stats = IInput::stats_to_json();
+
+	stats.AddMember("total", getTotal(), stats.GetAllocator());
+	stats.AddMember("rate", getRate(), stats.GetAllocator());
+
+	return stats;
+}
+
+void PulseCounter::input_ISR(int value, Timestamp timestamp)
+{
+	_pulses.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PulseCounter::_sample()
+{
+	Timestamp now = Clock::now();
+	uint64_t total = _pulses.load(std::memory_order_relaxed);
+	bool notify = false;
+	int value;
+
+	{
+		std::unique_lock<std::mutex> lock(_counterLock);
+
+		// Keep the newest sample at or before the window start as the rate origin
+		_samples.emplace_back(now, total);
+		while (_samples.size() > 2 && now - _samples[1].first >= _window) {
+			_samples.pop_front();
+		}
+
+		auto elapsed = std::chrono::duration<double>(now - _samples.front().first).count();
+		double rate = elapsed > 0 ? (total - _samples.front().second) / elapsed : 0;
+		_rate.store(rate, std::memory_order_relaxed);
+		value = (int)std::lround(rate * 3600);
+
+		if (_band(value) != _band(_notifiedValue)) {
+			notify = true;
+		}
+
+		if (_reportInterval > std::chrono::milliseconds::zero() && now - _lastReport >= _reportInterval) {
+			notify = true;
+		}
+
+		if (notify) {
+			_notifiedValue = value;
+			_lastReport = now;
+		}
+
+		if (!_stateFile.empty() && total != _savedTotal
+			&& now - _lastSave >= std::chrono::milliseconds(DOMOTIC_PI_PULSE_PERSIST_MS)) {
+			if (_saveThread.joinable()) {
+				_saveTotal = total;
+				_saveRequested = true;
+				_saveChange.notify_all();
+			}
+			else if (_save_total(_stateFile, total)) {
+				_savedTotal = total;
+			}
+			_lastSave = now;
+		}
+
+		_timerWheel->arm(_sampleTimer, std::chrono::milliseconds(DOMOTIC_PI_PULSE_SAMPLE_MS));
+	}
+
+	if (notify) {
+		valueChanged(value, now);
+	}
+}
+
+size_t PulseCounter::_band(int value) const
+{
+	return std::upper_bound(_thresholds.begin(), _thresholds.end(), value) - _thresholds.begin();
+}
+
+void PulseCounter::_save_loop()
+{
+	std::unique_lock<std::mutex> lock(_counterLock);
+
+	while (true) {
+		_saveChange.wait(lock, [this] { return _saveRequested || !_saveRunning; });
+		if (!_saveRunning) {
+			return;
+		}
+
+		std::string stateFile = _stateFile;
+		uint64_t total = _saveTotal;
+		_saveRequested = false;
+
+		// Disk syncs can take long, the sample timer keeps running meanwhile
+		lock.unlock();
+		bool saved = !stateFile.empty() && _save_total(stateFile, total);
+		lock.lock();
+
+		if (saved) {
+			_savedTotal = total;
+		}
+	}
+}
+
+bool PulseCounter::_save_total(const std::string& stateFile, uint64_t total) const
+{
+	// Written aside, synced then renamed, so a power cut leaves either total but never a truncated one
+	std::string tmpFile = stateFile + ".tmp";
+	std::string text = std::to_string(total) + "\n";
+
+	int fd = open(tmpFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		console->error("PulseCounter::_save_total : could not open '{}' for input '{}' ({}).",
+			tmpFile.c_str(), getID().c_str(), strerror(errno));
+		return false;
+	}
+
+	bool written = write(fd, text.data(), text.size()) == (ssize_t)text.size() && fsync(fd) == 0;
+	int error = errno;
+	close(fd);
+
+	if (!written) {
+		console->error("PulseCounter::_save_total : could not write '{}' for input '{}' ({}).",
+			tmpFile.c_str(), getID().c_str(), strerror(error));
+		return false;
+	}
+
+	if (std::rename(tmpFile.c_str(), stateFile.c_str())) {
+		console->error("PulseCounter::_save_total : could not replace '{}' for input '{}' ({}).",
+			stateFile.c_str(), getID().c_str(), strerror(errno));
+		return false;
+	}
+
+	// Rename is durable once the directory entry is synced
+	size_t slash = stateFile.rfind('/');
+	std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : stateFile.substr(0, slash);
+
+	int dirFd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dirFd < 0 || fsync(dirFd)) {
+		console->warn("PulseCounter::_save_total : could not sync directory '{}' for input '{}' ({}).",
+			directory.c_str(), getID().c_str(), strerror(errno));
+	}
+	if (dirFd >= 0) {
+		close(dirFd);
+	}
+
+	return true;
+}
+
+std::shared_ptr<PulseCounter> PulseCounter::from_json(const rapidjson::Value& config, DomoticNode_ptr parentNode)
+{
+	auto pulseCounter = std::make_shared<PulseCounter>(
+		config["id"].GetString(),
+		config["pin"].GetInt(),
+		config["pud"].GetInt(),
+		config.HasMember("isr_mode") ? (GpioEdge)config["isr_mode"].GetInt() : edge_rising,
+		config.HasMember("chip") ? config["chip"].GetUint() : 0);
+
+	if (config.HasMember("window")) {
+		pulseCounter->setWindow(std::chrono::milliseconds(config["window"].GetInt()));
+	}
+
+	if (config.HasMember("thresholds")) {
+		std::vector<int> thresholds;
+		for (auto& threshold : config["thresholds"].GetArray()) {
+			thresholds.push_back(threshold.GetInt());
+		}
+		pulseCounter->setThresholds(thresholds);
+	}
+
+	if (config.HasMember("reportInterval")) {
+		pulseCounter->setReportInterval(std::chrono::milliseconds(config["reportInterval"].GetInt()));
+	}
+
+	if (config.HasMember("stateFile")) {
+		pulseCounter->setStateFile(config["stateFile"].GetString());
+	}
+
+	// Set IInput base class attributes
+	IInput::from_json<PulseCounter>(config, pulseCounter, parentNode);
+
+	return pulseCounter;
+}
+
+rapidjson::Document PulseCounter::to_json() const
+{
+	rapidjson::Document input = IInput::to_json();
+
+	console->debug("PulseCounter::to_json : serializing input '{}'.", _id.c_str());
+
+	input.AddMember("type", "PulseCounter", input.GetAllocator());
+
+	input.AddMember("pin", _pin, input.GetAllocator());
+	if (_chip != 0) {
+		input.AddMember("chip", _chip, input.GetAllocator());
+	}
+	input.AddMember("pud", _pud, input.GetAllocator());
+	input.AddMember("isr_mode", (int)_edge, input.GetAllocator());
+
+	std::unique_lock<std::mutex> lock(_counterLock);
+
+	input.AddMember("window", (int64_t)_window.count(), input.GetAllocator());
+
+	if (!_thresholds.empty()) {
+		rapidjson::Value thresholds(rapidjson::kArrayType);
+		for (int threshold : _thresholds) {
+			thresholds.PushBack(threshold, input.GetAllocator());
+		}
+		input.AddMember("thresholds", thresholds, input.GetAllocator());
+	}
+
+	if (_reportInterval > std::chrono::milliseconds::zero()) {
+		input.AddMember("reportInterval", (int64_t)_reportInterval.count(), input.GetAllocator());
+	}
+
+	if (!_stateFile.empty()) {
+		rapidjson::Value stateFile;
+		stateFile.SetString(_stateFile.c_str(), input.GetAllocator());
+		input.AddMember("stateFile", stateFile, input.GetAllocator());
+	}
+
+	return input;
+}
@@ -0,0 +1,111 @@
+#include <PwmOutput.h>
+
+#include <domoticPi.h>
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+using namespace domotic_pi;
+
+const bool PwmOutput::_factoryRegistration =
+	OutputFactory::initializer_registration("PwmOutput", PwmOutput::from_json);
+
+PwmOutput::PwmOutput(const std::string& id, int pinNumber, double frequency, unsigned int chip)
+	: Pin(pinNumber, id, pin_cap_none, chip), IOutput(id), _frequency(frequency),
+	_pwmScheduler(PwmScheduler::load(chip)), _duty(0), _onDuty(100)
+{
+	if (pinNumber < 0) {
+		console->error("PwmOutput::ctor : pin number must be a valid pin for a PWM output.");
+		throw std::out_of_range("Pin number must be between 0 and " STR(DOMOTIC_PI_MAX_PIN) ".");
+	}
+
+	if (frequency <= 0) {
+		console->error("PwmOutput::ctor : PWM frequency must be positive.");
+		throw std::out_of_range("PWM frequency must be positive.");
+	}
+
+	_gpio->setMode(pinNumber, gpio_output);
+	_gpio->write(pinNumber, 0);
+
+	_channel = _pwmScheduler->addChannel(pinNumber,
+		std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(1.0 / frequency)));
+
+	console->info("PwmOutput::ctor : pin {} set to PWM OUTPUT mode at {} Hz.", pinNumber, frequency);
+}
+
+PwmOutput::~PwmOutput()
+{
+	_pwmScheduler->removeChannel(_channel);
+}
+
+int PwmOutput::getValue() const
+{
+	return _duty.load(std::memory_order_relaxed);
+}
+
+void PwmOutput::setState(OutState newState, Timestamp timestamp)
+{
+	if (newState == TOGGLE) {
+		newState = getValue() > 0 ? OFF : ON;
+	}
+
+	setValue(newState == ON ? _onDuty.load(std::memory_order_relaxed) : 0, timestamp);
+}
+
+void PwmOutput::setValue(int newValue, Timestamp timestamp)
+{
+	newValue = std::min(std::max(newValue, 0), 100);
+
+	_duty.store(newValue, std::memory_order_relaxed);
+	if (newValue > 0) {
+		_onDuty.store(newValue, std::memory_order_relaxed);
+	}
+
+	_channel->setDuty(newValue / 100.0);
+
+	_trace_command(timestamp);
+
+	console->debug("PwmOutput::setValue : output '{}' duty cycle set to {}%.", getID(), newValue);
+}
+
+double PwmOutput::getFrequency() const
+{
+	return _frequency;
+}
+
+rapidjson::Document PwmOutput::stats_to_json() const
+{
+	rapidjson::Document stats = IOutput::stats_to_json();
+
+	rapidjson::Value pwm(_pwmScheduler->stats_to_json(), stats.GetAllocator());
+	stats.AddMember("pwm", pwm, stats.GetAllocator());
+
+	return stats;
+}
+
+std::shared_ptr<PwmOutput> PwmOutput::from_json(const rapidjson::Value& config, DomoticNode_ptr parentNode)
+{
+	return std::make_shared<PwmOutput>(
+		config["id"].GetString(),
+		config["pin"].GetInt(),
+		config.HasMember("frequency") ? config["frequency"].GetDouble() : DOMOTIC_PI_PWM_FREQUENCY,
+		config.HasMember("chip") ? config["chip"].GetUint() : 0);
+}
+
+rapidjson::Document PwmOutput::to_json() const
+{
+	rapidjson::Document output = IOutput::to_json();
+
+	console->debug("PwmOutput::to_json : serializing output '{}'.", _id.c_str());
+
+	output.AddMember("type", "PwmOutput", output.GetAllocator());
+
+	output.AddMember("pin", _pin, output.GetAllocator());
+	if (_chip != 0) {
+		output.AddMember("chip", _chip, output.GetAllocator());
+	}
+	output.AddMember("frequency", _frequency, output.GetAllocator());
+
+	return output;
+}
@@ -0,0 +1,240 @@
+#include <PwmScheduler.h>
+
+#include <Clock.h>
+#include <domoticPi.h>
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+
+using namespace domotic_pi;
+
+std::array<std::shared_ptr<PwmScheduler>, DOMOTIC_PI_MAX_CHIPS> PwmScheduler::_pwmSchedulers;
+
+PwmScheduler::Channel::Channel(int pin, std::chrono::nanoseconds period)
+	: _pin(pin), _period(period), _duty(0), _removed(false), _level(0)
+{
+}
+
+int PwmScheduler::Channel::getPin() const
+{
+	return _pin;
+}
+
+std::chrono::nanoseconds PwmScheduler::Channel::getPeriod() const
+{
+	return _period;
+}
+
+void PwmScheduler::Channel::setDuty(double duty)
+{
+	duty = std::min(std::max(duty, 0.0), 1.0);
+	_duty.store((uint32_t)std::lround(duty * _dutyScale), std::memory_order_relaxed);
+}
+
+double PwmScheduler::Channel::getDuty() const
+{
+	return (double)_duty.load(std::memory_order_relaxed) / _dutyScale;
+}
+
+PwmScheduler::PwmScheduler(GpioBackend_ptr gpio)
+	: _gpio(gpio), _running(true), _edgeCount(0)
+{
+}
+
+PwmScheduler::~PwmScheduler()
+{
+	std::unique_lock<std::mutex> lock(_pwmLock);
+	_running = false;
+	_scheduleChange.notify_all();
+	lock.unlock();
+
+	if (_pwmThread.joinable()) {
+		_pwmThread.join();
+	}
+}
+
+const std::shared_ptr<PwmScheduler> PwmScheduler::load(unsigned int chip)
+{
+	GpioBackend_ptr gpio = IGpioBackend::load(chip);
+
+	if (_pwmSchedulers[chip] == nullptr) {
+		_pwmSchedulers[chip] = std::make_shared<PwmScheduler>(gpio);
+	}
+
+	return _pwmSchedulers[chip];
+}
+
+PwmChannel_ptr PwmScheduler::addChannel(int pin, std::chrono::nanoseconds period)
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		console->error("PwmScheduler::addChannel : pin number must be between 0 and " STR(DOMOTIC_PI_MAX_PIN) ".");
+		throw std::out_of_range("Pin number must be between 0 and " STR(DOMOTIC_PI_MAX_PIN) ".");
+	}
+
+	if (period <= std::chrono::nanoseconds::zero()) {
+		throw std::out_of_range("PWM period must be positive.");
+	}
+
+	auto channel = std::make_shared<Channel>(pin, period);
+
+	std::unique_lock<std::mutex> lock(_pwmLock);
+
+	// First period starts right away
+	_schedule.emplace(Clock::now(), channel);
+
+	if (!Clock::isVirtual() && !_pwmThread.joinable()) {
+		_pwmThread = std::thread(&PwmScheduler::_pwm_loop, this);
+	}
+
+	_scheduleChange.notify_all();
+
+	console->info("PwmScheduler::addChannel : PWM started on pin {} with {} us period.",
+		pin, (long long)std::chrono::duration_cast<std::chrono::microseconds>(period).count());
+
+	return channel;
+}
+
+void PwmScheduler::removeChannel(const PwmChannel_ptr& channel)
+{
+	if (channel == nullptr) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(_pwmLock);
+
+	// Planned edges of the channel are discarded when they come due
+	channel->_removed = true;
+	if (channel->_level) {
+		channel->_level = 0;
+		_gpio->write(channel->_pin, 0);
+	}
+
+	console->info("PwmScheduler::removeChannel : PWM stopped on pin {}.", channel->_pin);
+}
+
+Timestamp PwmScheduler::getNextEdge() const
+{
+	std::unique_lock<std::mutex> lock(_pwmLock);
+
+	return _schedule.empty() ? Timestamp::max() : std::get<0>(_schedule.top());
+}
+
+void PwmScheduler::advance()
+{
+	std::unique_lock<std::mutex> lock(_pwmLock);
+	_serve(Clock::now());
+}
+
+const LatencyHistogram& PwmScheduler::getJitter() const
+{
+	return _jitter;
+}
+
+uint64_t PwmScheduler::getEdgeCount() const
+{
+	return _edgeCount.load(std::memory_order_relaxed);
+}
+
+rapidjson::Document PwmScheduler::stats_to_json() const
+{
+	rapidjson::Document stats(rapidjson::kObjectType);
+
+	stats.AddMember("edges", getEdgeCount(), stats.GetAllocator());
+
+	rapidjson::Value jitter(_jitter.to_json(), stats.GetAllocator());
+	stats.AddMember("jitter", jitter, stats.GetAllocator());
+
+	return stats;
+}
+
+void PwmScheduler::_serve(Timestamp now)
+{
+	GpioBanks banks{};
+	bool changed = false;
+
+	while (!_schedule.empty() && std::get<0>(_schedule.top()) <= now) {
+		Timestamp due = std::get<0>(_schedule.top());
+		PwmChannel_ptr channel = std::get<1>(_schedule.top());
+		_schedule.pop();
+
+		if (channel->_removed) {
+			continue;
+		}
+
+		_jitter.record(now - due);
+
+		int level;
+		Timestamp next;
+
+		if (channel->_level && due < channel->_periodStart + channel->_period) {
+			// Falling edge, low until the end of the period
+			level = 0;
+			next = channel->_periodStart + channel->_period;
+		}
+		else {
+			// Period start: missed periods are dropped rather than replayed in a burst
+			if (now - due >= channel->_period) {
+				due = now;
+			}
+			channel->_periodStart = due;
+
+			uint32_t duty = channel->_duty.load(std::memory_order_relaxed);
+			auto onTime = std::chrono::duration_cast<Timestamp::duration>(channel->_period * duty / Channel::_dutyScale);
+
+			level = duty > 0 ? 1 : 0;
+			next = duty > 0 && duty < Channel::_dutyScale ? due + onTime : due + channel->_period;
+		}
+
+		if (level != channel->_level) {
+			channel->_level = level;
+
+			size_t bank = channel->_pin / 64;
+			uint64_t bit = (uint64_t)1 << (channel->_pin % 64);
+			if (level) {
+				banks[bank].set |= bit;
+				banks[bank].clear &= ~bit;
+			}
+			else {
+				banks[bank].clear |= bit;
+				banks[bank].set &= ~bit;
+			}
+
+			changed = true;
+			_edgeCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		_schedule.emplace(next, channel);
+	}
+
+	// Pins switching at the same time change together
+	if (changed) {
+		_gpio->writeBanks(banks);
+	}
+}
+
+void PwmScheduler::_pwm_loop()
+{
+	std::unique_lock<std::mutex> lock(_pwmLock);
+
+	while (_running) {
+		if (_schedule.empty()) {
+			_scheduleChange.wait(lock);
+			continue;
+		}
+
+		Timestamp due = std::get<0>(_schedule.top());
+		if (Clock::now() < due) {
+			_scheduleChange.wait_until(lock, due);
+			continue;
+		}
+
+		try {
+			_serve(Clock::now());
+		}
+		catch (std::exception& e) {
+			console->error("PwmScheduler::_pwm_loop : error while switching PWM pins : {}", e.what());
+		}
+	}
+}
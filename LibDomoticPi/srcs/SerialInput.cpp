@@ -0,0 +1,214 @@
+#include <SerialInput.h>
+
+#include <CommFactory.h>
+#include <domoticPi.h>
+#include <DomoticNode.h>
+#include <exceptions.h>
+
+#include <charconv>
+
+using namespace domotic_pi;
+
+const bool SerialInput::_factoryRegistration =
+	InputFactory::initializer_registration("SerialInput", SerialInput::from_json);
+
+SerialInput::SerialInput(
+	const std::string& id,
+	std::shared_ptr<SerialInterface> serialComm,
+	const std::string& key,
+	SerialInputFormat format) :
+	IInput(id),
+	_serial(serialComm), _key(key), _format(format),
+	_value(0), _repeat(false), _frames(0), _malformed(0)
+{
+	if (serialComm == nullptr) {
+		console->error("SerialInput::ctor : given serial comm interface can not be null.");
+		throw domotic_pi_exception("Serial comm interface can not be null.");
+	}
+
+	if (key.empty() || (format == serial_binary && key.size() != 1)) {
+		console->error("SerialInput::ctor : input '{}' key must be a single byte for the binary format, and not empty.", id.c_str());
+		throw domotic_pi_exception("Invalid serial input key.");
+	}
+
+	_frameToken = _serial->addFrameCallback(
+		std::bind(&SerialInput::_frame_received, this, std::placeholders::_1, std::placeholders::_2));
+
+	console->info("SerialInput::ctor : input '{}' reading frames with key '{}' from {}.",
+		id.c_str(), key.c_str(), _serial->getPort().c_str());
+}
+
+SerialInput::~SerialInput()
+{
+	_frameToken.reset();
+}
+
+int SerialInput::getValue() const
+{
+	return _value.load(std::memory_order_relaxed);
+}
+
+const std::string& SerialInput::getKey() const
+{
+	return _key;
+}
+
+SerialInputFormat SerialInput::getFormat() const
+{
+	return _format;
+}
+
+void SerialInput::setRepeat(bool repeat)
+{
+	_repeat = repeat;
+}
+
+bool SerialInput::getRepeat() const
+{
+	return _repeat;
+}
+
+uint64_t SerialInput::getFrameCount() const
+{
+	return _frames.load(std::memory_order_relaxed);
+}
+
+uint64_t SerialInput::getMalformedCount() const
+{
+	return _malformed.load(std::memory_order_relaxed);
+}
+
+std::vector<CommTopic> SerialInput::getListenedTopics() const
+{
+	return std::vector<CommTopic>{ { _serial, _key } };
+}
+
+rapidjson::Document SerialInput::stats_to_json() const
+{
+	rapidjson::Document stats = IInput::stats_to_json();
+
+	stats.AddMember("frames", getFrameCount(), stats.GetAllocator());
+	stats.AddMember("malformed", getMalformedCount(), stats.GetAllocator());
+
+	return stats;
+}
+
+std::shared_ptr<SerialInput> SerialInput::from_json(const rapidjson::Value& config, DomoticNode_ptr parentNode)
+{
+	const rapidjson::Value& serialInterface = config["comm"];
+
+	std::shared_ptr<SerialInterface> serialComm = nullptr;
+
+	if (serialInterface.IsString()) {
+		serialComm = std::dynamic_pointer_cast<SerialInterface>(parentNode->getComm(serialInterface.GetString()));
+	}
+	else {
+		serialComm = std::dynamic_pointer_cast<SerialInterface>(CommFactory::from_json(serialInterface, parentNode));
+	}
+
+	SerialInputFormat format = serial_text;
+	if (config.HasMember("format") && std::string(config["format"].GetString()) == "binary") {
+		format = serial_binary;
+	}
+
+	auto serialInput = std::make_shared<SerialInput>(
+		config["id"].GetString(),
+		serialComm,
+		config.HasMember("serialKey") ? config["serialKey"].GetString() : config["id"].GetString(),
+		format);
+
+	if (config.HasMember("repeat")) {
+		serialInput->setRepeat(config["repeat"].GetBool());
+	}
+
+	// Set IInput base class attributes
+	IInput::from_json<SerialInput>(config, serialInput, parentNode);
+
+	return serialInput;
+}
+
+rapidjson::Document SerialInput::to_json() const
+{
+	rapidjson::Document input = IInput::to_json();
+
+	console->debug("SerialInput::to_json : serializing input '{}'.", _id.c_str());
+
+	input.AddMember("type", "SerialInput", input.GetAllocator());
+
+	rapidjson::Value comm;
+	comm.SetString(_serial->getID().c_str(), input.GetAllocator());
+	input.AddMember("comm", comm, input.GetAllocator());
+
+	rapidjson::Value key;
+	key.SetString(_key.c_str(), (rapidjson::SizeType)_key.size(), input.GetAllocator());
+	input.AddMember("serialKey", key, input.GetAllocator());
+
+	input.AddMember("format", rapidjson::StringRef(_format == serial_binary ? "binary" : "text"), input.GetAllocator());
+	input.AddMember("repeat", getRepeat(), input.GetAllocator());
+
+	return input;
+}
+
+void SerialInput::_frame_received(std::string_view frame, Timestamp timestamp)
+{
+	int value;
+	if (!_parse(frame, value)) {
+		return;
+	}
+
+	_frames++;
+
+	int previous = _value.exchange(value);
+	if (previous == value && !_repeat) {
+		return;
+	}
+
+	console->debug("SerialInput::_frame_received : input '{}' changed value to '{}'.", getID().c_str(), value);
+
+	valueChanged(value, timestamp);
+}
+
+bool SerialInput::_parse(std::string_view frame, int& value)
+{
+	if (frame.size() <= _key.size() || frame.compare(0, _key.size(), _key) != 0) {
+		return false;
+	}
+
+	frame.remove_prefix(_key.size());
+
+	if (_format == serial_binary) {
+		if (frame.size() > 4) {
+			_malformed++;
+			return false;
+		}
+
+		// Big endian, sign extended from the first byte
+		int32_t result = (int8_t)frame[0];
+		for (size_t i = 1; i < frame.size(); ++i) {
+			result = (int32_t)((uint32_t)result << 8 | (uint8_t)frame[i]);
+		}
+
+		value = result;
+		return true;
+	}
+
+	// Line endings of devices printing lines with CR LF
+	while (!frame.empty() && (frame.back() == '\r' || frame.back() == ' ')) {
+		frame.remove_suffix(1);
+	}
+
+	// Separator ends the key, so a key being the prefix of another one does not match it
+	if (frame.empty() || (frame.front() != ':' && frame.front() != '=' && frame.front() != ' ')) {
+		return false;
+	}
+	frame.remove_prefix(1);
+
+	auto result = std::from_chars(frame.data(), frame.data() + frame.size(), value);
+
+	if (frame.empty() || result.ec != std::errc() || result.ptr != frame.data() + frame.size()) {
+		_malformed++;
+		return false;
+	}
+
+	return true;
+}
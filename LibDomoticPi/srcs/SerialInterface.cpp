@@ -1,24 +1,37 @@
 #include <SerialInterface.h>
 
+#include <Clock.h>
 #include <DomoticNode.h>
 #include <domoticPi.h>
 #include <exceptions.h>
+#include <SerialLink.h>
 
+#include <algorithm>
+#include <array>
 #include <errno.h>
+#include <exception>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 #include <wiringSerial.h>
 
 using namespace domotic_pi;
 
-const bool SerialInterface::_factoryRegistration = 
+const bool SerialInterface::_factoryRegistration =
 	CommFactory::initializer_registration("SerialInterface", SerialInterface::from_json);
 
 SerialInterface::SerialInterface(
-	const std::string& id, 
-	const std::string& port, 
-	int baud, 
-	int txPin, 
-	int rxPin) 
-	: IComm(id, "SerialInterface"), _port(port), _baudRate(baud), _pinTX(txPin), _pinRX(rxPin)
+	const std::string& id,
+	const std::string& port,
+	int baud,
+	int txPin,
+	int rxPin)
+	: IComm(id, "SerialInterface"), _port(port), _baudRate(baud), _pinTX(txPin, id), _pinRX(rxPin, id),
+	_txWriting(false), _writerRunning(false), _txBytes(0), _txCommands(0), _txCoalesced(0), _txWrites(0),
+	_rxRing(DOMOTIC_PI_SERIAL_RX_BUFFER), _rxScanned(0), _rxDiscarding(false), _rxSkip(0),
+	_framing(framing_delimiter), _delimiter('\n'), _lengthPrefix(1), _frameCallbacks(std::make_shared<const FrameCallbacks>()), _nextCallbackId(0),
+	_readerId(std::thread::id()), _epollFd(-1), _wakeupFd(-1), _readerRunning(false), _rxBytes(0), _rxFrames(0), _rxDropped(0)
 {
 	_serial = serialOpen(port.c_str(), baud);
 
@@ -32,10 +45,41 @@ SerialInterface::SerialInterface(
 
 SerialInterface::~SerialInterface()
 {
-#ifdef DOMOTIC_PI_THREAD_SAFE
-	std::unique_lock<std::mutex> lckrx(_rxOwn);
-	std::unique_lock<std::mutex> lcktx(_txOwn);
-#endif
+	// Link uses the reader thread and the port
+	{
+		std::unique_lock<std::mutex> lock(_linkOwn);
+		_link.reset();
+	}
+
+	// Queued commands are written before closing
+	{
+		std::unique_lock<std::mutex> lock(_txLock);
+		_txChange.wait(lock, [this] { return _txQueue.empty() && !_txWriting; });
+		_writerRunning = false;
+		_txChange.notify_all();
+	}
+
+	if (_writerThread.joinable()) {
+		_writerThread.join();
+	}
+
+	_readerRunning = false;
+
+	if (_readerThread.joinable()) {
+		uint64_t wakeup = 1;
+		if (::write(_wakeupFd, &wakeup, sizeof(wakeup)) < 0) {
+			console->error("SerialInterface::dtor : could not wake reader thread ({}).", strerror(errno));
+		}
+		_readerThread.join();
+	}
+
+	if (_wakeupFd >= 0) {
+		close(_wakeupFd);
+	}
+
+	if (_epollFd >= 0) {
+		close(_epollFd);
+	}
 
 	serialClose(_serial);
 
@@ -52,48 +96,529 @@ int SerialInterface::getBaudRate() const
 	return _baudRate;
 }
 
-std::string SerialInterface::read()
+void SerialInterface::setDelimiter(char delimiter)
+{
+	std::unique_lock<std::mutex> lock(_rxLock);
+
+	_framing = framing_delimiter;
+	_delimiter = delimiter;
+
+	_rxDropped += _rxRing.size();
+	_rxRing.clear();
+	_rxScanned = 0;
+	_rxDiscarding = false;
+	_rxSkip = 0;
+}
+
+void SerialInterface::setLengthPrefix(unsigned int bytes)
+{
+	if (bytes != 1 && bytes != 2) {
+		console->error("SerialInterface::setLengthPrefix : length prefix must be 1 or 2 bytes long.");
+		throw std::out_of_range("Length prefix must be 1 or 2 bytes long.");
+	}
+
+	std::unique_lock<std::mutex> lock(_rxLock);
+
+	_framing = framing_length;
+	_lengthPrefix = bytes;
+
+	_rxDropped += _rxRing.size();
+	_rxRing.clear();
+	_rxScanned = 0;
+	_rxDiscarding = false;
+	_rxSkip = 0;
+}
+
+SerialFraming SerialInterface::getFraming() const
+{
+	std::unique_lock<std::mutex> lock(_rxLock);
+	return _framing;
+}
+
+char SerialInterface::getDelimiter() const
+{
+	std::unique_lock<std::mutex> lock(_rxLock);
+	return _delimiter;
+}
+
+unsigned int SerialInterface::getLengthPrefix() const
+{
+	std::unique_lock<std::mutex> lock(_rxLock);
+	return _lengthPrefix;
+}
+
+CallbackToken_ptr SerialInterface::addFrameCallback(SerialFrameCallback callback)
 {
-	std::string message;
-	int bytes = 0;
+	uint64_t callbackId;
 
-#ifdef DOMOTIC_PI_THREAD_SAFE
-	std::unique_lock<std::mutex> lck(_rxOwn);
-#endif
+	{
+		std::unique_lock<std::mutex> lock(_callbacksLock);
 
-	// Check if there is something to read
-	if (!(bytes = serialDataAvail(_serial)))
-		return message;
+		auto frameCallbacks = std::make_shared<FrameCallbacks>(*_frameCallbacks);
+		callbackId = _nextCallbackId++;
+		(*frameCallbacks)[callbackId] = callback;
+		_frameCallbacks = frameCallbacks;
+	}
 
-	if (bytes < 0) {
-		console->error("SerialInterface::read : error during data availability check: {}.", strerror(errno));
-		return message;
+	{
+		std::unique_lock<std::mutex> lock(_rxLock);
+		_start_reader();
 	}
 
-	// Allocate read buffer
-	char *buffer = new char[bytes];
+	return std::make_shared<CallbackToken>([this, callbackId] {
+		{
+			std::unique_lock<std::mutex> lock(_callbacksLock);
+
+			auto frameCallbacks = std::make_shared<FrameCallbacks>(*_frameCallbacks);
+			frameCallbacks->erase(callbackId);
+			_frameCallbacks = frameCallbacks;
+		}
 
-	// Read all available bytes and store them in buffer
-	for (int i = 0; i < bytes; i++)
-		buffer[i] = (char)serialGetchar(_serial);
+		// Frames are delivered with rx lock held: once taken, the callback is not running anymore
+		if (std::this_thread::get_id() != _readerId.load()) {
+			std::unique_lock<std::mutex> lock(_rxLock);
+		}
+	});
+}
 
-	// Assign read buffer to message string
-	message.assign(buffer);
+std::string SerialInterface::read()
+{
+	std::unique_lock<std::mutex> lock(_rxLock);
+
+	_start_reader();
+
+	{
+		std::unique_lock<std::mutex> callbacksLock(_callbacksLock);
+		if (!_frameCallbacks->empty()) {
+			return std::string();
+		}
+	}
+
+	size_t offset, length, total;
+	if (!_next_frame(offset, length, total)) {
+		return std::string();
+	}
+
+	std::string message(_rxRing.view(offset, length, _rxScratch));
+	_rxRing.consume(total);
+	_rxScanned = 0;
+	_rxFrames++;
 
 	console->debug("SerialInterface::read : read message: '{}'.", message.c_str());
 
 	return message;
 }
 
-void SerialInterface::write(const std::string & message)
+void SerialInterface::write(const std::string & message, const std::string& key)
+{
+	_enqueue(TxCommand{ key, message, false, Clock::now() });
+
+	console->debug("SerialInterface::write : queued message: '{}'.", message.c_str());
+}
+
+void SerialInterface::write(const uint8_t* data, size_t length)
+{
+	_enqueue(TxCommand{ std::string(), std::string((const char*)data, length), true, Clock::now() });
+}
+
+void SerialInterface::flush()
+{
+	std::unique_lock<std::mutex> lock(_txLock);
+	_txChange.wait(lock, [this] { return _txQueue.empty() && !_txWriting; });
+}
+
+size_t SerialInterface::getTxQueueDepth() const
+{
+	std::unique_lock<std::mutex> lock(_txLock);
+	return _txQueue.size();
+}
+
+const LatencyHistogram& SerialInterface::getTxDrainLatency() const
+{
+	return _txDrain;
+}
+
+std::shared_ptr<SerialLink> SerialInterface::getLink()
+{
+	std::unique_lock<std::mutex> lock(_linkOwn);
+
+	if (_link == nullptr) {
+		_link = std::make_shared<SerialLink>(*this);
+	}
+
+	return _link;
+}
+
+uint64_t SerialInterface::getReceivedBytes() const
+{
+	return _rxBytes.load(std::memory_order_relaxed);
+}
+
+uint64_t SerialInterface::getReceivedFrames() const
+{
+	return _rxFrames.load(std::memory_order_relaxed);
+}
+
+uint64_t SerialInterface::getDroppedBytes() const
+{
+	return _rxDropped.load(std::memory_order_relaxed);
+}
+
+rapidjson::Document SerialInterface::stats_to_json() const
+{
+	rapidjson::Document stats(rapidjson::kObjectType);
+
+	stats.AddMember("rx_bytes", getReceivedBytes(), stats.GetAllocator());
+	stats.AddMember("rx_frames", getReceivedFrames(), stats.GetAllocator());
+	stats.AddMember("rx_dropped", getDroppedBytes(), stats.GetAllocator());
+
+	stats.AddMember("tx_bytes", _txBytes.load(), stats.GetAllocator());
+	stats.AddMember("tx_commands", _txCommands.load(), stats.GetAllocator());
+	stats.AddMember("tx_coalesced", _txCoalesced.load(), stats.GetAllocator());
+	stats.AddMember("tx_writes", _txWrites.load(), stats.GetAllocator());
+	stats.AddMember("tx_queue", (uint64_t)getTxQueueDepth(), stats.GetAllocator());
+
+	rapidjson::Value drain(_txDrain.to_json(), stats.GetAllocator());
+	stats.AddMember("tx_drain", drain, stats.GetAllocator());
+
+	std::unique_lock<std::mutex> lock(_linkOwn);
+	if (_link != nullptr) {
+		rapidjson::Value link(_link->stats_to_json(), stats.GetAllocator());
+		stats.AddMember("link", link, stats.GetAllocator());
+	}
+
+	return stats;
+}
+
+void SerialInterface::_enqueue(TxCommand command)
+{
+	std::unique_lock<std::mutex> lock(_txLock);
+
+	_txCommands++;
+
+	// Virtual time has no writer thread, as the timer wheel
+	if (Clock::isVirtual()) {
+		if (command.binary) {
+			_write_all(command.data.data(), command.data.size());
+		}
+		else {
+			serialPuts(_serial, command.data.c_str());
+		}
+
+		_txBytes += command.data.size();
+		_txWrites++;
+		return;
+	}
+
+	// Command not written yet is replaced by the newer one, keeping its place in the queue
+	if (!command.key.empty()) {
+		auto queued = std::find_if(_txQueue.begin(), _txQueue.end(), [&command](const TxCommand& queued) {
+			return queued.key == command.key;
+		});
+
+		if (queued != _txQueue.end()) {
+			queued->data = std::move(command.data);
+			_txCoalesced++;
+			return;
+		}
+	}
+
+	_txChange.wait(lock, [this] { return _txQueue.size() < DOMOTIC_PI_SERIAL_TX_QUEUE; });
+
+	_txQueue.push_back(std::move(command));
+
+	if (!_writerRunning) {
+		_writerRunning = true;
+		_writerThread = std::thread(&SerialInterface::_writer_loop, this);
+	}
+
+	_txChange.notify_all();
+}
+
+void SerialInterface::_writer_loop()
+{
+	std::deque<TxCommand> batch;
+	std::unique_lock<std::mutex> lock(_txLock);
+
+	while (true) {
+		_txChange.wait(lock, [this] { return !_txQueue.empty() || !_writerRunning; });
+
+		if (_txQueue.empty()) {
+			break;
+		}
+
+		// Whole queue taken at once, callers queue again without waiting for the write
+		batch.swap(_txQueue);
+		_txWriting = true;
+		_txChange.notify_all();
+		lock.unlock();
+
+		_txBatch.clear();
+		for (auto& command : batch) {
+			_txBatch.insert(_txBatch.end(), command.data.begin(), command.data.end());
+		}
+
+		if (_write_all(_txBatch.data(), _txBatch.size())) {
+			_txBytes += _txBatch.size();
+		}
+		_txWrites++;
+
+		for (auto& command : batch) {
+			_txDrain.recordSince(command.queued);
+		}
+		batch.clear();
+
+		lock.lock();
+		_txWriting = false;
+		_txChange.notify_all();
+	}
+}
+
+bool SerialInterface::_write_all(const char* data, size_t length)
 {
-#ifdef DOMOTIC_PI_THREAD_SAFE
-	std::unique_lock<std::mutex> lck(_txOwn);
-#endif
+	while (length > 0) {
+		ssize_t written = ::write(_serial, data, length);
+
+		if (written < 0) {
+			if (errno == EINTR || errno == EAGAIN) {
+				continue;
+			}
+
+			console->error("SerialInterface::_write_all : write failed on {} ({}).", _port, strerror(errno));
+			return false;
+		}
+
+		data += written;
+		length -= written;
+	}
+
+	return true;
+}
+
+void SerialInterface::_start_reader()
+{
+	if (_readerThread.joinable()) {
+		return;
+	}
 
-	serialPrintf(_serial, "{}", message.c_str());
+	if (_epollFd < 0) {
+		_epollFd = epoll_create1(EPOLL_CLOEXEC);
+		_wakeupFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	}
+
+	if (_epollFd < 0 || _wakeupFd < 0) {
+		console->error("SerialInterface::_start_reader : epoll or eventfd creation failed ({}).", strerror(errno));
+		return;
+	}
 
-	console->debug("SerialInterface::read : wrote message: '{}'.", message.c_str());
+	struct epoll_event event = {};
+	event.events = EPOLLIN;
+
+	event.data.fd = _wakeupFd;
+	epoll_ctl(_epollFd, EPOLL_CTL_ADD, _wakeupFd, &event);
+
+	event.data.fd = _serial;
+	if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, _serial, &event) < 0 && errno != EEXIST) {
+		console->error("SerialInterface::_start_reader : could not watch serial port {} ({}).", _port, strerror(errno));
+		return;
+	}
+
+	_readerRunning = true;
+	_readerThread = std::thread(&SerialInterface::_reader_loop, this);
+
+	console->info("SerialInterface::_start_reader : receiving frames from {}.", _port);
+}
+
+void SerialInterface::_reader_loop()
+{
+	std::array<struct epoll_event, 2> events;
+
+	_readerId = std::this_thread::get_id();
+
+	while (_readerRunning) {
+		int count = epoll_wait(_epollFd, events.data(), events.size(), -1);
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			console->error("SerialInterface::_reader_loop : epoll wait failed ({}).", strerror(errno));
+			break;
+		}
+
+		for (int i = 0; i < count; ++i) {
+			if (events[i].data.fd == _wakeupFd) {
+				uint64_t wakeups;
+				if (::read(_wakeupFd, &wakeups, sizeof(wakeups)) < 0 && errno != EAGAIN) {
+					console->error("SerialInterface::_reader_loop : eventfd read failed ({}).", strerror(errno));
+				}
+				continue;
+			}
+
+			Timestamp timestamp = Clock::now();
+			std::unique_lock<std::mutex> lock(_rxLock);
+
+			if (!_receive()) {
+				_readerRunning = false;
+				break;
+			}
+
+			std::shared_ptr<const FrameCallbacks> frameCallbacks;
+			{
+				std::unique_lock<std::mutex> callbacksLock(_callbacksLock);
+				frameCallbacks = _frameCallbacks;
+			}
+
+			// Without callbacks, frames are kept for read
+			if (frameCallbacks->empty()) {
+				continue;
+			}
+
+			size_t offset, length, total;
+			while (_next_frame(offset, length, total)) {
+				std::string_view frame = _rxRing.view(offset, length, _rxScratch);
+				_rxFrames++;
+
+				for (auto& it : *frameCallbacks) {
+					try {
+						it.second(frame, timestamp);
+					}
+					catch (std::exception& e) {
+						console->error("SerialInterface::_reader_loop : frame callback failed on {} : {}", _port, e.what());
+					}
+				}
+
+				_rxRing.consume(total);
+				_rxScanned = 0;
+			}
+		}
+	}
+}
+
+bool SerialInterface::_receive()
+{
+	if (_rxRing.space() == 0) {
+		_make_room();
+	}
+
+	// Level triggered: a single read per wake up, remaining bytes wake the loop again
+	auto span = _rxRing.writeSpan();
+	ssize_t size = ::read(_serial, span.first, span.second);
+
+	if (size < 0) {
+		if (errno == EAGAIN || errno == EINTR) {
+			return true;
+		}
+
+		console->error("SerialInterface::_receive : read failed on {} ({}), receiving stopped.", _port, strerror(errno));
+		return false;
+	}
+
+	if (size == 0) {
+		console->error("SerialInterface::_receive : {} closed, receiving stopped.", _port);
+		return false;
+	}
+
+	_rxRing.commit(size);
+	_rxBytes += size;
+
+	return true;
+}
+
+bool SerialInterface::_next_frame(size_t& offset, size_t& length, size_t& total)
+{
+	if (_framing == framing_delimiter) {
+		// Rest of a frame too long for the ring, dropped up to its delimiter
+		if (_rxDiscarding) {
+			size_t end = _rxRing.find(_delimiter);
+			size_t dropped = end == ByteRing::npos ? _rxRing.size() : end + 1;
+
+			_rxRing.consume(dropped);
+			_rxDropped += dropped;
+			_rxScanned = 0;
+
+			if (end == ByteRing::npos) {
+				return false;
+			}
+			_rxDiscarding = false;
+		}
+
+		// Bytes already scanned by a previous call are not searched again
+		size_t end = _rxRing.find(_delimiter, _rxScanned);
+		if (end == ByteRing::npos) {
+			_rxScanned = _rxRing.size();
+			return false;
+		}
+
+		offset = 0;
+		length = end;
+		total = end + 1;
+
+		return true;
+	}
+
+	// Rest of a frame too long for the ring, dropped up to its announced length
+	if (_rxSkip > 0) {
+		size_t dropped = std::min(_rxSkip, _rxRing.size());
+
+		_rxRing.consume(dropped);
+		_rxDropped += dropped;
+		_rxSkip -= dropped;
+		_rxScanned = 0;
+
+		if (_rxSkip > 0) {
+			return false;
+		}
+	}
+
+	if (_rxRing.size() < _lengthPrefix) {
+		return false;
+	}
+
+	length = 0;
+	for (unsigned int i = 0; i < _lengthPrefix; ++i) {
+		length = (length << 8) | _rxRing.at(i);
+	}
+
+	if (_rxRing.size() < _lengthPrefix + length) {
+		return false;
+	}
+
+	offset = _lengthPrefix;
+	total = _lengthPrefix + length;
+
+	return true;
+}
+
+void SerialInterface::_make_room()
+{
+	size_t offset, length, total;
+
+	// Oldest frame nobody read, or a frame too long for the ring
+	if (_next_frame(offset, length, total)) {
+		_rxRing.consume(total);
+		_rxDropped += total;
+	}
+	else {
+		total = _rxRing.size();
+
+		// Next prefix is past the end of the frame, not in the bytes following the ring
+		if (_framing == framing_length && total >= _lengthPrefix) {
+			length = 0;
+			for (unsigned int i = 0; i < _lengthPrefix; ++i) {
+				length = (length << 8) | _rxRing.at(i);
+			}
+			_rxSkip = _lengthPrefix + length - total;
+		}
+
+		_rxRing.clear();
+		_rxDropped += total;
+		_rxDiscarding = _framing == framing_delimiter;
+	}
+
+	_rxScanned = 0;
+
+	console->warn("SerialInterface::_make_room : receive buffer of {} full, {} bytes dropped.", _port, total);
 }
 
 std::shared_ptr<SerialInterface> SerialInterface::from_json(const rapidjson::Value& config, DomoticNode_ptr parentNode)
@@ -101,17 +626,38 @@ std::shared_ptr<SerialInterface> SerialInterface::from_json(const rapidjson::Val
 	int txPin = config.HasMember("serialTxPin") ? config["serialTxPin"].GetInt() : -1;
 	int rxPin = config.HasMember("serialRxPin") ? config["serialRxPin"].GetInt() : -1;
 
-	return std::make_shared<SerialInterface>(
+	auto serialInterface = std::make_shared<SerialInterface>(
 		config["id"].GetString(),
 		config["serialPort"].GetString(),
 		config["serialBaud"].GetInt(),
 		txPin,
 		rxPin);
+
+	if (config.HasMember("lengthPrefix")) {
+		serialInterface->setLengthPrefix(config["lengthPrefix"].GetUint());
+	}
+	else if (config.HasMember("frameDelimiter")) {
+		serialInterface->setDelimiter(config["frameDelimiter"].GetString()[0]);
+	}
+
+	if (config.HasMember("linkWindow")) {
+		serialInterface->getLink()->setWindow(config["linkWindow"].GetUint());
+	}
+
+	if (config.HasMember("linkAckTimeout")) {
+		serialInterface->getLink()->setAckTimeout(std::chrono::milliseconds(config["linkAckTimeout"].GetUint()));
+	}
+
+	if (config.HasMember("linkRetries")) {
+		serialInterface->getLink()->setRetries(config["linkRetries"].GetUint());
+	}
+
+	return serialInterface;
 }
 
 rapidjson::Document SerialInterface::to_json() const
 {
-	console->debug("SerialInterface::to_json : serializing serial comm '{}'.", 
+	console->debug("SerialInterface::to_json : serializing serial comm '{}'.",
 		_port.c_str());
 
 	rapidjson::Document serialInterface = IComm::to_json();
@@ -128,5 +674,22 @@ rapidjson::Document SerialInterface::to_json() const
 	if (_pinRX.getPin() >= 0)
 		serialInterface.AddMember("serialRxPin", _pinRX.getPin(), serialInterface.GetAllocator());
 
+	if (getFraming() == framing_length) {
+		serialInterface.AddMember("lengthPrefix", getLengthPrefix(), serialInterface.GetAllocator());
+	}
+	else if (getDelimiter() != '\n') {
+		rapidjson::Value delimiter;
+		char value = getDelimiter();
+		delimiter.SetString(&value, 1, serialInterface.GetAllocator());
+		serialInterface.AddMember("frameDelimiter", delimiter, serialInterface.GetAllocator());
+	}
+
+	std::unique_lock<std::mutex> lock(_linkOwn);
+	if (_link != nullptr) {
+		serialInterface.AddMember("linkWindow", _link->getWindow(), serialInterface.GetAllocator());
+		serialInterface.AddMember("linkAckTimeout", (unsigned int)_link->getAckTimeout().count(), serialInterface.GetAllocator());
+		serialInterface.AddMember("linkRetries", _link->getRetries(), serialInterface.GetAllocator());
+	}
+
 	return serialInterface;
-}
\ No newline at end of file
+}
@@ -0,0 +1,309 @@
+#include <SerialLink.h>
+
+#include <Clock.h>
+#include <domoticPi.h>
+#include <SerialInterface.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace domotic_pi;
+
+namespace {
+
+	constexpr size_t setFrameSize = 11;
+	constexpr size_t ackFrameSize = 6;
+
+	// Seq is a single byte. Every sent seq stays reserved until acked or timed out, superseded
+	// commands included, so at most a window of seqs are in use and a late ack has to be
+	// delayed by 256 - window commands to match a newer command (of the same module)
+	constexpr unsigned int maxWindow = 64;
+
+	// Retransmission delay doubles with each attempt, up to 8 times the ack timeout
+	constexpr unsigned int maxBackoffShift = 3;
+
+}
+
+SerialLink::SerialLink(SerialInterface& serial) :
+	_serial(serial), _timerWheel(TimerWheel::load()),
+	_nextSeq(0), _window(DOMOTIC_PI_SERIAL_LINK_WINDOW),
+	_ackTimeout(DOMOTIC_PI_SERIAL_LINK_ACK_MS), _retries(DOMOTIC_PI_SERIAL_LINK_RETRIES),
+	_txFrames(0), _retransmits(0), _acked(0), _failed(0), _superseded(0), _crcErrors(0)
+{
+	_serial.setLengthPrefix(1);
+
+	_retransmitTimer = _timerWheel->newTimer([this] {
+		_retransmit();
+	});
+
+	_frameToken = _serial.addFrameCallback([this](std::string_view frame, Timestamp) {
+		_frame_received(frame);
+	});
+
+	console->info("SerialLink::ctor : binary protocol started on {}.", _serial.getPort());
+}
+
+SerialLink::~SerialLink()
+{
+	_frameToken.reset();
+	_timerWheel->cancel(_retransmitTimer);
+
+	std::unique_lock<std::mutex> lock(_linkLock);
+
+	if (!_inFlight.empty() || !_queued.empty()) {
+		console->warn("SerialLink::dtor : {} commands not acked on {}.",
+			_inFlight.size() + _queued.size(), _serial.getPort());
+	}
+}
+
+uint16_t SerialLink::crc16(const uint8_t* data, size_t length, uint16_t crc)
+{
+	for (size_t i = 0; i < length; ++i) {
+		crc ^= (uint16_t)data[i] << 8;
+		for (int bit = 0; bit < 8; ++bit) {
+			crc = crc & 0x8000 ? (uint16_t)(crc << 1 ^ 0x1021) : (uint16_t)(crc << 1);
+		}
+	}
+
+	return crc;
+}
+
+void SerialLink::send(uint8_t index, int32_t value)
+{
+	std::unique_lock<std::mutex> lock(_linkLock);
+
+	// Older command of the same module is superseded: not sent again, but its seq stays
+	// reserved (and counted in the window) until its ack comes back or its deadline passes
+	auto inFlight = std::find_if(_inFlight.begin(), _inFlight.end(), [index](const Command& command) {
+		return command.index == index && !command.superseded;
+	});
+	if (inFlight != _inFlight.end()) {
+		inFlight->superseded = true;
+		_superseded++;
+	}
+
+	auto queued = std::find_if(_queued.begin(), _queued.end(), [index](const Command& command) {
+		return command.index == index;
+	});
+	if (queued != _queued.end()) {
+		queued->value = value;
+		_superseded++;
+	}
+	else {
+		_queued.push_back(Command{ 0, index, value, 0, Timestamp(), false });
+	}
+
+	_fill_window();
+	_arm_timer();
+}
+
+void SerialLink::setWindow(unsigned int window)
+{
+	if (window == 0 || window > maxWindow) {
+		console->error("SerialLink::setWindow : window must be between 1 and {}.", maxWindow);
+		throw std::out_of_range("Serial link window must be between 1 and 64.");
+	}
+
+	std::unique_lock<std::mutex> lock(_linkLock);
+
+	_window = window;
+	_fill_window();
+	_arm_timer();
+}
+
+unsigned int SerialLink::getWindow() const
+{
+	std::unique_lock<std::mutex> lock(_linkLock);
+	return _window;
+}
+
+void SerialLink::setAckTimeout(std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(_linkLock);
+	_ackTimeout = timeout;
+}
+
+std::chrono::milliseconds SerialLink::getAckTimeout() const
+{
+	std::unique_lock<std::mutex> lock(_linkLock);
+	return _ackTimeout;
+}
+
+void SerialLink::setRetries(unsigned int retries)
+{
+	std::unique_lock<std::mutex> lock(_linkLock);
+	_retries = retries;
+}
+
+unsigned int SerialLink::getRetries() const
+{
+	std::unique_lock<std::mutex> lock(_linkLock);
+	return _retries;
+}
+
+size_t SerialLink::getPendingCount() const
+{
+	std::unique_lock<std::mutex> lock(_linkLock);
+
+	size_t superseded = std::count_if(_inFlight.begin(), _inFlight.end(), [](const Command& command) {
+		return command.superseded;
+	});
+
+	return _inFlight.size() - superseded + _queued.size();
+}
+
+rapidjson::Document SerialLink::stats_to_json() const
+{
+	rapidjson::Document stats(rapidjson::kObjectType);
+
+	stats.AddMember("tx_frames", _txFrames.load(), stats.GetAllocator());
+	stats.AddMember("retransmits", _retransmits.load(), stats.GetAllocator());
+	stats.AddMember("acked", _acked.load(), stats.GetAllocator());
+	stats.AddMember("failed", _failed.load(), stats.GetAllocator());
+	stats.AddMember("superseded", _superseded.load(), stats.GetAllocator());
+	stats.AddMember("crc_errors", _crcErrors.load(), stats.GetAllocator());
+	stats.AddMember("pending", (uint64_t)getPendingCount(), stats.GetAllocator());
+
+	return stats;
+}
+
+void SerialLink::_frame_received(std::string_view frame)
+{
+	// Other frames of the interface belong to serial inputs
+	if (frame.size() != ackFrameSize - 1 || (frame[0] != link_ack && frame[0] != link_nack)) {
+		return;
+	}
+
+	uint8_t bytes[ackFrameSize] = { (uint8_t)(ackFrameSize - 1) };
+	std::copy(frame.begin(), frame.end(), bytes + 1);
+
+	if (crc16(bytes, ackFrameSize - 2) != (uint16_t)(bytes[ackFrameSize - 2] << 8 | bytes[ackFrameSize - 1])) {
+		_crcErrors++;
+		console->warn("SerialLink::_frame_received : frame with a wrong CRC received on {}.", _serial.getPort());
+		return;
+	}
+
+	uint8_t seq = bytes[2];
+	uint8_t index = bytes[3];
+
+	std::unique_lock<std::mutex> lock(_linkLock);
+
+	// Ack of a command already acked or timed out is ignored
+	auto command = std::find_if(_inFlight.begin(), _inFlight.end(), [seq, index](const Command& command) {
+		return command.seq == seq && command.index == index;
+	});
+	if (command == _inFlight.end()) {
+		return;
+	}
+
+	if (command->superseded) {
+		// Seq released, the newer command of the module is in charge
+		_inFlight.erase(command);
+		_fill_window();
+	}
+	else if (frame[0] == link_nack) {
+		console->debug("SerialLink::_frame_received : command {} refused on {}, sent again after backoff.", seq, _serial.getPort());
+
+		// Sent again by the retransmit timer, within the retry limit
+		Timestamp retry = Clock::now() + _backoff(command->attempts) / 2;
+		command->deadline = std::min(command->deadline, retry);
+	}
+	else {
+		_inFlight.erase(command);
+		_acked++;
+
+		_fill_window();
+	}
+
+	_arm_timer();
+}
+
+void SerialLink::_retransmit()
+{
+	std::unique_lock<std::mutex> lock(_linkLock);
+
+	Timestamp now = Clock::now();
+
+	for (auto command = _inFlight.begin(); command != _inFlight.end(); ) {
+		if (command->deadline > now) {
+			++command;
+			continue;
+		}
+
+		if (command->superseded) {
+			command = _inFlight.erase(command);
+			continue;
+		}
+
+		if (command->attempts > _retries) {
+			console->error("SerialLink::_retransmit : command {} of module {} not acked on {}, given up.",
+				command->seq, command->index, _serial.getPort());
+
+			_failed++;
+			command = _inFlight.erase(command);
+			continue;
+		}
+
+		_retransmits++;
+		_transmit(*command);
+		++command;
+	}
+
+	_fill_window();
+	_arm_timer();
+}
+
+void SerialLink::_transmit(Command& command)
+{
+	uint8_t frame[setFrameSize] = {
+		(uint8_t)(setFrameSize - 1),
+		link_set,
+		command.seq,
+		command.index,
+		(uint8_t)((uint32_t)command.value >> 24),
+		(uint8_t)((uint32_t)command.value >> 16),
+		(uint8_t)((uint32_t)command.value >> 8),
+		(uint8_t)command.value
+	};
+
+	uint16_t crc = crc16(frame, setFrameSize - 2);
+	frame[setFrameSize - 2] = (uint8_t)(crc >> 8);
+	frame[setFrameSize - 1] = (uint8_t)crc;
+
+	_serial.write(frame, setFrameSize);
+
+	command.attempts++;
+	command.deadline = Clock::now() + _backoff(command.attempts);
+	_txFrames++;
+}
+
+std::chrono::milliseconds SerialLink::_backoff(unsigned int attempts) const
+{
+	return _ackTimeout * (1 << std::min(attempts - 1, maxBackoffShift));
+}
+
+void SerialLink::_fill_window()
+{
+	while (_inFlight.size() < _window && !_queued.empty()) {
+		Command command = _queued.front();
+		_queued.pop_front();
+
+		command.seq = _nextSeq++;
+		_transmit(command);
+		_inFlight.push_back(command);
+	}
+}
+
+void SerialLink::_arm_timer()
+{
+	if (_inFlight.empty()) {
+		return;
+	}
+
+	Timestamp deadline = std::min_element(_inFlight.begin(), _inFlight.end(), [](const Command& a, const Command& b) {
+		return a.deadline < b.deadline;
+	})->deadline;
+
+	auto delay = std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now());
+	_timerWheel->arm(_retransmitTimer, std::max(delay, std::chrono::milliseconds::zero()));
+}
@@ -1,22 +1,34 @@
 #include <SerialOutput.h>
 
 #include <CommFactory.h>
+#include <DomoticNode.h>
 #include <domoticPi.h>
 #include <exceptions.h>
 
+#include <stdexcept>
+
 using namespace domotic_pi;
 
 const bool SerialOutput::_factoryRegistration =
 	OutputFactory::initializer_registration("SerialOutput", SerialOutput::from_json);
 
-SerialOutput::SerialOutput(const std::string& id, std::shared_ptr<SerialInterface> serialComm, int min_range, int max_range) : 
-	IOutput(id), _serial(serialComm), _range_min(min_range), _range_max(max_range)
+SerialOutput::SerialOutput(const std::string& id, std::shared_ptr<SerialInterface> serialComm, int min_range, int max_range, int linkIndex) : 
+	IOutput(id), _serial(serialComm), _range_min(min_range), _range_max(max_range), _linkIndex(linkIndex)
 {
 	if (serialComm == nullptr) {
 		console->error("SerialOutput::ctor : given serial interface can not be null.");
 		throw domotic_pi_exception("Serial interface can not be null");
 	}
 
+	if (linkIndex > 255) {
+		console->error("SerialOutput::ctor : module index of output '{}' must be between 0 and 255.", id.c_str());
+		throw std::out_of_range("Serial output module index must be between 0 and 255.");
+	}
+
+	if (linkIndex >= 0) {
+		_link = _serial->getLink();
+	}
+
 	_value = min_range;
 
 #ifdef DOMOTIC_PI_APPLE_HOMEKIT
@@ -43,27 +55,27 @@ SerialOutput::~SerialOutput()
 	setValue(_range_min);
 }
 
-void SerialOutput::setState(OutState newState)
+void SerialOutput::setState(OutState newState, Timestamp timestamp)
 {
 	switch (newState) {
 	case ON:
-		setValue(_range_max);
+		setValue(_range_max, timestamp);
 		break;
 	case OFF:
-		setValue(_range_min);
+		setValue(_range_min, timestamp);
 		break;
 	case TOGGLE:
 		if (_value > _range_min)
-			setValue(_range_min);
+			setValue(_range_min, timestamp);
 		else
-			setValue(_range_max);
+			setValue(_range_max, timestamp);
 		break;
 	default:
 		break;
 	}
 }
 
-void SerialOutput::setValue(int newValue)
+void SerialOutput::setValue(int newValue, Timestamp timestamp)
 {
 	// Check given value range and adjust it if necessary
 	if (newValue < _range_min)
@@ -72,16 +84,23 @@ void SerialOutput::setValue(int newValue)
 	if (newValue > _range_max)
 		newValue = _range_max;
 
-	// Build serial command string
-	std::string cmd(getID());
-	cmd.append(std::to_string(newValue));
-
 #ifdef DOMOTIC_PI_THREAD_SAFE
 	std::unique_lock<std::mutex> lck(_valueLock);
 #endif
 
-	// Send command through serial interface
-	_serial->write(cmd);
+	// Send command through serial interface, acked and sent again by the link if binary
+	if (_link != nullptr) {
+		_link->send((uint8_t)_linkIndex, newValue);
+	}
+	else {
+		std::string cmd(getID());
+		cmd.append(std::to_string(newValue));
+
+		// Pending command of this output is replaced if not written yet
+		_serial->write(cmd, getID());
+	}
+
+	_trace_command(timestamp);
 
 	_value = newValue;
 
@@ -106,11 +125,26 @@ std::shared_ptr<SerialOutput> SerialOutput::from_json(const rapidjson::Value& co
 		serialComm = std::dynamic_pointer_cast<SerialInterface>(CommFactory::from_json(serialInterface, parentNode));
 	}
 
+	int linkIndex = -1;
+	if (config.HasMember("protocol") && std::string(config["protocol"].GetString()) == "binary") {
+		if (!config.HasMember("serialIndex")) {
+			console->error("SerialOutput::from_json : binary output '{}' needs a serialIndex.", config["id"].GetString());
+			throw domotic_pi_exception("Binary serial output needs a module index.");
+		}
+		linkIndex = config["serialIndex"].GetInt();
+	}
+
 	return std::make_shared<SerialOutput>(
 		config["id"].GetString(),
 		serialComm,
 		config["range_min"].GetInt(),
-		config["range_max"].GetInt());
+		config["range_max"].GetInt(),
+		linkIndex);
+}
+
+int SerialOutput::getLinkIndex() const
+{
+	return _linkIndex;
 }
 
 rapidjson::Document SerialOutput::to_json() const
@@ -128,5 +162,10 @@ rapidjson::Document SerialOutput::to_json() const
 	output.AddMember("range_min", _range_min, output.GetAllocator());
 	output.AddMember("range_max", _range_max, output.GetAllocator());
 
+	if (_linkIndex >= 0) {
+		output.AddMember("protocol", "binary", output.GetAllocator());
+		output.AddMember("serialIndex", _linkIndex, output.GetAllocator());
+	}
+
 	return output;
 }
\ No newline at end of file
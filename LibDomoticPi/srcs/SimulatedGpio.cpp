@@ -0,0 +1,352 @@
+#include <SimulatedGpio.h>
+
+#include <Clock.h>
+#include <domoticPi.h>
+#include <exceptions.h>
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+using namespace domotic_pi;
+
+SimulatedGpio::SimulatedGpio()
+	: _edgeCount(0), _recordWrites(true), _batchCounter(0), _generatorRunning(true)
+{
+}
+
+SimulatedGpio::~SimulatedGpio()
+{
+	std::unique_lock<std::mutex> lock(_gpioLock);
+	_generatorRunning = false;
+	_generatorChange.notify_all();
+	lock.unlock();
+
+	if (_generatorThread.joinable()) {
+		_generatorThread.join();
+	}
+}
+
+int SimulatedGpio::setup()
+{
+	console->info("SimulatedGpio::setup : simulated GPIO ready.");
+
+	return 0;
+}
+
+const char * SimulatedGpio::getName() const
+{
+	return "simulated";
+}
+
+void SimulatedGpio::setMode(int pin, GpioMode mode)
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(_gpioLock);
+	_pins[pin].mode = mode;
+}
+
+void SimulatedGpio::setPull(int pin, GpioPull pull)
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(_gpioLock);
+	if (_pins[pin].mode == gpio_input && pull != pull_off) {
+		_pins[pin].level = pull == pull_up ? 1 : 0;
+	}
+}
+
+void SimulatedGpio::write(int pin, int value)
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		return;
+	}
+
+	Write pinWrite{ Clock::now(), pin, value ? 1 : 0, 0 };
+	WriteCallback callback;
+
+	{
+		std::unique_lock<std::mutex> lock(_gpioLock);
+
+		pinWrite.batch = ++_batchCounter;
+		_pins[pin].level = pinWrite.value;
+		if (_recordWrites) {
+			_writes.push_back(pinWrite);
+		}
+
+		callback = _writeCallback;
+	}
+
+	if (callback != nullptr) {
+		callback(pinWrite);
+	}
+}
+
+void SimulatedGpio::writeBanks(const GpioBanks& banks)
+{
+	std::vector<Write> pinWrites;
+	WriteCallback callback;
+
+	{
+		std::unique_lock<std::mutex> lock(_gpioLock);
+
+		Timestamp timestamp = Clock::now();
+		uint64_t batch = ++_batchCounter;
+
+		for (size_t bank = 0; bank < banks.size(); ++bank) {
+			for (uint64_t changed = banks[bank].set | banks[bank].clear; changed; changed &= changed - 1) {
+				int bit = __builtin_ctzll(changed);
+				int pin = (int)(bank * 64 + bit);
+				if (pin > DOMOTIC_PI_MAX_PIN) {
+					break;
+				}
+
+				Write pinWrite{ timestamp, pin, (banks[bank].clear >> bit) & 1 ? 0 : 1, batch };
+				_pins[pin].level = pinWrite.value;
+				pinWrites.push_back(pinWrite);
+			}
+		}
+
+		if (_recordWrites) {
+			_writes.insert(_writes.end(), pinWrites.begin(), pinWrites.end());
+		}
+
+		callback = _writeCallback;
+	}
+
+	if (callback != nullptr) {
+		for (auto& pinWrite : pinWrites) {
+			callback(pinWrite);
+		}
+	}
+}
+
+int SimulatedGpio::read(int pin)
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		return 0;
+	}
+
+	std::unique_lock<std::mutex> lock(_gpioLock);
+	return _pins[pin].level;
+}
+
+void SimulatedGpio::readBanks(const GpioLevels& mask, GpioLevels& levels)
+{
+	std::unique_lock<std::mutex> lock(_gpioLock);
+
+	for (size_t bank = 0; bank < mask.size(); ++bank) {
+		levels[bank] = 0;
+		for (uint64_t pins = mask[bank]; pins; pins &= pins - 1) {
+			int bit = __builtin_ctzll(pins);
+			int pin = (int)(bank * 64 + bit);
+			if (pin > DOMOTIC_PI_MAX_PIN) {
+				break;
+			}
+
+			levels[bank] |= (uint64_t)_pins[pin].level << bit;
+		}
+	}
+}
+
+int SimulatedGpio::setEdgeCallback(int pin, GpioEdge edge, GpioEdgeCallback callback)
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		return -1;
+	}
+
+	std::unique_lock<std::mutex> lock(_gpioLock);
+
+	_pins[pin].edge = edge;
+	if (edge == edge_none) {
+		_pins[pin].callback = nullptr;
+	}
+	else if (callback != nullptr) {
+		_pins[pin].callback = callback;
+	}
+
+	return 0;
+}
+
+bool SimulatedGpio::setLevel(int pin, int level, Timestamp timestamp)
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		return false;
+	}
+
+	level = level ? 1 : 0;
+	GpioEdgeCallback callback;
+
+	{
+		std::unique_lock<std::mutex> lock(_gpioLock);
+
+		Pin& simPin = _pins[pin];
+		if (simPin.level == level) {
+			return false;
+		}
+		simPin.level = level;
+
+		bool raise = simPin.edge == edge_both
+			|| (simPin.edge == edge_rising && level == 1)
+			|| (simPin.edge == edge_falling && level == 0);
+
+		if (!raise || simPin.callback == nullptr) {
+			return false;
+		}
+
+		callback = simPin.callback;
+	}
+
+	_edgeCount.fetch_add(1, std::memory_order_relaxed);
+
+	try {
+		callback(level, timestamp == Timestamp() ? Clock::now() : timestamp);
+	}
+	catch (std::exception& e) {
+		console->warn("SimulatedGpio::setLevel : exception during edge callback : {}", e.what());
+	}
+
+	return true;
+}
+
+size_t SimulatedGpio::injectEdges(int pin, size_t count, std::chrono::nanoseconds interval)
+{
+	Timestamp timestamp = Clock::now();
+	size_t raised = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		if (setLevel(pin, !read(pin), timestamp)) {
+			++raised;
+		}
+		timestamp += std::chrono::duration_cast<Timestamp::duration>(interval);
+	}
+
+	return raised;
+}
+
+void SimulatedGpio::startEdgeGenerator(int pin, double rate)
+{
+	if (Clock::isVirtual()) {
+		console->error("SimulatedGpio::startEdgeGenerator : edge generators need a real clock.");
+		throw domotic_pi_exception("Edge generator not available on a virtual clock.");
+	}
+
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN || rate <= 0) {
+		throw std::out_of_range("Edge generator needs a valid pin and a positive rate.");
+	}
+
+	auto interval = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(1.0 / rate));
+
+	std::unique_lock<std::mutex> lock(_gpioLock);
+
+	_generators[pin] = std::make_pair(interval, Clock::now() + interval);
+	if (!_generatorThread.joinable()) {
+		_generatorThread = std::thread(&SimulatedGpio::_generator_loop, this);
+	}
+
+	_generatorChange.notify_all();
+
+	console->info("SimulatedGpio::startEdgeGenerator : pin {} toggled at {} edges/s.", pin, rate);
+}
+
+void SimulatedGpio::stopEdgeGenerator(int pin)
+{
+	std::unique_lock<std::mutex> lock(_gpioLock);
+
+	if (pin < 0) {
+		_generators.clear();
+	}
+	else {
+		_generators.erase(pin);
+	}
+
+	_generatorChange.notify_all();
+}
+
+uint64_t SimulatedGpio::getEdgeCount() const
+{
+	return _edgeCount.load(std::memory_order_relaxed);
+}
+
+void SimulatedGpio::setWriteCallback(WriteCallback callback)
+{
+	std::unique_lock<std::mutex> lock(_gpioLock);
+	_writeCallback = callback;
+}
+
+void SimulatedGpio::setRecordWrites(bool record)
+{
+	std::unique_lock<std::mutex> lock(_gpioLock);
+	_recordWrites = record;
+}
+
+std::vector<SimulatedGpio::Write> SimulatedGpio::getWrites() const
+{
+	std::unique_lock<std::mutex> lock(_gpioLock);
+	return _writes;
+}
+
+bool SimulatedGpio::writtenTogether(const std::vector<int>& pins) const
+{
+	std::unique_lock<std::mutex> lock(_gpioLock);
+
+	uint64_t batch = 0;
+	for (int pin : pins) {
+		auto last = std::find_if(_writes.rbegin(), _writes.rend(), [pin](const Write& pinWrite) {
+			return pinWrite.pin == pin;
+		});
+
+		if (last == _writes.rend() || (batch != 0 && last->batch != batch)) {
+			return false;
+		}
+		batch = last->batch;
+	}
+
+	return true;
+}
+
+void SimulatedGpio::clearWrites()
+{
+	std::unique_lock<std::mutex> lock(_gpioLock);
+	_writes.clear();
+}
+
+void SimulatedGpio::_generator_loop()
+{
+	std::unique_lock<std::mutex> lock(_gpioLock);
+
+	while (_generatorRunning) {
+		if (_generators.empty()) {
+			_generatorChange.wait(lock);
+			continue;
+		}
+
+		// Earliest generator due
+		auto next = _generators.begin();
+		for (auto it = _generators.begin(); it != _generators.end(); ++it) {
+			if (it->second.second < next->second.second) {
+				next = it;
+			}
+		}
+
+		Timestamp due = next->second.second;
+		if (Clock::now() < due) {
+			_generatorChange.wait_until(lock, due);
+			continue;
+		}
+
+		// Late edges keep their planned time, so the generated rate holds on average
+		int pin = next->first;
+		next->second.second += next->second.first;
+		int level = !_pins[pin].level;
+
+		lock.unlock();
+		setLevel(pin, level, due);
+		lock.lock();
+	}
+}
@@ -0,0 +1,343 @@
+#include <TimerWheel.h>
+
+#include <Clock.h>
+#include <domoticPi.h>
+
+#include <exception>
+#include <limits>
+
+using namespace domotic_pi;
+
+std::shared_ptr<TimerWheel> TimerWheel::_timerWheel;
+
+TimerWheel::Timer::Timer(std::function<void()> callback)
+	: _callback(callback), _expireTick(0), _level(0), _slot(0), _prev(nullptr), _next(nullptr)
+{
+}
+
+TimerWheel::TimerWheel()
+	: _start(Clock::now()),
+	_tick(std::chrono::milliseconds(DOMOTIC_PI_TIMER_TICK_MS)),
+	_occupied(), _currentTick(0), _wakeTick(std::numeric_limits<uint64_t>::max()), _armedCount(0),
+	_running(nullptr), _wheelRunning(true)
+{
+	for (auto& level : _wheel) {
+		level.fill(nullptr);
+	}
+
+	// On a virtual clock the wheel is driven by the clock owner through advance
+	if (!Clock::isVirtual()) {
+		_wheelThread = std::thread(&TimerWheel::_wheel_loop, this);
+	}
+
+	console->debug("TimerWheel::ctor : timer wheel started with {} ms tick.", DOMOTIC_PI_TIMER_TICK_MS);
+}
+
+TimerWheel::~TimerWheel()
+{
+	std::unique_lock<std::mutex> lock(_wheelLock);
+	_wheelRunning = false;
+	_wheelChange.notify_all();
+	lock.unlock();
+
+	if (_wheelThread.joinable()) {
+		_wheelThread.join();
+	}
+
+	// Release wheel references to still armed timers
+	lock.lock();
+	for (auto& level : _wheel) {
+		for (auto& slot : level) {
+			while (slot != nullptr) {
+				Timer * timer = slot;
+				_unlink(timer);
+				timer->_armed.reset();
+			}
+		}
+	}
+
+	console->debug("TimerWheel::dtor : timer wheel stopped.");
+}
+
+const std::shared_ptr<TimerWheel> TimerWheel::load()
+{
+	if (_timerWheel == nullptr) {
+		_timerWheel = std::make_shared<TimerWheel>();
+	}
+
+	return _timerWheel;
+}
+
+Timer_ptr TimerWheel::newTimer(std::function<void()> callback)
+{
+	return std::make_shared<Timer>(callback);
+}
+
+void TimerWheel::arm(const Timer_ptr& timer, std::chrono::milliseconds delay)
+{
+	if (delay < std::chrono::milliseconds::zero()) {
+		delay = std::chrono::milliseconds::zero();
+	}
+
+	// Round delay up to the next tick, so a timer never expires early
+	auto delayTicks = (std::chrono::duration_cast<std::chrono::steady_clock::duration>(delay) + _tick
+		- std::chrono::steady_clock::duration(1)) / _tick;
+
+	std::unique_lock<std::mutex> lock(_wheelLock);
+
+	if (timer->_armed != nullptr) {
+		_unlink(timer.get());
+	}
+
+	// An empty wheel can jump straight to current time instead of walking idle ticks
+	uint64_t nowTick = _now_tick();
+	if (_armedCount == 0 && nowTick > _currentTick) {
+		_currentTick = nowTick;
+	}
+
+	timer->_expireTick = std::max(nowTick, _currentTick) + std::max<uint64_t>(delayTicks, 1);
+	timer->_armed = timer;
+	_link(timer.get());
+
+	// Wake wheel thread only if the new timer expires before its planned wake up
+	if (timer->_expireTick < _wakeTick) {
+		_wheelChange.notify_all();
+	}
+}
+
+Timer_ptr TimerWheel::schedule(std::chrono::milliseconds delay, std::function<void()> callback)
+{
+	Timer_ptr timer = newTimer(callback);
+	arm(timer, delay);
+
+	return timer;
+}
+
+void TimerWheel::cancel(const Timer_ptr& timer)
+{
+	if (timer == nullptr) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(_wheelLock);
+
+	if (timer->_armed != nullptr) {
+		_unlink(timer.get());
+		timer->_armed.reset();
+	}
+
+	// Wait for running callback to complete, unless it is the one asking for cancellation
+	if (std::this_thread::get_id() != _wheelThreadId) {
+		_wheelChange.wait(lock, [&] { return _running != timer.get(); });
+
+		// The callback may have re-armed its own timer meanwhile
+		if (timer->_armed != nullptr) {
+			_unlink(timer.get());
+			timer->_armed.reset();
+		}
+	}
+}
+
+bool TimerWheel::isArmed(const Timer_ptr& timer) const
+{
+	std::unique_lock<std::mutex> lock(_wheelLock);
+
+	return timer->_armed != nullptr;
+}
+
+size_t TimerWheel::getArmedCount() const
+{
+	std::unique_lock<std::mutex> lock(_wheelLock);
+
+	return _armedCount;
+}
+
+Timestamp TimerWheel::getNextExpiry() const
+{
+	std::unique_lock<std::mutex> lock(_wheelLock);
+
+	if (_armedCount == 0) {
+		return Timestamp::max();
+	}
+
+	return _start + _tick * _next_event_tick();
+}
+
+void TimerWheel::advance()
+{
+	std::unique_lock<std::mutex> lock(_wheelLock);
+
+	// Callbacks run on the calling thread, which acts as wheel thread meanwhile
+	_wheelThreadId = std::this_thread::get_id();
+
+	_expire(_now_tick(), lock);
+}
+
+uint64_t TimerWheel::_now_tick() const
+{
+	return (Clock::now() - _start) / _tick;
+}
+
+uint64_t TimerWheel::_next_event_tick() const
+{
+	uint64_t nextTick = std::numeric_limits<uint64_t>::max();
+
+	// First occupied slot of the lower level after current one
+	if (_occupied[0]) {
+		unsigned shift = (_currentTick + 1) & _slotMask;
+		uint64_t rotated = shift ? (_occupied[0] >> shift) | (_occupied[0] << (_slots - shift)) : _occupied[0];
+		nextTick = _currentTick + 1 + __builtin_ctzll(rotated);
+	}
+
+	// Upper levels need to be cascaded when the lower level wraps around
+	for (unsigned level = 1; level < _levels; ++level) {
+		if (_occupied[level]) {
+			nextTick = std::min(nextTick, (_currentTick | _slotMask) + 1);
+			break;
+		}
+	}
+
+	return nextTick;
+}
+
+void TimerWheel::_link(Timer * timer)
+{
+	uint64_t expireTick = std::max(timer->_expireTick, _currentTick);
+	uint64_t delta = expireTick - _currentTick;
+
+	// Timers beyond wheel range are parked on the last slot reachable and re-linked on cascade
+	if (delta >= _maxDelta) {
+		expireTick = _currentTick + _maxDelta - 1;
+		delta = _maxDelta - 1;
+	}
+
+	unsigned level = 0;
+	while (delta >= ((uint64_t)1 << (_levelBits * (level + 1)))) {
+		++level;
+	}
+
+	timer->_level = level;
+	timer->_slot = (expireTick >> (_levelBits * level)) & _slotMask;
+
+	Timer *& head = _wheel[level][timer->_slot];
+	timer->_prev = nullptr;
+	timer->_next = head;
+	if (head != nullptr) {
+		head->_prev = timer;
+	}
+	head = timer;
+
+	_occupied[level] |= (uint64_t)1 << timer->_slot;
+	++_armedCount;
+}
+
+void TimerWheel::_unlink(Timer * timer)
+{
+	Timer *& head = _wheel[timer->_level][timer->_slot];
+
+	if (timer->_prev != nullptr) {
+		timer->_prev->_next = timer->_next;
+	}
+	else {
+		head = timer->_next;
+	}
+
+	if (timer->_next != nullptr) {
+		timer->_next->_prev = timer->_prev;
+	}
+
+	timer->_prev = nullptr;
+	timer->_next = nullptr;
+
+	if (head == nullptr) {
+		_occupied[timer->_level] &= ~((uint64_t)1 << timer->_slot);
+	}
+	--_armedCount;
+}
+
+void TimerWheel::_cascade(unsigned level)
+{
+	Timer *& head = _wheel[level][(_currentTick >> (_levelBits * level)) & _slotMask];
+
+	// Move every timer in the slot to its lower level position
+	while (head != nullptr) {
+		Timer * timer = head;
+		_unlink(timer);
+		_link(timer);
+	}
+}
+
+void TimerWheel::_wheel_loop()
+{
+	std::unique_lock<std::mutex> lock(_wheelLock);
+	_wheelThreadId = std::this_thread::get_id();
+
+	while (_wheelRunning) {
+		_wakeTick = _next_event_tick();
+
+		// Sleep until something has to be done on the wheel
+		if (_wakeTick == std::numeric_limits<uint64_t>::max()) {
+			_wheelChange.wait(lock);
+			continue;
+		}
+
+		uint64_t nowTick = _now_tick();
+		if (nowTick < _wakeTick) {
+			_wheelChange.wait_until(lock, _start + _tick * _wakeTick);
+			continue;
+		}
+
+		_expire(nowTick, lock);
+	}
+}
+
+void TimerWheel::_expire(uint64_t nowTick, std::unique_lock<std::mutex>& lock)
+{
+	while (_currentTick < nowTick && _wheelRunning) {
+		// Nothing left on the wheel, idle ticks can be skipped
+		if (_armedCount == 0) {
+			_currentTick = nowTick;
+			break;
+		}
+
+		++_currentTick;
+
+		// Cascade upper levels when lower ones wrap around, starting from the highest
+		unsigned wrappedLevels = 0;
+		while (wrappedLevels < _levels - 1
+			&& ((_currentTick >> (_levelBits * (wrappedLevels + 1))) << (_levelBits * (wrappedLevels + 1))) == _currentTick) {
+			++wrappedLevels;
+		}
+		for (unsigned level = wrappedLevels; level > 0; --level) {
+			_cascade(level);
+		}
+
+		Timer *& head = _wheel[0][_currentTick & _slotMask];
+		while (head != nullptr) {
+			Timer * timer = head;
+			_unlink(timer);
+
+			if (timer->_expireTick > _currentTick) {
+				_link(timer);
+				continue;
+			}
+
+			Timer_ptr expired = std::move(timer->_armed);
+			_running = timer;
+			lock.unlock();
+
+			try {
+				expired->_callback();
+			}
+			catch (std::exception& e) {
+				console->warn("TimerWheel::_expire : exception during timer callback : {}", e.what());
+			}
+
+			expired.reset();
+
+			lock.lock();
+			_running = nullptr;
+			_wheelChange.notify_all();
+		}
+	}
+}
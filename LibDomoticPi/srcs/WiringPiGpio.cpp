@@ -0,0 +1,73 @@
+#include <domoticPiDefine.h>
+
+// Built only when wiringPi support is enabled
+#ifdef DOMOTIC_PI_WIRING_PI
+
+#include <WiringPiGpio.h>
+
+#include <Clock.h>
+
+#include <wiringPi.h>
+
+using namespace domotic_pi;
+
+WiringPiGpio::WiringPiGpio()
+{
+	for (auto& edge : _edges) {
+		edge.store(edge_none, std::memory_order_relaxed);
+	}
+}
+
+int WiringPiGpio::setup()
+{
+	return wiringPiSetup(WPI_MODE_PINS);
+}
+
+const char * WiringPiGpio::getName() const
+{
+	return "wiringPi";
+}
+
+void WiringPiGpio::setMode(int pin, GpioMode mode)
+{
+	pinMode(pin, mode == gpio_output ? OUTPUT : INPUT);
+}
+
+void WiringPiGpio::setPull(int pin, GpioPull pull)
+{
+	pullUpDnControl(pin, pull == pull_up ? PUD_UP : pull == pull_down ? PUD_DOWN : PUD_OFF);
+}
+
+void WiringPiGpio::write(int pin, int value)
+{
+	digitalWrite(pin, value ? HIGH : LOW);
+}
+
+int WiringPiGpio::read(int pin)
+{
+	return digitalRead(pin);
+}
+
+int WiringPiGpio::setEdgeCallback(int pin, GpioEdge edge, GpioEdgeCallback callback)
+{
+	if (pin < 0 || pin > DOMOTIC_PI_MAX_PIN) {
+		return -1;
+	}
+
+	_edges[pin].store(edge, std::memory_order_relaxed);
+
+	std::function<void()> isr;
+	if (callback != nullptr) {
+		isr = [this, pin, callback] {
+			Timestamp timestamp = Clock::now();
+
+			// Single edge interrupts imply the level, reading it back could catch a bounce
+			int edge = _edges[pin].load(std::memory_order_relaxed);
+			callback(edge == edge_rising ? 1 : edge == edge_falling ? 0 : digitalRead(pin), timestamp);
+		};
+	}
+
+	return wiringPiISR(pin, edge, isr);
+}
+
+#endif // DOMOTIC_PI_WIRING_PI
@@ -1,12 +1,12 @@
 #include <domoticPi.h>
 
 #include <domoticPiDefine.h>
+#include <IGpioBackend.h>
 
 #include <rapidjson/error/en.h>
 #include <rapidjson/prettywriter.h>
 #include <rapidjson/stringbuffer.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
-#include <wiringPi.h>
 
 std::shared_ptr<spdlog::logger> domotic_pi::console = spdlog::stdout_color_mt("domoticPi");
 
@@ -23,10 +23,11 @@ int domotic_pi::domoticPiInit()
 		return retval;
 	}
 
-	retval = wiringPiSetup(WPI_MODE_PINS);
+	const std::shared_ptr<IGpioBackend> gpio = IGpioBackend::load();
+	retval = gpio->setup();
 
 	if (retval)
-		console->error("domoticPiInit : wiringPiSetup returned {} code.", retval);
+		console->error("domoticPiInit : {} GPIO setup returned {} code.", gpio->getName(), retval);
 	else
 		console->info("domoticPiInit : domoticPi initialization succesful.");
 